@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include <osg/Geometry>
+#include <osg/Notify>
+#include <osg/PagedLOD>
+#include <osg/Texture>
+#include <osg/Timer>
+#include <osg/TriangleIndexFunctor>
+
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/WriteFile>
+
+#include <osgUtil/Optimizer>
+#include <osgUtil/Simplifier>
+#include <osgUtil/TransformAttributeFunctor>
+
+#include <sstream>
+
+#include "TileBuilder.h"
+
+namespace
+{
+
+struct CollectTriangles
+{
+    CollectTriangles(): _indices(0) {}
+
+    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        if (p1==p2 || p2==p3 || p1==p3) return;
+
+        _indices->push_back(p1);
+        _indices->push_back(p2);
+        _indices->push_back(p3);
+    }
+
+    std::vector<unsigned int>* _indices;
+};
+
+void collectTriangles(const osg::Geometry& geometry, std::vector<unsigned int>& indices)
+{
+    osg::TriangleIndexFunctor<CollectTriangles> collector;
+    collector._indices = &indices;
+    geometry.accept(collector);
+}
+
+bool getVertex(const osg::Array* vertices, unsigned int index, osg::Vec3d& vertex)
+{
+    const osg::Vec3Array* vec3Array = dynamic_cast<const osg::Vec3Array*>(vertices);
+    if (vec3Array)
+    {
+        vertex = (*vec3Array)[index];
+        return true;
+    }
+
+    const osg::Vec3dArray* vec3dArray = dynamic_cast<const osg::Vec3dArray*>(vertices);
+    if (vec3dArray)
+    {
+        vertex = (*vec3dArray)[index];
+        return true;
+    }
+
+    return false;
+}
+
+/** Base for visitors that need each Geometry's world transform and the StateSets accumulated down to it.*/
+class WorldGeometryVisitor : public osg::NodeVisitor
+{
+    public:
+
+        WorldGeometryVisitor():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        virtual void apply(osg::Node& node)
+        {
+            if (node.getStateSet()) _stateSetStack.push_back(node.getStateSet());
+            traverse(node);
+            if (node.getStateSet()) _stateSetStack.pop_back();
+        }
+
+        virtual void apply(osg::Geometry& geometry)
+        {
+            const osg::Array* vertices = geometry.getVertexArray();
+            if (!vertices || vertices->getNumElements()==0) return;
+
+            osg::Vec3d vertex;
+            if (!getVertex(vertices, 0, vertex))
+            {
+                OSG_INFO<<"TileBuilder : ignoring Geometry without a Vec3Array or Vec3dArray vertex array."<<std::endl;
+                return;
+            }
+
+            if (geometry.getStateSet()) _stateSetStack.push_back(geometry.getStateSet());
+
+            osg::Matrixd matrix = osg::computeLocalToWorld(getNodePath());
+            apply(geometry, matrix);
+
+            if (geometry.getStateSet()) _stateSetStack.pop_back();
+        }
+
+        virtual void apply(osg::Geometry& geometry, const osg::Matrixd& matrix) = 0;
+
+    protected:
+
+        typedef std::vector<osg::StateSet*> StateSetStack;
+        StateSetStack _stateSetStack;
+};
+
+/** Count the triangles in the input and accumulate their world space bounds.*/
+class ScanVisitor : public WorldGeometryVisitor
+{
+    public:
+
+        ScanVisitor(): _numTriangles(0) {}
+
+        using WorldGeometryVisitor::apply;
+
+        virtual void apply(osg::Geometry& geometry, const osg::Matrixd& matrix)
+        {
+            std::vector<unsigned int> indices;
+            collectTriangles(geometry, indices);
+            if (indices.empty()) return;
+
+            _numTriangles += indices.size()/3;
+
+            const osg::Array* vertices = geometry.getVertexArray();
+            osg::Vec3d vertex;
+            for(std::vector<unsigned int>::const_iterator itr = indices.begin();
+                itr != indices.end();
+                ++itr)
+            {
+                if (getVertex(vertices, *itr, vertex)) _bounds.expandBy(vertex*matrix);
+            }
+        }
+
+        osg::BoundingBoxd   _bounds;
+        unsigned int        _numTriangles;
+};
+
+osg::Array* copyArray(const osg::Array* array, const std::vector<unsigned int>& vertexOrder, unsigned int numVertices)
+{
+    if (!array) return 0;
+
+    if (array->getBinding()==osg::Array::BIND_OVERALL || array->getNumElements()!=numVertices)
+    {
+        return osg::clone(array, osg::CopyOp::DEEP_COPY_ALL);
+    }
+
+    osg::Array* newArray = osg::cloneType(array);
+    newArray->setBinding(array->getBinding());
+    newArray->setNormalize(array->getNormalize());
+    newArray->resizeArray(vertexOrder.size());
+
+    unsigned int elementSize = array->getElementSize();
+    for(unsigned int i=0; i<vertexOrder.size(); ++i)
+    {
+        memcpy(const_cast<GLvoid*>(newArray->getDataPointer(i)), array->getDataPointer(vertexOrder[i]), elementSize);
+    }
+
+    return newArray;
+}
+
+/** Split each Geometry into the leaf cells containing its triangle centroids, flattening the
+  * transforms and StateSets above it so each piece can be written out on its own.*/
+class BucketVisitor : public WorldGeometryVisitor
+{
+    public:
+
+        typedef std::map<TileBuilder::CellKey, osg::ref_ptr<osg::Geode> > CellGeodeMap;
+        typedef std::map<TileBuilder::CellKey, unsigned int> CellCountMap;
+
+        BucketVisitor(const TileBuilder& builder, const osgDB::Options* options):
+            _builder(builder),
+            _options(options) {}
+
+        using WorldGeometryVisitor::apply;
+
+        virtual void apply(osg::Geometry& geometry, const osg::Matrixd& matrix)
+        {
+            std::vector<unsigned int> indices;
+            collectTriangles(geometry, indices);
+            if (indices.empty()) return;
+
+            const osg::Array* vertices = geometry.getVertexArray();
+            unsigned int numVertices = vertices->getNumElements();
+
+            typedef std::map<TileBuilder::CellKey, std::vector<unsigned int> > CellTriangleMap;
+            CellTriangleMap cellTriangles;
+
+            osg::Vec3d v0, v1, v2;
+            for(unsigned int i=0; i+2<indices.size(); i+=3)
+            {
+                getVertex(vertices, indices[i], v0);
+                getVertex(vertices, indices[i+1], v1);
+                getVertex(vertices, indices[i+2], v2);
+
+                osg::Vec3d centroid = (v0+v1+v2)/3.0;
+                std::vector<unsigned int>& triangles = cellTriangles[_builder.cellForPoint(centroid*matrix)];
+                triangles.push_back(indices[i]);
+                triangles.push_back(indices[i+1]);
+                triangles.push_back(indices[i+2]);
+            }
+
+            osg::StateSet* stateset = getStateSet();
+
+            const unsigned int invalid = 0xffffffff;
+            std::vector<unsigned int> remap(numVertices, invalid);
+            for(CellTriangleMap::iterator itr = cellTriangles.begin();
+                itr != cellTriangles.end();
+                ++itr)
+            {
+                const std::vector<unsigned int>& triangles = itr->second;
+
+                std::vector<unsigned int> vertexOrder;
+                osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt(GL_TRIANGLES);
+                elements->reserve(triangles.size());
+                for(std::vector<unsigned int>::const_iterator titr = triangles.begin();
+                    titr != triangles.end();
+                    ++titr)
+                {
+                    if (remap[*titr]==invalid)
+                    {
+                        remap[*titr] = vertexOrder.size();
+                        vertexOrder.push_back(*titr);
+                    }
+                    elements->push_back(remap[*titr]);
+                }
+
+                for(std::vector<unsigned int>::const_iterator vitr = vertexOrder.begin();
+                    vitr != vertexOrder.end();
+                    ++vitr)
+                {
+                    remap[*vitr] = invalid;
+                }
+
+                osg::ref_ptr<osg::Geometry> cellGeometry = new osg::Geometry;
+                cellGeometry->setName(geometry.getName());
+                cellGeometry->setStateSet(stateset);
+                cellGeometry->setVertexArray(copyArray(vertices, vertexOrder, numVertices));
+                cellGeometry->setNormalArray(copyArray(geometry.getNormalArray(), vertexOrder, numVertices));
+                cellGeometry->setColorArray(copyArray(geometry.getColorArray(), vertexOrder, numVertices));
+                cellGeometry->setSecondaryColorArray(copyArray(geometry.getSecondaryColorArray(), vertexOrder, numVertices));
+                cellGeometry->setFogCoordArray(copyArray(geometry.getFogCoordArray(), vertexOrder, numVertices));
+                for(unsigned int unit=0; unit<geometry.getNumTexCoordArrays(); ++unit)
+                {
+                    cellGeometry->setTexCoordArray(unit, copyArray(geometry.getTexCoordArray(unit), vertexOrder, numVertices));
+                }
+                for(unsigned int index=0; index<geometry.getNumVertexAttribArrays(); ++index)
+                {
+                    cellGeometry->setVertexAttribArray(index, copyArray(geometry.getVertexAttribArray(index), vertexOrder, numVertices));
+                }
+                cellGeometry->addPrimitiveSet(elements.get());
+
+                if (!matrix.isIdentity())
+                {
+                    osgUtil::TransformAttributeFunctor tf(matrix);
+                    cellGeometry->accept(tf);
+                    cellGeometry->dirtyBound();
+                }
+
+                osg::ref_ptr<osg::Geode>& geode = _cellGeodes[itr->first];
+                if (!geode) geode = new osg::Geode;
+                geode->addDrawable(cellGeometry.get());
+
+                _cellTriangleCounts[itr->first] += triangles.size()/3;
+            }
+        }
+
+        CellGeodeMap    _cellGeodes;
+        CellCountMap    _cellTriangleCounts;
+
+    protected:
+
+        /** Return the StateSets down to the current Geometry merged into one.*/
+        osg::StateSet* getStateSet()
+        {
+            if (_stateSetStack.empty()) return 0;
+
+            osg::ref_ptr<osg::StateSet>& stateset = _mergedStateSets[_stateSetStack];
+            if (stateset.valid()) return stateset.get();
+
+            if (_stateSetStack.size()==1)
+            {
+                stateset = _stateSetStack.front();
+            }
+            else
+            {
+                stateset = new osg::StateSet;
+                for(StateSetStack::iterator itr = _stateSetStack.begin();
+                    itr != _stateSetStack.end();
+                    ++itr)
+                {
+                    stateset->merge(**itr);
+                }
+            }
+
+            referenceExternalImages(*stateset);
+            return stateset.get();
+        }
+
+        /** Make images loaded from file be written out as references to the original file rather than
+          * copied into every chunk, with the path resolved so the chunk can be read from another directory.*/
+        void referenceExternalImages(osg::StateSet& stateset)
+        {
+            const osg::StateSet::TextureAttributeList& textureAttributes = stateset.getTextureAttributeList();
+            for(unsigned int unit=0; unit<textureAttributes.size(); ++unit)
+            {
+                osg::Texture* texture = dynamic_cast<osg::Texture*>(stateset.getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+                if (!texture) continue;
+
+                for(unsigned int i=0; i<texture->getNumImages(); ++i)
+                {
+                    osg::Image* image = texture->getImage(i);
+                    if (!image || image->getFileName().empty()) continue;
+
+                    std::string path = osgDB::findDataFile(image->getFileName(), _options.get());
+                    if (path.empty()) continue;
+
+                    image->setFileName(osgDB::getRealPath(path));
+                    image->setWriteHint(osg::Image::EXTERNAL_FILE);
+                }
+            }
+        }
+
+        typedef std::map< StateSetStack, osg::ref_ptr<osg::StateSet> > MergedStateSetMap;
+
+        const TileBuilder&                      _builder;
+        osg::ref_ptr<const osgDB::Options>      _options;
+        MergedStateSetMap                       _mergedStateSets;
+};
+
+/** Gather the Geometry from a tile's content so it can be merged into the parent tile.*/
+class CollectGeometryVisitor : public osg::NodeVisitor
+{
+    public:
+
+        CollectGeometryVisitor():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        virtual void apply(osg::Geometry& geometry)
+        {
+            _geometries.push_back(&geometry);
+        }
+
+        std::vector< osg::ref_ptr<osg::Geometry> > _geometries;
+};
+
+class CountTrianglesVisitor : public osg::NodeVisitor
+{
+    public:
+
+        CountTrianglesVisitor():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _numTriangles(0) {}
+
+        virtual void apply(osg::Geometry& geometry)
+        {
+            std::vector<unsigned int> indices;
+            collectTriangles(geometry, indices);
+            _numTriangles += indices.size()/3;
+        }
+
+        unsigned int _numTriangles;
+};
+
+class BuildTileOperation : public osg::Operation
+{
+    public:
+
+        BuildTileOperation(TileBuilder* builder, const TileBuilder::CellKey& key, bool leaf):
+            osg::Operation("BuildTileOperation", false),
+            _builder(builder),
+            _key(key),
+            _leaf(leaf) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            if (_leaf) _builder->buildLeafTile(_key);
+            else _builder->buildInternalTile(_key);
+        }
+
+    protected:
+
+        TileBuilder*            _builder;
+        TileBuilder::CellKey    _key;
+        bool                    _leaf;
+};
+
+}
+
+TileBuilder::TileBuilder():
+    _targetNumTrianglesPerTile(50000),
+    _maximumNumLevels(8),
+    _useQuadTree(false),
+    _rangeScale(6.0f),
+    _maximumAtlasSize(2048),
+    _numThreads(0),
+    _numInputTriangles(0),
+    _numLevels(1)
+{
+    _splitAxis[0] = _splitAxis[1] = _splitAxis[2] = true;
+}
+
+bool TileBuilder::build(const FileNameList& fileNames, const std::string& fileNameOut)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    _cells.clear();
+    _numErrors.exchange(0);
+
+    const osgDB::Options* registryOptions = osgDB::Registry::instance()->getOptions();
+    _readOptions = registryOptions ? osg::clone(registryOptions, osg::CopyOp::SHALLOW_COPY) : new osgDB::Options;
+
+    // chunks and tile content are read back many times over, so share the images they reference.
+    _chunkOptions = osg::clone(_readOptions.get(), osg::CopyOp::SHALLOW_COPY);
+    _chunkOptions->setObjectCacheHint(osgDB::Options::CACHE_IMAGES);
+
+    // the final tiles carry their images with them so the hierarchy can be moved as a whole.
+    _tileOptions = osg::clone(_readOptions.get(), osg::CopyOp::SHALLOW_COPY);
+    _tileOptions->setPluginStringData("WriteImageHint", "IncludeData");
+
+    _tileDirectory = osgDB::getNameLessExtension(fileNameOut)+"_tiles";
+    _tempDirectory = osgDB::concatPaths(_tileDirectory, "tmp");
+    if (!osgDB::makeDirectory(_tempDirectory))
+    {
+        OSG_WARN<<"TileBuilder : unable to create directory "<<_tempDirectory<<std::endl;
+        return false;
+    }
+
+    if (!scanInputs(fileNames) || !bucketInputs(fileNames)) return false;
+
+    _taskPool = new osg::TaskPool(_numThreads);
+
+    for(int level=static_cast<int>(_numLevels)-1; level>=0; --level)
+    {
+        osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+        unsigned int numTiles = 0;
+        for(CellMap::iterator itr = _cells.lower_bound(CellKey(level,0,0,0));
+            itr != _cells.end() && itr->first.level==static_cast<unsigned int>(level);
+            ++itr)
+        {
+            _taskPool->add(new BuildTileOperation(this, itr->first, level==static_cast<int>(_numLevels)-1), taskSet.get());
+            ++numTiles;
+        }
+        _taskPool->wait(taskSet.get());
+
+        osgDB::Registry::instance()->clearObjectCache();
+
+        OSG_NOTICE<<"TileBuilder : built "<<numTiles<<" tiles on level "<<level<<std::endl;
+    }
+
+    _taskPool = 0;
+
+    CellKey rootKey(0,0,0,0);
+    osg::ref_ptr<osg::Node> root = readContent(rootKey);
+    if (root.valid() && _numLevels>1)
+    {
+        const Cell& rootCell = _cells[rootKey];
+        float cutOff = _rangeScale*rootCell.bound.radius();
+
+        osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD;
+        plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+        plod->setCenter(rootCell.bound.center());
+        plod->setRadius(rootCell.bound.radius());
+        plod->addChild(root.get(), cutOff, FLT_MAX);
+        plod->setFileName(1, osgDB::concatPaths(osgDB::getSimpleFileName(_tileDirectory), subTileFileName(rootKey)));
+        plod->setRange(1, 0.0f, cutOff);
+        root = plod;
+    }
+
+    remove(contentFileName(rootKey).c_str());
+    remove(_tempDirectory.c_str());
+
+    if (!root.valid() || !writeNode(*root, fileNameOut, _tileOptions.get())) return false;
+
+    OSG_NOTICE<<"TileBuilder : wrote "<<_cells.size()<<" tiles over "<<_numLevels<<" levels in "
+              <<osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick())<<"s"<<std::endl;
+
+    return _numErrors==0;
+}
+
+bool TileBuilder::scanInputs(const FileNameList& fileNames)
+{
+    _bounds.init();
+    _numInputTriangles = 0;
+
+    for(FileNameList::const_iterator itr = fileNames.begin();
+        itr != fileNames.end();
+        ++itr)
+    {
+        osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(*itr, _readOptions.get());
+        if (!node)
+        {
+            OSG_WARN<<"TileBuilder : unable to read "<<*itr<<std::endl;
+            return false;
+        }
+
+        ScanVisitor sv;
+        node->accept(sv);
+        _bounds.expandBy(sv._bounds);
+        _numInputTriangles += sv._numTriangles;
+    }
+
+    if (!_bounds.valid() || _numInputTriangles==0)
+    {
+        OSG_WARN<<"TileBuilder : no triangles found in the input."<<std::endl;
+        return false;
+    }
+
+    // choose the depth so that the leaf tiles hold about the target number of triangles.
+    unsigned int branching = _useQuadTree ? 4 : 8;
+    unsigned int numLeavesRequired = (_numInputTriangles+_targetNumTrianglesPerTile-1)/std::max(_targetNumTrianglesPerTile, 1u);
+    unsigned int numLeaves = 1;
+    _numLevels = 1;
+    while(numLeaves<numLeavesRequired && _numLevels<_maximumNumLevels)
+    {
+        numLeaves *= branching;
+        ++_numLevels;
+    }
+
+    _splitAxis[0] = _splitAxis[1] = _splitAxis[2] = true;
+    if (_useQuadTree)
+    {
+        osg::Vec3d extents = _bounds._max-_bounds._min;
+        unsigned int smallestAxis = 0;
+        if (extents[1]<extents[smallestAxis]) smallestAxis = 1;
+        if (extents[2]<extents[smallestAxis]) smallestAxis = 2;
+        _splitAxis[smallestAxis] = false;
+    }
+
+    OSG_NOTICE<<"TileBuilder : "<<_numInputTriangles<<" triangles, building "<<_numLevels<<" levels"<<std::endl;
+
+    return true;
+}
+
+bool TileBuilder::bucketInputs(const FileNameList& fileNames)
+{
+    // read the inputs one at a time, writing out the triangles for each leaf cell as a chunk.
+    for(unsigned int fileIndex=0; fileIndex<fileNames.size(); ++fileIndex)
+    {
+        osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(fileNames[fileIndex], _readOptions.get());
+        if (!node) return false;
+
+        osg::ref_ptr<osgDB::Options> options = osg::clone(_readOptions.get(), osg::CopyOp::SHALLOW_COPY);
+        options->getDatabasePathList().push_front(osgDB::getFilePath(fileNames[fileIndex]));
+
+        BucketVisitor bv(*this, options.get());
+        node->accept(bv);
+        node = 0;
+
+        for(BucketVisitor::CellGeodeMap::iterator itr = bv._cellGeodes.begin();
+            itr != bv._cellGeodes.end();
+            ++itr)
+        {
+            const CellKey& key = itr->first;
+
+            std::ostringstream str;
+            str<<"chunk_L"<<key.level<<"_X"<<key.x<<"_Y"<<key.y<<"_Z"<<key.z<<"_"<<fileIndex<<".osgb";
+            std::string chunkFileName = osgDB::concatPaths(_tempDirectory, str.str());
+
+            if (!writeNode(*(itr->second), chunkFileName, _chunkOptions.get())) return false;
+
+            Cell& cell = _cells[key];
+            cell.chunkFileNames.push_back(chunkFileName);
+            cell.numTriangles += bv._cellTriangleCounts[key];
+        }
+    }
+
+    // link the leaf cells up to the root through the cells of the coarser levels.
+    std::vector<CellKey> leafKeys;
+    for(CellMap::iterator itr = _cells.begin(); itr != _cells.end(); ++itr)
+    {
+        leafKeys.push_back(itr->first);
+    }
+
+    for(std::vector<CellKey>::iterator itr = leafKeys.begin();
+        itr != leafKeys.end();
+        ++itr)
+    {
+        CellKey key = *itr;
+        while(key.level>0)
+        {
+            CellKey parentKey = key.parent();
+            bool newParent = (_cells.count(parentKey)==0);
+            _cells[parentKey].children.push_back(key);
+            if (!newParent) break;
+            key = parentKey;
+        }
+    }
+
+    return true;
+}
+
+TileBuilder::CellKey TileBuilder::cellForPoint(const osg::Vec3d& point) const
+{
+    unsigned int resolution = 1u<<(_numLevels-1);
+
+    unsigned int index[3] = { 0, 0, 0 };
+    for(unsigned int axis=0; axis<3; ++axis)
+    {
+        double extent = _bounds._max[axis]-_bounds._min[axis];
+        if (!_splitAxis[axis] || extent<=0.0) continue;
+
+        double t = (point[axis]-_bounds._min[axis])/extent;
+        int i = static_cast<int>(floor(t*static_cast<double>(resolution)));
+        index[axis] = static_cast<unsigned int>(osg::clampBetween(i, 0, static_cast<int>(resolution)-1));
+    }
+
+    return CellKey(_numLevels-1, index[0], index[1], index[2]);
+}
+
+std::string TileBuilder::contentFileName(const CellKey& key) const
+{
+    std::ostringstream str;
+    str<<"content_L"<<key.level<<"_X"<<key.x<<"_Y"<<key.y<<"_Z"<<key.z<<".osgb";
+    return osgDB::concatPaths(_tempDirectory, str.str());
+}
+
+std::string TileBuilder::subTileFileName(const CellKey& key) const
+{
+    std::ostringstream str;
+    str<<"L"<<key.level<<"_X"<<key.x<<"_Y"<<key.y<<"_Z"<<key.z<<"_subtiles.osgb";
+    return str.str();
+}
+
+osg::ref_ptr<osg::Node> TileBuilder::readContent(const CellKey& key)
+{
+    osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(contentFileName(key), _chunkOptions.get());
+    if (!node)
+    {
+        OSG_WARN<<"TileBuilder : unable to read "<<contentFileName(key)<<std::endl;
+        ++_numErrors;
+    }
+    return node;
+}
+
+bool TileBuilder::writeNode(const osg::Node& node, const std::string& fileName, const osgDB::Options* options)
+{
+    if (osgDB::writeNodeFile(node, fileName, options)) return true;
+
+    OSG_WARN<<"TileBuilder : unable to write "<<fileName<<std::endl;
+    ++_numErrors;
+    return false;
+}
+
+void TileBuilder::finishCell(const CellKey& key, osg::Node* content)
+{
+    CountTrianglesVisitor ctv;
+    content->accept(ctv);
+
+    Cell& cell = _cells.find(key)->second;
+    cell.bound = content->getBound();
+    cell.numTriangles = ctv._numTriangles;
+
+    writeNode(*content, contentFileName(key), _chunkOptions.get());
+}
+
+void TileBuilder::buildLeafTile(const CellKey& key)
+{
+    Cell& cell = _cells.find(key)->second;
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    for(std::vector<std::string>::iterator itr = cell.chunkFileNames.begin();
+        itr != cell.chunkFileNames.end();
+        ++itr)
+    {
+        osg::ref_ptr<osg::Node> chunk = osgDB::readRefNodeFile(*itr, _chunkOptions.get());
+        if (!chunk)
+        {
+            OSG_WARN<<"TileBuilder : unable to read "<<*itr<<std::endl;
+            ++_numErrors;
+            continue;
+        }
+
+        CollectGeometryVisitor cgv;
+        chunk->accept(cgv);
+        for(unsigned int i=0; i<cgv._geometries.size(); ++i)
+        {
+            geode->addDrawable(cgv._geometries[i].get());
+        }
+
+        remove(itr->c_str());
+    }
+
+    osgUtil::Optimizer optimizer;
+    optimizer.optimize(geode.get(), osgUtil::Optimizer::SHARE_DUPLICATE_STATE |
+                                    osgUtil::Optimizer::MERGE_GEOMETRY |
+                                    osgUtil::Optimizer::INDEX_MESH |
+                                    osgUtil::Optimizer::VERTEX_POSTTRANSFORM);
+
+    finishCell(key, geode.get());
+}
+
+void TileBuilder::buildInternalTile(const CellKey& key)
+{
+    Cell& cell = _cells.find(key)->second;
+
+    // write the children out as this cell's sub tiles, the leaves as they are and the rest as
+    // PagedLOD's holding their coarse content and referring to their own sub tiles.
+    osg::ref_ptr<osg::Group> subTiles = new osg::Group;
+    for(std::vector<CellKey>::iterator itr = cell.children.begin();
+        itr != cell.children.end();
+        ++itr)
+    {
+        osg::ref_ptr<osg::Node> content = readContent(*itr);
+        if (!content) continue;
+
+        if (itr->level==_numLevels-1)
+        {
+            subTiles->addChild(content.get());
+        }
+        else
+        {
+            const Cell& child = _cells.find(*itr)->second;
+            float cutOff = _rangeScale*child.bound.radius();
+
+            osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD;
+            plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+            plod->setCenter(child.bound.center());
+            plod->setRadius(child.bound.radius());
+            plod->addChild(content.get(), cutOff, FLT_MAX);
+            plod->setFileName(1, subTileFileName(*itr));
+            plod->setRange(1, 0.0f, cutOff);
+            subTiles->addChild(plod.get());
+        }
+
+        remove(contentFileName(*itr).c_str());
+    }
+
+    writeNode(*subTiles, osgDB::concatPaths(_tileDirectory, subTileFileName(key)), _tileOptions.get());
+
+    // the children have been written out, so their geometry can now be reused for this cell's content.
+    CollectGeometryVisitor cgv;
+    subTiles->accept(cgv);
+    subTiles = 0;
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    for(unsigned int i=0; i<cgv._geometries.size(); ++i)
+    {
+        geode->addDrawable(cgv._geometries[i].get());
+    }
+    cgv._geometries.clear();
+
+    osgUtil::Optimizer::TextureAtlasVisitor tav;
+    tav.getTextureAtlasBuilder().setMaximumAtlasSize(_maximumAtlasSize, _maximumAtlasSize);
+    geode->accept(tav);
+    tav.optimize();
+
+    osgUtil::Optimizer optimizer;
+    optimizer.optimize(geode.get(), osgUtil::Optimizer::SHARE_DUPLICATE_STATE |
+                                    osgUtil::Optimizer::MERGE_GEOMETRY |
+                                    osgUtil::Optimizer::INDEX_MESH);
+
+    CountTrianglesVisitor ctv;
+    geode->accept(ctv);
+    if (ctv._numTriangles>_targetNumTrianglesPerTile)
+    {
+        osgUtil::Simplifier simplifier(static_cast<float>(_targetNumTrianglesPerTile)/static_cast<float>(ctv._numTriangles));
+        geode->accept(simplifier);
+    }
+
+    optimizer.optimize(geode.get(), osgUtil::Optimizer::VERTEX_POSTTRANSFORM);
+
+    finishCell(key, geode.get());
+}
@@ -0,0 +1,142 @@
+#ifndef _TILE_BUILDER_H
+#define _TILE_BUILDER_H
+
+#include <osg/BoundingBox>
+#include <osg/BoundingSphere>
+#include <osg/Node>
+#include <osg/Geode>
+#include <osg/TaskPool>
+#include <osgDB/Options>
+
+#include <OpenThreads/Atomic>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Converts a set of input models into a hierarchy of PagedLOD tiles.
+  * The input files are read one at a time and their triangles are bucketed into the leaf cells
+  * of an octree or quadtree, with each cell's share written out to a temporary file so only a
+  * single input model is ever held in memory.  The leaf tiles are then built from these chunks,
+  * and each coarser level is built from its children by building a texture atlas, merging and
+  * simplifying down to the target triangle count.  Tiles on the same level are built in parallel.*/
+class TileBuilder {
+    public :
+
+        typedef std::vector<std::string> FileNameList;
+
+        TileBuilder();
+
+        /** Set the number of triangles aimed for in each tile, used to choose the depth of the tree
+          * and the simplification ratio of the coarser levels.*/
+        void setTargetNumTrianglesPerTile(unsigned int num) { _targetNumTrianglesPerTile = num; }
+        unsigned int getTargetNumTrianglesPerTile() const { return _targetNumTrianglesPerTile; }
+
+        /** Set the maximum depth of the tree, the root being level 0.*/
+        void setMaximumNumLevels(unsigned int num) { _maximumNumLevels = num; }
+        unsigned int getMaximumNumLevels() const { return _maximumNumLevels; }
+
+        /** Subdivide only the two largest axes of the model, rather than all three.*/
+        void setUseQuadTree(bool flag) { _useQuadTree = flag; }
+        bool getUseQuadTree() const { return _useQuadTree; }
+
+        /** Set the ratio of the PagedLOD cut off distance to the radius of a tile.*/
+        void setRangeScale(float scale) { _rangeScale = scale; }
+        float getRangeScale() const { return _rangeScale; }
+
+        /** Set the maximum width and height of the texture atlases built for the coarser levels.*/
+        void setMaximumAtlasSize(unsigned int size) { _maximumAtlasSize = size; }
+        unsigned int getMaximumAtlasSize() const { return _maximumAtlasSize; }
+
+        /** Set the number of threads used to build tiles, 0 uses the number of processors.*/
+        void setNumThreads(unsigned int num) { _numThreads = num; }
+        unsigned int getNumThreads() const { return _numThreads; }
+
+        /** Read the input files and write the tile hierarchy, fileNameOut holding the root tile
+          * and the rest of the tiles being written as .osgb files into a directory alongside it.*/
+        bool build(const FileNameList& fileNames, const std::string& fileNameOut);
+
+        struct CellKey
+        {
+            CellKey(): level(0), x(0), y(0), z(0) {}
+            CellKey(unsigned int l, unsigned int i, unsigned int j, unsigned int k): level(l), x(i), y(j), z(k) {}
+
+            bool operator < (const CellKey& rhs) const
+            {
+                if (level<rhs.level) return true;
+                if (rhs.level<level) return false;
+                if (x<rhs.x) return true;
+                if (rhs.x<x) return false;
+                if (y<rhs.y) return true;
+                if (rhs.y<y) return false;
+                return z<rhs.z;
+            }
+
+            CellKey parent() const { return CellKey(level-1, x/2, y/2, z/2); }
+
+            unsigned int level, x, y, z;
+        };
+
+        struct Cell
+        {
+            Cell(): numTriangles(0) {}
+
+            std::vector<std::string>    chunkFileNames;
+            std::vector<CellKey>        children;
+            osg::BoundingSphere         bound;
+            unsigned int                numTriangles;
+        };
+
+        typedef std::map<CellKey, Cell> CellMap;
+
+        /** Get the leaf cell that a world space point falls into.*/
+        CellKey cellForPoint(const osg::Vec3d& point) const;
+
+        /** Build the leaf tile for the cell from its chunks.*/
+        void buildLeafTile(const CellKey& key);
+
+        /** Write the cell's children out as its sub tile file and build the cell's own coarse tile from them.*/
+        void buildInternalTile(const CellKey& key);
+
+    private :
+
+        TileBuilder( const TileBuilder& ) {}
+        TileBuilder& operator = (const TileBuilder& ) { return *this; }
+
+        bool scanInputs(const FileNameList& fileNames);
+        bool bucketInputs(const FileNameList& fileNames);
+
+        std::string contentFileName(const CellKey& key) const;
+        std::string subTileFileName(const CellKey& key) const;
+
+        osg::ref_ptr<osg::Node> readContent(const CellKey& key);
+        bool writeNode(const osg::Node& node, const std::string& fileName, const osgDB::Options* options);
+
+        void finishCell(const CellKey& key, osg::Node* content);
+
+        unsigned int                    _targetNumTrianglesPerTile;
+        unsigned int                    _maximumNumLevels;
+        bool                            _useQuadTree;
+        float                           _rangeScale;
+        unsigned int                    _maximumAtlasSize;
+        unsigned int                    _numThreads;
+
+        osg::BoundingBoxd               _bounds;
+        unsigned int                    _numInputTriangles;
+        unsigned int                    _numLevels;
+        bool                            _splitAxis[3];
+
+        std::string                     _tileDirectory;
+        std::string                     _tempDirectory;
+
+        osg::ref_ptr<osgDB::Options>    _readOptions;
+        osg::ref_ptr<osgDB::Options>    _chunkOptions;
+        osg::ref_ptr<osgDB::Options>    _tileOptions;
+
+        CellMap                         _cells;
+        osg::ref_ptr<osg::TaskPool>     _taskPool;
+
+        OpenThreads::Atomic             _numErrors;
+};
+
+#endif
@@ -11,6 +11,7 @@
 #include <osg/Texture3D>
 #include <osg/BlendFunc>
 #include <osg/Timer>
+#include <osg/ImageUtils>
 
 #include <osgDB/Registry>
 #include <osgDB/ReadFile>
@@ -29,6 +30,7 @@
 #include <iostream>
 
 #include "OrientationConverter.h"
+#include "TileBuilder.h"
 
 typedef std::vector<std::string> FileNameList;
 
@@ -113,9 +115,10 @@ class CompressTexturesVisitor : public osg::NodeVisitor
 {
 public:
 
-    CompressTexturesVisitor(osg::Texture::InternalFormatMode internalFormatMode):
+    CompressTexturesVisitor(osg::Texture::InternalFormatMode internalFormatMode, osg::CompressionQuality quality):
         osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
-        _internalFormatMode(internalFormatMode) {}
+        _internalFormatMode(internalFormatMode),
+        _quality(quality) {}
 
     virtual void apply(osg::Node& node)
     {
@@ -149,8 +152,61 @@ public:
         }
     }
 
+    // the compressed format osg::Texture would choose for an image of the pixel format, for compressing on the CPU.
+    GLenum getCompressedFormat(GLenum pixelFormat) const
+    {
+        bool hasAlpha = pixelFormat==GL_RGBA;
+        switch(_internalFormatMode)
+        {
+            case(osg::Texture::USE_S3TC_DXT1_COMPRESSION): return hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_S3TC_DXT1c_COMPRESSION): return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_S3TC_DXT1a_COMPRESSION): return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_S3TC_DXT3_COMPRESSION): return hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT3_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_S3TC_DXT5_COMPRESSION): return hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_RGTC1_COMPRESSION): return GL_COMPRESSED_RED_RGTC1_EXT;
+            case(osg::Texture::USE_RGTC2_COMPRESSION): return GL_COMPRESSED_RED_GREEN_RGTC2_EXT;
+            case(osg::Texture::USE_ETC_COMPRESSION): return hasAlpha ? 0 : GL_ETC1_RGB8_OES;
+            case(osg::Texture::USE_ETC2_COMPRESSION): return hasAlpha ? GL_COMPRESSED_RGBA8_ETC2_EAC : GL_COMPRESSED_RGB8_ETC2;
+            default: return 0;
+        }
+    }
+
     void compress()
     {
+        // compress on the CPU where possible, only creating a graphics context for the textures that need the OpenGL driver.
+        TextureSet glTextureSet;
+        for(TextureSet::iterator itr=_textureSet.begin();
+            itr!=_textureSet.end();
+            ++itr)
+        {
+            osg::Texture2D* texture2D = dynamic_cast<osg::Texture2D*>(const_cast<osg::Texture*>(itr->get()));
+            osg::Image* image = texture2D ? texture2D->getImage() : 0;
+            if (image && isCompressible(*image))
+            {
+                GLenum compressedFormat = getCompressedFormat(image->getPixelFormat());
+                if (osg::isCompressionSupported(image->getPixelFormat(), image->getDataType(), compressedFormat))
+                {
+                    // build the mipmaps the OpenGL driver would have generated for a mipmapped min filter, so they are compressed too.
+                    bool mipmappingRequired = texture2D->getFilter(osg::Texture::MIN_FILTER)!=osg::Texture::LINEAR &&
+                                              texture2D->getFilter(osg::Texture::MIN_FILTER)!=osg::Texture::NEAREST;
+                    if (mipmappingRequired && !image->isMipmap())
+                    {
+                        osg::buildMipmaps(image, osg::RESAMPLE_BOX, osg::TaskPool::instance().get());
+                    }
+
+                    osg::ref_ptr<osg::Image> compressedImage = osg::compressImage(image, compressedFormat, _quality, osg::TaskPool::instance().get());
+                    if (compressedImage.valid())
+                    {
+                        texture2D->setImage(compressedImage.get());
+                        continue;
+                    }
+                }
+            }
+            glTextureSet.insert(*itr);
+        }
+
+        if (glTextureSet.empty()) return;
+
         MyGraphicsContext context;
         if (!context.valid())
         {
@@ -161,8 +217,8 @@ public:
         osg::ref_ptr<osg::State> state = new osg::State;
         state->initializeExtensionProcs();
 
-        for(TextureSet::iterator itr=_textureSet.begin();
-            itr!=_textureSet.end();
+        for(TextureSet::iterator itr=glTextureSet.begin();
+            itr!=glTextureSet.end();
             ++itr)
         {
             osg::Texture* texture = const_cast<osg::Texture*>(itr->get());
@@ -171,9 +227,7 @@ public:
             osg::Texture3D* texture3D = dynamic_cast<osg::Texture3D*>(texture);
 
             osg::ref_ptr<osg::Image> image = texture2D ? texture2D->getImage() : (texture3D ? texture3D->getImage() : 0);
-            if (image.valid() &&
-                (image->getPixelFormat()==GL_RGB || image->getPixelFormat()==GL_RGBA) &&
-                (image->s()>=32 && image->t()>=32))
+            if (image.valid() && isCompressible(*image))
             {
                 texture->setInternalFormatMode(_internalFormatMode);
 
@@ -194,6 +248,12 @@ public:
         }
     }
 
+    static bool isCompressible(const osg::Image& image)
+    {
+        return (image.getPixelFormat()==GL_RGB || image.getPixelFormat()==GL_RGBA) &&
+               (image.s()>=32 && image.t()>=32);
+    }
+
     void write(const std::string &dir)
     {
         for(TextureSet::iterator itr=_textureSet.begin();
@@ -208,8 +268,9 @@ public:
             osg::ref_ptr<osg::Image> image = texture2D ? texture2D->getImage() : (texture3D ? texture3D->getImage() : 0);
             if (image.valid())
             {
+                // .dds doesn't store the ETC formats, so write them to .ktx.
                 std::string name = osgDB::getStrippedName(image->getFileName());
-                name += ".dds";
+                name += isETC(image->getPixelFormat()) ? ".ktx" : ".dds";
                 image->setFileName(name);
                 std::string path = dir.empty() ? name : osgDB::concatPaths(dir, name);
                 osgDB::writeImageFile(*image, path);
@@ -218,9 +279,90 @@ public:
         }
     }
 
+    static bool isETC(GLenum pixelFormat)
+    {
+        switch(pixelFormat)
+        {
+            case(GL_ETC1_RGB8_OES):
+            case(GL_COMPRESSED_RGB8_ETC2):
+            case(GL_COMPRESSED_RGBA8_ETC2_EAC):
+            case(GL_COMPRESSED_R11_EAC):
+            case(GL_COMPRESSED_RG11_EAC):
+                return true;
+            default:
+                return false;
+        }
+    }
+
     typedef std::set< osg::ref_ptr<osg::Texture> > TextureSet;
     TextureSet                          _textureSet;
     osg::Texture::InternalFormatMode    _internalFormatMode;
+    osg::CompressionQuality             _quality;
+
+};
+
+class MipmapTexturesVisitor : public osg::NodeVisitor
+{
+public:
+
+    MipmapTexturesVisitor(osg::ResampleFilter filter):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _filter(filter) {}
+
+    virtual void apply(osg::Node& node)
+    {
+        if (node.getStateSet()) apply(*node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geode& node)
+    {
+        if (node.getStateSet()) apply(*node.getStateSet());
+
+        for(unsigned int i=0;i<node.getNumDrawables();++i)
+        {
+            osg::Drawable* drawable = node.getDrawable(i);
+            if (drawable && drawable->getStateSet()) apply(*drawable->getStateSet());
+        }
+
+        traverse(node);
+    }
+
+    virtual void apply(osg::StateSet& stateset)
+    {
+        for(unsigned int i=0;i<stateset.getTextureAttributeList().size();++i)
+        {
+            osg::Texture2D* texture2D = dynamic_cast<osg::Texture2D*>(stateset.getTextureAttribute(i,osg::StateAttribute::TEXTURE));
+            if (texture2D && texture2D->getImage()) _imageSet.insert(texture2D->getImage());
+        }
+    }
+
+    void buildMipmaps()
+    {
+        for(ImageSet::iterator itr=_imageSet.begin();
+            itr!=_imageSet.end();
+            ++itr)
+        {
+            osg::Image* image = itr->get();
+            if (image->isMipmap()) continue;
+
+            // osg::Texture rescales non power of two images before applying them, which it can't do for mipmapped images.
+            if (image->s()!=osg::Image::computeNearestPowerOfTwo(image->s()) || image->t()!=osg::Image::computeNearestPowerOfTwo(image->t()))
+            {
+                osg::notify(osg::NOTICE)<<"Not building mipmaps for non power of two image '"<<image->getFileName()<<"'."<<std::endl;
+                continue;
+            }
+
+            if (!osg::buildMipmaps(image, _filter, osg::TaskPool::instance().get()))
+            {
+                osg::notify(osg::NOTICE)<<"Unable to build mipmaps for image '"<<image->getFileName()<<"', unsupported pixel format or data type."<<std::endl;
+            }
+        }
+    }
+
+    typedef std::set< osg::ref_ptr<osg::Image> > ImageSet;
+    ImageSet                _imageSet;
+    osg::ResampleFilter     _filter;
 
 };
 
@@ -442,6 +584,19 @@ static void usage( const char *prog, const char *msg )
     osg::notify(osg::NOTICE)<<"    --compressed-dxt1  - Enable the usage of S3TC DXT1 compressed textures"<< std::endl;
     osg::notify(osg::NOTICE)<<"    --compressed-dxt3  - Enable the usage of S3TC DXT3 compressed textures"<< std::endl;
     osg::notify(osg::NOTICE)<<"    --compressed-dxt5  - Enable the usage of S3TC DXT5 compressed textures"<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --compressed-rgtc1 - Enable the usage of RGTC1 compressed textures"<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --compressed-rgtc2 - Enable the usage of RGTC2 compressed textures"<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --compressed-etc1  - Enable the usage of ETC1 compressed textures"<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --compressed-etc2  - Enable the usage of ETC2 compressed textures"<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --compression-quality <quality> - fast, normal or high, for the"<< std::endl;
+    osg::notify(osg::NOTICE)<<"                         formats compressed on the CPU. Defaults to normal."<< std::endl;
+    osg::notify(osg::NOTICE)<<"                         2D textures other than ARB compressed ones are"<< std::endl;
+    osg::notify(osg::NOTICE)<<"                         compressed without needing a graphics context."<< std::endl;
+    osg::notify(osg::NOTICE)<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --mipmaps          - Build the mipmaps of 2D texture images, storing"<< std::endl;
+    osg::notify(osg::NOTICE)<<"                         them with the images written out."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --mipmap-filter <filter> - Filter used to build the mipmaps, one of"<< std::endl;
+    osg::notify(osg::NOTICE)<<"                         box, triangle, kaiser or lanczos. Defaults to box."<< std::endl;
     osg::notify(osg::NOTICE)<< std::endl;
     osg::notify(osg::NOTICE)<<"    --fix-transparency - fix statesets which are currently"<< std::endl;
     osg::notify(osg::NOTICE)<<"                         declared as transparent, but should be opaque."<< std::endl;
@@ -517,6 +672,23 @@ static void usage( const char *prog, const char *msg )
                               "                         (--addMissingColours also accepted)."<< std::endl;
     osg::notify(osg::NOTICE)<<"    --overallNormal    - Replace normals with a single overall normal."<< std::endl;
     osg::notify(osg::NOTICE)<<"    --enable-object-cache - Enable caching of objects, images, etc."<< std::endl;
+    osg::notify(osg::NOTICE)<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile             - Convert the input files into a hierarchy of PagedLOD\n"
+                              "                         tiles, the output file holding the root tile and the\n"
+                              "                         rest being written as .osgb files into a directory\n"
+                              "                         named after it.  The input files are read one at a\n"
+                              "                         time so inputs larger than memory can be split over\n"
+                              "                         several files.  The orientation, scale, translation\n"
+                              "                         and simplify options are not applied when tiling."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-triangles n - Target number of triangles in each tile (default 50000)."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-levels n    - Maximum number of levels in the hierarchy (default 8)."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-quadtree    - Subdivide the two largest axes only, rather than using"<< std::endl
+                            <<"                         an octree."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-range-scale f - Ratio of the PagedLOD cut off distance to the tile"<< std::endl
+                            <<"                         radius (default 6)."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-atlas-size n - Maximum texture atlas size for coarse tiles (default 2048)."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --tile-threads n   - Number of threads used to build tiles (default number"<< std::endl
+                            <<"                         of processors)."<< std::endl;
 
     osg::notify( osg::NOTICE ) << std::endl;
     osg::notify( osg::NOTICE ) <<
@@ -734,6 +906,35 @@ int main( int argc, char **argv )
     while(arguments.read("--compressed-dxt1")) { internalFormatMode = osg::Texture::USE_S3TC_DXT1_COMPRESSION; }
     while(arguments.read("--compressed-dxt3")) { internalFormatMode = osg::Texture::USE_S3TC_DXT3_COMPRESSION; }
     while(arguments.read("--compressed-dxt5")) { internalFormatMode = osg::Texture::USE_S3TC_DXT5_COMPRESSION; }
+    while(arguments.read("--compressed-rgtc1")) { internalFormatMode = osg::Texture::USE_RGTC1_COMPRESSION; }
+    while(arguments.read("--compressed-rgtc2")) { internalFormatMode = osg::Texture::USE_RGTC2_COMPRESSION; }
+    while(arguments.read("--compressed-etc1")) { internalFormatMode = osg::Texture::USE_ETC_COMPRESSION; }
+    while(arguments.read("--compressed-etc2")) { internalFormatMode = osg::Texture::USE_ETC2_COMPRESSION; }
+
+    osg::CompressionQuality compressionQuality = osg::COMPRESSION_NORMAL;
+    std::string compressionQualityString;
+    while(arguments.read("--compression-quality",compressionQualityString))
+    {
+        if (compressionQualityString=="fast") compressionQuality = osg::COMPRESSION_FAST;
+        else if (compressionQualityString=="normal") compressionQuality = osg::COMPRESSION_NORMAL;
+        else if (compressionQualityString=="high") compressionQuality = osg::COMPRESSION_HIGH;
+        else osg::notify(osg::NOTICE)<<"Unknown compression quality '"<<compressionQualityString<<"', using normal."<<std::endl;
+    }
+
+    bool buildMipmaps = false;
+    while(arguments.read("--mipmaps")) { buildMipmaps = true; }
+
+    osg::ResampleFilter mipmapFilter = osg::RESAMPLE_BOX;
+    std::string mipmapFilterString;
+    while(arguments.read("--mipmap-filter",mipmapFilterString))
+    {
+        buildMipmaps = true;
+        if (mipmapFilterString=="box") mipmapFilter = osg::RESAMPLE_BOX;
+        else if (mipmapFilterString=="triangle") mipmapFilter = osg::RESAMPLE_TRIANGLE;
+        else if (mipmapFilterString=="kaiser") mipmapFilter = osg::RESAMPLE_KAISER;
+        else if (mipmapFilterString=="lanczos") mipmapFilter = osg::RESAMPLE_LANCZOS;
+        else osg::notify(osg::NOTICE)<<"Unknown mipmap filter '"<<mipmapFilterString<<"', using box."<<std::endl;
+    }
 
     bool smooth = false;
     while(arguments.read("--smooth")) { smooth = true; }
@@ -747,6 +948,20 @@ int main( int argc, char **argv )
     bool enableObjectCache = false;
     while(arguments.read("--enable-object-cache")) { enableObjectCache = true; }
 
+    bool do_tile = false;
+    TileBuilder tileBuilder;
+    while(arguments.read("--tile")) { do_tile = true; }
+
+    unsigned int tileValue = 0;
+    while(arguments.read("--tile-triangles", tileValue)) { tileBuilder.setTargetNumTrianglesPerTile(tileValue); do_tile = true; }
+    while(arguments.read("--tile-levels", tileValue)) { tileBuilder.setMaximumNumLevels(tileValue); do_tile = true; }
+    while(arguments.read("--tile-atlas-size", tileValue)) { tileBuilder.setMaximumAtlasSize(tileValue); do_tile = true; }
+    while(arguments.read("--tile-threads", tileValue)) { tileBuilder.setNumThreads(tileValue); do_tile = true; }
+    while(arguments.read("--tile-quadtree")) { tileBuilder.setUseQuadTree(true); do_tile = true; }
+
+    float tileRangeScale = 0.0f;
+    while(arguments.read("--tile-range-scale", tileRangeScale)) { tileBuilder.setRangeScale(tileRangeScale); do_tile = true; }
+
     // any option left unread are converted into errors to write out later.
     arguments.reportRemainingOptionsAsUnrecognized();
 
@@ -778,6 +993,23 @@ int main( int argc, char **argv )
         fileNames.pop_back();
     }
 
+    if (do_tile)
+    {
+        if (do_convert || do_simplify)
+        {
+            osg::notify(osg::NOTICE)<<"Warning: orientation, scale, translation and simplify options are ignored when tiling."<< std::endl;
+        }
+
+        if (!tileBuilder.build(fileNames, fileNameOut))
+        {
+            osg::notify(osg::NOTICE)<<"Error building tiles for '"<<fileNameOut<<"'."<< std::endl;
+            return 1;
+        }
+
+        osg::notify(osg::NOTICE)<<"Data written to '"<<fileNameOut<<"'."<< std::endl;
+        return 0;
+    }
+
     osg::Timer_t startTick = osg::Timer::instance()->tick();
 
     osg::ref_ptr<osg::Node> root = osgDB::readRefNodeFiles(fileNames);
@@ -823,10 +1055,17 @@ int main( int argc, char **argv )
         if( do_convert )
             root = oc.convert( root.get() );
 
+        if (buildMipmaps)
+        {
+            MipmapTexturesVisitor mtv(mipmapFilter);
+            root->accept(mtv);
+            mtv.buildMipmaps();
+        }
+
         if (internalFormatMode != osg::Texture::USE_IMAGE_DATA_FORMAT)
         {
             ext = osgDB::getFileExtension(fileNameOut);
-            CompressTexturesVisitor ctv(internalFormatMode);
+            CompressTexturesVisitor ctv(internalFormatMode, compressionQuality);
             root->accept(ctv);
             ctv.compress();
 
@@ -31,6 +31,7 @@
 #include <osgDB/ReadFile>
 
 #include <osgText/FadeText>
+#include <osgText/TextBatch>
 
 #include <osgSim/OverlayNode>
 #include <osgSim/SphereSegment>
@@ -121,6 +122,51 @@ osg::Node* createFadeText(osg::EllipsoidModel* ellipsoid)
 }
 
 
+osg::Node* createTextBatch(osg::EllipsoidModel* ellipsoid, unsigned int numLat, unsigned int numLong)
+{
+    osg::Group* group = new osg::Group;
+    group->getOrCreateStateSet()->setMode(GL_DEPTH_TEST,osg::StateAttribute::OFF);
+
+    osg::Geode* geode = new osg::Geode;
+    group->addChild(geode);
+
+    // all the labels are laid out in the one TextBatch, drawn with a single draw call per glyph texture.
+    osgText::TextBatch* textBatch = new osgText::TextBatch;
+    textBatch->setFont("fonts/arial.ttf");
+    textBatch->setCharacterSizeMode(osgText::TextBase::SCREEN_COORDS);
+    textBatch->setCharacterSize(24.0f);
+    textBatch->setAlignment(osgText::TextBase::CENTER_BASE_LINE);
+    geode->addDrawable(textBatch);
+
+    std::vector<std::string> textList;
+    textList.push_back("Town");
+    textList.push_back("City");
+    textList.push_back("Village");
+    textList.push_back("River");
+    textList.push_back("Mountain");
+    textList.push_back("Road");
+    textList.push_back("Lake");
+
+    double latitude = 0.0;
+    double longitude = -100.0;
+    double deltaLatitude = 15.0/double(numLat);
+    double deltaLongitude = 20.0/double(numLong);
+
+    unsigned int t = 0;
+    for(unsigned int i = 0; i < numLat; ++i, latitude += deltaLatitude)
+    {
+        double lgnt = longitude;
+        for(unsigned int j = 0; j < numLong; ++j, ++t, lgnt += deltaLongitude)
+        {
+            double X,Y,Z;
+            ellipsoid->convertLatLongHeightToXYZ( osg::DegreesToRadians(latitude), osg::DegreesToRadians(lgnt), 0.0, X, Y, Z);
+            textBatch->addLabel(textList[t % textList.size()], osg::Vec3(X,Y,Z));
+        }
+    }
+
+    return group;
+}
+
 class TextSettings : public osg::NodeVisitor
 {
 public:
@@ -171,6 +217,9 @@ public:
             }
             if (_shaderTechniqueSet) text->setShaderTechnique(_shaderTechnique);
         }
+
+        osgText::TextBatch* textBatch = dynamic_cast<osgText::TextBatch*>(&drawable);
+        if (textBatch && _shaderTechniqueSet) textBatch->setShaderTechnique(_shaderTechnique);
     }
 
     bool                        _backdropTypeSet;
@@ -183,6 +232,12 @@ int main(int argc, char** argv)
 {
     osg::ArgumentParser arguments(&argc, argv);
 
+    arguments.getApplicationUsage()->addCommandLineOption("--batch <numLat> <numLong>", "Place a grid of numLat by numLong labels in a single osgText::TextBatch rather than using FadeText.");
+
+    unsigned int numBatchLat = 0;
+    unsigned int numBatchLong = 0;
+    bool useTextBatch = arguments.read("--batch", numBatchLat, numBatchLong);
+
     // construct the viewer.
     osgViewer::Viewer viewer(arguments);
 
@@ -201,7 +256,8 @@ int main(int argc, char** argv)
     if (csn)
     {
         // add fade text around the globe
-        csn->addChild(createFadeText(csn->getEllipsoidModel()));
+        if (useTextBatch) csn->addChild(createTextBatch(csn->getEllipsoidModel(), numBatchLat, numBatchLong));
+        else csn->addChild(createFadeText(csn->getEllipsoidModel()));
     }
 
     if (arguments.argc()>1)
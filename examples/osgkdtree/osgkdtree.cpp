@@ -42,6 +42,96 @@
 #include <osg/KdTree>
 
 #include <iostream>
+#include <stdlib.h>
+#include <math.h>
+
+// Create a height field like grid of triangles to run the ray benchmark against when no model is specified.
+osg::Node* createTerrain(unsigned int numRows)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    for(unsigned int r=0; r<=numRows; ++r)
+    {
+        for(unsigned int c=0; c<=numRows; ++c)
+        {
+            float x = static_cast<float>(c), y = static_cast<float>(r);
+            vertices->push_back(osg::Vec3(x, y, sinf(x*0.05f)*cosf(y*0.07f)*10.0f));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        for(unsigned int c=0; c<numRows; ++c)
+        {
+            unsigned int i = r*(numRows+1)+c;
+            triangles->push_back(i); triangles->push_back(i+1); triangles->push_back(i+numRows+2);
+            triangles->push_back(i); triangles->push_back(i+numRows+2); triangles->push_back(i+numRows+1);
+        }
+    }
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(triangles.get());
+
+    osg::ref_ptr<osg::KdTreeBuilder> builder = osgDB::Registry::instance()->getKdTreeBuilder()->clone();
+    geometry->accept(*builder);
+
+    return geometry.release();
+}
+
+// Time vertical rays cast down onto the scene, first with an IntersectionVisitor per ray and then with all the rays
+// gathered in an IntersectorGroup so that they share the traversal of the scene graph.
+void runRayBenchmark(osg::Node* scene, unsigned int numRays)
+{
+    const osg::BoundingSphere& bs = scene->getBound();
+
+    std::vector< osg::ref_ptr<osgUtil::LineSegmentIntersector> > intersectors;
+    srand(1);
+    for(unsigned int i=0; i<numRays; ++i)
+    {
+        double x = bs.center().x() + (static_cast<double>(rand())/RAND_MAX*2.0-1.0)*bs.radius()*0.7;
+        double y = bs.center().y() + (static_cast<double>(rand())/RAND_MAX*2.0-1.0)*bs.radius()*0.7;
+        osg::ref_ptr<osgUtil::LineSegmentIntersector> lsi = new osgUtil::LineSegmentIntersector(
+            osg::Vec3d(x, y, bs.center().z()+bs.radius()), osg::Vec3d(x, y, bs.center().z()-bs.radius()));
+        lsi->setIntersectionLimit(osgUtil::Intersector::LIMIT_NEAREST);
+        intersectors.push_back(lsi);
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    unsigned int numHitsSingle = 0;
+    for(unsigned int i=0; i<numRays; ++i)
+    {
+        intersectors[i]->reset();
+        osgUtil::IntersectionVisitor iv(intersectors[i].get());
+        scene->accept(iv);
+        if (intersectors[i]->containsIntersections()) ++numHitsSingle;
+    }
+
+    osg::Timer_t midTick = osg::Timer::instance()->tick();
+
+    osg::ref_ptr<osgUtil::IntersectorGroup> group = new osgUtil::IntersectorGroup;
+    for(unsigned int i=0; i<numRays; ++i)
+    {
+        intersectors[i]->reset();
+        group->addIntersector(intersectors[i].get());
+    }
+
+    osgUtil::IntersectionVisitor iv(group.get());
+    scene->accept(iv);
+
+    unsigned int numHitsBatched = 0;
+    for(unsigned int i=0; i<numRays; ++i)
+    {
+        if (intersectors[i]->containsIntersections()) ++numHitsBatched;
+    }
+
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    std::cout<<"Ray benchmark, "<<numRays<<" rays"<<std::endl;
+    std::cout<<"  single   "<<osg::Timer::instance()->delta_m(startTick, midTick)<<"ms, "<<numHitsSingle<<" hits"<<std::endl;
+    std::cout<<"  batched  "<<osg::Timer::instance()->delta_m(midTick, endTick)<<"ms, "<<numHitsBatched<<" hits"<<std::endl;
+}
 
 int main(int argc, char **argv)
 {
@@ -54,10 +144,33 @@ int main(int argc, char **argv)
     while (arguments.read("--max", maxNumLevels)) {}
     while (arguments.read("--leaf", targetNumIndicesPerLeaf)) {}
 
+    unsigned int numBenchmarkRays = 0;
+    while (arguments.read("--benchmark-rays", numBenchmarkRays)) {}
+
+    unsigned int terrainSize = 512;
+    while (arguments.read("--terrain-size", terrainSize)) {}
+
+    osg::KdTree::BuildOptions& buildOptions = osgDB::Registry::instance()->getKdTreeBuilder()->_buildOptions;
+    std::string layout;
+    while (arguments.read("--layout", layout))
+    {
+        if (layout=="depth") buildOptions._nodeLayout = osg::KdTree::BuildOptions::DEPTH_FIRST;
+        else if (layout=="breadth") buildOptions._nodeLayout = osg::KdTree::BuildOptions::BREADTH_FIRST;
+        else if (layout=="veb") buildOptions._nodeLayout = osg::KdTree::BuildOptions::VAN_EMDE_BOAS;
+        else std::cout<<"Unknown KdTree node layout "<<layout<<", use depth, breadth or veb."<<std::endl;
+    }
+
     osgDB::Registry::instance()->setBuildKdTreesHint(osgDB::ReaderWriter::Options::BUILD_KDTREES);
 
     osg::ref_ptr<osg::Node> scene = osgDB::readRefNodeFiles(arguments);
 
+    if (numBenchmarkRays>0)
+    {
+        if (!scene) scene = createTerrain(terrainSize);
+        runRayBenchmark(scene.get(), numBenchmarkRays);
+        return 0;
+    }
+
     if (!scene)
     {
         std::cout<<"No model loaded, please specify a valid model on the command line."<<std::endl;
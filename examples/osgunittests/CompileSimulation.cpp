@@ -0,0 +1,289 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/State>
+#include <osgUtil/IncrementalCompileOperation>
+
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+
+typedef osgUtil::IncrementalCompileOperation ICO;
+
+// Replays a CompileTrace through the IncrementalCompileOperation's scheduling code, with each compile advancing
+// a simulated clock by its recorded time rather than doing any OpenGL work, so scheduling decisions can be
+// evaluated headless.
+struct SimulationStats
+{
+    SimulationStats():
+        numFrames(0),
+        numOverrunFrames(0),
+        maxOverrun(0.0),
+        totalCompileTime(0.0),
+        totalLatency(0.0),
+        maxLatency(0),
+        numCompiled(0),
+        earlyRelativeError(0.0),
+        lateRelativeError(0.0),
+        numEarly(0),
+        numLate(0) {}
+
+    unsigned int    numFrames;
+    unsigned int    numOverrunFrames;
+    double          maxOverrun;
+    double          totalCompileTime;
+    double          totalLatency;
+    unsigned int    maxLatency;
+    unsigned int    numCompiled;
+    double          earlyRelativeError;
+    double          lateRelativeError;
+    unsigned int    numEarly;
+    unsigned int    numLate;
+};
+
+class SimulatedCompileOp : public ICO::CompileOp
+{
+    public:
+
+        SimulatedCompileOp(const osgUtil::CompileTrace::Record& record, double* clock, SimulationStats* stats, unsigned int numRecords):
+            _record(record),
+            _clock(clock),
+            _stats(stats),
+            _numRecords(numRecords) {}
+
+        virtual double estimatedTimeForCompile(ICO::CompileInfo& compileInfo) const
+        {
+            osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
+            switch(_record.type)
+            {
+                case(osgUtil::CompileTrace::TEXTURE): return gce->getTextureCostEstimator()->estimateCompileTime(_record.compileSize);
+                case(osgUtil::CompileTrace::PROGRAM): return gce->getProgramCostEstimator()->estimateCompileTime(_record.compileSize);
+                default: return gce->getGeometryCostEstimator()->estimateCompileTime(_record.compileSize);
+            }
+        }
+
+        virtual bool compile(ICO::CompileInfo& /*compileInfo*/)
+        {
+            *_clock += _record.compileTime;
+            return true;
+        }
+
+        virtual void recordCompileTime(ICO::CompileInfo& compileInfo, double estimatedTime, double compileTime)
+        {
+            osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
+            switch(_record.type)
+            {
+                case(osgUtil::CompileTrace::TEXTURE): gce->getTextureCostEstimator()->recordCompileTime(_record.compileSize, compileTime); break;
+                case(osgUtil::CompileTrace::PROGRAM): gce->getProgramCostEstimator()->recordCompileTime(_record.compileSize, compileTime); break;
+                default: gce->getGeometryCostEstimator()->recordCompileTime(_record.compileSize, compileTime); break;
+            }
+
+            unsigned int latency = compileInfo.incrementalCompileOperation->getCurrentFrameNumber()-_record.frameNumberAdded;
+            _stats->totalLatency += static_cast<double>(latency);
+            if (latency>_stats->maxLatency) _stats->maxLatency = latency;
+
+            // compare the accuracy of the estimates over the first and last quarter of the compiles.
+            if (compileInfo.useCostEstimates && compileTime>0.0)
+            {
+                double relativeError = fabs(estimatedTime-compileTime)/compileTime;
+                if (_stats->numCompiled<_numRecords/4) { _stats->earlyRelativeError += relativeError; ++_stats->numEarly; }
+                else if (_stats->numCompiled>=_numRecords-_numRecords/4) { _stats->lateRelativeError += relativeError; ++_stats->numLate; }
+            }
+
+            ++_stats->numCompiled;
+        }
+
+    protected:
+
+        osgUtil::CompileTrace::Record   _record;
+        double*                         _clock;
+        SimulationStats*                _stats;
+        unsigned int                    _numRecords;
+};
+
+// CompileInfo that reads the simulated clock rather than the timer.
+struct SimulatedCompileInfo : public ICO::CompileInfo
+{
+    SimulatedCompileInfo(osg::State* state, ICO* ico, const double* clock):
+        ICO::CompileInfo(state, ico),
+        _clock(clock) {}
+
+    virtual double elapsedTime() const { return *_clock; }
+
+    const double* _clock;
+};
+
+static bool lessFrameNumberAdded(const osgUtil::CompileTrace::Record& lhs, const osgUtil::CompileTrace::Record& rhs)
+{
+    return lhs.frameNumberAdded<rhs.frameNumberAdded;
+}
+
+static void createSyntheticTrace(osgUtil::CompileTrace& trace, unsigned int numFrames)
+{
+    // bursts of paged in tiles with a mix of small geometries and large textures, with compile times drawn from
+    // throughputs well below the GraphicsCostEstimator's defaults so that the uncalibrated estimates are too low.
+    srand(1);
+    for(unsigned int frame=0; frame<numFrames; frame+=20)
+    {
+        unsigned int numOps = 10+rand()%30;
+        for(unsigned int i=0; i<numOps; ++i)
+        {
+            osgUtil::CompileTrace::Record record;
+            record.frameNumberAdded = frame;
+            record.frameNumberCompiled = frame;
+
+            double noise = 0.8+0.4*static_cast<double>(rand())/static_cast<double>(RAND_MAX);
+            if (rand()%3==0)
+            {
+                unsigned int dimension = 64u<<(rand()%5);
+                record.type = osgUtil::CompileTrace::TEXTURE;
+                record.compileSize = dimension*dimension*4;
+                record.compileTime = (0.00005+static_cast<double>(record.compileSize)/1.0e9)*noise;
+            }
+            else
+            {
+                record.type = osgUtil::CompileTrace::GEOMETRY;
+                record.compileSize = 4096+rand()%(1<<20);
+                record.compileTime = (0.00002+static_cast<double>(record.compileSize)/2.0e9)*noise;
+            }
+            trace.add(record);
+        }
+    }
+}
+
+static SimulationStats simulate(const osgUtil::CompileTrace::Records& records, double budget, bool useCostEstimates, unsigned int maxNumObjectsPerFrame)
+{
+    SimulationStats stats;
+
+    osg::ref_ptr<osg::State> state = new osg::State;
+    osg::ref_ptr<ICO> ico = new ICO;
+    ico->setUseCostEstimates(useCostEstimates);
+
+    double clock = 0.0;
+    unsigned int numRecords = records.size();
+    unsigned int nextRecord = 0;
+    unsigned int frame = 0;
+    while(nextRecord<numRecords || !ico->getToCompile().empty())
+    {
+        ico->setCurrentFrameNumber(frame);
+
+        // add the compiles requested this frame as a single CompileSet.
+        osg::ref_ptr<ICO::CompileSet> compileSet;
+        while(nextRecord<numRecords && records[nextRecord].frameNumberAdded<=frame)
+        {
+            if (!compileSet)
+            {
+                compileSet = new ICO::CompileSet;
+                ++(compileSet->_numberCompileListsToCompile);
+            }
+            compileSet->_compileMap[0].add(new SimulatedCompileOp(records[nextRecord], &clock, &stats, numRecords));
+            ++nextRecord;
+        }
+        if (compileSet.valid()) ico->add(compileSet.get(), false);
+
+        ICO::CompileSets toCompile;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(*(ico->getToCompiledMutex()));
+            toCompile = ico->getToCompile();
+        }
+
+        clock = 0.0;
+        SimulatedCompileInfo compileInfo(state.get(), ico.get(), &clock);
+        compileInfo.allocatedTime = budget;
+        compileInfo.maxNumObjectsToCompile = maxNumObjectsPerFrame;
+
+        if (!toCompile.empty()) ico->compileSets(toCompile, compileInfo);
+        ico->mergeCompiledSubgraphs(0);
+
+        stats.totalCompileTime += clock;
+        if (clock>budget)
+        {
+            ++stats.numOverrunFrames;
+            if (clock-budget>stats.maxOverrun) stats.maxOverrun = clock-budget;
+        }
+
+        ++frame;
+    }
+
+    stats.numFrames = frame;
+    return stats;
+}
+
+static void report(const char* name, const SimulationStats& stats, double budget)
+{
+    std::cout<<"  "<<name<<std::endl;
+    std::cout<<"    frames "<<stats.numFrames<<", compiles "<<stats.numCompiled
+             <<", overrun frames "<<stats.numOverrunFrames
+             <<", worst frame "<<(budget+stats.maxOverrun)*1000.0<<"ms"
+             <<", average compile time per frame "<<stats.totalCompileTime*1000.0/static_cast<double>(stats.numFrames)<<"ms"<<std::endl;
+    std::cout<<"    average latency "<<(stats.numCompiled>0 ? stats.totalLatency/static_cast<double>(stats.numCompiled) : 0.0)
+             <<" frames, max latency "<<stats.maxLatency<<" frames"<<std::endl;
+    if (stats.numEarly>0 && stats.numLate>0)
+    {
+        std::cout<<"    estimate error, first quarter "<<100.0*stats.earlyRelativeError/static_cast<double>(stats.numEarly)
+                 <<"%, last quarter "<<100.0*stats.lateRelativeError/static_cast<double>(stats.numLate)<<"%"<<std::endl;
+    }
+}
+
+void runCompileSimulation(osg::ArgumentParser& arguments)
+{
+    std::string traceFileName;
+    while(arguments.read("--trace", traceFileName)) {}
+
+    std::string writeTraceFileName;
+    while(arguments.read("--write-trace", writeTraceFileName)) {}
+
+    double budget = 2.0;
+    while(arguments.read("--budget", budget)) {}
+    budget /= 1000.0;
+
+    unsigned int numFrames = 1000;
+    while(arguments.read("--frames", numFrames)) {}
+
+    unsigned int maxNumObjectsPerFrame = 20;
+    while(arguments.read("--max-objects", maxNumObjectsPerFrame)) {}
+
+    osg::ref_ptr<osgUtil::CompileTrace> trace = new osgUtil::CompileTrace;
+    if (!traceFileName.empty())
+    {
+        if (!trace->read(traceFileName))
+        {
+            std::cout<<"Unable to read compile trace "<<traceFileName<<std::endl;
+            return;
+        }
+    }
+    else
+    {
+        createSyntheticTrace(*trace, numFrames);
+    }
+
+    if (!writeTraceFileName.empty()) trace->write(writeTraceFileName);
+
+    // traces are recorded in the order the compiles completed, so replay them in the order they were requested.
+    osgUtil::CompileTrace::Records records;
+    trace->getRecords(records);
+    std::stable_sort(records.begin(), records.end(), lessFrameNumberAdded);
+
+    std::cout<<"Compile scheduling simulation, "<<records.size()<<" compiles, "<<budget*1000.0<<"ms per frame"<<std::endl;
+    report("compile in order till time runs out", simulate(records, budget, false, maxNumObjectsPerFrame), budget);
+    report("schedule with calibrated cost estimates", simulate(records, budget, true, maxNumObjectsPerFrame), budget);
+}
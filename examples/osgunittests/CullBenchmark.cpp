@@ -0,0 +1,185 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osg/TaskPool>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/Statistics>
+
+#include <iostream>
+#include <math.h>
+
+// Builds a grid of groups of single triangle drawables, spread over a number of StateSets, and times the cull
+// traversal of it from a camera that circles the grid so that the set of visible StateSets changes every frame.
+static osg::Node* createCullBenchmarkScene(unsigned int numDrawables, unsigned int numStateSets, unsigned int numGroups)
+{
+    std::vector< osg::ref_ptr<osg::StateSet> > statesets;
+    for(unsigned int i=0; i<numStateSets; ++i)
+    {
+        statesets.push_back(new osg::StateSet);
+    }
+
+    osg::Group* root = new osg::Group;
+    for(unsigned int i=0; i<numGroups; ++i)
+    {
+        root->addChild(new osg::Group);
+    }
+
+    unsigned int gridSize = static_cast<unsigned int>(ceil(sqrt(static_cast<double>(numDrawables))));
+    for(unsigned int i=0; i<numDrawables; ++i)
+    {
+        osg::Vec3 origin(static_cast<float>(i%gridSize), static_cast<float>(i/gridSize), 0.0f);
+
+        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+        vertices->push_back(origin);
+        vertices->push_back(origin+osg::Vec3(0.5f,0.0f,0.0f));
+        vertices->push_back(origin+osg::Vec3(0.0f,0.5f,0.0f));
+
+        osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+        geometry->setVertexArray(vertices.get());
+        geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->setStateSet(statesets[(i*7919)%numStateSets].get());
+        geode->addDrawable(geometry.get());
+
+        root->getChild((i*numGroups)/numDrawables)->asGroup()->addChild(geode.get());
+    }
+
+    return root;
+}
+
+void runCullBenchmark(osg::ArgumentParser& arguments)
+{
+    unsigned int numDrawables = 50000;
+    while(arguments.read("--drawables", numDrawables)) {}
+
+    unsigned int numStateSets = 2000;
+    while(arguments.read("--statesets", numStateSets)) {}
+
+    unsigned int numFrames = 100;
+    while(arguments.read("--frames", numFrames)) {}
+
+    bool resetStateGraph = false;
+    while(arguments.read("--reset-stategraph")) { resetStateGraph = true; }
+
+    unsigned int numCullThreads = 0;
+    while(arguments.read("--parallel-cull", numCullThreads)) {}
+
+    if (numDrawables==0 || numStateSets==0 || numFrames==0) return;
+
+    osg::ref_ptr<osg::Node> scene = createCullBenchmarkScene(numDrawables, numStateSets, 16);
+
+    osg::ref_ptr<osgUtil::CullVisitor> cv = osgUtil::CullVisitor::create();
+    osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph;
+    osg::ref_ptr<osgUtil::RenderStage> renderStage = new osgUtil::RenderStage;
+    osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,1280,1024);
+
+    if (numCullThreads>0)
+    {
+        cv->setParallelCullTaskPool(new osg::TaskPool(numCullThreads));
+        scene->setCullCallback(new osgUtil::ParallelCullCallback);
+    }
+
+    const osg::BoundingSphere& bs = scene->getBound();
+    osg::Matrixd projection = osg::Matrixd::perspective(50.0, 1280.0/1024.0, 1.0, bs.radius()*4.0);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    double totalCullTime = 0.0;
+    unsigned int totalDrawables = 0;
+    unsigned int totalStateGraphs = 0;
+    unsigned int totalLeavesAllocated = 0;
+    unsigned int totalLeavesReused = 0;
+    unsigned int totalMatricesAllocated = 0;
+    unsigned int totalMatricesReused = 0;
+
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        double angle = osg::PI*2.0*static_cast<double>(frame)/static_cast<double>(numFrames);
+        osg::Vec3d eye = bs.center()+osg::Vec3d(cos(angle), sin(angle), 0.4)*bs.radius()*0.6;
+        osg::Vec3d center = bs.center()+osg::Vec3d(cos(angle+1.0), sin(angle+1.0), 0.0)*bs.radius()*0.3;
+        osg::Matrixd view = osg::Matrixd::lookAt(eye, center, osg::Vec3d(0.0,0.0,1.0));
+
+        cv->reset();
+        cv->setTraversalNumber(frame);
+        cv->setStateGraph(stateGraph.get());
+        cv->setRenderStage(renderStage.get());
+
+        renderStage->reset();
+        renderStage->setViewport(viewport.get());
+
+        if (resetStateGraph) stateGraph->reset();
+        else stateGraph->clean();
+
+        osg::Timer_t cullStartTick = osg::Timer::instance()->tick();
+
+        cv->pushViewport(viewport.get());
+        cv->pushProjectionMatrix(new osg::RefMatrix(projection));
+        cv->pushModelViewMatrix(new osg::RefMatrix(view), osg::Transform::ABSOLUTE_RF);
+
+        scene->accept(*cv);
+
+        cv->popModelViewMatrix();
+        cv->popProjectionMatrix();
+        cv->popViewport();
+
+        renderStage->sort();
+        stateGraph->prune();
+
+        osg::Timer_t cullEndTick = osg::Timer::instance()->tick();
+        totalCullTime += osg::Timer::instance()->delta_m(cullStartTick, cullEndTick);
+
+        osgUtil::Statistics stats;
+        renderStage->getStats(stats);
+        totalDrawables += stats.numDrawables;
+        totalStateGraphs += stats.numStateGraphs;
+
+        totalLeavesAllocated += cv->getNumRenderLeavesAllocated();
+        totalLeavesReused += cv->getNumRenderLeavesReused();
+        totalMatricesAllocated += cv->getNumMatricesAllocated();
+        totalMatricesReused += cv->getNumMatricesReused();
+    }
+
+    double totalTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+    std::cout<<"Cull benchmark, "<<numDrawables<<" drawables, "<<numStateSets<<" StateSets, "<<numFrames<<" frames";
+    if (numCullThreads>0) std::cout<<", "<<numCullThreads<<" cull threads";
+    if (resetStateGraph) std::cout<<", StateGraph reset each frame";
+    std::cout<<std::endl;
+
+    std::cout<<"  average cull time "<<totalCullTime/static_cast<double>(numFrames)<<"ms"
+             <<", average frame time "<<totalTime/static_cast<double>(numFrames)<<"ms"
+             <<", average drawables culled in "<<totalDrawables/numFrames
+             <<", average StateGraphs "<<totalStateGraphs/numFrames<<std::endl;
+
+    std::cout<<"  RenderLeaves allocated "<<totalLeavesAllocated<<", reused "<<totalLeavesReused
+             <<", matrices allocated "<<totalMatricesAllocated<<", reused "<<totalMatricesReused<<std::endl;
+
+    const osgUtil::StateGraph::Pool* pool = stateGraph->getPool();
+    if (pool)
+    {
+        std::cout<<"  StateGraph nodes allocated "<<pool->getNumAllocated()
+                 <<", reused "<<pool->getNumReused()
+                 <<", held in pool "<<pool->getNumFree()<<std::endl;
+    }
+}
@@ -0,0 +1,155 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osgUtil/IntersectionBatch>
+#include <osgUtil/LineSegmentIntersector>
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+
+// Builds a tiled terrain and compares the time to intersect a set of height queries with it in a single serial
+// IntersectionVisitor traversal against an osgUtil::IntersectionBatch, checking that both give the same results.
+static float terrainHeight(float x, float y)
+{
+    return 20.0f*sinf(x*0.05f)*cosf(y*0.03f) + 5.0f*sinf(x*0.31f+y*0.17f);
+}
+
+static osg::Node* createTerrain(unsigned int numTiles, unsigned int tileSize)
+{
+    osg::Group* root = new osg::Group;
+    for(unsigned int ty=0; ty<numTiles; ++ty)
+    {
+        for(unsigned int tx=0; tx<numTiles; ++tx)
+        {
+            osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+            for(unsigned int j=0; j<=tileSize; ++j)
+            {
+                for(unsigned int i=0; i<=tileSize; ++i)
+                {
+                    float x = static_cast<float>(tx*tileSize+i);
+                    float y = static_cast<float>(ty*tileSize+j);
+                    vertices->push_back(osg::Vec3(x, y, terrainHeight(x, y)));
+                }
+            }
+
+            osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+            for(unsigned int j=0; j<tileSize; ++j)
+            {
+                for(unsigned int i=0; i<tileSize; ++i)
+                {
+                    unsigned int v = j*(tileSize+1)+i;
+                    triangles->push_back(v); triangles->push_back(v+1); triangles->push_back(v+tileSize+2);
+                    triangles->push_back(v); triangles->push_back(v+tileSize+2); triangles->push_back(v+tileSize+1);
+                }
+            }
+
+            osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+            geometry->setVertexArray(vertices.get());
+            geometry->addPrimitiveSet(triangles.get());
+
+            osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+            geode->addDrawable(geometry.get());
+            root->addChild(geode.get());
+        }
+    }
+    return root;
+}
+
+void runIntersectionBenchmark(osg::ArgumentParser& arguments)
+{
+    unsigned int numQueries = 10000;
+    while(arguments.read("--queries", numQueries)) {}
+
+    unsigned int numTiles = 16;
+    while(arguments.read("--tiles", numTiles)) {}
+
+    unsigned int binSize = 64;
+    while(arguments.read("--bin-size", binSize)) {}
+
+    unsigned int numThreads = 0;
+    while(arguments.read("--intersect-threads", numThreads)) {}
+
+    const unsigned int tileSize = 32;
+    osg::ref_ptr<osg::Node> terrain = createTerrain(numTiles, tileSize);
+    terrain->getBound();
+
+    float extent = static_cast<float>(numTiles*tileSize);
+    std::vector< std::pair<osg::Vec3d, osg::Vec3d> > segments;
+    srand(1);
+    for(unsigned int i=0; i<numQueries; ++i)
+    {
+        double x = extent*static_cast<double>(rand())/static_cast<double>(RAND_MAX);
+        double y = extent*static_cast<double>(rand())/static_cast<double>(RAND_MAX);
+        segments.push_back(std::make_pair(osg::Vec3d(x, y, 100.0), osg::Vec3d(x, y, -100.0)));
+    }
+
+    std::cout<<"Intersection benchmark, "<<numQueries<<" queries, "<<numTiles*numTiles<<" tiles of "<<tileSize*tileSize*2<<" triangles"<<std::endl;
+
+    // serial traversal of all the queries in one IntersectorGroup.
+    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup;
+    for(unsigned int i=0; i<numQueries; ++i)
+    {
+        intersectorGroup->addIntersector(new osgUtil::LineSegmentIntersector(segments[i].first, segments[i].second));
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    osgUtil::IntersectionVisitor iv(intersectorGroup.get());
+    terrain->accept(iv);
+    double serialTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+    std::cout<<"  single IntersectionVisitor "<<serialTime<<"ms"<<std::endl;
+
+    // batched and binned traversal.
+    osg::ref_ptr<osgUtil::IntersectionBatch> batch = new osgUtil::IntersectionBatch;
+    batch->setMaximumNumIntersectorsPerBin(binSize);
+    if (numThreads>0) batch->setTaskPool(new osg::TaskPool(numThreads));
+    for(unsigned int i=0; i<numQueries; ++i)
+    {
+        batch->addIntersector(new osgUtil::LineSegmentIntersector(segments[i].first, segments[i].second));
+    }
+
+    startTick = osg::Timer::instance()->tick();
+    batch->computeIntersections(terrain.get());
+    double batchTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+    unsigned int numMismatches = 0;
+    unsigned int numHits = 0;
+    for(unsigned int i=0; i<numQueries; ++i)
+    {
+        osgUtil::LineSegmentIntersector* serial = static_cast<osgUtil::LineSegmentIntersector*>(intersectorGroup->getIntersectors()[i].get());
+        osgUtil::LineSegmentIntersector* batched = static_cast<osgUtil::LineSegmentIntersector*>(batch->getIntersector(i));
+        if (serial->containsIntersections()) ++numHits;
+        if (serial->containsIntersections()!=batched->containsIntersections() ||
+            (serial->containsIntersections() &&
+             (serial->getFirstIntersection().getWorldIntersectPoint()-batched->getFirstIntersection().getWorldIntersectPoint()).length()>1e-6))
+        {
+            ++numMismatches;
+        }
+    }
+
+    std::cout<<"  IntersectionBatch "<<batchTime<<"ms, "<<batch->getNumBins()<<" bins on "
+             <<(batch->getTaskPool() ? batch->getTaskPool()->getNumThreads() : 0)<<" threads"<<std::endl;
+    std::cout<<"  "<<numHits<<" queries hit the terrain, "<<numMismatches<<" results differ"<<std::endl;
+}
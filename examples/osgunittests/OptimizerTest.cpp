@@ -0,0 +1,199 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Notify>
+#include <osg/Geometry>
+#include <osg/TaskPool>
+#include <osg/Timer>
+#include <osgDB/Registry>
+#include <osgUtil/Optimizer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+
+// Optimizes the same generated scene serially and with a TaskPool, checking that the two runs write out
+// byte for byte identical .osgt files and that the permission callback is only called from the calling thread.
+namespace
+{
+
+osg::Geometry* createGeometry(unsigned int numTriangles, const osg::Vec3& offset)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUShort> triangles = new osg::DrawElementsUShort(GL_TRIANGLES);
+    for(unsigned int i=0; i<numTriangles; ++i)
+    {
+        // reuse a vertex of the previous triangle now and again so that the mesh passes have something to do.
+        for(unsigned int v=0; v<3; ++v)
+        {
+            if (i>0 && v==0 && rand()%2==0)
+            {
+                triangles->push_back(static_cast<unsigned short>(vertices->size()-1));
+                continue;
+            }
+
+            triangles->push_back(static_cast<unsigned short>(vertices->size()));
+            vertices->push_back(offset + osg::Vec3(static_cast<float>(rand()%100), static_cast<float>(rand()%100), static_cast<float>(rand()%100)));
+            normals->push_back(osg::Vec3(0.0f, 0.0f, 1.0f));
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(triangles.get());
+    return geometry;
+}
+
+// build the scene from a fixed seed, so that each call returns an identical scene graph.
+osg::Node* createScene(unsigned int numGroups, unsigned int numGeometriesPerGroup)
+{
+    srand(1);
+
+    osg::Group* root = new osg::Group;
+    osg::ref_ptr<osg::Geometry> sharedGeometry = createGeometry(20, osg::Vec3());
+    for(unsigned int g=0; g<numGroups; ++g)
+    {
+        osg::ref_ptr<osg::Group> group = new osg::Group;
+        osg::Vec3 offset(static_cast<float>(g%32)*100.0f, static_cast<float>(g/32)*100.0f, 0.0f);
+        for(unsigned int i=0; i<numGeometriesPerGroup; ++i)
+        {
+            osg::ref_ptr<osg::Geometry> geometry = createGeometry(10+rand()%50, offset);
+            if (rand()%10==0) geometry->setName("locked");
+            group->addChild(geometry.get());
+        }
+
+        // every eighth group shares a child with the others, so has to be merged serially.
+        if (g%8==0) group->addChild(sharedGeometry.get());
+
+        root->addChild(group.get());
+    }
+    return root;
+}
+
+class PermissionCallback : public osgUtil::Optimizer::IsOperationPermissibleForObjectCallback
+{
+public:
+
+    PermissionCallback():
+        _callingThread(OpenThreads::Thread::CurrentThread()),
+        _numCalls(0),
+        _numCallsFromOtherThreads(0) {}
+
+    virtual bool isOperationPermissibleForObjectImplementation(const osgUtil::Optimizer* optimizer, const osg::Drawable* drawable, unsigned int option) const
+    {
+        ++_numCalls;
+        if (OpenThreads::Thread::CurrentThread()!=_callingThread) ++_numCallsFromOtherThreads;
+
+        if (drawable->getName()=="locked") return false;
+        return optimizer->isOperationPermissibleForObjectImplementation(drawable, option);
+    }
+
+    virtual bool isOperationPermissibleForObjectImplementation(const osgUtil::Optimizer* optimizer, const osg::Node* node, unsigned int option) const
+    {
+        ++_numCalls;
+        if (OpenThreads::Thread::CurrentThread()!=_callingThread) ++_numCallsFromOtherThreads;
+
+        return optimizer->isOperationPermissibleForObjectImplementation(node, option);
+    }
+
+    OpenThreads::Thread*    _callingThread;
+    mutable unsigned int    _numCalls;
+    mutable unsigned int    _numCallsFromOtherThreads;
+};
+
+std::string optimizeAndWrite(osg::Node* scene, osg::TaskPool* taskPool, PermissionCallback* callback, double& time)
+{
+    const unsigned int options = osgUtil::Optimizer::MERGE_GEOMETRY |
+                                 osgUtil::Optimizer::INDEX_MESH |
+                                 osgUtil::Optimizer::VERTEX_POSTTRANSFORM |
+                                 osgUtil::Optimizer::VERTEX_PRETRANSFORM;
+
+    osgUtil::Optimizer optimizer;
+    optimizer.setTaskPool(taskPool);
+    optimizer.setIsOperationPermissibleForObjectCallback(callback);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    optimizer.optimize(scene, options);
+    time = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+    std::ostringstream output;
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgt");
+    if (rw) rw->writeNode(*scene, output);
+    return output.str();
+}
+
+}
+
+bool runOptimizerTest(osg::ArgumentParser& arguments)
+{
+    unsigned int numGroups = 512;
+    while(arguments.read("--groups", numGroups)) {}
+
+    unsigned int numGeometriesPerGroup = 8;
+    while(arguments.read("--geometries", numGeometriesPerGroup)) {}
+
+    unsigned int numThreads = 4;
+    while(arguments.read("--optimizer-threads", numThreads)) {}
+
+    std::cout<<"Optimizer test, "<<numGroups<<" groups of "<<numGeometriesPerGroup<<" geometries"<<std::endl;
+
+    double serialTime = 0.0;
+    osg::ref_ptr<osg::Node> serialScene = createScene(numGroups, numGeometriesPerGroup);
+    osg::ref_ptr<PermissionCallback> serialCallback = new PermissionCallback;
+    std::string serialOutput = optimizeAndWrite(serialScene.get(), 0, serialCallback.get(), serialTime);
+
+    double parallelTime = 0.0;
+    osg::ref_ptr<osg::Node> parallelScene = createScene(numGroups, numGeometriesPerGroup);
+    osg::ref_ptr<osg::TaskPool> taskPool = new osg::TaskPool(numThreads);
+    osg::ref_ptr<PermissionCallback> parallelCallback = new PermissionCallback;
+    std::string parallelOutput = optimizeAndWrite(parallelScene.get(), taskPool.get(), parallelCallback.get(), parallelTime);
+
+    if (serialOutput.empty())
+    {
+        OSG_FATAL<<"Optimizer test failed, unable to write the optimized scenes as the osg plugin could not be loaded."<<std::endl;
+        return false;
+    }
+
+    std::cout<<"  serial   "<<serialTime<<"ms, "<<serialCallback->_numCalls<<" permission checks"<<std::endl;
+    std::cout<<"  parallel "<<parallelTime<<"ms with "<<numThreads<<" threads, "<<parallelCallback->_numCalls<<" permission checks"<<std::endl;
+    std::cout<<"  outputs "<<(serialOutput==parallelOutput ? "identical" : "DIFFER")<<", "<<serialOutput.size()<<" bytes"<<std::endl;
+    std::cout<<"  permission checks from other threads "<<parallelCallback->_numCallsFromOtherThreads<<std::endl;
+
+    bool passed = true;
+    if (serialOutput!=parallelOutput)
+    {
+        OSG_FATAL<<"Optimizer test failed, the serial and parallel outputs differ."<<std::endl;
+        passed = false;
+    }
+
+    if (parallelCallback->_numCallsFromOtherThreads!=0)
+    {
+        OSG_FATAL<<"Optimizer test failed, "<<parallelCallback->_numCallsFromOtherThreads<<" permission checks were made from other threads."<<std::endl;
+        passed = false;
+    }
+
+    return passed;
+}
@@ -0,0 +1,206 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/BackgroundDeleteHandler>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <vector>
+
+// Times ref_ptr<> churn from several threads, each both copying pointers to objects shared between the threads and
+// creating and releasing small subgraphs of its own, whilst the main thread advances frames and releases a large
+// subgraph, which is the stall a DeleteHandler that deletes in the background is intended to remove.
+typedef std::vector< osg::ref_ptr<osg::Node> > NodeList;
+
+class RefChurnThread : public OpenThreads::Thread
+{
+    public:
+
+        RefChurnThread(const NodeList& shared, unsigned int numIterations):
+            _shared(shared),
+            _numIterations(numIterations),
+            _time(0.0) {}
+
+        virtual void run()
+        {
+            osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+            NodeList local;
+            for(unsigned int i=0; i<_numIterations; ++i)
+            {
+                // copying the shared pointers contends on their reference counts
+                local = _shared;
+                local.clear();
+
+                // and releasing the new subgraph goes through the DeleteHandler
+                osg::ref_ptr<osg::Group> group = new osg::Group;
+                for(unsigned int c=0; c<8; ++c)
+                {
+                    group->addChild(new osg::Geode);
+                }
+            }
+
+            _time = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+        }
+
+        double getTime() const { return _time; }
+
+    protected:
+
+        const NodeList& _shared;
+        unsigned int    _numIterations;
+        double          _time;
+};
+
+static osg::Node* createReleaseSubgraph(unsigned int numGeodes)
+{
+    osg::Group* root = new osg::Group;
+    osg::Group* group = 0;
+    for(unsigned int i=0; i<numGeodes; ++i)
+    {
+        if ((i%64)==0)
+        {
+            group = new osg::Group;
+            root->addChild(group);
+        }
+
+        osg::Geometry* geometry = new osg::Geometry;
+        geometry->setVertexArray(new osg::Vec3Array(12));
+        geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 12));
+
+        osg::Geode* geode = new osg::Geode;
+        geode->addDrawable(geometry);
+        group->addChild(geode);
+    }
+    return root;
+}
+
+static void runRefCountMode(const char* name, osg::DeleteHandler* deleteHandler, unsigned int numThreads, unsigned int numIterations, unsigned int numGeodes)
+{
+    osg::Referenced::setDeleteHandler(deleteHandler);
+
+    NodeList shared;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        shared.push_back(new osg::Group);
+    }
+
+    osg::ref_ptr<osg::Node> subgraph = createReleaseSubgraph(numGeodes);
+
+    std::vector<RefChurnThread*> threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new RefChurnThread(shared, numIterations));
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads[i]->startThread();
+    }
+
+    // advance frames as a viewer would whilst the threads run, releasing the large subgraph part way through.
+    unsigned int frameNumber = 0;
+    double releaseTime = 0.0;
+    double maxFlushTime = 0.0;
+    bool running = true;
+    while(running)
+    {
+        OpenThreads::Thread::microSleep(1000);
+
+        if (frameNumber==10)
+        {
+            osg::Timer_t releaseTick = osg::Timer::instance()->tick();
+            subgraph = 0;
+            releaseTime = osg::Timer::instance()->delta_m(releaseTick, osg::Timer::instance()->tick());
+        }
+
+        if (deleteHandler)
+        {
+            osg::Timer_t flushTick = osg::Timer::instance()->tick();
+            deleteHandler->flush();
+            deleteHandler->setFrameNumber(++frameNumber);
+            double flushTime = osg::Timer::instance()->delta_m(flushTick, osg::Timer::instance()->tick());
+            if (flushTime>maxFlushTime) maxFlushTime = flushTime;
+        }
+        else
+        {
+            ++frameNumber;
+        }
+
+        running = frameNumber<=10;
+        for(unsigned int i=0; i<numThreads; ++i)
+        {
+            if (threads[i]->isRunning()) running = true;
+        }
+    }
+
+    double churnTime = 0.0;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads[i]->join();
+        if (threads[i]->getTime()>churnTime) churnTime = threads[i]->getTime();
+        delete threads[i];
+    }
+
+    if (deleteHandler) deleteHandler->flushAll();
+
+    double totalTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+    std::cout<<"  "<<name<<std::endl;
+    std::cout<<"    churn "<<churnTime<<"ms, "<<static_cast<double>(numThreads*numIterations)/churnTime<<" iterations/ms"
+             <<", release of subgraph on main thread "<<releaseTime<<"ms"
+             <<", worst flush "<<maxFlushTime<<"ms"
+             <<", total "<<totalTime<<"ms"<<std::endl;
+
+    osg::BackgroundDeleteHandler* backgroundDeleteHandler = dynamic_cast<osg::BackgroundDeleteHandler*>(deleteHandler);
+    if (backgroundDeleteHandler)
+    {
+        std::cout<<"    objects deleted in background "<<backgroundDeleteHandler->getNumObjectsDeletedInBackground()<<std::endl;
+    }
+
+    shared.clear();
+    osg::Referenced::setDeleteHandler(0);
+}
+
+void runRefCountBenchmark(osg::ArgumentParser& arguments)
+{
+    unsigned int numThreads = 4;
+    while(arguments.read("--ref-threads", numThreads)) {}
+
+    unsigned int numIterations = 100000;
+    while(arguments.read("--iterations", numIterations)) {}
+
+    unsigned int numGeodes = 100000;
+    while(arguments.read("--release-geodes", numGeodes)) {}
+
+    std::cout<<"Reference count benchmark, "<<numThreads<<" threads, "<<numIterations<<" iterations each, releasing "<<numGeodes<<" geodes"<<std::endl;
+
+    runRefCountMode("no DeleteHandler", 0, numThreads, numIterations, numGeodes);
+    runRefCountMode("DeleteHandler retaining 2 frames", new osg::DeleteHandler(2), numThreads, numIterations, numGeodes);
+    runRefCountMode("BackgroundDeleteHandler", new osg::BackgroundDeleteHandler(0), numThreads, numIterations, numGeodes);
+    runRefCountMode("BackgroundDeleteHandler retaining 2 frames", new osg::BackgroundDeleteHandler(2), numThreads, numIterations, numGeodes);
+}
@@ -0,0 +1,297 @@
+/* -*-c++-*-
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LightSource>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <osg/TaskPool>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/Statistics>
+#include <osgShadow/ShadowedScene>
+#include <osgShadow/ViewDependentShadowMap>
+
+#include <iostream>
+#include <math.h>
+
+static const unsigned int s_receivesShadowTraversalMask = 0x1;
+static const unsigned int s_castsShadowTraversalMask = 0x2;
+
+// ViewDependentShadowMap that times the light space extents computation and the cull of the shadow cameras, each camera
+// only being timed when they are culled serially as the parallel cull doesn't go through cullShadowCastingScene(..).
+class TimedViewDependentShadowMap : public osgShadow::ViewDependentShadowMap
+{
+public:
+
+    TimedViewDependentShadowMap():
+        _currentCamera(0),
+        _extentsTime(0.0),
+        _shadowCullTime(0.0) {}
+
+    virtual void cullShadowCastingScene(osgUtil::CullVisitor* cv, osg::Camera* camera) const
+    {
+        osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+        osgShadow::ViewDependentShadowMap::cullShadowCastingScene(cv, camera);
+
+        if (_currentCamera>=_cameraCullTimes.size()) _cameraCullTimes.resize(_currentCamera+1, 0.0);
+        _cameraCullTimes[_currentCamera++] += osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+    }
+
+    virtual void cullShadowCastingScenes(osgUtil::CullVisitor* cv, ViewDependentData& vdd, const CameraList& cameras) const
+    {
+        osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+        _currentCamera = 0;
+        osgShadow::ViewDependentShadowMap::cullShadowCastingScenes(cv, vdd, cameras);
+
+        _shadowCullTime += osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+    }
+
+    virtual osg::BoundingBox computeShadowCasterExtents(ViewDependentData& vdd, LightData& positionedLight, const osg::Polytope& polytope, const osg::Matrixd& projectionMatrix, const osg::Matrixd& viewMatrix)
+    {
+        osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+        osg::BoundingBox bb = osgShadow::ViewDependentShadowMap::computeShadowCasterExtents(vdd, positionedLight, polytope, projectionMatrix, viewMatrix);
+
+        _extentsTime += osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+        return bb;
+    }
+
+    mutable unsigned int        _currentCamera;
+    mutable std::vector<double> _cameraCullTimes;
+    double                      _extentsTime;
+    mutable double              _shadowCullTime;
+};
+
+// Builds a ground plane receiving shadows from a grid of small boxes, with a row of the boxes in each transform.
+static osg::Node* createShadowCasters(unsigned int numCasters, unsigned int numDynamicRows)
+{
+    osg::Group* group = new osg::Group;
+
+    unsigned int gridSize = static_cast<unsigned int>(ceil(sqrt(static_cast<double>(numCasters))));
+
+    osg::ref_ptr<osg::DrawElementsUShort> indices = new osg::DrawElementsUShort(GL_QUADS);
+    const unsigned short faces[] = { 0,1,2,3, 4,5,6,7, 0,1,5,4, 1,2,6,5, 2,3,7,6, 3,0,4,7 };
+    for(unsigned int i=0; i<24; ++i) indices->push_back(faces[i]);
+
+    for(unsigned int row=0; row<gridSize; ++row)
+    {
+        osg::MatrixTransform* transform = new osg::MatrixTransform(osg::Matrixd::translate(0.0, static_cast<double>(row), 0.0));
+        if (row<numDynamicRows) transform->setDataVariance(osg::Object::DYNAMIC);
+        group->addChild(transform);
+
+        for(unsigned int column=0; column<gridSize && row*gridSize+column<numCasters; ++column)
+        {
+            osg::Vec3 origin(static_cast<float>(column), 0.0f, 0.0f);
+            float size = 0.4f;
+            float height = 0.5f + static_cast<float>((row*7919+column*104729)%100)*0.02f;
+
+            osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+            vertices->push_back(origin);
+            vertices->push_back(origin+osg::Vec3(size,0.0f,0.0f));
+            vertices->push_back(origin+osg::Vec3(size,size,0.0f));
+            vertices->push_back(origin+osg::Vec3(0.0f,size,0.0f));
+            vertices->push_back(origin+osg::Vec3(0.0f,0.0f,height));
+            vertices->push_back(origin+osg::Vec3(size,0.0f,height));
+            vertices->push_back(origin+osg::Vec3(size,size,height));
+            vertices->push_back(origin+osg::Vec3(0.0f,size,height));
+
+            osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+            geometry->setVertexArray(vertices.get());
+            geometry->addPrimitiveSet(indices.get());
+
+            osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+            geode->setNodeMask(s_castsShadowTraversalMask | s_receivesShadowTraversalMask);
+            geode->addDrawable(geometry.get());
+
+            transform->addChild(geode.get());
+        }
+    }
+
+    float extent = static_cast<float>(gridSize);
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    vertices->push_back(osg::Vec3(-1.0f,-1.0f,0.0f));
+    vertices->push_back(osg::Vec3(extent+1.0f,-1.0f,0.0f));
+    vertices->push_back(osg::Vec3(extent+1.0f,extent+1.0f,0.0f));
+    vertices->push_back(osg::Vec3(-1.0f,extent+1.0f,0.0f));
+
+    osg::ref_ptr<osg::Geometry> ground = new osg::Geometry;
+    ground->setVertexArray(vertices.get());
+    ground->addPrimitiveSet(new osg::DrawArrays(GL_QUADS, 0, 4));
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->setNodeMask(s_receivesShadowTraversalMask);
+    geode->addDrawable(ground.get());
+    group->addChild(geode.get());
+
+    return group;
+}
+
+void runShadowCullBenchmark(osg::ArgumentParser& arguments)
+{
+    unsigned int numCasters = 20000;
+    while(arguments.read("--casters", numCasters)) {}
+
+    unsigned int numDynamicRows = 0;
+    while(arguments.read("--dynamic-rows", numDynamicRows)) {}
+
+    unsigned int numLights = 2;
+    while(arguments.read("--lights", numLights)) {}
+
+    unsigned int numShadowMaps = 2;
+    while(arguments.read("--shadow-maps", numShadowMaps)) {}
+
+    unsigned int numFrames = 100;
+    while(arguments.read("--frames", numFrames)) {}
+
+    unsigned int numCullThreads = 0;
+    while(arguments.read("--parallel-cull", numCullThreads)) {}
+
+    bool cacheCasterBounds = false;
+    while(arguments.read("--cache-caster-bounds")) { cacheCasterBounds = true; }
+
+    bool staticCamera = false;
+    while(arguments.read("--static-camera")) { staticCamera = true; }
+
+    if (numCasters==0 || numFrames==0 || numLights==0) return;
+
+    osg::ref_ptr<osgShadow::ShadowSettings> settings = new osgShadow::ShadowSettings;
+    settings->setReceivesShadowTraversalMask(s_receivesShadowTraversalMask);
+    settings->setCastsShadowTraversalMask(s_castsShadowTraversalMask);
+    settings->setNumShadowMapsPerLight(numShadowMaps);
+    settings->setCullShadowMapsInParallel(numCullThreads>0);
+    settings->setCacheShadowCasterBounds(cacheCasterBounds);
+
+    osg::ref_ptr<TimedViewDependentShadowMap> vdsm = new TimedViewDependentShadowMap;
+
+    osg::ref_ptr<osgShadow::ShadowedScene> shadowedScene = new osgShadow::ShadowedScene;
+    shadowedScene->setShadowSettings(settings.get());
+    shadowedScene->setShadowTechnique(vdsm.get());
+    shadowedScene->addChild(createShadowCasters(numCasters, numDynamicRows));
+
+    for(unsigned int i=0; i<numLights; ++i)
+    {
+        double angle = osg::PI*0.5*static_cast<double>(i)/static_cast<double>(numLights);
+
+        osg::ref_ptr<osg::LightSource> lightSource = new osg::LightSource;
+        lightSource->getLight()->setLightNum(i);
+        lightSource->getLight()->setPosition(osg::Vec4(cos(angle)*0.5, sin(angle)*0.5, 1.0, 0.0));
+        shadowedScene->addChild(lightSource.get());
+    }
+
+    vdsm->init();
+
+    osg::ref_ptr<osgUtil::CullVisitor> cv = osgUtil::CullVisitor::create();
+    osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph;
+    osg::ref_ptr<osgUtil::RenderStage> renderStage = new osgUtil::RenderStage;
+    osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,1280,1024);
+
+    if (numCullThreads>0)
+    {
+        cv->setParallelCullTaskPool(new osg::TaskPool(numCullThreads));
+    }
+
+    const osg::BoundingSphere& bs = shadowedScene->getBound();
+    osg::Matrixd projection = osg::Matrixd::perspective(50.0, 1280.0/1024.0, 1.0, bs.radius()*4.0);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    double totalCullTime = 0.0;
+    unsigned int totalDrawables = 0;
+    unsigned int totalShadowStages = 0;
+
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        double angle = staticCamera ? 0.0 : osg::PI*2.0*static_cast<double>(frame)/static_cast<double>(numFrames);
+        osg::Vec3d eye = bs.center()+osg::Vec3d(cos(angle), sin(angle), 0.3)*bs.radius()*0.5;
+        osg::Vec3d center = bs.center()+osg::Vec3d(cos(angle+1.0), sin(angle+1.0), 0.0)*bs.radius()*0.3;
+        osg::Matrixd view = osg::Matrixd::lookAt(eye, center, osg::Vec3d(0.0,0.0,1.0));
+
+        cv->reset();
+        cv->setTraversalNumber(frame);
+        cv->setStateGraph(stateGraph.get());
+        cv->setRenderStage(renderStage.get());
+
+        renderStage->reset();
+        renderStage->setViewport(viewport.get());
+
+        stateGraph->clean();
+
+        osg::Timer_t cullStartTick = osg::Timer::instance()->tick();
+
+        cv->pushViewport(viewport.get());
+        cv->pushProjectionMatrix(new osg::RefMatrix(projection));
+        cv->pushModelViewMatrix(new osg::RefMatrix(view), osg::Transform::ABSOLUTE_RF);
+
+        shadowedScene->accept(*cv);
+
+        cv->popModelViewMatrix();
+        cv->popProjectionMatrix();
+        cv->popViewport();
+
+        renderStage->sort();
+        stateGraph->prune();
+
+        osg::Timer_t cullEndTick = osg::Timer::instance()->tick();
+        totalCullTime += osg::Timer::instance()->delta_m(cullStartTick, cullEndTick);
+
+        osgUtil::Statistics stats;
+        for(osgUtil::RenderStage::RenderStageList::iterator itr = renderStage->getPreRenderList().begin();
+            itr != renderStage->getPreRenderList().end();
+            ++itr)
+        {
+            itr->second->getStats(stats);
+            ++totalShadowStages;
+        }
+        totalDrawables += stats.numDrawables;
+    }
+
+    double totalTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+    double frames = static_cast<double>(numFrames);
+
+    std::cout<<"Shadow cull benchmark, "<<numCasters<<" casters, "<<numLights<<" lights, "<<numShadowMaps<<" shadow maps per light, "<<numFrames<<" frames";
+    if (numDynamicRows>0) std::cout<<", "<<numDynamicRows<<" dynamic rows";
+    if (numCullThreads>0) std::cout<<", "<<numCullThreads<<" cull threads";
+    if (cacheCasterBounds) std::cout<<", cached caster bounds";
+    if (staticCamera) std::cout<<", static camera";
+    std::cout<<std::endl;
+
+    std::cout<<"  average cull time "<<totalCullTime/frames<<"ms"
+             <<", average frame time "<<totalTime/frames<<"ms"
+             <<", shadow stages per frame "<<static_cast<double>(totalShadowStages)/frames
+             <<", average shadow casting drawables "<<totalDrawables/numFrames<<std::endl;
+
+    std::cout<<"  average caster extents time "<<vdsm->_extentsTime/frames<<"ms"
+             <<", average shadow camera cull time "<<vdsm->_shadowCullTime/frames<<"ms"<<std::endl;
+
+    for(unsigned int i=0; i<vdsm->_cameraCullTimes.size(); ++i)
+    {
+        std::cout<<"    shadow camera "<<i<<" (light "<<i/numShadowMaps<<", shadow map "<<i%numShadowMaps<<") average cull time "
+                 <<vdsm->_cameraCullTimes[i]/frames<<"ms"<<std::endl;
+    }
+
+    if (vdsm->_cameraCullTimes.empty() && numCullThreads>0)
+    {
+        std::cout<<"    per shadow camera cull times are only reported when the shadow cameras are culled serially"<<std::endl;
+    }
+}
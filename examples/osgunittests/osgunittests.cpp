@@ -34,6 +34,12 @@
 #include <iostream>
 
 extern void runFileNameUtilsTest(osg::ArgumentParser& arguments);
+extern void runCullBenchmark(osg::ArgumentParser& arguments);
+extern void runCompileSimulation(osg::ArgumentParser& arguments);
+extern void runRefCountBenchmark(osg::ArgumentParser& arguments);
+extern void runIntersectionBenchmark(osg::ArgumentParser& arguments);
+extern void runShadowCullBenchmark(osg::ArgumentParser& arguments);
+extern bool runOptimizerTest(osg::ArgumentParser& arguments);
 
 void testFrustum(double left,double right,double bottom,double top,double zNear,double zFar)
 {
@@ -572,6 +578,37 @@ int main( int argc, char** argv )
     arguments.getApplicationUsage()->addCommandLineOption("matrix","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("performance","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("read-threads <numthreads>","Run multi-thread reading test.");
+    arguments.getApplicationUsage()->addCommandLineOption("cull","Run the cull traversal benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("--drawables <num>","Number of drawables in the cull benchmark scene, default 50000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--statesets <num>","Number of StateSets in the cull benchmark scene, default 2000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--frames <num>","Number of frames to cull in the cull benchmark, default 100, or to generate compiles over in the compile simulation, default 1000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--reset-stategraph","Reset the StateGraph each frame in the cull benchmark rather than cleaning and pruning it.");
+    arguments.getApplicationUsage()->addCommandLineOption("--parallel-cull <numthreads>","Cull the cull benchmark scene in parallel using the specified number of threads.");
+    arguments.getApplicationUsage()->addCommandLineOption("compile","Run the IncrementalCompileOperation scheduling simulation.");
+    arguments.getApplicationUsage()->addCommandLineOption("--trace <filename>","Replay a compile trace recorded with OSG_COMPILE_TRACE in the compile simulation, rather than a generated one.");
+    arguments.getApplicationUsage()->addCommandLineOption("--write-trace <filename>","Write out the compile trace used by the compile simulation.");
+    arguments.getApplicationUsage()->addCommandLineOption("--budget <ms>","Time allocated to compiles each frame in the compile simulation, default 2.");
+    arguments.getApplicationUsage()->addCommandLineOption("--max-objects <num>","Maximum number of objects compiled each frame in the compile simulation, default 20.");
+    arguments.getApplicationUsage()->addCommandLineOption("refcount","Run the reference counting and DeleteHandler benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ref-threads <num>","Number of threads churning ref_ptr<> in the refcount benchmark, default 4.");
+    arguments.getApplicationUsage()->addCommandLineOption("--iterations <num>","Number of iterations run by each thread in the refcount benchmark, default 100000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--release-geodes <num>","Number of geodes in the subgraph released by the main thread in the refcount benchmark, default 100000.");
+    arguments.getApplicationUsage()->addCommandLineOption("intersect","Run the batched intersection benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("--queries <num>","Number of line segments intersected in the intersect benchmark, default 10000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <num>","Number of terrain tiles along each side in the intersect benchmark, default 16.");
+    arguments.getApplicationUsage()->addCommandLineOption("--bin-size <num>","Maximum number of line segments in each bin in the intersect benchmark, default 64.");
+    arguments.getApplicationUsage()->addCommandLineOption("--intersect-threads <num>","Number of threads used in the intersect benchmark, default uses the shared TaskPool.");
+    arguments.getApplicationUsage()->addCommandLineOption("shadow","Run the ViewDependentShadowMap cull benchmark, also reading --frames and --parallel-cull.");
+    arguments.getApplicationUsage()->addCommandLineOption("--casters <num>","Number of shadow casters in the shadow benchmark scene, default 20000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--dynamic-rows <num>","Number of rows of shadow casters given DYNAMIC data variance in the shadow benchmark, default 0.");
+    arguments.getApplicationUsage()->addCommandLineOption("--lights <num>","Number of shadow casting lights in the shadow benchmark, default 2.");
+    arguments.getApplicationUsage()->addCommandLineOption("--shadow-maps <num>","Number of shadow maps per light in the shadow benchmark, default 2.");
+    arguments.getApplicationUsage()->addCommandLineOption("--cache-caster-bounds","Cache the bounds of static shadow casters in the shadow benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("--static-camera","Keep the view fixed rather than orbiting the scene in the shadow benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("optimizer","Check that optimizing a scene with a TaskPool gives the same output as a serial run.");
+    arguments.getApplicationUsage()->addCommandLineOption("--groups <num>","Number of groups in the optimizer test scene, default 512.");
+    arguments.getApplicationUsage()->addCommandLineOption("--geometries <num>","Number of geometries per group in the optimizer test scene, default 8.");
+    arguments.getApplicationUsage()->addCommandLineOption("--optimizer-threads <num>","Number of TaskPool threads used by the optimizer test, default 4.");
 
 
     if (arguments.argc()<=1)
@@ -601,6 +638,24 @@ int main( int argc, char** argv )
     bool printPolytopeTest = false;
     while (arguments.read("polytope")) printPolytopeTest = true;
 
+    bool runCullBenchmarkTest = false;
+    while (arguments.read("cull")) runCullBenchmarkTest = true;
+
+    bool runCompileSimulationTest = false;
+    while (arguments.read("compile")) runCompileSimulationTest = true;
+
+    bool runRefCountBenchmarkTest = false;
+    while (arguments.read("refcount")) runRefCountBenchmarkTest = true;
+
+    bool runIntersectionBenchmarkTest = false;
+    while (arguments.read("intersect")) runIntersectionBenchmarkTest = true;
+
+    bool runShadowCullBenchmarkTest = false;
+    while (arguments.read("shadow")) runShadowCullBenchmarkTest = true;
+
+    bool runOptimizerTestTest = false;
+    while (arguments.read("optimizer")) runOptimizerTestTest = true;
+
     bool doTestThreadInitAndExit = false;
     while (arguments.read("thread")) doTestThreadInitAndExit = true;
 
@@ -610,6 +665,42 @@ int main( int argc, char** argv )
     bool performanceTest = false;
     while (arguments.read("p") || arguments.read("performance")) performanceTest = true;
 
+    // the benchmark and simulation options must be read before remaining options are reported.
+    if (runCullBenchmarkTest)
+    {
+        runCullBenchmark(arguments);
+        return 0;
+    }
+
+    if (runCompileSimulationTest)
+    {
+        runCompileSimulation(arguments);
+        return 0;
+    }
+
+    if (runRefCountBenchmarkTest)
+    {
+        runRefCountBenchmark(arguments);
+        return 0;
+    }
+
+    if (runIntersectionBenchmarkTest)
+    {
+        runIntersectionBenchmark(arguments);
+        return 0;
+    }
+
+    if (runShadowCullBenchmarkTest)
+    {
+        runShadowCullBenchmark(arguments);
+        return 0;
+    }
+
+    if (runOptimizerTestTest)
+    {
+        return runOptimizerTest(arguments) ? 0 : 1;
+    }
+
     // if user request help write it out to cout.
     if (arguments.read("-h") || arguments.read("--help"))
     {
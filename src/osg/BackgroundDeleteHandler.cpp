@@ -0,0 +1,203 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/BackgroundDeleteHandler>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+using namespace osg;
+
+void BackgroundDeleteHandler::ReclamationThread::run()
+{
+    OSG_INFO<<"BackgroundDeleteHandler::ReclamationThread::run()"<<std::endl;
+
+    while(_handler->_done==0)
+    {
+        if (!_handler->deleteQueuedBatches(true, true))
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_handler->_queueMutex);
+            if (_handler->_done==0)
+            {
+                // time out periodically as a guard against a missed wake up.
+                _handler->_queueCondition.wait(&(_handler->_queueMutex), 100);
+            }
+        }
+    }
+}
+
+BackgroundDeleteHandler::BackgroundDeleteHandler(int numberOfFramesToRetainObjects, unsigned int batchSize):
+    DeleteHandler(numberOfFramesToRetainObjects),
+    _batchSize(batchSize),
+    _reclamationThread(this)
+{
+    _reclamationThread.startThread();
+}
+
+BackgroundDeleteHandler::~BackgroundDeleteHandler()
+{
+    // once _done is set requestDelete() deletes straight away, as the handler may be part way through destruction
+    // when objects unref'd by the final flush request their own deletion.
+    _done.exchange(1);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queueMutex);
+        _queueCondition.broadcast();
+    }
+    if (_reclamationThread.isRunning()) _reclamationThread.join();
+
+    flushAll();
+}
+
+BackgroundDeleteHandler::ThreadBatch& BackgroundDeleteHandler::getThreadBatch()
+{
+    // threads started by OpenThreads are identified by their Thread object, other threads such as the main thread by
+    // the address of their stack, which is spaced far enough apart between threads to map them to different batches.
+    size_t key;
+    OpenThreads::Thread* thread = OpenThreads::Thread::CurrentThread();
+    if (thread)
+    {
+        key = reinterpret_cast<size_t>(thread)/sizeof(void*);
+    }
+    else
+    {
+        int local = 0;
+        key = reinterpret_cast<size_t>(&local)>>16;
+    }
+    key ^= (key>>5) ^ (key>>11);
+    return _threadBatches[key%NUM_THREAD_BATCHES];
+}
+
+void BackgroundDeleteHandler::handOver(Batch& batch)
+{
+    if (batch.objects.empty()) return;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queueMutex);
+        _queue.push_back(Batch());
+        _queue.back().frameNumber = batch.frameNumber;
+        _queue.back().objects.swap(batch.objects);
+
+        // when objects are retained the batch can't be deleted till a later frame, which flush() will signal
+        if (_numFramesToRetainObjects==0) _queueCondition.signal();
+    }
+
+    batch.objects.reserve(_batchSize);
+}
+
+void BackgroundDeleteHandler::handOverAll()
+{
+    for(unsigned int i=0; i<NUM_THREAD_BATCHES; ++i)
+    {
+        ThreadBatch& threadBatch = _threadBatches[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(threadBatch.mutex);
+        handOver(threadBatch.batch);
+    }
+}
+
+bool BackgroundDeleteHandler::deleteQueuedBatches(bool retainObjects, bool inBackground)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> deleteLock(_deleteMutex);
+
+    Batches toDelete;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queueMutex);
+        if (_queue.empty()) return false;
+
+        if (!retainObjects || _numFramesToRetainObjects==0)
+        {
+            toDelete.swap(_queue);
+        }
+        else
+        {
+            if (_currentFrameNumber<_numFramesToRetainObjects) return false;
+
+            unsigned int frameNumberToClearTo = _currentFrameNumber - _numFramesToRetainObjects;
+
+            // batches are handed over as threads fill them so aren't in frame order, keep the ones still too recent.
+            Batches toKeep;
+            for(Batches::iterator itr = _queue.begin();
+                itr != _queue.end();
+                ++itr)
+            {
+                Batches& destination = (itr->frameNumber <= frameNumberToClearTo) ? toDelete : toKeep;
+                destination.push_back(Batch());
+                destination.back().frameNumber = itr->frameNumber;
+                destination.back().objects.swap(itr->objects);
+            }
+            _queue.swap(toKeep);
+        }
+    }
+
+    if (toDelete.empty()) return false;
+
+    // delete outside the queue lock, as destructors unref children which request their own deletion.
+    for(Batches::iterator itr = toDelete.begin();
+        itr != toDelete.end();
+        ++itr)
+    {
+        ObjectList& objects = itr->objects;
+        for(ObjectList::iterator oitr = objects.begin();
+            oitr != objects.end();
+            ++oitr)
+        {
+            doDelete(*oitr);
+
+            --_numObjectsPending;
+            if (inBackground) ++_numObjectsDeletedInBackground;
+        }
+    }
+
+    return true;
+}
+
+void BackgroundDeleteHandler::flush()
+{
+    handOverAll();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queueMutex);
+    _queueCondition.signal();
+}
+
+void BackgroundDeleteHandler::flushAll()
+{
+    // deleting a batch can request further deletes, so keep going till nothing is left.
+    do
+    {
+        handOverAll();
+    }
+    while(deleteQueuedBatches(false, false));
+}
+
+void BackgroundDeleteHandler::requestDelete(const osg::Referenced* object)
+{
+    // objects released by the destruction of a batch are deleted straight away, they are already past the
+    // retention period of the object that held them and the reclamation thread has nothing else to do.
+    if (_done!=0 || OpenThreads::Thread::CurrentThread()==&_reclamationThread)
+    {
+        doDelete(object);
+        return;
+    }
+
+    ThreadBatch& threadBatch = getThreadBatch();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(threadBatch.mutex);
+
+    Batch& batch = threadBatch.batch;
+
+    // keep each batch to a single frame so it can be retained for the right length of time.
+    if (!batch.objects.empty() && batch.frameNumber!=_currentFrameNumber) handOver(batch);
+
+    if (batch.objects.empty()) batch.frameNumber = _currentFrameNumber;
+    batch.objects.push_back(object);
+    ++_numObjectsPending;
+
+    if (batch.objects.size()>=_batchSize) handOver(batch);
+}
@@ -24,6 +24,8 @@ CullStack::CullStack()
     _bbCornerNear = 0;
     _bbCornerFar = 7;
     _currentReuseMatrixIndex=0;
+    _numMatricesAllocated=0;
+    _numMatricesReused=0;
     _identity = new RefMatrix();
 
     _index_modelviewCullingStack = 0;
@@ -39,6 +41,8 @@ CullStack::CullStack(const CullStack& cs):
     _bbCornerNear = 0;
     _bbCornerFar = 7;
     _currentReuseMatrixIndex=0;
+    _numMatricesAllocated=0;
+    _numMatricesReused=0;
     _identity = new RefMatrix();
 
     _index_modelviewCullingStack = 0;
@@ -86,6 +90,35 @@ void CullStack::reset()
     _bbCornerNear = (~_bbCornerFar)&7;
 
     _currentReuseMatrixIndex=0;
+    _numMatricesAllocated=0;
+    _numMatricesReused=0;
+}
+
+void CullStack::copyCullStackState(const CullStack& cs)
+{
+    _occluderList = cs._occluderList;
+
+    _projectionStack = cs._projectionStack;
+    _modelviewStack = cs._modelviewStack;
+    _MVPW_Stack = cs._MVPW_Stack;
+    _viewportStack = cs._viewportStack;
+
+    _referenceViewPoints = cs._referenceViewPoints;
+    _eyePointStack = cs._eyePointStack;
+    _viewPointStack = cs._viewPointStack;
+
+    _clipspaceCullingStack = cs._clipspaceCullingStack;
+    _projectionCullingStack = cs._projectionCullingStack;
+
+    // only the active entries of the modelview culling stack are copied, the rest are just kept for reuse.
+    _modelviewCullingStack.assign(cs._modelviewCullingStack.begin(), cs._modelviewCullingStack.begin()+cs._index_modelviewCullingStack);
+    _index_modelviewCullingStack = cs._index_modelviewCullingStack;
+    _back_modelviewCullingStack = _index_modelviewCullingStack>0 ? &_modelviewCullingStack[_index_modelviewCullingStack-1] : 0;
+
+    _frustumVolume = cs._frustumVolume;
+
+    _bbCornerNear = cs._bbCornerNear;
+    _bbCornerFar = cs._bbCornerFar;
 }
 
 
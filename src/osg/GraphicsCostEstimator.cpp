@@ -43,6 +43,8 @@ void GeometryCostEstimator::setDefaults()
 
     _displayListCompileConstant = 0.0;
     _displayListCompileFactor = 10.0;
+
+    _measuredCompileCost.reset();
 }
 
 void GeometryCostEstimator::calibrate(osg::RenderInfo& /*renderInfo*/)
@@ -55,6 +57,11 @@ CostPair GeometryCostEstimator::estimateCompileCost(const osg::Geometry* geometr
     bool usesVBO = geometry->getUseVertexBufferObjects();
     bool usesDL = !usesVBO && geometry->getUseDisplayList() && geometry->getSupportsDisplayList();
 
+    if ((usesVBO || usesDL) && _measuredCompileCost.calibrated())
+    {
+        return CostPair(_measuredCompileCost(computeCompileSize(geometry)), 0.0);
+    }
+
     if (usesVBO || usesDL)
     {
         CostPair cost;
@@ -96,6 +103,37 @@ CostPair GeometryCostEstimator::estimateDrawCost(const osg::Geometry* /*geometry
     return CostPair(0.0,0.0);
 }
 
+unsigned int GeometryCostEstimator::computeCompileSize(const osg::Geometry* geometry) const
+{
+    unsigned int size = 0;
+    if (geometry->getVertexArray()) size += geometry->getVertexArray()->getTotalDataSize();
+    if (geometry->getNormalArray()) size += geometry->getNormalArray()->getTotalDataSize();
+    if (geometry->getColorArray()) size += geometry->getColorArray()->getTotalDataSize();
+    if (geometry->getSecondaryColorArray()) size += geometry->getSecondaryColorArray()->getTotalDataSize();
+    if (geometry->getFogCoordArray()) size += geometry->getFogCoordArray()->getTotalDataSize();
+    for(unsigned i=0; i<geometry->getNumTexCoordArrays(); ++i)
+    {
+        if (geometry->getTexCoordArray(i)) size += geometry->getTexCoordArray(i)->getTotalDataSize();
+    }
+    for(unsigned i=0; i<geometry->getNumVertexAttribArrays(); ++i)
+    {
+        if (geometry->getVertexAttribArray(i)) size += geometry->getVertexAttribArray(i)->getTotalDataSize();
+    }
+    for(unsigned i=0; i<geometry->getNumPrimitiveSets(); ++i)
+    {
+        const osg::PrimitiveSet* primSet = geometry->getPrimitiveSet(i);
+        const osg::DrawElements* drawElements = primSet ? primSet->getDrawElements() : 0;
+        if (drawElements) size += drawElements->getTotalDataSize();
+    }
+    return size;
+}
+
+double GeometryCostEstimator::estimateCompileTime(unsigned int compileSize) const
+{
+    if (_measuredCompileCost.calibrated()) return _measuredCompileCost(compileSize);
+    return _arrayCompileCost(compileSize);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
 // TextureCostEstimator
@@ -112,6 +150,8 @@ void TextureCostEstimator::setDefaults()
     double min_time = 0.00001; // 10 nano seconds.
     _compileCost.set(min_time, 1.0/transfer_bandwidth, 256); // min time 1/10th of millisecond, min size 256
     _drawCost.set(min_time, 1.0/gpu_bandwidth, 256); // min time 1/10th of millisecond, min size 256
+
+    _measuredCompileCost.reset();
 }
 
 void TextureCostEstimator::calibrate(osg::RenderInfo& /*renderInfo*/)
@@ -120,13 +160,18 @@ void TextureCostEstimator::calibrate(osg::RenderInfo& /*renderInfo*/)
 
 CostPair TextureCostEstimator::estimateCompileCost(const osg::Texture* texture) const
 {
+    if (_measuredCompileCost.calibrated())
+    {
+        return CostPair(_measuredCompileCost(computeCompileSize(texture)), 0.0);
+    }
+
     CostPair cost;
     for(unsigned int i=0; i<texture->getNumImages(); ++i)
     {
         const osg::Image* image = texture->getImage(i);
         if (image) cost.first += _compileCost(image->getTotalDataSize());
     }
-    OSG_NOTICE<<"TextureCostEstimator::estimateCompileCost(), size="<<cost.first<<std::endl;
+    OSG_DEBUG<<"TextureCostEstimator::estimateCompileCost(), size="<<cost.first<<std::endl;
     return cost;
 }
 
@@ -135,6 +180,23 @@ CostPair TextureCostEstimator::estimateDrawCost(const osg::Texture* /*texture*/)
     return CostPair(0.0,0.0);
 }
 
+unsigned int TextureCostEstimator::computeCompileSize(const osg::Texture* texture) const
+{
+    unsigned int size = 0;
+    for(unsigned int i=0; i<texture->getNumImages(); ++i)
+    {
+        const osg::Image* image = texture->getImage(i);
+        if (image) size += image->getTotalDataSize();
+    }
+    return size;
+}
+
+double TextureCostEstimator::estimateCompileTime(unsigned int compileSize) const
+{
+    if (_measuredCompileCost.calibrated()) return _measuredCompileCost(compileSize);
+    return _compileCost(compileSize);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
 // ProgramCostEstimator
@@ -145,14 +207,19 @@ ProgramCostEstimator::ProgramCostEstimator()
 
 void ProgramCostEstimator::setDefaults()
 {
+    _measuredCompileCost.reset();
 }
 
 void ProgramCostEstimator::calibrate(osg::RenderInfo& /*renderInfo*/)
 {
 }
 
-CostPair ProgramCostEstimator::estimateCompileCost(const osg::Program* /*program*/) const
+CostPair ProgramCostEstimator::estimateCompileCost(const osg::Program* program) const
 {
+    if (_measuredCompileCost.calibrated())
+    {
+        return CostPair(_measuredCompileCost(computeCompileSize(program)), 0.0);
+    }
     return CostPair(0.0,0.0);
 }
 
@@ -161,6 +228,23 @@ CostPair ProgramCostEstimator::estimateDrawCost(const osg::Program* /*program*/)
     return CostPair(0.0,0.0);
 }
 
+unsigned int ProgramCostEstimator::computeCompileSize(const osg::Program* program) const
+{
+    unsigned int size = 0;
+    for(unsigned int i=0; i<program->getNumShaders(); ++i)
+    {
+        const osg::Shader* shader = program->getShader(i);
+        if (shader) size += shader->getShaderSource().size();
+    }
+    return size;
+}
+
+double ProgramCostEstimator::estimateCompileTime(unsigned int compileSize) const
+{
+    if (_measuredCompileCost.calibrated()) return _measuredCompileCost(compileSize);
+    return 0.0;
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
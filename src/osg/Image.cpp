@@ -14,6 +14,7 @@
 #include <osg/GLU>
 
 #include <osg/Image>
+#include <osg/ImageUtils>
 #include <osg/Notify>
 #include <osg/io_utils>
 
@@ -1609,20 +1610,33 @@ void Image::scaleImage(int s,int t,int r, GLenum newDataType)
         return;
     }
 
-    PixelStorageModes psm;
-    psm.pack_alignment = _packing;
-    psm.pack_row_length = _rowLength;
-    psm.unpack_alignment = _packing;
+    bool resampled = false;
+    if (isResampleSupported(_pixelFormat, _dataType) && isResampleSupported(_pixelFormat, newDataType))
+    {
+        // filter with the vectorized resampler for the common formats, falling back to gluScaleImage if it fails.
+        osg::ref_ptr<osg::Image> destImage = new osg::Image;
+        destImage->setImage(s, t, 1, _internalTextureFormat, _pixelFormat, newDataType, newData, NO_DELETE, _packing);
+        resampled = resampleImage(this, destImage.get(), RESAMPLE_TRIANGLE);
+    }
 
-    GLint status = gluScaleImage(&psm, _pixelFormat,
-        _s,
-        _t,
-        _dataType,
-        _data,
-        s,
-        t,
-        newDataType,
-        newData);
+    GLint status = 0;
+    if (!resampled)
+    {
+        PixelStorageModes psm;
+        psm.pack_alignment = _packing;
+        psm.pack_row_length = _rowLength;
+        psm.unpack_alignment = _packing;
+
+        status = gluScaleImage(&psm, _pixelFormat,
+            _s,
+            _t,
+            _dataType,
+            _data,
+            s,
+            t,
+            newDataType,
+            newData);
+    }
 
     if (status==0)
     {
@@ -0,0 +1,976 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/ImageUtils>
+#include <osg/Texture>
+#include <osg/Math>
+#include <osg/Notify>
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace osg;
+
+namespace
+{
+
+const unsigned int BLOCK_ROWS_PER_BAND = 16;
+const unsigned int MINIMUM_BLOCKS_FOR_TASKS = 1024;
+
+// A 4x4 block of pixels in row major order.
+struct PixelBlock
+{
+    unsigned char rgba[16][4];
+};
+
+inline int square(int v) { return v*v; }
+
+inline int clampTo(int v, int minValue, int maxValue) { return v<minValue ? minValue : (v>maxValue ? maxValue : v); }
+
+unsigned int computeBlockSizeInBytes(GLenum compressedFormat)
+{
+    switch(compressedFormat)
+    {
+        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):
+        case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT):
+        case(GL_COMPRESSED_RED_RGTC1_EXT):
+        case(GL_ETC1_RGB8_OES):
+        case(GL_COMPRESSED_RGB8_ETC2):
+        case(GL_COMPRESSED_R11_EAC):
+            return 8;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT):
+        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+        case(GL_COMPRESSED_RGBA8_ETC2_EAC):
+        case(GL_COMPRESSED_RG11_EAC):
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// Reads 4x4 blocks of an uncompressed GL_UNSIGNED_BYTE image as RGBA, clamping to the edges of images whose sizes
+// aren't multiples of four.
+struct BlockReader
+{
+    const unsigned char*    data;
+    unsigned int            rowStep;
+    int                     width;
+    int                     height;
+    GLenum                  pixelFormat;
+    unsigned int            pixelSize;
+
+    void readPixel(const unsigned char* pixel, unsigned char* rgba) const
+    {
+        switch(pixelFormat)
+        {
+            case(GL_RGB): rgba[0] = pixel[0]; rgba[1] = pixel[1]; rgba[2] = pixel[2]; rgba[3] = 255; break;
+            case(GL_RGBA): rgba[0] = pixel[0]; rgba[1] = pixel[1]; rgba[2] = pixel[2]; rgba[3] = pixel[3]; break;
+            case(GL_BGR): rgba[0] = pixel[2]; rgba[1] = pixel[1]; rgba[2] = pixel[0]; rgba[3] = 255; break;
+            case(GL_BGRA): rgba[0] = pixel[2]; rgba[1] = pixel[1]; rgba[2] = pixel[0]; rgba[3] = pixel[3]; break;
+            case(GL_LUMINANCE): rgba[0] = rgba[1] = rgba[2] = pixel[0]; rgba[3] = 255; break;
+            case(GL_LUMINANCE_ALPHA): rgba[0] = rgba[1] = rgba[2] = pixel[0]; rgba[3] = pixel[1]; break;
+            case(GL_INTENSITY): rgba[0] = rgba[1] = rgba[2] = rgba[3] = pixel[0]; break;
+            case(GL_ALPHA): rgba[0] = rgba[1] = rgba[2] = 0; rgba[3] = pixel[0]; break;
+            case(GL_RED): rgba[0] = pixel[0]; rgba[1] = rgba[2] = 0; rgba[3] = 255; break;
+            case(GL_RG): rgba[0] = pixel[0]; rgba[1] = pixel[1]; rgba[2] = 0; rgba[3] = 255; break;
+        }
+    }
+
+    void readBlock(int bx, int by, PixelBlock& block) const
+    {
+        for(int y=0; y<4; ++y)
+        {
+            const unsigned char* row = data + osg::minimum(by*4+y, height-1)*rowStep;
+            for(int x=0; x<4; ++x)
+            {
+                readPixel(row + osg::minimum(bx*4+x, width-1)*pixelSize, block.rgba[y*4+x]);
+            }
+        }
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BC1 colour blocks, also used for the colour of DXT3 and DXT5
+//
+inline unsigned short packRGB565(const float* rgb)
+{
+    int r = clampTo(static_cast<int>(rgb[0]*(31.0f/255.0f)+0.5f), 0, 31);
+    int g = clampTo(static_cast<int>(rgb[1]*(63.0f/255.0f)+0.5f), 0, 63);
+    int b = clampTo(static_cast<int>(rgb[2]*(31.0f/255.0f)+0.5f), 0, 31);
+    return static_cast<unsigned short>((r<<11) | (g<<5) | b);
+}
+
+inline void unpackRGB565(unsigned short v, int* rgb)
+{
+    int r = (v>>11)&31, g = (v>>5)&63, b = v&31;
+    rgb[0] = (r<<3)|(r>>2);
+    rgb[1] = (g<<2)|(g>>4);
+    rgb[2] = (b<<3)|(b>>2);
+}
+
+struct ColorBlockEncoding
+{
+    unsigned short  color0;
+    unsigned short  color1;
+    unsigned int    indices;
+    int             error;
+};
+
+class ColorBlockEncoder
+{
+    public:
+
+        // punchThroughAlpha encodes pixels with alpha below 128 as transparent, fourColorOnly is required for DXT3 and DXT5
+        // whose colour blocks are always decoded with four colours.
+        ColorBlockEncoder(const PixelBlock& block, bool punchThroughAlpha, bool fourColorOnly):
+            _block(block),
+            _fourColorOnly(fourColorOnly),
+            _numUsed(0),
+            _hasTransparent(false)
+        {
+            for(unsigned int i=0; i<16; ++i)
+            {
+                _used[i] = !punchThroughAlpha || block.rgba[i][3]>=128;
+                if (_used[i]) ++_numUsed;
+                else _hasTransparent = true;
+            }
+        }
+
+        void encode(CompressionQuality quality, unsigned char* out)
+        {
+            ColorBlockEncoding best;
+            if (_numUsed==0)
+            {
+                best.color0 = 0;
+                best.color1 = 0;
+                best.indices = 0xffffffff;
+            }
+            else
+            {
+                float start0[3], start1[3];
+                computePrincipalEndpoints(start0, start1);
+
+                bool threeColor = _hasTransparent;
+                best = refine(start0, start1, threeColor, quality);
+
+                // a three colour block can represent colours midway between the endpoints more closely.
+                if (quality==COMPRESSION_HIGH && !_fourColorOnly && !threeColor && best.error>0)
+                {
+                    ColorBlockEncoding alternative = refine(start0, start1, true, quality);
+                    if (alternative.error<best.error) best = alternative;
+                }
+            }
+
+            out[0] = best.color0 & 0xff;
+            out[1] = best.color0 >> 8;
+            out[2] = best.color1 & 0xff;
+            out[3] = best.color1 >> 8;
+            out[4] = best.indices & 0xff;
+            out[5] = (best.indices >> 8) & 0xff;
+            out[6] = (best.indices >> 16) & 0xff;
+            out[7] = (best.indices >> 24) & 0xff;
+        }
+
+    protected:
+
+        // fit the endpoints to the range of the pixels along their principal axis.
+        void computePrincipalEndpoints(float* end0, float* end1) const
+        {
+            float mean[3] = { 0.0f, 0.0f, 0.0f };
+            for(unsigned int i=0; i<16; ++i)
+            {
+                if (!_used[i]) continue;
+                for(unsigned int c=0; c<3; ++c) mean[c] += _block.rgba[i][c];
+            }
+            for(unsigned int c=0; c<3; ++c) mean[c] /= static_cast<float>(_numUsed);
+
+            float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+            for(unsigned int i=0; i<16; ++i)
+            {
+                if (!_used[i]) continue;
+                float r = _block.rgba[i][0]-mean[0], g = _block.rgba[i][1]-mean[1], b = _block.rgba[i][2]-mean[2];
+                covariance[0] += r*r; covariance[1] += r*g; covariance[2] += r*b;
+                covariance[3] += g*g; covariance[4] += g*b; covariance[5] += b*b;
+            }
+
+            // power iteration for the dominant eigenvector.
+            float axis[3] = { 1.0f, 1.0f, 1.0f };
+            for(unsigned int iteration=0; iteration<8; ++iteration)
+            {
+                float x = covariance[0]*axis[0] + covariance[1]*axis[1] + covariance[2]*axis[2];
+                float y = covariance[1]*axis[0] + covariance[3]*axis[1] + covariance[4]*axis[2];
+                float z = covariance[2]*axis[0] + covariance[4]*axis[1] + covariance[5]*axis[2];
+                float length = osg::maximum(osg::absolute(x), osg::maximum(osg::absolute(y), osg::absolute(z)));
+                if (length<1e-6f) break;
+                axis[0] = x/length; axis[1] = y/length; axis[2] = z/length;
+            }
+
+            float minT = 0.0f, maxT = 0.0f;
+            float lengthSquared = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+            for(unsigned int i=0; i<16; ++i)
+            {
+                if (!_used[i]) continue;
+                float t = ((_block.rgba[i][0]-mean[0])*axis[0] + (_block.rgba[i][1]-mean[1])*axis[1] + (_block.rgba[i][2]-mean[2])*axis[2])/lengthSquared;
+                minT = osg::minimum(minT, t);
+                maxT = osg::maximum(maxT, t);
+            }
+
+            for(unsigned int c=0; c<3; ++c)
+            {
+                end0[c] = mean[c] + axis[c]*maxT;
+                end1[c] = mean[c] + axis[c]*minT;
+            }
+        }
+
+        ColorBlockEncoding evaluate(const float* end0, const float* end1, bool threeColor) const
+        {
+            ColorBlockEncoding encoding;
+            encoding.color0 = packRGB565(end0);
+            encoding.color1 = packRGB565(end1);
+
+            // the order of the endpoints selects between the four and three colour palettes.
+            if (threeColor ? encoding.color0>encoding.color1 : encoding.color0<encoding.color1)
+            {
+                std::swap(encoding.color0, encoding.color1);
+            }
+
+            int palette[4][3];
+            unpackRGB565(encoding.color0, palette[0]);
+            unpackRGB565(encoding.color1, palette[1]);
+            unsigned int numColors = 4;
+            if (encoding.color0==encoding.color1)
+            {
+                numColors = 1;
+            }
+            else if (threeColor)
+            {
+                for(unsigned int c=0; c<3; ++c) palette[2][c] = (palette[0][c]+palette[1][c])/2;
+                numColors = 3;
+            }
+            else
+            {
+                for(unsigned int c=0; c<3; ++c)
+                {
+                    palette[2][c] = (2*palette[0][c]+palette[1][c])/3;
+                    palette[3][c] = (palette[0][c]+2*palette[1][c])/3;
+                }
+            }
+
+            encoding.indices = 0;
+            encoding.error = 0;
+            for(unsigned int i=0; i<16; ++i)
+            {
+                unsigned int index = 3;
+                if (_used[i])
+                {
+                    int bestError = INT_MAX;
+                    for(unsigned int p=0; p<numColors; ++p)
+                    {
+                        int error = square(_block.rgba[i][0]-palette[p][0]) + square(_block.rgba[i][1]-palette[p][1]) + square(_block.rgba[i][2]-palette[p][2]);
+                        if (error<bestError) { bestError = error; index = p; }
+                    }
+                    encoding.error += bestError;
+                }
+                encoding.indices |= index<<(2*i);
+            }
+            return encoding;
+        }
+
+        // alternate between choosing indices and solving the least squares endpoints for them.
+        ColorBlockEncoding refine(const float* start0, const float* start1, bool threeColor, CompressionQuality quality) const
+        {
+            ColorBlockEncoding best = evaluate(start0, start1, threeColor);
+
+            unsigned int numIterations = quality==COMPRESSION_FAST ? 0 : (quality==COMPRESSION_NORMAL ? 2 : 6);
+            for(unsigned int iteration=0; iteration<numIterations && best.error>0; ++iteration)
+            {
+                float end0[3], end1[3];
+                if (!solveEndpoints(best, threeColor, end0, end1)) break;
+
+                ColorBlockEncoding encoding = evaluate(end0, end1, threeColor);
+                if (encoding.error>=best.error) break;
+                best = encoding;
+            }
+            return best;
+        }
+
+        bool solveEndpoints(const ColorBlockEncoding& encoding, bool threeColor, float* end0, float* end1) const
+        {
+            static const float fourColorWeights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+            static const float threeColorWeights[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+            const float* weights = (threeColor || encoding.color0==encoding.color1) ? threeColorWeights : fourColorWeights;
+
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+            for(unsigned int i=0; i<16; ++i)
+            {
+                if (!_used[i]) continue;
+                float a = weights[(encoding.indices>>(2*i))&3];
+                float b = 1.0f-a;
+                aa += a*a; ab += a*b; bb += b*b;
+                for(unsigned int c=0; c<3; ++c)
+                {
+                    ax[c] += a*_block.rgba[i][c];
+                    bx[c] += b*_block.rgba[i][c];
+                }
+            }
+
+            float determinant = aa*bb - ab*ab;
+            if (osg::absolute(determinant)<1e-6f) return false;
+
+            float inverse = 1.0f/determinant;
+            for(unsigned int c=0; c<3; ++c)
+            {
+                end0[c] = osg::clampBetween((ax[c]*bb - bx[c]*ab)*inverse, 0.0f, 255.0f);
+                end1[c] = osg::clampBetween((bx[c]*aa - ax[c]*ab)*inverse, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        const PixelBlock&   _block;
+        bool                _fourColorOnly;
+        bool                _used[16];
+        unsigned int        _numUsed;
+        bool                _hasTransparent;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BC4 blocks, also used for the alpha of DXT5 and each channel of BC5
+//
+int evaluateBC4(const unsigned char* values, int endpoint0, int endpoint1, unsigned char* indices)
+{
+    int palette[8];
+    palette[0] = endpoint0;
+    palette[1] = endpoint1;
+    if (endpoint0>endpoint1)
+    {
+        for(int i=1; i<7; ++i) palette[i+1] = ((7-i)*endpoint0 + i*endpoint1 + 3)/7;
+    }
+    else
+    {
+        for(int i=1; i<5; ++i) palette[i+1] = ((5-i)*endpoint0 + i*endpoint1 + 2)/5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    int total = 0;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        int bestError = INT_MAX;
+        for(unsigned int p=0; p<8; ++p)
+        {
+            int error = square(values[i]-palette[p]);
+            if (error<bestError) { bestError = error; indices[i] = static_cast<unsigned char>(p); }
+        }
+        total += bestError;
+    }
+    return total;
+}
+
+void encodeBC4Block(const unsigned char* values, CompressionQuality quality, unsigned char* out)
+{
+    int minValue = 255, maxValue = 0;
+    int minInner = 255, maxInner = 0;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        minValue = osg::minimum(minValue, static_cast<int>(values[i]));
+        maxValue = osg::maximum(maxValue, static_cast<int>(values[i]));
+        if (values[i]!=0 && values[i]!=255)
+        {
+            minInner = osg::minimum(minInner, static_cast<int>(values[i]));
+            maxInner = osg::maximum(maxInner, static_cast<int>(values[i]));
+        }
+    }
+
+    int endpoint0 = maxValue, endpoint1 = minValue;
+    unsigned char indices[16], candidateIndices[16];
+    int bestError = evaluateBC4(values, endpoint0, endpoint1, indices);
+
+    // the six value palette keeps exact 0 and 255 for blocks that mix them with other values.
+    if (quality!=COMPRESSION_FAST && bestError>0 && minInner<=maxInner)
+    {
+        int error = evaluateBC4(values, minInner, maxInner, candidateIndices);
+        if (error<bestError)
+        {
+            bestError = error;
+            endpoint0 = minInner;
+            endpoint1 = maxInner;
+            memcpy(indices, candidateIndices, 16);
+        }
+    }
+
+    if (quality==COMPRESSION_HIGH && bestError>0 && maxValue>minValue)
+    {
+        int start0 = endpoint0, start1 = endpoint1;
+        for(int d0=-2; d0<=2; ++d0)
+        {
+            for(int d1=-2; d1<=2; ++d1)
+            {
+                int e0 = clampTo(start0+d0, 0, 255), e1 = clampTo(start1+d1, 0, 255);
+                // keep to the palette the start endpoints were chosen for.
+                if ((e0>e1)!=(start0>start1)) continue;
+
+                int error = evaluateBC4(values, e0, e1, candidateIndices);
+                if (error<bestError)
+                {
+                    bestError = error;
+                    endpoint0 = e0;
+                    endpoint1 = e1;
+                    memcpy(indices, candidateIndices, 16);
+                }
+            }
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(endpoint0);
+    out[1] = static_cast<unsigned char>(endpoint1);
+    unsigned int bits = 0, numBits = 0, byte = 2;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        bits |= static_cast<unsigned int>(indices[i])<<numBits;
+        numBits += 3;
+        while(numBits>=8)
+        {
+            out[byte++] = static_cast<unsigned char>(bits & 0xff);
+            bits >>= 8;
+            numBits -= 8;
+        }
+    }
+}
+
+void encodeDXT3AlphaBlock(const PixelBlock& block, unsigned char* out)
+{
+    for(unsigned int i=0; i<8; ++i)
+    {
+        unsigned int a0 = (block.rgba[i*2][3]*15+127)/255;
+        unsigned int a1 = (block.rgba[i*2+1][3]*15+127)/255;
+        out[i] = static_cast<unsigned char>(a0 | (a1<<4));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// ETC1 colour blocks, which are also the individual and differential modes of ETC2
+//
+const int etcModifierTable[8][2] = { {2,8}, {5,17}, {9,29}, {13,42}, {18,60}, {24,80}, {33,106}, {47,183} };
+
+struct EtcSubblock
+{
+    int             pixels[8][3];
+    unsigned int    positions[8];
+};
+
+struct EtcSubblockEncoding
+{
+    int             quantized[3];
+    unsigned int    table;
+    unsigned char   selectors[8];
+    int             error;
+};
+
+inline int expandEtc(int v, bool differential) { return differential ? ((v<<3)|(v>>2)) : ((v<<4)|v); }
+
+void evaluateEtcSubblock(const EtcSubblock& subblock, const int* quantized, bool differential, EtcSubblockEncoding& best)
+{
+    int base[3];
+    for(unsigned int c=0; c<3; ++c) base[c] = expandEtc(quantized[c], differential);
+
+    for(unsigned int table=0; table<8; ++table)
+    {
+        int modifiers[4] = { etcModifierTable[table][0], etcModifierTable[table][1], -etcModifierTable[table][0], -etcModifierTable[table][1] };
+
+        int total = 0;
+        unsigned char selectors[8];
+        for(unsigned int i=0; i<8 && total<best.error; ++i)
+        {
+            int bestError = INT_MAX;
+            for(unsigned int m=0; m<4; ++m)
+            {
+                int error = square(clampTo(base[0]+modifiers[m], 0, 255)-subblock.pixels[i][0]) +
+                            square(clampTo(base[1]+modifiers[m], 0, 255)-subblock.pixels[i][1]) +
+                            square(clampTo(base[2]+modifiers[m], 0, 255)-subblock.pixels[i][2]);
+                if (error<bestError) { bestError = error; selectors[i] = static_cast<unsigned char>(m); }
+            }
+            total += bestError;
+        }
+
+        if (total<best.error)
+        {
+            best.error = total;
+            best.table = table;
+            for(unsigned int c=0; c<3; ++c) best.quantized[c] = quantized[c];
+            memcpy(best.selectors, selectors, 8);
+        }
+    }
+}
+
+// search base colours around the average of the subblock, within [minimum, maximum] of each channel when constrained.
+void encodeEtcSubblock(const EtcSubblock& subblock, bool differential, CompressionQuality quality,
+                       const int* minimum, const int* maximum, EtcSubblockEncoding& best)
+{
+    int maxValue = differential ? 31 : 15;
+
+    float average[3] = { 0.0f, 0.0f, 0.0f };
+    for(unsigned int i=0; i<8; ++i)
+    {
+        for(unsigned int c=0; c<3; ++c) average[c] += subblock.pixels[i][c];
+    }
+
+    float scale = static_cast<float>(maxValue)/(255.0f*8.0f);
+    int rounded[3], floors[3];
+    for(unsigned int c=0; c<3; ++c)
+    {
+        float v = average[c]*scale;
+        rounded[c] = static_cast<int>(v+0.5f);
+        floors[c] = static_cast<int>(v);
+    }
+
+    best.error = INT_MAX;
+
+    // candidates are the rounded average, shifted up and down in brightness, and for the highest quality
+    // each combination of rounding the channels down or up.
+    int shiftRange = quality==COMPRESSION_FAST ? 0 : 1;
+    unsigned int numCandidates = 2*shiftRange+1 + (quality==COMPRESSION_HIGH ? 8 : 0);
+    for(unsigned int candidate=0; candidate<numCandidates; ++candidate)
+    {
+        int quantized[3];
+        for(unsigned int c=0; c<3; ++c)
+        {
+            int v = candidate<=static_cast<unsigned int>(2*shiftRange) ?
+                    rounded[c] + static_cast<int>(candidate)-shiftRange :
+                    floors[c] + (((candidate-2*shiftRange-1)>>c)&1);
+            quantized[c] = clampTo(v, minimum ? minimum[c] : 0, maximum ? maximum[c] : maxValue);
+            quantized[c] = clampTo(quantized[c], 0, maxValue);
+        }
+        evaluateEtcSubblock(subblock, quantized, differential, best);
+    }
+}
+
+void setupEtcSubblocks(const PixelBlock& block, bool flip, EtcSubblock* subblocks)
+{
+    unsigned int counts[2] = { 0, 0 };
+    for(unsigned int y=0; y<4; ++y)
+    {
+        for(unsigned int x=0; x<4; ++x)
+        {
+            unsigned int s = flip ? (y>=2 ? 1 : 0) : (x>=2 ? 1 : 0);
+            EtcSubblock& subblock = subblocks[s];
+            for(unsigned int c=0; c<3; ++c) subblock.pixels[counts[s]][c] = block.rgba[y*4+x][c];
+            // pixels are indexed down the columns.
+            subblock.positions[counts[s]] = x*4+y;
+            ++counts[s];
+        }
+    }
+}
+
+void encodeEtcColorBlock(const PixelBlock& block, CompressionQuality quality, unsigned char* out)
+{
+    int bestError = INT_MAX;
+    unsigned int high = 0, low = 0;
+
+    for(unsigned int flip=0; flip<2; ++flip)
+    {
+        EtcSubblock subblocks[2];
+        setupEtcSubblocks(block, flip!=0, subblocks);
+
+        for(unsigned int mode=0; mode<2; ++mode)
+        {
+            bool differential = mode==1;
+
+            EtcSubblockEncoding encodings[2];
+            encodeEtcSubblock(subblocks[0], differential, quality, 0, 0, encodings[0]);
+            encodeEtcSubblock(subblocks[1], differential, quality, 0, 0, encodings[1]);
+
+            if (differential)
+            {
+                bool inRange = true;
+                for(unsigned int c=0; c<3; ++c)
+                {
+                    int delta = encodings[1].quantized[c]-encodings[0].quantized[c];
+                    if (delta<-4 || delta>3) inRange = false;
+                }
+
+                // the second base colour is stored as a three bit offset from the first, so refit whichever
+                // subblock loses less when constrained to the other.
+                if (!inRange)
+                {
+                    int minimum[3], maximum[3];
+                    for(unsigned int c=0; c<3; ++c) { minimum[c] = encodings[0].quantized[c]-4; maximum[c] = encodings[0].quantized[c]+3; }
+                    EtcSubblockEncoding constrained1;
+                    encodeEtcSubblock(subblocks[1], true, quality, minimum, maximum, constrained1);
+
+                    for(unsigned int c=0; c<3; ++c) { minimum[c] = encodings[1].quantized[c]-3; maximum[c] = encodings[1].quantized[c]+4; }
+                    EtcSubblockEncoding constrained0;
+                    encodeEtcSubblock(subblocks[0], true, quality, minimum, maximum, constrained0);
+
+                    if (encodings[0].error+constrained1.error <= constrained0.error+encodings[1].error) encodings[1] = constrained1;
+                    else encodings[0] = constrained0;
+                }
+            }
+
+            int error = encodings[0].error + encodings[1].error;
+            if (error>=bestError) continue;
+            bestError = error;
+
+            unsigned int q0[3], q1[3];
+            for(unsigned int c=0; c<3; ++c)
+            {
+                q0[c] = static_cast<unsigned int>(encodings[0].quantized[c]);
+                q1[c] = static_cast<unsigned int>(encodings[1].quantized[c]);
+            }
+            if (differential)
+            {
+                high = (q0[0]<<27) | (((q1[0]-q0[0])&7)<<24) |
+                       (q0[1]<<19) | (((q1[1]-q0[1])&7)<<16) |
+                       (q0[2]<<11) | (((q1[2]-q0[2])&7)<<8);
+            }
+            else
+            {
+                high = (q0[0]<<28) | (q1[0]<<24) | (q0[1]<<20) | (q1[1]<<16) | (q0[2]<<12) | (q1[2]<<8);
+            }
+            high |= (encodings[0].table<<5) | (encodings[1].table<<2) | (mode<<1) | flip;
+
+            low = 0;
+            for(unsigned int s=0; s<2; ++s)
+            {
+                for(unsigned int i=0; i<8; ++i)
+                {
+                    unsigned int selector = encodings[s].selectors[i];
+                    unsigned int position = subblocks[s].positions[i];
+                    low |= ((selector>>1)<<(16+position)) | ((selector&1)<<position);
+                }
+            }
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(high>>24);
+    out[1] = static_cast<unsigned char>(high>>16);
+    out[2] = static_cast<unsigned char>(high>>8);
+    out[3] = static_cast<unsigned char>(high);
+    out[4] = static_cast<unsigned char>(low>>24);
+    out[5] = static_cast<unsigned char>(low>>16);
+    out[6] = static_cast<unsigned char>(low>>8);
+    out[7] = static_cast<unsigned char>(low);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// EAC blocks, for the alpha of ETC2 RGBA8 and for R11 and RG11
+//
+const int eacModifierTable[16][8] =
+{
+    {-3,-6,-9,-15,2,5,8,14}, {-3,-7,-10,-13,2,6,9,12}, {-2,-5,-8,-13,1,4,7,12}, {-2,-4,-6,-13,1,3,5,12},
+    {-3,-6,-8,-12,2,5,7,11}, {-3,-7,-9,-11,2,6,8,10}, {-4,-7,-8,-11,3,6,7,10}, {-3,-5,-8,-11,2,4,7,10},
+    {-2,-6,-8,-10,1,5,7,9}, {-2,-5,-8,-10,1,4,7,9}, {-2,-4,-8,-10,1,3,7,9}, {-2,-5,-7,-10,1,4,6,9},
+    {-3,-4,-7,-10,2,3,6,9}, {-1,-2,-3,-10,0,1,2,9}, {-4,-6,-8,-9,3,5,7,8}, {-3,-5,-7,-9,2,4,6,8}
+};
+
+// values are 8 bit for the alpha of RGBA8, and 11 bit for R11 and RG11, whose base and multiplier are scaled by eight.
+void encodeEacBlock(const int* values, bool elevenBit, CompressionQuality quality, unsigned char* out)
+{
+    int maxOutput = elevenBit ? 2047 : 255;
+    int unit = elevenBit ? 8 : 1;
+
+    int minValue = maxOutput, maxValue = 0;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        minValue = osg::minimum(minValue, values[i]);
+        maxValue = osg::maximum(maxValue, values[i]);
+    }
+
+    int bestError = INT_MAX;
+    int bestBase = 0, bestMultiplier = 1, bestTable = 0;
+    unsigned char bestSelectors[16];
+    memset(bestSelectors, 0, 16);
+
+    int searchRange = quality==COMPRESSION_FAST ? 0 : (quality==COMPRESSION_NORMAL ? 1 : 2);
+    for(int table=0; table<16 && bestError>0; ++table)
+    {
+        const int* modifiers = eacModifierTable[table];
+        int span = modifiers[7]-modifiers[3];
+
+        int idealMultiplier = clampTo(((maxValue-minValue)/unit + span/2)/span, 1+searchRange, 15-searchRange);
+        for(int multiplier=idealMultiplier-searchRange; multiplier<=idealMultiplier+searchRange; ++multiplier)
+        {
+
+            // centre the table's range of modifiers on the values.
+            int idealCenter = (minValue+maxValue)/2 - ((modifiers[7]+modifiers[3])*multiplier*unit)/2;
+            int idealBase = clampTo(elevenBit ? idealCenter/8 : idealCenter, searchRange, 255-searchRange);
+            for(int base=idealBase-searchRange; base<=idealBase+searchRange; ++base)
+            {
+
+                int center = elevenBit ? base*8+4 : base;
+                int palette[8];
+                for(unsigned int m=0; m<8; ++m) palette[m] = clampTo(center + modifiers[m]*multiplier*unit, 0, maxOutput);
+
+                int total = 0;
+                unsigned char selectors[16];
+                for(unsigned int i=0; i<16 && total<bestError; ++i)
+                {
+                    int bestPixelError = INT_MAX;
+                    for(unsigned int m=0; m<8; ++m)
+                    {
+                        int error = square(values[i]-palette[m]);
+                        if (error<bestPixelError) { bestPixelError = error; selectors[i] = static_cast<unsigned char>(m); }
+                    }
+                    total += bestPixelError;
+                }
+
+                if (total<bestError)
+                {
+                    bestError = total;
+                    bestBase = base;
+                    bestMultiplier = multiplier;
+                    bestTable = table;
+                    memcpy(bestSelectors, selectors, 16);
+                }
+            }
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(bestBase);
+    out[1] = static_cast<unsigned char>((bestMultiplier<<4) | bestTable);
+
+    // 48 bits of selectors, most significant first, with the pixels indexed down the columns.
+    unsigned int highBits = 0, lowBits = 0;
+    for(unsigned int position=0; position<16; ++position)
+    {
+        unsigned int x = position/4, y = position%4;
+        unsigned int selector = bestSelectors[y*4+x];
+        if (position<8) highBits |= selector<<(21-position*3);
+        else lowBits |= selector<<(21-(position-8)*3);
+    }
+    out[2] = static_cast<unsigned char>(highBits>>16);
+    out[3] = static_cast<unsigned char>(highBits>>8);
+    out[4] = static_cast<unsigned char>(highBits);
+    out[5] = static_cast<unsigned char>(lowBits>>16);
+    out[6] = static_cast<unsigned char>(lowBits>>8);
+    out[7] = static_cast<unsigned char>(lowBits);
+}
+
+void encodeEacChannel(const PixelBlock& block, unsigned int channel, bool elevenBit, CompressionQuality quality, unsigned char* out)
+{
+    int values[16];
+    for(unsigned int i=0; i<16; ++i)
+    {
+        int v = block.rgba[i][channel];
+        values[i] = elevenBit ? (v*2047+127)/255 : v;
+    }
+    encodeEacBlock(values, elevenBit, quality, out);
+}
+
+void encodeBC4Channel(const PixelBlock& block, unsigned int channel, CompressionQuality quality, unsigned char* out)
+{
+    unsigned char values[16];
+    for(unsigned int i=0; i<16; ++i) values[i] = block.rgba[i][channel];
+    encodeBC4Block(values, quality, out);
+}
+
+void encodeBlock(const PixelBlock& block, GLenum compressedFormat, CompressionQuality quality, unsigned char* out)
+{
+    switch(compressedFormat)
+    {
+        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):
+            ColorBlockEncoder(block, false, false).encode(quality, out);
+            break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT):
+            ColorBlockEncoder(block, true, false).encode(quality, out);
+            break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT):
+            encodeDXT3AlphaBlock(block, out);
+            ColorBlockEncoder(block, false, true).encode(quality, out+8);
+            break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):
+            encodeBC4Channel(block, 3, quality, out);
+            ColorBlockEncoder(block, false, true).encode(quality, out+8);
+            break;
+        case(GL_COMPRESSED_RED_RGTC1_EXT):
+            encodeBC4Channel(block, 0, quality, out);
+            break;
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+            encodeBC4Channel(block, 0, quality, out);
+            encodeBC4Channel(block, 1, quality, out+8);
+            break;
+        case(GL_ETC1_RGB8_OES):
+        case(GL_COMPRESSED_RGB8_ETC2):
+            encodeEtcColorBlock(block, quality, out);
+            break;
+        case(GL_COMPRESSED_RGBA8_ETC2_EAC):
+            encodeEacChannel(block, 3, false, quality, out);
+            encodeEtcColorBlock(block, quality, out+8);
+            break;
+        case(GL_COMPRESSED_R11_EAC):
+            encodeEacChannel(block, 0, true, quality, out);
+            break;
+        case(GL_COMPRESSED_RG11_EAC):
+            encodeEacChannel(block, 0, true, quality, out);
+            encodeEacChannel(block, 1, true, quality, out+8);
+            break;
+    }
+}
+
+struct CompressLevel
+{
+    BlockReader     reader;
+    unsigned char*  destData;
+    unsigned int    numBlocksX;
+    unsigned int    numBlocksY;
+};
+
+struct CompressJob
+{
+    GLenum                      compressedFormat;
+    CompressionQuality          quality;
+    unsigned int                blockSize;
+    std::vector<CompressLevel>  levels;
+};
+
+void compressBlockRows(const CompressJob& job, const CompressLevel& level, unsigned int beginRow, unsigned int endRow)
+{
+    PixelBlock block;
+    for(unsigned int by=beginRow; by<endRow; ++by)
+    {
+        unsigned char* out = level.destData + by*level.numBlocksX*job.blockSize;
+        for(unsigned int bx=0; bx<level.numBlocksX; ++bx, out+=job.blockSize)
+        {
+            level.reader.readBlock(bx, by, block);
+            encodeBlock(block, job.compressedFormat, job.quality, out);
+        }
+    }
+}
+
+class CompressBlockRowsOperation : public osg::Operation
+{
+    public:
+
+        CompressBlockRowsOperation(const CompressJob& job, const CompressLevel& level, unsigned int beginRow, unsigned int endRow):
+            osg::Operation("CompressBlockRows", false),
+            _job(job),
+            _level(level),
+            _beginRow(beginRow),
+            _endRow(endRow) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            compressBlockRows(_job, _level, _beginRow, _endRow);
+        }
+
+    protected:
+
+        const CompressJob&      _job;
+        const CompressLevel&    _level;
+        unsigned int            _beginRow;
+        unsigned int            _endRow;
+};
+
+}
+
+bool osg::isCompressionSupported(GLenum pixelFormat, GLenum dataType, GLenum compressedFormat)
+{
+    if (dataType!=GL_UNSIGNED_BYTE || computeBlockSizeInBytes(compressedFormat)==0) return false;
+
+    switch(pixelFormat)
+    {
+        case(GL_RGB):
+        case(GL_RGBA):
+        case(GL_BGR):
+        case(GL_BGRA):
+        case(GL_LUMINANCE):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_INTENSITY):
+        case(GL_ALPHA):
+        case(GL_RED):
+        case(GL_RG):
+            return true;
+        default:
+            return false;
+    }
+}
+
+osg::Image* osg::compressImage(const osg::Image* image, GLenum compressedFormat, CompressionQuality quality, osg::TaskPool* taskPool)
+{
+    if (!image || !image->data() || image->r()!=1 || image->s()<=0 || image->t()<=0 ||
+        !isCompressionSupported(image->getPixelFormat(), image->getDataType(), compressedFormat))
+    {
+        return 0;
+    }
+
+    CompressJob job;
+    job.compressedFormat = compressedFormat;
+    job.quality = quality;
+    job.blockSize = computeBlockSizeInBytes(compressedFormat);
+
+    unsigned int numLevels = image->isMipmap() ? image->getNumMipmapLevels() : 1;
+    job.levels.resize(numLevels);
+
+    osg::Image::MipmapDataType offsets;
+    unsigned int totalSize = 0;
+    unsigned int totalBlocks = 0;
+    int width = image->s();
+    int height = image->t();
+    for(unsigned int k=0; k<numLevels; ++k)
+    {
+        CompressLevel& level = job.levels[k];
+        level.reader.data = image->getMipmapData(k);
+        level.reader.rowStep = k==0 ? image->getRowStepInBytes() : osg::Image::computeRowWidthInBytes(width, image->getPixelFormat(), image->getDataType(), image->getPacking());
+        level.reader.width = width;
+        level.reader.height = height;
+        level.reader.pixelFormat = image->getPixelFormat();
+        level.reader.pixelSize = osg::Image::computeNumComponents(image->getPixelFormat());
+        level.numBlocksX = (width+3)/4;
+        level.numBlocksY = (height+3)/4;
+
+        if (k>0) offsets.push_back(totalSize);
+        totalSize += level.numBlocksX*level.numBlocksY*job.blockSize;
+        totalBlocks += level.numBlocksX*level.numBlocksY;
+
+        width = osg::maximum(width>>1, 1);
+        height = osg::maximum(height>>1, 1);
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+    for(unsigned int k=0; k<numLevels; ++k)
+    {
+        job.levels[k].destData = data + (k==0 ? 0 : offsets[k-1]);
+    }
+
+    bool useTasks = taskPool && totalBlocks>=MINIMUM_BLOCKS_FOR_TASKS;
+    osg::ref_ptr<osg::TaskSet> taskSet = useTasks ? new osg::TaskSet : 0;
+    for(unsigned int k=0; k<numLevels; ++k)
+    {
+        const CompressLevel& level = job.levels[k];
+        for(unsigned int beginRow=0; beginRow<level.numBlocksY; beginRow+=BLOCK_ROWS_PER_BAND)
+        {
+            unsigned int endRow = osg::minimum(beginRow+BLOCK_ROWS_PER_BAND, level.numBlocksY);
+            if (useTasks) taskPool->add(new CompressBlockRowsOperation(job, level, beginRow, endRow), taskSet.get());
+            else compressBlockRows(job, level, beginRow, endRow);
+        }
+    }
+
+    if (useTasks) taskPool->wait(taskSet.get());
+
+    osg::Image* compressedImage = new osg::Image;
+    compressedImage->setFileName(image->getFileName());
+    compressedImage->setImage(image->s(), image->t(), 1, compressedFormat, compressedFormat, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE, 1);
+    compressedImage->setMipmapLevels(offsets);
+    compressedImage->setOrigin(image->getOrigin());
+
+    OSG_INFO<<"osg::compressImage() compressed "<<image->s()<<"x"<<image->t()<<" image with "<<numLevels<<" levels into "<<totalSize<<" bytes"<<std::endl;
+
+    return compressedImage;
+}
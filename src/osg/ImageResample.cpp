@@ -0,0 +1,551 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/ImageUtils>
+#include <osg/Math>
+#include <osg/Notify>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// the kernels are selected by the instruction sets the compiler targets, as there is no runtime CPU dispatch.
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define OSG_RESAMPLE_USE_AVX
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #include <emmintrin.h>
+    #define OSG_RESAMPLE_USE_SSE2
+#endif
+
+using namespace osg;
+
+namespace
+{
+
+const double KAISER_ALPHA = 4.0;
+const unsigned int ROWS_PER_BAND = 64;
+const unsigned int MINIMUM_PIXELS_FOR_TASKS = 65536;
+
+inline double sinc(double x)
+{
+    if (fabs(x)<1e-6) return 1.0;
+    x *= osg::PI;
+    return sin(x)/x;
+}
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x*0.5;
+    for(unsigned int k=1; k<32; ++k)
+    {
+        term *= (halfX/static_cast<double>(k));
+        double termSquared = term*term;
+        sum += termSquared;
+        if (termSquared<sum*1e-12) break;
+    }
+    return sum;
+}
+
+double filterSupport(ResampleFilter filter)
+{
+    switch(filter)
+    {
+        case(RESAMPLE_BOX): return 0.5;
+        case(RESAMPLE_TRIANGLE): return 1.0;
+        case(RESAMPLE_KAISER): return 3.0;
+        case(RESAMPLE_LANCZOS): return 3.0;
+    }
+    return 1.0;
+}
+
+double evaluateFilter(ResampleFilter filter, double x)
+{
+    x = fabs(x);
+    switch(filter)
+    {
+        case(RESAMPLE_BOX):
+            return x<=0.5 ? 1.0 : 0.0;
+        case(RESAMPLE_TRIANGLE):
+            return x<1.0 ? 1.0-x : 0.0;
+        case(RESAMPLE_KAISER):
+        {
+            if (x>=3.0) return 0.0;
+            double t = x/3.0;
+            return sinc(x)*besselI0(KAISER_ALPHA*sqrt(1.0-t*t))/besselI0(KAISER_ALPHA);
+        }
+        case(RESAMPLE_LANCZOS):
+            return x<3.0 ? sinc(x)*sinc(x/3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+// The source pixels and weights that make up each destination pixel along one axis.
+struct Contributions
+{
+    std::vector<unsigned int>   first;
+    std::vector<unsigned int>   indices;
+    std::vector<float>          weights;
+
+    bool isIdentity() const
+    {
+        if (indices.size()+1!=first.size()) return false;
+        for(unsigned int i=0; i<indices.size(); ++i)
+        {
+            if (indices[i]!=i || weights[i]!=1.0f) return false;
+        }
+        return true;
+    }
+};
+
+void computeContributions(ResampleFilter filter, int srcSize, int destSize, Contributions& contributions)
+{
+    double scale = static_cast<double>(srcSize)/static_cast<double>(destSize);
+    // widen the filter when minifying so that it averages all the source pixels it covers.
+    double filterScale = osg::maximum(scale, 1.0);
+    double support = filterSupport(filter)*filterScale;
+
+    contributions.first.reserve(destSize+1);
+    for(int i=0; i<destSize; ++i)
+    {
+        contributions.first.push_back(static_cast<unsigned int>(contributions.indices.size()));
+
+        double center = (static_cast<double>(i)+0.5)*scale;
+        int left = static_cast<int>(floor(center-support));
+        int right = static_cast<int>(ceil(center+support));
+
+        unsigned int start = static_cast<unsigned int>(contributions.indices.size());
+        double total = 0.0;
+        for(int j=left; j<=right; ++j)
+        {
+            double weight = evaluateFilter(filter, (static_cast<double>(j)+0.5-center)/filterScale);
+            if (weight==0.0) continue;
+
+            // clamp to the edge, merging the taps beyond it into the edge pixel.
+            unsigned int index = static_cast<unsigned int>(osg::clampBetween(j, 0, srcSize-1));
+            if (contributions.indices.size()>start && contributions.indices.back()==index)
+            {
+                contributions.weights.back() += static_cast<float>(weight);
+            }
+            else
+            {
+                contributions.indices.push_back(index);
+                contributions.weights.push_back(static_cast<float>(weight));
+            }
+            total += weight;
+        }
+
+        if (total==0.0)
+        {
+            contributions.indices.resize(start);
+            contributions.weights.resize(start);
+            contributions.indices.push_back(static_cast<unsigned int>(osg::clampBetween(static_cast<int>(center), 0, srcSize-1)));
+            contributions.weights.push_back(1.0f);
+        }
+        else
+        {
+            float inverseTotal = static_cast<float>(1.0/total);
+            for(unsigned int t=start; t<contributions.weights.size(); ++t) contributions.weights[t] *= inverseTotal;
+        }
+    }
+    contributions.first.push_back(static_cast<unsigned int>(contributions.indices.size()));
+}
+
+void readRow(GLenum dataType, const unsigned char* src, float* dest, unsigned int num)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):
+        {
+            const float scale = 1.0f/255.0f;
+            unsigned int i=0;
+#ifdef OSG_RESAMPLE_USE_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 scale4 = _mm_set1_ps(scale);
+            for(; i+16<=num; i+=16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+                __m128i low = _mm_unpacklo_epi8(bytes, zero);
+                __m128i high = _mm_unpackhi_epi8(bytes, zero);
+                _mm_storeu_ps(dest+i,    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale4));
+                _mm_storeu_ps(dest+i+4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale4));
+                _mm_storeu_ps(dest+i+8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale4));
+                _mm_storeu_ps(dest+i+12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale4));
+            }
+#endif
+            for(; i<num; ++i) dest[i] = static_cast<float>(src[i])*scale;
+            break;
+        }
+        case(GL_UNSIGNED_SHORT):
+        {
+            const unsigned short* data = reinterpret_cast<const unsigned short*>(src);
+            const float scale = 1.0f/65535.0f;
+            for(unsigned int i=0; i<num; ++i) dest[i] = static_cast<float>(data[i])*scale;
+            break;
+        }
+        case(GL_FLOAT):
+            memcpy(dest, src, num*sizeof(float));
+            break;
+    }
+}
+
+void writeRow(GLenum dataType, const float* src, unsigned char* dest, unsigned int num)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):
+        {
+            unsigned int i=0;
+#ifdef OSG_RESAMPLE_USE_SSE2
+            const __m128 scale4 = _mm_set1_ps(255.0f);
+            const __m128 half4 = _mm_set1_ps(0.5f);
+            for(; i+16<=num; i+=16)
+            {
+                // the conversions saturate, so the packs clamp to 0..255.
+                __m128i v0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_loadu_ps(src+i), _mm_setzero_ps()), scale4), half4));
+                __m128i v1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_loadu_ps(src+i+4), _mm_setzero_ps()), scale4), half4));
+                __m128i v2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_loadu_ps(src+i+8), _mm_setzero_ps()), scale4), half4));
+                __m128i v3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_loadu_ps(src+i+12), _mm_setzero_ps()), scale4), half4));
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest+i), packed);
+            }
+#endif
+            for(; i<num; ++i)
+            {
+                float v = src[i]*255.0f+0.5f;
+                dest[i] = v<=0.0f ? 0 : (v>=255.0f ? 255 : static_cast<unsigned char>(v));
+            }
+            break;
+        }
+        case(GL_UNSIGNED_SHORT):
+        {
+            unsigned short* data = reinterpret_cast<unsigned short*>(dest);
+            for(unsigned int i=0; i<num; ++i)
+            {
+                float v = src[i]*65535.0f+0.5f;
+                data[i] = v<=0.0f ? 0 : (v>=65535.0f ? 65535 : static_cast<unsigned short>(v));
+            }
+            break;
+        }
+        case(GL_FLOAT):
+            memcpy(dest, src, num*sizeof(float));
+            break;
+    }
+}
+
+// filter a row of source pixels horizontally to the destination width.
+void filterRow(const float* src, float* dest, unsigned int numComponents, const Contributions& contributions)
+{
+    unsigned int destWidth = static_cast<unsigned int>(contributions.first.size())-1;
+    const unsigned int* indices = contributions.indices.empty() ? 0 : &contributions.indices.front();
+    const float* weights = contributions.weights.empty() ? 0 : &contributions.weights.front();
+
+#ifdef OSG_RESAMPLE_USE_SSE2
+    if (numComponents==4)
+    {
+        for(unsigned int x=0; x<destWidth; ++x)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for(unsigned int t=contributions.first[x]; t<contributions.first[x+1]; ++t)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(src+indices[t]*4)));
+            }
+            _mm_storeu_ps(dest+x*4, sum);
+        }
+        return;
+    }
+#endif
+
+    for(unsigned int x=0; x<destWidth; ++x)
+    {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(unsigned int t=contributions.first[x]; t<contributions.first[x+1]; ++t)
+        {
+            const float* pixel = src+indices[t]*numComponents;
+            for(unsigned int c=0; c<numComponents; ++c) sum[c] += weights[t]*pixel[c];
+        }
+        for(unsigned int c=0; c<numComponents; ++c) dest[x*numComponents+c] = sum[c];
+    }
+}
+
+// sum the weighted horizontally filtered rows into a destination row.
+void accumulateRows(const float* const* rows, const float* weights, unsigned int numRows, float* dest, unsigned int num)
+{
+    unsigned int i=0;
+#ifdef OSG_RESAMPLE_USE_AVX
+    for(; i+8<=num; i+=8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for(unsigned int r=0; r<numRows; ++r)
+        {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[r]), _mm256_loadu_ps(rows[r]+i)));
+        }
+        _mm256_storeu_ps(dest+i, sum);
+    }
+#endif
+#ifdef OSG_RESAMPLE_USE_SSE2
+    for(; i+4<=num; i+=4)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for(unsigned int r=0; r<numRows; ++r)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[r]), _mm_loadu_ps(rows[r]+i)));
+        }
+        _mm_storeu_ps(dest+i, sum);
+    }
+#endif
+    for(; i<num; ++i)
+    {
+        float sum = 0.0f;
+        for(unsigned int r=0; r<numRows; ++r) sum += weights[r]*rows[r][i];
+        dest[i] = sum;
+    }
+}
+
+struct ResampleJob
+{
+    const unsigned char*    srcData;
+    unsigned int            srcRowStep;
+    unsigned int            srcWidth;
+    GLenum                  srcDataType;
+
+    unsigned char*          destData;
+    unsigned int            destRowStep;
+    unsigned int            destWidth;
+    GLenum                  destDataType;
+
+    unsigned int            numComponents;
+    Contributions           horizontal;
+    Contributions           vertical;
+    bool                    horizontalIdentity;
+};
+
+// resample the destination rows [beginRow, endRow), filtering each source row they need horizontally once.
+void resampleRows(const ResampleJob& job, unsigned int beginRow, unsigned int endRow)
+{
+    const Contributions& vertical = job.vertical;
+
+    unsigned int minRow = vertical.indices[vertical.first[beginRow]];
+    unsigned int maxRow = minRow;
+    for(unsigned int t=vertical.first[beginRow]; t<vertical.first[endRow]; ++t)
+    {
+        minRow = osg::minimum(minRow, vertical.indices[t]);
+        maxRow = osg::maximum(maxRow, vertical.indices[t]);
+    }
+
+    unsigned int srcRowSize = job.srcWidth*job.numComponents;
+    unsigned int destRowSize = job.destWidth*job.numComponents;
+
+    std::vector<float> filtered((maxRow-minRow+1)*destRowSize);
+    std::vector<float> srcRow(job.horizontalIdentity ? 0 : srcRowSize);
+    for(unsigned int r=minRow; r<=maxRow; ++r)
+    {
+        float* filteredRow = &filtered[(r-minRow)*destRowSize];
+        if (job.horizontalIdentity)
+        {
+            readRow(job.srcDataType, job.srcData+r*job.srcRowStep, filteredRow, srcRowSize);
+        }
+        else
+        {
+            readRow(job.srcDataType, job.srcData+r*job.srcRowStep, &srcRow.front(), srcRowSize);
+            filterRow(&srcRow.front(), filteredRow, job.numComponents, job.horizontal);
+        }
+    }
+
+    std::vector<const float*> rows;
+    std::vector<float> destRow(destRowSize);
+    for(unsigned int y=beginRow; y<endRow; ++y)
+    {
+        rows.clear();
+        for(unsigned int t=vertical.first[y]; t<vertical.first[y+1]; ++t)
+        {
+            rows.push_back(&filtered[(vertical.indices[t]-minRow)*destRowSize]);
+        }
+
+        accumulateRows(&rows.front(), &vertical.weights[vertical.first[y]], static_cast<unsigned int>(rows.size()), &destRow.front(), destRowSize);
+        writeRow(job.destDataType, &destRow.front(), job.destData+y*job.destRowStep, destRowSize);
+    }
+}
+
+class ResampleRowsOperation : public osg::Operation
+{
+    public:
+
+        ResampleRowsOperation(const ResampleJob& job, unsigned int beginRow, unsigned int endRow):
+            osg::Operation("ResampleRows", false),
+            _job(job),
+            _beginRow(beginRow),
+            _endRow(endRow) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            resampleRows(_job, _beginRow, _endRow);
+        }
+
+    protected:
+
+        const ResampleJob&  _job;
+        unsigned int        _beginRow;
+        unsigned int        _endRow;
+};
+
+void resample(GLenum pixelFormat, int packing,
+              const unsigned char* srcData, unsigned int srcRowStep, int srcWidth, int srcHeight, GLenum srcDataType,
+              unsigned char* destData, int destWidth, int destHeight, GLenum destDataType,
+              ResampleFilter filter, osg::TaskPool* taskPool)
+{
+    ResampleJob job;
+    job.srcData = srcData;
+    job.srcRowStep = srcRowStep;
+    job.srcWidth = srcWidth;
+    job.srcDataType = srcDataType;
+    job.destData = destData;
+    job.destRowStep = osg::Image::computeRowWidthInBytes(destWidth, pixelFormat, destDataType, packing);
+    job.destWidth = destWidth;
+    job.destDataType = destDataType;
+    job.numComponents = osg::Image::computeNumComponents(pixelFormat);
+
+    computeContributions(filter, srcWidth, destWidth, job.horizontal);
+    computeContributions(filter, srcHeight, destHeight, job.vertical);
+    job.horizontalIdentity = job.horizontal.isIdentity();
+
+    unsigned int numBands = (destHeight+ROWS_PER_BAND-1)/ROWS_PER_BAND;
+    bool useTasks = taskPool && numBands>1 && static_cast<unsigned int>(destWidth*destHeight)>=MINIMUM_PIXELS_FOR_TASKS;
+
+    osg::ref_ptr<osg::TaskSet> taskSet = useTasks ? new osg::TaskSet : 0;
+    for(unsigned int band=0; band<numBands; ++band)
+    {
+        unsigned int beginRow = band*ROWS_PER_BAND;
+        unsigned int endRow = osg::minimum(beginRow+ROWS_PER_BAND, static_cast<unsigned int>(destHeight));
+        if (useTasks) taskPool->add(new ResampleRowsOperation(job, beginRow, endRow), taskSet.get());
+        else resampleRows(job, beginRow, endRow);
+    }
+
+    if (useTasks) taskPool->wait(taskSet.get());
+}
+
+}
+
+bool osg::isResampleSupported(GLenum pixelFormat, GLenum dataType)
+{
+    if (dataType!=GL_UNSIGNED_BYTE && dataType!=GL_UNSIGNED_SHORT && dataType!=GL_FLOAT) return false;
+    switch(pixelFormat)
+    {
+        case(GL_ALPHA):
+        case(GL_LUMINANCE):
+        case(GL_INTENSITY):
+        case(GL_RED):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_RG):
+        case(GL_RGB):
+        case(GL_BGR):
+        case(GL_RGBA):
+        case(GL_BGRA):
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool osg::resampleImage(const osg::Image* srcImage, osg::Image* destImage, ResampleFilter filter, osg::TaskPool* taskPool)
+{
+    if (!srcImage || !destImage || !srcImage->data() || !destImage->data()) return false;
+
+    if (srcImage->getPixelFormat()!=destImage->getPixelFormat() ||
+        srcImage->r()!=1 || destImage->r()!=1 ||
+        srcImage->s()<=0 || srcImage->t()<=0 || destImage->s()<=0 || destImage->t()<=0 ||
+        !isResampleSupported(srcImage->getPixelFormat(), srcImage->getDataType()) ||
+        !isResampleSupported(destImage->getPixelFormat(), destImage->getDataType()))
+    {
+        return false;
+    }
+
+    // the destination rows are written at the packing of the destination.
+    if (destImage->getRowStepInBytes()!=osg::Image::computeRowWidthInBytes(destImage->s(), destImage->getPixelFormat(), destImage->getDataType(), destImage->getPacking()))
+    {
+        return false;
+    }
+
+    resample(srcImage->getPixelFormat(), destImage->getPacking(),
+             srcImage->data(), srcImage->getRowStepInBytes(), srcImage->s(), srcImage->t(), srcImage->getDataType(),
+             destImage->data(), destImage->s(), destImage->t(), destImage->getDataType(),
+             filter, taskPool);
+
+    destImage->dirty();
+    return true;
+}
+
+bool osg::buildMipmaps(osg::Image* image, ResampleFilter filter, osg::TaskPool* taskPool)
+{
+    if (!image || !image->data() || image->isMipmap() || image->r()!=1 || image->s()<=0 || image->t()<=0 ||
+        !isResampleSupported(image->getPixelFormat(), image->getDataType()))
+    {
+        return false;
+    }
+
+    GLenum pixelFormat = image->getPixelFormat();
+    GLenum dataType = image->getDataType();
+    int packing = image->getPacking();
+
+    // lay the levels out one after another, the first as a contiguous copy of the image.
+    osg::Image::MipmapDataType offsets;
+    std::vector<int> widths, heights;
+    unsigned int totalSize = 0;
+    int width = image->s();
+    int height = image->t();
+    while(true)
+    {
+        widths.push_back(width);
+        heights.push_back(height);
+        totalSize += osg::Image::computeRowWidthInBytes(width, pixelFormat, dataType, packing)*height;
+
+        if (width==1 && height==1) break;
+
+        width = osg::maximum(width>>1, 1);
+        height = osg::maximum(height>>1, 1);
+        offsets.push_back(totalSize);
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    unsigned int rowSize = image->getRowSizeInBytes();
+    for(int row=0; row<image->t(); ++row)
+    {
+        memcpy(data+row*rowSize, image->data(0, row), rowSize);
+    }
+
+    unsigned int levelOffset = 0;
+    for(unsigned int level=1; level<widths.size(); ++level)
+    {
+        unsigned int previousRowStep = osg::Image::computeRowWidthInBytes(widths[level-1], pixelFormat, dataType, packing);
+        unsigned int nextLevelOffset = offsets[level-1];
+        resample(pixelFormat, packing,
+                 data+levelOffset, previousRowStep, widths[level-1], heights[level-1], dataType,
+                 data+nextLevelOffset, widths[level], heights[level], dataType,
+                 filter, taskPool);
+        levelOffset = nextLevelOffset;
+    }
+
+    image->setImage(image->s(), image->t(), 1, image->getInternalTextureFormat(), pixelFormat, dataType, data, osg::Image::USE_NEW_DELETE, packing);
+    image->setMipmapLevels(offsets);
+
+    OSG_INFO<<"osg::buildMipmaps() built "<<widths.size()<<" levels for "<<image->s()<<"x"<<image->t()<<" image"<<std::endl;
+
+    return true;
+}
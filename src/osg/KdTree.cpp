@@ -43,6 +43,17 @@ struct BuildKdTree
 
     int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
 
+    typedef std::vector< int >                  NodeOrder;
+
+    void layoutNodes(KdTree::BuildOptions& options, int rootIndex);
+
+    unsigned int computeHeight(int nodeIndex) const;
+
+    void appendDepthFirst(NodeOrder& order, int nodeIndex) const;
+    void appendBreadthFirst(NodeOrder& order, int rootIndex) const;
+    void appendVanEmdeBoas(NodeOrder& order, int nodeIndex, unsigned int height) const;
+    void collectNodesAtDepth(NodeOrder& nodes, int nodeIndex, unsigned int depth) const;
+
     KdTree&             _kdTree;
 
     osg::BoundingBox    _bb;
@@ -222,6 +233,8 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     }
     primitiveIndices.swap(new_indices);
 
+    layoutNodes(options, nodeNum);
+
 
 #ifdef VERBOSE_OUTPUT
     OSG_NOTICE<<"Root nodeNum="<<nodeNum<<std::endl;
@@ -469,6 +482,116 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
 }
 
+void BuildKdTree::layoutNodes(KdTree::BuildOptions& options, int rootIndex)
+{
+    NodeOrder order;
+    order.reserve(_kdTree.getNodes().size());
+    switch(options._nodeLayout)
+    {
+        case(KdTree::BuildOptions::BREADTH_FIRST): appendBreadthFirst(order, rootIndex); break;
+        case(KdTree::BuildOptions::VAN_EMDE_BOAS): appendVanEmdeBoas(order, rootIndex, computeHeight(rootIndex)); break;
+        default: appendDepthFirst(order, rootIndex); break;
+    }
+
+    // copy the nodes across in their new order, which always starts with the root, remapping the child indices.
+    // Nodes orphaned by in situ divisions aren't reachable from the root so are dropped.
+    NodeOrder newIndices(_kdTree.getNodes().size(), 0);
+    for(unsigned int i=0; i<order.size(); ++i)
+    {
+        newIndices[order[i]] = static_cast<int>(i);
+    }
+
+    KdTree::KdNodeList newNodes;
+    newNodes.reserve(order.size());
+    for(NodeOrder::iterator itr = order.begin();
+        itr != order.end();
+        ++itr)
+    {
+        KdTree::KdNode node = _kdTree.getNode(*itr);
+        if (node.first>=0)
+        {
+            node.first = node.first>0 ? newIndices[node.first] : 0;
+            node.second = node.second>0 ? newIndices[node.second] : 0;
+        }
+        newNodes.push_back(node);
+    }
+
+    _kdTree.getNodes().swap(newNodes);
+}
+
+unsigned int BuildKdTree::computeHeight(int nodeIndex) const
+{
+    const KdTree::KdNode& node = _kdTree.getNode(nodeIndex);
+    if (node.first<0) return 1;
+
+    unsigned int firstHeight = node.first>0 ? computeHeight(node.first) : 0;
+    unsigned int secondHeight = node.second>0 ? computeHeight(node.second) : 0;
+    return 1 + osg::maximum(firstHeight, secondHeight);
+}
+
+void BuildKdTree::appendDepthFirst(NodeOrder& order, int nodeIndex) const
+{
+    order.push_back(nodeIndex);
+
+    const KdTree::KdNode& node = _kdTree.getNode(nodeIndex);
+    if (node.first<0) return;
+
+    if (node.first>0) appendDepthFirst(order, node.first);
+    if (node.second>0) appendDepthFirst(order, node.second);
+}
+
+void BuildKdTree::appendBreadthFirst(NodeOrder& order, int rootIndex) const
+{
+    // the order list doubles up as the queue of nodes still to visit.
+    unsigned int begin = order.size();
+    order.push_back(rootIndex);
+    for(unsigned int i=begin; i<order.size(); ++i)
+    {
+        const KdTree::KdNode& node = _kdTree.getNode(order[i]);
+        if (node.first<0) continue;
+
+        if (node.first>0) order.push_back(node.first);
+        if (node.second>0) order.push_back(node.second);
+    }
+}
+
+void BuildKdTree::appendVanEmdeBoas(NodeOrder& order, int nodeIndex, unsigned int height) const
+{
+    if (height<=1)
+    {
+        order.push_back(nodeIndex);
+        return;
+    }
+
+    // lay out the top half of the levels as one block, followed by each of the subtrees hanging off its bottom.
+    unsigned int topHeight = height/2;
+    appendVanEmdeBoas(order, nodeIndex, topHeight);
+
+    NodeOrder bottomRoots;
+    collectNodesAtDepth(bottomRoots, nodeIndex, topHeight);
+    for(NodeOrder::iterator itr = bottomRoots.begin();
+        itr != bottomRoots.end();
+        ++itr)
+    {
+        appendVanEmdeBoas(order, *itr, height-topHeight);
+    }
+}
+
+void BuildKdTree::collectNodesAtDepth(NodeOrder& nodes, int nodeIndex, unsigned int depth) const
+{
+    if (depth==0)
+    {
+        nodes.push_back(nodeIndex);
+        return;
+    }
+
+    const KdTree::KdNode& node = _kdTree.getNode(nodeIndex);
+    if (node.first<0) return;
+
+    if (node.first>0) collectNodesAtDepth(nodes, node.first, depth-1);
+    if (node.second>0) collectNodesAtDepth(nodes, node.second, depth-1);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTree::BuildOptions
@@ -476,7 +599,8 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _nodeLayout(VAN_EMDE_BOAS)
 {
 }
 
@@ -205,15 +205,16 @@ Referenced::~Referenced()
         OSG_WARN<<"         the final reference count was "<<_refCount<<", memory corruption possible."<<std::endl;
     }
 
-    // signal observers that we are being deleted.
-    signalObserversAndDelete(true, false);
+    ObserverSet* observerSet = getObserverSet();
+    if (observerSet)
+    {
+        // signal observers that we are being deleted, unless unref() has already done so, in which case the
+        // ObserverSet has been detached and there's no need to take its mutex a second time.
+        if (observerSet->getObserverdObject()) observerSet->signalObjectDeleted(this);
 
-    // delete the ObserverSet
-#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
-    if (_observerSet.get()) static_cast<ObserverSet*>(_observerSet.get())->unref();
-#else
-    if (_observerSet) static_cast<ObserverSet*>(_observerSet)->unref();
-#endif
+        // delete the ObserverSet
+        observerSet->unref();
+    }
 
 #if !defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
     if (_refMutex) delete _refMutex;
@@ -0,0 +1,373 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/TaskPool>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+using namespace osg;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  TaskSet
+//
+TaskSet::TaskSet():
+    osg::Referenced(true)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  WorkerThread
+//
+TaskPool::WorkerThread::WorkerThread(TaskPool* pool, unsigned int index):
+    osg::Referenced(true),
+    _pool(pool),
+    _index(index)
+{
+}
+
+TaskPool::WorkerThread::~WorkerThread()
+{
+    if (isRunning())
+    {
+        cancel();
+        join();
+    }
+}
+
+void TaskPool::WorkerThread::run()
+{
+    OSG_INFO<<"TaskPool::WorkerThread::run() "<<_index<<std::endl;
+
+    while(_pool->_done==0)
+    {
+        Task task;
+        bool stolen = false;
+        if (_pool->takeTask(static_cast<int>(_index), task, stolen))
+        {
+            if (stolen) ++(_pool->_numTasksStolen);
+            _pool->runTask(task);
+        }
+        else
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_pool->_idleMutex);
+            if (_pool->_numTasksPending==0 && _pool->_done==0)
+            {
+                // time out periodically as a guard against a missed wake up.
+                _pool->_idleCondition.wait(&(_pool->_idleMutex), 100);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  TaskPool
+//
+TaskPool::TaskPool(unsigned int numThreads):
+    osg::Referenced(true)
+{
+    setUpThreads(numThreads);
+}
+
+TaskPool::~TaskPool()
+{
+    cancel();
+}
+
+ref_ptr<TaskPool>& TaskPool::instance()
+{
+    static ref_ptr<TaskPool> s_taskPool = new TaskPool;
+    return s_taskPool;
+}
+
+void TaskPool::setUpThreads(unsigned int numThreads)
+{
+    cancel();
+
+    if (numThreads==0) numThreads = OpenThreads::GetNumberOfProcessors();
+    if (numThreads==0) numThreads = 1;
+
+    _done.exchange(0);
+
+    _queues.clear();
+    for(unsigned int i=0; i<=numThreads; ++i)
+    {
+        _queues.push_back(new TaskQueue);
+    }
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        _workers.push_back(new WorkerThread(this, i));
+    }
+
+    for(WorkerThreads::iterator itr = _workers.begin();
+        itr != _workers.end();
+        ++itr)
+    {
+        (*itr)->startThread();
+    }
+}
+
+void TaskPool::setProcessorAffinity(const OpenThreads::Affinity& affinity)
+{
+    for(WorkerThreads::iterator itr = _workers.begin();
+        itr != _workers.end();
+        ++itr)
+    {
+        (*itr)->setProcessorAffinity(affinity);
+    }
+}
+
+void TaskPool::cancel()
+{
+    if (_workers.empty()) return;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_idleMutex);
+        _done.exchange(1);
+        _idleCondition.broadcast();
+    }
+
+    for(WorkerThreads::iterator itr = _workers.begin();
+        itr != _workers.end();
+        ++itr)
+    {
+        (*itr)->join();
+    }
+    _workers.clear();
+
+    // release any tasks that were never started so that waiting TaskSets complete.
+    for(TaskQueues::iterator itr = _queues.begin();
+        itr != _queues.end();
+        ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        for(std::deque<Task>::iterator titr = (*itr)->_tasks.begin();
+            titr != (*itr)->_tasks.end();
+            ++titr)
+        {
+            if (titr->_taskSet.valid()) --(titr->_taskSet->_numTasksOutstanding);
+            --_numTasksPending;
+        }
+        (*itr)->_tasks.clear();
+        (*itr)->_numTasks.exchange(0);
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_idleMutex);
+        _taskSetCompletedCondition.broadcast();
+    }
+}
+
+int TaskPool::currentWorkerIndex() const
+{
+    WorkerThread* worker = dynamic_cast<WorkerThread*>(OpenThreads::Thread::CurrentThread());
+    return (worker && worker->getTaskPool()==this) ? static_cast<int>(worker->getIndex()) : -1;
+}
+
+bool TaskPool::isWorkerThread() const
+{
+    return currentWorkerIndex()>=0;
+}
+
+void TaskPool::add(Operation* operation, TaskSet* taskSet)
+{
+    if (!operation) return;
+
+    if (taskSet) ++(taskSet->_numTasksOutstanding);
+
+    if (_workers.empty())
+    {
+        // no workers to hand the task over to so run it straight away.
+        Task task(operation, taskSet);
+        runTask(task);
+        return;
+    }
+
+    int workerIndex = currentWorkerIndex();
+    TaskQueue* queue = (workerIndex>=0) ? _queues[workerIndex].get() : _queues.back().get();
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        queue->_tasks.push_back(Task(operation, taskSet));
+        ++(queue->_numTasks);
+        ++_numTasksPending;
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_idleMutex);
+        _idleCondition.signal();
+    }
+}
+
+bool TaskPool::takeTask(int workerIndex, Task& task, bool& stolen)
+{
+    unsigned int numQueues = _queues.size();
+    if (numQueues==0 || _numTasksPending==0) return false;
+
+    // first look in the worker's own deque, taking the most recently added task.
+    if (workerIndex>=0)
+    {
+        TaskQueue* queue = _queues[workerIndex].get();
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        if (!queue->_tasks.empty())
+        {
+            task = queue->_tasks.back();
+            queue->_tasks.pop_back();
+            --(queue->_numTasks);
+            --_numTasksPending;
+            stolen = false;
+            return true;
+        }
+    }
+
+    // then steal the oldest task from the deepest of the other queues, the queue sizes are
+    // sampled from the atomic counts without locking as they are only used to pick which queue to try.
+    for(unsigned int attempt=0; attempt<2; ++attempt)
+    {
+        unsigned int deepestIndex = numQueues;
+        size_t deepestSize = 0;
+        for(unsigned int i=0; i<numQueues; ++i)
+        {
+            if (static_cast<int>(i)==workerIndex) continue;
+
+            size_t queueSize = static_cast<unsigned int>(_queues[i]->_numTasks);
+            if (queueSize>deepestSize)
+            {
+                deepestSize = queueSize;
+                deepestIndex = i;
+            }
+        }
+
+        if (deepestIndex==numQueues) return false;
+
+        TaskQueue* queue = _queues[deepestIndex].get();
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        if (!queue->_tasks.empty())
+        {
+            task = queue->_tasks.front();
+            queue->_tasks.pop_front();
+            --(queue->_numTasks);
+            --_numTasksPending;
+            stolen = (deepestIndex+1<numQueues);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TaskPool::takeTaskFromSet(int workerIndex, TaskSet* taskSet, Task& task)
+{
+    unsigned int numQueues = _queues.size();
+    if (numQueues==0 || _numTasksPending==0) return false;
+
+    // look in the calling worker's own deque first, most recent first, then through the rest oldest first.
+    for(unsigned int i=0; i<numQueues; ++i)
+    {
+        unsigned int queueIndex = (workerIndex>=0) ? (static_cast<unsigned int>(workerIndex)+i)%numQueues : numQueues-1-i;
+        TaskQueue* queue = _queues[queueIndex].get();
+        if (queue->_numTasks==0) continue;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        if (i==0 && workerIndex>=0)
+        {
+            for(std::deque<Task>::reverse_iterator itr = queue->_tasks.rbegin();
+                itr != queue->_tasks.rend();
+                ++itr)
+            {
+                if (itr->_taskSet==taskSet)
+                {
+                    task = *itr;
+                    queue->_tasks.erase(--(itr.base()));
+                    --(queue->_numTasks);
+                    --_numTasksPending;
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            for(std::deque<Task>::iterator itr = queue->_tasks.begin();
+                itr != queue->_tasks.end();
+                ++itr)
+            {
+                if (itr->_taskSet==taskSet)
+                {
+                    task = *itr;
+                    queue->_tasks.erase(itr);
+                    --(queue->_numTasks);
+                    --_numTasksPending;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void TaskPool::runTask(Task& task)
+{
+    (*task._operation)(0);
+
+    ++_numTasksRun;
+
+    if (task._taskSet.valid() && --(task._taskSet->_numTasksOutstanding)==0)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_idleMutex);
+        _taskSetCompletedCondition.broadcast();
+    }
+}
+
+bool TaskPool::runNextTask()
+{
+    Task task;
+    bool stolen = false;
+    if (!takeTask(currentWorkerIndex(), task, stolen)) return false;
+
+    runTask(task);
+    return true;
+}
+
+void TaskPool::wait(TaskSet* taskSet)
+{
+    if (!taskSet) return;
+
+    int workerIndex = currentWorkerIndex();
+    while(!taskSet->completed())
+    {
+        Task task;
+        if (takeTaskFromSet(workerIndex, taskSet, task))
+        {
+            runTask(task);
+        }
+        else
+        {
+            // the remaining operations are running on other threads, completion of the set is broadcast.
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_idleMutex);
+            if (!taskSet->completed())
+            {
+                _taskSetCompletedCondition.wait(&_idleMutex, 10);
+            }
+        }
+    }
+}
+
+void TaskPool::resetStats()
+{
+    _numTasksRun.exchange(0);
+    _numTasksStolen.exchange(0);
+}
@@ -12,6 +12,7 @@
 */
 #include <osg/GLExtensions>
 #include <osg/Image>
+#include <osg/ImageUtils>
 #include <osg/Texture>
 #include <osg/State>
 #include <osg/Notify>
@@ -2129,6 +2130,23 @@ GLenum Texture::selectSizedInternalFormat(const osg::Image* image) const
     }
 }
 
+// Scale an image to the power of two size of the texture, filtering on the CPU for the formats osg::resampleImage() supports
+// and falling back to gluScaleImage() for the others.
+static void scaleImageData(PixelStorageModes& psm, const Image* image, GLsizei width, GLsizei height, unsigned char* destData)
+{
+    if (isResampleSupported(image->getPixelFormat(), image->getDataType()))
+    {
+        osg::ref_ptr<osg::Image> destImage = new osg::Image;
+        destImage->setImage(width, height, 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), destData, osg::Image::NO_DELETE, image->getPacking());
+        if (resampleImage(image, destImage.get(), RESAMPLE_TRIANGLE)) return;
+    }
+
+    gluScaleImage(&psm, image->getPixelFormat(),
+                  image->s(),image->t(),image->getDataType(),image->data(),
+                  width,height,image->getDataType(),
+                  destData);
+}
+
 void Texture::applyTexImage2D_load(State& state, GLenum target, const Image* image, GLsizei inwidth, GLsizei inheight,GLsizei numMipmapLevels) const
 {
     // if we don't have a valid image we can't create a texture!
@@ -2245,10 +2263,7 @@ void Texture::applyTexImage2D_load(State& state, GLenum target, const Image* ima
         psm.unpack_alignment = image->getPacking();
 
         // rescale the image to the correct size.
-        gluScaleImage(&psm, image->getPixelFormat(),
-                        image->s(),image->t(),image->getDataType(),image->data(),
-                        inwidth,inheight,image->getDataType(),
-                        dataPtr);
+        scaleImageData(psm, image, inwidth, inheight, dataPtr);
 
         rowLength = 0;
     }
@@ -2433,17 +2448,46 @@ void Texture::applyTexImage2D_load(State& state, GLenum target, const Image* ima
             {
                 numMipmapLevels = 0;
 
-                gluBuild2DMipmaps( target, _internalFormat,
-                    inwidth,inheight,
-                    (GLenum)image->getPixelFormat(), (GLenum)image->getDataType(),
-                    dataPtr);
+                // build the mipmap chain on the CPU where supported, serially so the graphics thread never waits on tasks queued in a TaskPool.
+                osg::ref_ptr<osg::Image> mipmapImage = new osg::Image;
+                mipmapImage->setImage(inwidth, inheight, 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+                                      dataPtr, osg::Image::NO_DELETE, image->getPacking(), rowLength);
 
-                int width  = image->s();
-                int height = image->t();
-                for( numMipmapLevels = 0 ; (width || height) ; ++numMipmapLevels)
+                if (buildMipmaps(mipmapImage.get(), RESAMPLE_BOX, 0))
                 {
-                    width >>= 1;
-                    height >>= 1;
+#if !defined(OSG_GLES1_AVAILABLE) && !defined(OSG_GLES2_AVAILABLE) && !defined(OSG_GLES3_AVAILABLE)
+                    glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+#endif
+                    numMipmapLevels = mipmapImage->getNumMipmapLevels();
+
+                    int width  = inwidth;
+                    int height = inheight;
+                    for( GLsizei k = 0 ; k < numMipmapLevels ; k++)
+                    {
+                        glTexImage2D( target, k, _internalFormat,
+                             width, height, _borderWidth,
+                            (GLenum)image->getPixelFormat(),
+                            (GLenum)image->getDataType(),
+                            mipmapImage->getMipmapData(k));
+
+                        width = osg::maximum(width>>1, 1);
+                        height = osg::maximum(height>>1, 1);
+                    }
+                }
+                else
+                {
+                    gluBuild2DMipmaps( target, _internalFormat,
+                        inwidth,inheight,
+                        (GLenum)image->getPixelFormat(), (GLenum)image->getDataType(),
+                        dataPtr);
+
+                    int width  = image->s();
+                    int height = image->t();
+                    for( numMipmapLevels = 0 ; (width || height) ; ++numMipmapLevels)
+                    {
+                        width >>= 1;
+                        height >>= 1;
+                    }
                 }
             }
             else
@@ -2570,10 +2614,7 @@ void Texture::applyTexImage2D_subload(State& state, GLenum target, const Image*
         psm.pack_alignment = image->getPacking();
         psm.unpack_alignment = image->getPacking();
 
-        gluScaleImage(&psm, image->getPixelFormat(),
-                      image->s(),image->t(),image->getDataType(),image->data(),
-                      inwidth,inheight,image->getDataType(),
-                      dataPtr);
+        scaleImageData(psm, image, inwidth, inheight, dataPtr);
 
         rowLength = 0;
     }
@@ -15,6 +15,7 @@
 #include <osgAnimation/VertexInfluence>
 #include <osgAnimation/RigGeometry>
 #include <osgAnimation/RigTransformSoftware>
+#include <osg/CullStack>
 #include <sstream>
 
 using namespace osgAnimation;
@@ -56,6 +57,8 @@ RigGeometry::RigGeometry()
     setUpdateCallback(new UpdateRigGeometry);
     setDataVariance(osg::Object::DYNAMIC);
     _needToComputeMatrix = true;
+    _skipUpdateWhenCulled = false;
+    _lastFrameNumberInView.exchange(UNKNOWN_FRAME_NUMBER);
     _matrixFromSkeletonToGeometry = _invMatrixFromSkeletonToGeometry = osg::Matrix::identity();
     // disable the computation of boundingbox for the rig mesh
     setComputeBoundingBoxCallback(new RigComputeBoundingBoxCallback());
@@ -69,7 +72,9 @@ RigGeometry::RigGeometry(const RigGeometry& b, const osg::CopyOp& copyop) :
     _geometry(b._geometry),
     _rigTransformImplementation(osg::clone(b._rigTransformImplementation.get(), copyop)),
     _vertexInfluenceMap(b._vertexInfluenceMap),
-    _needToComputeMatrix(b._needToComputeMatrix)
+    _needToComputeMatrix(b._needToComputeMatrix),
+    _skipUpdateWhenCulled(b._skipUpdateWhenCulled),
+    _lastFrameNumberInView(UNKNOWN_FRAME_NUMBER)
 {
     _needToComputeMatrix = true;
     _matrixFromSkeletonToGeometry = _invMatrixFromSkeletonToGeometry = osg::Matrix::identity();
@@ -82,6 +87,20 @@ RigGeometry::RigGeometry(const RigGeometry& b, const osg::CopyOp& copyop) :
 }
 
 
+void RigGeometry::accept(osg::NodeVisitor& nv)
+{
+    if (nv.getVisitorType()==osg::NodeVisitor::CULL_VISITOR && nv.getFrameStamp() && nv.validNodeMask(*this))
+    {
+        osg::CullStack* cullStack = nv.asCullStack();
+        if (cullStack && !(isCullingActive() && cullStack->isCulled(getBoundingBox())))
+        {
+            _lastFrameNumberInView.exchange(nv.getFrameStamp()->getFrameNumber());
+        }
+    }
+
+    osg::Geometry::accept(nv);
+}
+
 const osg::Matrix& RigGeometry::getMatrixFromSkeletonToGeometry() const { return _matrixFromSkeletonToGeometry; }
 const osg::Matrix& RigGeometry::getInvMatrixFromSkeletonToGeometry() const { return _invMatrixFromSkeletonToGeometry;}
 
@@ -23,7 +23,39 @@
 
 using namespace osgAnimation;
 
-RigTransformSoftware::RigTransformSoftware()
+namespace
+{
+    struct SkinVertexGroupsOperation : public osg::Operation
+    {
+        SkinVertexGroupsOperation(RigTransformSoftware* rts, unsigned int begin, unsigned int end,
+                                  const osg::Matrix& transform, const osg::Matrix& invTransform,
+                                  const osg::Vec3* positionSrc, osg::Vec3* positionDst,
+                                  const osg::Vec3* normalSrc, osg::Vec3* normalDst):
+            osg::Operation("SkinVertexGroupsOperation", false),
+            _rts(rts), _begin(begin), _end(end),
+            _transform(transform), _invTransform(invTransform),
+            _positionSrc(positionSrc), _positionDst(positionDst),
+            _normalSrc(normalSrc), _normalDst(normalDst) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            _rts->skinVertexGroups(_begin, _end, _transform, _invTransform, _positionSrc, _positionDst, _normalSrc, _normalDst);
+        }
+
+        RigTransformSoftware*   _rts;
+        unsigned int            _begin;
+        unsigned int            _end;
+        osg::Matrix             _transform;
+        osg::Matrix             _invTransform;
+        const osg::Vec3*        _positionSrc;
+        osg::Vec3*              _positionDst;
+        const osg::Vec3*        _normalSrc;
+        osg::Vec3*              _normalDst;
+    };
+}
+
+RigTransformSoftware::RigTransformSoftware():
+    _minimumNumVerticesPerTask(4096)
 {
     _needInit = true;
 }
@@ -31,6 +63,8 @@ RigTransformSoftware::RigTransformSoftware()
 RigTransformSoftware::RigTransformSoftware(const RigTransformSoftware& rts,const osg::CopyOp& copyop):
     RigTransform(rts, copyop),
     _needInit(rts._needInit),
+    _taskPool(rts._taskPool),
+    _minimumNumVerticesPerTask(rts._minimumNumVerticesPerTask),
     _invalidInfluence(rts._invalidInfluence)
 {
 
@@ -184,6 +218,9 @@ bool RigTransformSoftware::init(RigGeometry&rig)
         localid2bone.push_back(bone);
     }
 
+    _bones.assign(localid2bone.begin(), localid2bone.end());
+    _boneMatrices.resize(_bones.size());
+
     ///fill bone ptr in the _uniqVertexGroupList
     for(VertexGroupList::iterator itvg = _uniqVertexGroupList.begin(); itvg != _uniqVertexGroupList.end(); ++itvg)
     {
@@ -248,19 +285,74 @@ void RigTransformSoftware::operator()(RigGeometry& geom)
     osg::Vec3Array* normalDst = static_cast<osg::Vec3Array*>(destination.getNormalArray());
 
 
-    compute<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                       geom.getInvMatrixFromSkeletonToGeometry(),
-                       &positionSrc->front(),
-                       &positionDst->front());    
-    positionDst->dirty();
+    // compute each bone's matrix once, rather than once per vertex group that it influences.
+    for(unsigned int i=0; i<_bones.size(); ++i)
+    {
+        const Bone* bone = _bones[i].get();
+        if (bone) _boneMatrices[i] = bone->getInvBindMatrixInSkeletonSpace() * bone->getMatrixInSkeletonSpace();
+    }
 
-    if (normalSrc )
+    const osg::Matrix& transform = geom.getMatrixFromSkeletonToGeometry();
+    const osg::Matrix& invTransform = geom.getInvMatrixFromSkeletonToGeometry();
+    const osg::Vec3* positionSrcPtr = &positionSrc->front();
+    osg::Vec3* positionDstPtr = &positionDst->front();
+    const osg::Vec3* normalSrcPtr = normalSrc ? &normalSrc->front() : 0;
+    osg::Vec3* normalDstPtr = normalSrc ? &normalDst->front() : 0;
+
+    unsigned int numGroups = _uniqVertexGroupList.size();
+    unsigned int minimumNumVertices = osg::maximum(_minimumNumVerticesPerTask, 1u);
+    if (_taskPool.valid() && positionSrc->size()>=2*minimumNumVertices)
     {
-        computeNormal<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                                 geom.getInvMatrixFromSkeletonToGeometry(),
-                                 &normalSrc->front(),
-                                 &normalDst->front());
-        normalDst->dirty();
+        // the vertex groups reference disjoint sets of vertices so chunks of groups can be skinned concurrently.
+        osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+        unsigned int begin = 0;
+        unsigned int numVertices = 0;
+        for(unsigned int i=0; i<numGroups; ++i)
+        {
+            numVertices += _uniqVertexGroupList[i].getVertices().size();
+            if (numVertices>=minimumNumVertices || i+1==numGroups)
+            {
+                _taskPool->add(new SkinVertexGroupsOperation(this, begin, i+1, transform, invTransform,
+                                                             positionSrcPtr, positionDstPtr, normalSrcPtr, normalDstPtr),
+                               taskSet.get());
+                begin = i+1;
+                numVertices = 0;
+            }
+        }
+        _taskPool->wait(taskSet.get());
     }
+    else
+    {
+        skinVertexGroups(0, numGroups, transform, invTransform, positionSrcPtr, positionDstPtr, normalSrcPtr, normalDstPtr);
+    }
+
+    positionDst->dirty();
+    if (normalSrc) normalDst->dirty();
+}
+
+void RigTransformSoftware::skinVertexGroups(unsigned int begin, unsigned int end,
+                                            const osg::Matrix& transform, const osg::Matrix& invTransform,
+                                            const osg::Vec3* positionSrc, osg::Vec3* positionDst,
+                                            const osg::Vec3* normalSrc, osg::Vec3* normalDst)
+{
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        VertexGroup& uniq = _uniqVertexGroupList[i];
+        uniq.computeMatrixForVertexSet(_boneMatrices);
+        osg::Matrix matrix = transform * uniq.getMatrix() * invTransform;
 
+        const IndexList& vertices = uniq.getVertices();
+        for(IndexList::const_iterator vertIDit=vertices.begin(); vertIDit!=vertices.end(); ++vertIDit)
+        {
+            positionDst[*vertIDit] = positionSrc[*vertIDit] * matrix;
+        }
+
+        if (normalSrc)
+        {
+            for(IndexList::const_iterator vertIDit=vertices.begin(); vertIDit!=vertices.end(); ++vertIDit)
+            {
+                normalDst[*vertIDit] = osg::Matrix::transform3x3(normalSrc[*vertIDit], matrix);
+            }
+        }
+    }
 }
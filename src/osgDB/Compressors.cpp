@@ -13,6 +13,8 @@
 // Written by Wang Rui, (C) 2010
 
 #include <osg/Notify>
+#include <osg/Math>
+#include <osg/TaskPool>
 #include <osgDB/Registry>
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
@@ -173,4 +175,277 @@ public:
 
 REGISTER_COMPRESSOR( "zlib", ZLibCompressor )
 
+// Block framed ZLib compressor, the source is split into fixed size blocks that are compressed
+// independently so that both compression and decompression can be spread over the shared TaskPool.
+// The stream starts with the block size and count, followed by a block index of the uncompressed
+// and compressed size of each block, and then the compressed blocks themselves. The index lets a
+// reader locate any block without inflating the ones before it. All header and index fields are
+// written as little endian 32 bit unsigned integers, whatever the byte order of the writer.
+class ZLibBlocksCompressor : public BaseCompressor
+{
+public:
+    ZLibBlocksCompressor() {}
+
+    // size of the blocks written by compress()
+    static const unsigned int s_blockSize = 1048576;
+
+    // largest block size accepted by decompress()
+    static const unsigned int s_maximumBlockSize = 64*1048576;
+
+    // deflate can't compress by more than 1032:1, so blocks claiming more than this are rejected
+    static const unsigned int s_maximumCompressionRatio = 1032;
+
+    struct Block
+    {
+        Block() : uncompressedSize(0), compressedSize(0), offset(0) {}
+
+        unsigned int uncompressedSize;
+        unsigned int compressedSize;
+        std::string::size_type offset;
+        std::string data;
+    };
+    typedef std::vector<Block> Blocks;
+
+    class CompressBlockOperation : public osg::Operation
+    {
+    public:
+        CompressBlockOperation( const std::string& src, Block& block, OpenThreads::Atomic& numFailed )
+        :   osg::Operation("CompressBlockOperation", false),
+            _src(src), _block(block), _numFailed(numFailed) {}
+
+        virtual void operator () ( osg::Object* )
+        {
+            uLongf destLen = compressBound( _block.uncompressedSize );
+            _block.data.resize( destLen );
+            if ( compress2((Bytef*)(&(*_block.data.begin())), &destLen,
+                           (const Bytef*)(_src.data() + _block.offset), _block.uncompressedSize, 6)!=Z_OK )
+            {
+                ++_numFailed;
+                return;
+            }
+            _block.data.resize( destLen );
+            _block.compressedSize = destLen;
+        }
+
+        const std::string&      _src;
+        Block&                  _block;
+        OpenThreads::Atomic&    _numFailed;
+    };
+
+    class DecompressBlockOperation : public osg::Operation
+    {
+    public:
+        DecompressBlockOperation( std::string& target, Block& block, OpenThreads::Atomic& numFailed )
+        :   osg::Operation("DecompressBlockOperation", false),
+            _target(target), _block(block), _numFailed(numFailed) {}
+
+        virtual void operator () ( osg::Object* )
+        {
+            uLongf destLen = _block.uncompressedSize;
+            if ( uncompress((Bytef*)(&(*_target.begin()) + _block.offset), &destLen,
+                            (const Bytef*)_block.data.data(), _block.compressedSize)!=Z_OK ||
+                 destLen!=_block.uncompressedSize )
+            {
+                ++_numFailed;
+            }
+        }
+
+        std::string&            _target;
+        Block&                  _block;
+        OpenThreads::Atomic&    _numFailed;
+    };
+
+    virtual bool compress( std::ostream& fout, const std::string& src )
+    {
+        std::string::size_type numBlocks = (src.size()+s_blockSize-1)/s_blockSize;
+        if ( numBlocks>0xffffffffu )
+        {
+            OSG_WARN << "ZLibBlocksCompressor: source of " << src.size() << " bytes has too many blocks to index." << std::endl;
+            return false;
+        }
+
+        Blocks blocks(numBlocks);
+        for ( std::string::size_type i=0; i<numBlocks; ++i )
+        {
+            blocks[i].offset = i*s_blockSize;
+            blocks[i].uncompressedSize = static_cast<unsigned int>(osg::minimum(static_cast<std::string::size_type>(s_blockSize), src.size()-blocks[i].offset));
+        }
+
+        OpenThreads::Atomic numFailed;
+        runBlockOperations( blocks, CompressOperationFactory(src, numFailed) );
+        if ( numFailed!=0 ) return false;
+
+        writeUInt( fout, s_blockSize );
+        writeUInt( fout, static_cast<unsigned int>(numBlocks) );
+        for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr )
+        {
+            writeUInt( fout, itr->uncompressedSize );
+            writeUInt( fout, itr->compressedSize );
+        }
+        for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr )
+        {
+            fout.write( itr->data.data(), itr->data.size() );
+        }
+        return !fout.fail();
+    }
+
+    virtual bool decompress( std::istream& fin, std::string& target )
+    {
+        unsigned int blockSize = 0, numBlocks = 0;
+        if ( !readUInt(fin, blockSize) || !readUInt(fin, numBlocks) ) return false;
+
+        if ( blockSize==0 || blockSize>s_maximumBlockSize )
+        {
+            OSG_WARN << "ZLibBlocksCompressor: invalid block size " << blockSize << "." << std::endl;
+            return false;
+        }
+
+        // when the stream can report its size, check the index and blocks fit in what remains of it before allocating for them,
+        // otherwise the index is read an entry at a time so a stream that ends early fails before much is allocated.
+        std::streamoff remaining = getRemainingSize( fin );
+        if ( remaining>=0 && static_cast<std::streamoff>(numBlocks)*2*INT_SIZE>remaining )
+        {
+            OSG_WARN << "ZLibBlocksCompressor: block index of " << numBlocks << " blocks exceeds the stream size." << std::endl;
+            return false;
+        }
+
+        uLong maximumCompressedSize = compressBound( blockSize );
+
+        Blocks blocks;
+        blocks.reserve( osg::minimum(numBlocks, 1024u) );
+
+        std::string::size_type totalSize = 0;
+        std::streamoff totalCompressedSize = 0;
+        for ( unsigned int i=0; i<numBlocks; ++i )
+        {
+            Block block;
+            if ( !readUInt(fin, block.uncompressedSize) || !readUInt(fin, block.compressedSize) ) return false;
+
+            if ( block.uncompressedSize>blockSize || block.compressedSize>maximumCompressedSize ||
+                 block.uncompressedSize>static_cast<std::string::size_type>(block.compressedSize)*s_maximumCompressionRatio )
+            {
+                OSG_WARN << "ZLibBlocksCompressor: invalid size of block " << i << "." << std::endl;
+                return false;
+            }
+
+            block.offset = totalSize;
+            totalSize += block.uncompressedSize;
+            totalCompressedSize += block.compressedSize;
+            blocks.push_back( block );
+        }
+
+        if ( remaining>=0 && totalCompressedSize>remaining-static_cast<std::streamoff>(numBlocks)*2*INT_SIZE )
+        {
+            OSG_WARN << "ZLibBlocksCompressor: compressed blocks exceed the stream size." << std::endl;
+            return false;
+        }
+
+        for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr )
+        {
+            itr->data.resize( itr->compressedSize );
+            if ( itr->compressedSize>0 ) fin.read( &(*itr->data.begin()), itr->compressedSize );
+            if ( fin.fail() ) return false;
+        }
+
+        std::string::size_type previousSize = target.size();
+        if ( totalSize>target.max_size()-previousSize ) return false;
+
+        target.resize( previousSize+totalSize );
+        if ( previousSize>0 )
+        {
+            for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr ) itr->offset += previousSize;
+        }
+
+        OpenThreads::Atomic numFailed;
+        runBlockOperations( blocks, DecompressOperationFactory(target, numFailed) );
+        return numFailed==0;
+    }
+
+protected:
+
+    struct CompressOperationFactory
+    {
+        CompressOperationFactory( const std::string& src, OpenThreads::Atomic& numFailed ) : _src(src), _numFailed(numFailed) {}
+        osg::Operation* operator () ( Block& block ) const { return new CompressBlockOperation(_src, block, _numFailed); }
+
+        const std::string&      _src;
+        OpenThreads::Atomic&    _numFailed;
+    };
+
+    struct DecompressOperationFactory
+    {
+        DecompressOperationFactory( std::string& target, OpenThreads::Atomic& numFailed ) : _target(target), _numFailed(numFailed) {}
+        osg::Operation* operator () ( Block& block ) const { return new DecompressBlockOperation(_target, block, _numFailed); }
+
+        std::string&            _target;
+        OpenThreads::Atomic&    _numFailed;
+    };
+
+    static void writeUInt( std::ostream& fout, unsigned int value )
+    {
+        char bytes[4];
+        bytes[0] = static_cast<char>(value & 0xff);
+        bytes[1] = static_cast<char>((value >> 8) & 0xff);
+        bytes[2] = static_cast<char>((value >> 16) & 0xff);
+        bytes[3] = static_cast<char>((value >> 24) & 0xff);
+        fout.write( bytes, 4 );
+    }
+
+    static bool readUInt( std::istream& fin, unsigned int& value )
+    {
+        unsigned char bytes[4];
+        fin.read( reinterpret_cast<char*>(bytes), 4 );
+        if ( fin.fail() ) return false;
+
+        value = static_cast<unsigned int>(bytes[0]) |
+                (static_cast<unsigned int>(bytes[1]) << 8) |
+                (static_cast<unsigned int>(bytes[2]) << 16) |
+                (static_cast<unsigned int>(bytes[3]) << 24);
+        return true;
+    }
+
+    // Return the number of bytes left in the stream, or -1 if the stream can't be repositioned to find out.
+    static std::streamoff getRemainingSize( std::istream& fin )
+    {
+        std::streampos current = fin.tellg();
+        if ( current==std::streampos(-1) ) return -1;
+
+        fin.seekg( 0, std::ios::end );
+        std::streampos end = fin.tellg();
+        fin.seekg( current );
+        if ( end==std::streampos(-1) || fin.fail() )
+        {
+            fin.clear();
+            fin.seekg( current );
+            return -1;
+        }
+        return end-current;
+    }
+
+    // Run the operation for each block, a single block is processed on the calling thread
+    template<class OperationFactory>
+    void runBlockOperations( Blocks& blocks, const OperationFactory& factory )
+    {
+        osg::TaskPool* taskPool = osg::TaskPool::instance().get();
+        if ( blocks.size()<2 || !taskPool )
+        {
+            for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr )
+            {
+                osg::ref_ptr<osg::Operation> operation = factory(*itr);
+                (*operation)(0);
+            }
+            return;
+        }
+
+        osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+        for ( Blocks::iterator itr=blocks.begin(); itr!=blocks.end(); ++itr )
+        {
+            taskPool->add( factory(*itr), taskSet.get() );
+        }
+        taskPool->wait( taskSet.get() );
+    }
+};
+
+REGISTER_COMPRESSOR( "zlib_blocks", ZLibBlocksCompressor )
+
 #endif
@@ -48,6 +48,7 @@ static osg::ApplicationUsageProxy DatabasePager_e3(osg::ApplicationUsage::ENVIRO
 static osg::ApplicationUsageProxy DatabasePager_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_PRIORITY <mode>", "Set the thread priority to DEFAULT, MIN, LOW, NOMINAL, HIGH or MAX.");
 static osg::ApplicationUsageProxy DatabasePager_e11(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD <num>","Set the target maximum number of PagedLOD to maintain.");
 static osg::ApplicationUsageProxy DatabasePager_e12(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_ASSIGN_PBO_TO_IMAGES <ON/OFF>","Set whether PixelBufferObjects should be assigned to Images to aid download to the GPU.");
+static osg::ApplicationUsageProxy DatabasePager_e13(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_TASK_POOL <ON/OFF>","Switch on or off running the database requests as tasks on a work stealing thread pool in place of dedicated database threads.");
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -243,11 +244,12 @@ public:
 class DatabasePager::FindCompileableGLObjectsVisitor : public osgUtil::StateToCompile
 {
 public:
-    FindCompileableGLObjectsVisitor(const DatabasePager* pager, osg::Object* markerObject):
+    FindCompileableGLObjectsVisitor(const DatabasePager* pager, osg::Object* markerObject, bool deferKdTreeBuilds=false):
             osgUtil::StateToCompile(osgUtil::GLObjectsVisitor::COMPILE_DISPLAY_LISTS|osgUtil::GLObjectsVisitor::COMPILE_STATE_ATTRIBUTES, markerObject),
             _pager(pager),
             _changeAutoUnRef(false), _valueAutoUnRef(false),
-            _changeAnisotropy(false), _valueAnisotropy(1.0)
+            _changeAnisotropy(false), _valueAnisotropy(1.0),
+            _deferKdTreeBuilds(deferKdTreeBuilds)
     {
         _assignPBOToImages = _pager->_assignPBOToImages;
 
@@ -293,7 +295,8 @@ public:
     {
         if (_kdTreeBuilder.valid() && _markerObject.get()!=drawable.getUserData())
         {
-            drawable.accept(*_kdTreeBuilder);
+            if (_deferKdTreeBuilds) _drawablesToBuildKdTrees.push_back(&drawable);
+            else drawable.accept(*_kdTreeBuilder);
         }
 
         StateToCompile::apply(drawable);
@@ -331,6 +334,9 @@ public:
 
     }
 
+    /** Build the KdTrees of the drawables collected when deferKdTreeBuilds is set, split into tasks run on the TaskPool.*/
+    void buildKdTrees(osg::TaskPool* taskPool);
+
     const DatabasePager*                    _pager;
     bool                                    _changeAutoUnRef;
     bool                                    _valueAutoUnRef;
@@ -338,12 +344,101 @@ public:
     float                                   _valueAnisotropy;
     osg::ref_ptr<osg::KdTreeBuilder>        _kdTreeBuilder;
 
+    bool                                    _deferKdTreeBuilds;
+    DatabasePager::DrawableList             _drawablesToBuildKdTrees;
+
 protected:
 
     FindCompileableGLObjectsVisitor& operator = (const FindCompileableGLObjectsVisitor&) { return *this; }
 };
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  BuildKdTreesOperation
+//
+struct DatabasePager::BuildKdTreesOperation : public osg::Operation
+{
+    BuildKdTreesOperation(osg::KdTreeBuilder* kdTreeBuilder):
+        osg::Operation("BuildKdTrees", false),
+        _kdTreeBuilder(kdTreeBuilder->clone()) {}
+
+    virtual void operator () (osg::Object*)
+    {
+        for(DrawableList::iterator itr = _drawables.begin();
+            itr != _drawables.end();
+            ++itr)
+        {
+            (*itr)->accept(*_kdTreeBuilder);
+        }
+    }
+
+    osg::ref_ptr<osg::KdTreeBuilder>    _kdTreeBuilder;
+    DrawableList                        _drawables;
+};
+
+void DatabasePager::FindCompileableGLObjectsVisitor::buildKdTrees(osg::TaskPool* taskPool)
+{
+    if (_drawablesToBuildKdTrees.empty()) return;
+
+    // split the drawables into a few tasks per pool thread so idle threads can steal a share.
+    unsigned int numTasks = osg::maximum(1u, taskPool->getNumThreads()*4);
+    unsigned int numDrawablesPerTask = (static_cast<unsigned int>(_drawablesToBuildKdTrees.size())+numTasks-1)/numTasks;
+
+    osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+    for(DrawableList::iterator itr = _drawablesToBuildKdTrees.begin();
+        itr != _drawablesToBuildKdTrees.end();
+        )
+    {
+        osg::ref_ptr<DatabasePager::BuildKdTreesOperation> operation = new DatabasePager::BuildKdTreesOperation(_kdTreeBuilder.get());
+        for(unsigned int i=0; i<numDrawablesPerTask && itr != _drawablesToBuildKdTrees.end(); ++i, ++itr)
+        {
+            operation->_drawables.push_back(*itr);
+        }
+        taskPool->add(operation.get(), taskSet.get());
+    }
+
+    taskPool->wait(taskSet.get());
+
+    _drawablesToBuildKdTrees.clear();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ProcessRequestOperation
+//
+struct DatabasePager::ProcessRequestOperation : public osg::Operation
+{
+    ProcessRequestOperation(DatabasePager* pager):
+        osg::Operation("DatabasePager::ProcessRequest", false),
+        _pager(pager) {}
+
+    virtual void operator () (osg::Object*)
+    {
+        if (_pager->_done || _pager->_databasePagerThreadPaused) return;
+
+        if (_pager->_deleteRemovedSubgraphsInDatabaseThread)
+        {
+            _pager->deleteRemovedSubgraphs(_pager->_fileRequestQueue.get());
+        }
+
+        // take the next request from whichever queue has the largest backlog.
+        ReadQueue* first_queue = _pager->_fileRequestQueue.get();
+        ReadQueue* second_queue = _pager->_httpRequestQueue.get();
+        if (second_queue->size()>first_queue->size()) std::swap(first_queue, second_queue);
+
+        osg::ref_ptr<DatabaseRequest> databaseRequest;
+        first_queue->takeFirst(databaseRequest);
+        if (!databaseRequest.valid()) second_queue->takeFirst(databaseRequest);
+
+        _pager->processRequest(databaseRequest, DatabaseThread::HANDLE_ALL_REQUESTS, 0, "DatabasePager::ProcessRequestOperation");
+    }
+
+    DatabasePager* _pager;
+};
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  SortFileRequestFunctor
@@ -573,14 +668,332 @@ DatabasePager::ReadQueue::ReadQueue(DatabasePager* pager, const std::string& nam
     _name(name)
 {
     _block = new osg::RefBlock;
+
+    resetStats();
+}
+
+DatabasePager::ReadQueue::~ReadQueue()
+{
+    for(RequestHeap::iterator itr = _requestHeap.begin();
+        itr != _requestHeap.end();
+        ++itr)
+    {
+        (*itr)->_readQueue = 0;
+        invalidate(itr->get());
+    }
 }
 
 void DatabasePager::ReadQueue::updateBlock()
 {
-    _block->set((!_requestList.empty() || !_childrenToDeleteList.empty()) &&
+    _block->set((!_requestHeap.empty() || !_childrenToDeleteList.empty()) &&
                 !_pager->_databasePagerThreadPaused);
 }
 
+void DatabasePager::ReadQueue::placeNoLock(unsigned int index, DatabaseRequest* databaseRequest)
+{
+    _requestHeap[index] = databaseRequest;
+    databaseRequest->_readQueue = this;
+    databaseRequest->_requestQueueIndex = index;
+}
+
+void DatabasePager::ReadQueue::siftUpNoLock(unsigned int index)
+{
+    DatabasePager::SortFileRequestFunctor highPriority;
+
+    osg::ref_ptr<DatabaseRequest> databaseRequest = _requestHeap[index];
+    while(index>0)
+    {
+        unsigned int parent = (index-1)/2;
+        if (!highPriority(databaseRequest, _requestHeap[parent])) break;
+
+        placeNoLock(index, _requestHeap[parent].get());
+        index = parent;
+    }
+    placeNoLock(index, databaseRequest.get());
+}
+
+void DatabasePager::ReadQueue::siftDownNoLock(unsigned int index)
+{
+    DatabasePager::SortFileRequestFunctor highPriority;
+
+    unsigned int numRequests = _requestHeap.size();
+    osg::ref_ptr<DatabaseRequest> databaseRequest = _requestHeap[index];
+    for(;;)
+    {
+        unsigned int child = index*2+1;
+        if (child>=numRequests) break;
+
+        if (child+1<numRequests && highPriority(_requestHeap[child+1], _requestHeap[child])) ++child;
+        if (!highPriority(_requestHeap[child], databaseRequest)) break;
+
+        placeNoLock(index, _requestHeap[child].get());
+        index = child;
+    }
+    placeNoLock(index, databaseRequest.get());
+}
+
+void DatabasePager::ReadQueue::eraseNoLock(unsigned int index)
+{
+    _requestHeap[index]->_readQueue = 0;
+
+    unsigned int last = _requestHeap.size()-1;
+    if (index!=last)
+    {
+        DatabaseRequest* moved = _requestHeap[last].get();
+        placeNoLock(index, moved);
+        _requestHeap.pop_back();
+
+        // the moved entry may need to go either way to restore the heap ordering.
+        siftUpNoLock(index);
+        if (moved->_requestQueueIndex==index) siftDownNoLock(index);
+    }
+    else
+    {
+        _requestHeap.pop_back();
+    }
+}
+
+void DatabasePager::ReadQueue::recordLatencyNoLock(DatabaseRequest* databaseRequest)
+{
+    double latency = osg::Timer::instance()->delta_s(databaseRequest->_tickAddedToRequestQueue, osg::Timer::instance()->tick());
+
+    if (latency<_minimumLatency) _minimumLatency = latency;
+    if (latency>_maximumLatency) _maximumLatency = latency;
+
+    _totalLatency += latency;
+    ++_numLatencySamples;
+}
+
+unsigned int DatabasePager::ReadQueue::getLatencyStats(double& minimumLatency, double& maximumLatency, double& totalLatency)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    minimumLatency = _minimumLatency;
+    maximumLatency = _maximumLatency;
+    totalLatency = _totalLatency;
+    return _numLatencySamples;
+}
+
+void DatabasePager::ReadQueue::resetStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    _minimumLatency = DBL_MAX;
+    _maximumLatency = -DBL_MAX;
+    _totalLatency = 0.0;
+    _numLatencySamples = 0;
+}
+
+bool DatabasePager::ReadQueue::pruneOldRequestsAndCheckIfEmpty()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    unsigned int frameNumber = _pager->_frameNumber;
+    if (_frameNumberLastPruned != frameNumber)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+        // compact the heap in place, then rebuild the heap ordering over the remaining requests.
+        unsigned int numKept = 0;
+        for(RequestHeap::iterator citr = _requestHeap.begin();
+            citr != _requestHeap.end();
+            ++citr)
+        {
+            if ((*citr)->isRequestCurrent(frameNumber))
+            {
+                _requestHeap[numKept++] = *citr;
+            }
+            else
+            {
+                (*citr)->_readQueue = 0;
+                invalidate(citr->get());
+
+                OSG_INFO<<"DatabasePager::ReadQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<(*citr)<<std::endl;
+            }
+        }
+
+        if (numKept != _requestHeap.size())
+        {
+            _requestHeap.resize(numKept);
+            for(unsigned int i=0; i<numKept; ++i)
+            {
+                _requestHeap[i]->_requestQueueIndex = i;
+            }
+            for(unsigned int i=numKept/2; i>0; --i)
+            {
+                siftDownNoLock(i-1);
+            }
+        }
+
+        _frameNumberLastPruned = frameNumber;
+
+        updateBlock();
+    }
+
+    return _requestHeap.empty();
+}
+
+bool DatabasePager::ReadQueue::empty()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    return _requestHeap.empty();
+}
+
+unsigned int DatabasePager::ReadQueue::size()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    return _requestHeap.size();
+}
+
+void DatabasePager::ReadQueue::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    for(RequestHeap::iterator citr = _requestHeap.begin();
+        citr != _requestHeap.end();
+        ++citr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+        (*citr)->_readQueue = 0;
+        invalidate(citr->get());
+    }
+
+    _requestHeap.clear();
+
+    _frameNumberLastPruned = _pager->_frameNumber;
+
+    updateBlock();
+}
+
+void DatabasePager::ReadQueue::remove(DatabasePager::DatabaseRequest* databaseRequest)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    if (databaseRequest->_readQueue==this)
+    {
+        eraseNoLock(databaseRequest->_requestQueueIndex);
+    }
+}
+
+void DatabasePager::ReadQueue::addNoLock(DatabasePager::DatabaseRequest* databaseRequest)
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+        if (databaseRequest->_readQueue==this)
+        {
+            siftUpNoLock(databaseRequest->_requestQueueIndex);
+            siftDownNoLock(databaseRequest->_requestQueueIndex);
+        }
+        else
+        {
+            databaseRequest->_tickAddedToRequestQueue = osg::Timer::instance()->tick();
+            _requestHeap.push_back(databaseRequest);
+            siftUpNoLock(_requestHeap.size()-1);
+        }
+    }
+    updateBlock();
+}
+
+void DatabasePager::ReadQueue::updatePriority(DatabasePager::DatabaseRequest* databaseRequest, double timestampLastRequest, float priorityLastRequest)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+    databaseRequest->_timestampLastRequest = timestampLastRequest;
+    databaseRequest->_priorityLastRequest = priorityLastRequest;
+
+    // the request may have been taken or moved to another queue since the caller looked it up.
+    if (databaseRequest->_readQueue==this)
+    {
+        siftUpNoLock(databaseRequest->_requestQueueIndex);
+        siftDownNoLock(databaseRequest->_requestQueueIndex);
+    }
+}
+
+void DatabasePager::ReadQueue::swap(RequestList& requestList)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    RequestList localList;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+        // return the requests in the order they were added.
+        typedef std::vector< std::pair<osg::Timer_t, unsigned int> > AddedOrder;
+        AddedOrder addedOrder;
+        addedOrder.reserve(_requestHeap.size());
+        for(unsigned int i=0; i<_requestHeap.size(); ++i)
+        {
+            addedOrder.push_back(AddedOrder::value_type(_requestHeap[i]->_tickAddedToRequestQueue, i));
+        }
+        std::sort(addedOrder.begin(), addedOrder.end());
+
+        for(AddedOrder::iterator itr = addedOrder.begin();
+            itr != addedOrder.end();
+            ++itr)
+        {
+            DatabaseRequest* databaseRequest = _requestHeap[itr->second].get();
+            databaseRequest->_readQueue = 0;
+            localList.push_back(databaseRequest);
+        }
+        _requestHeap.clear();
+    }
+
+    requestList.swap(localList);
+    for(RequestList::iterator itr = localList.begin();
+        itr != localList.end();
+        ++itr)
+    {
+        addNoLock(itr->get());
+    }
+}
+
+void DatabasePager::ReadQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    if (!_requestHeap.empty())
+    {
+        int frameNumber = _pager->_frameNumber;
+
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+            // the front of the heap is the most recently requested entry, so if it isn't current
+            // it is pruned and the next is tried, leaving the remaining entries untouched.
+            while(!_requestHeap.empty())
+            {
+                osg::ref_ptr<DatabaseRequest> front = _requestHeap.front();
+                eraseNoLock(0);
+
+                if (front->isRequestCurrent(frameNumber))
+                {
+                    recordLatencyNoLock(front.get());
+                    databaseRequest = front;
+                    break;
+                }
+
+                invalidate(front.get());
+
+                OSG_INFO<<"DatabasePager::ReadQueue::takeFirst(): Pruning "<<front.get()<<std::endl;
+            }
+        }
+
+        if (databaseRequest.valid())
+        {
+            OSG_INFO<<" DatabasePager::ReadQueue::takeFirst() Found DatabaseRequest size()="<<_requestHeap.size()<<std::endl;
+        }
+        else
+        {
+            _frameNumberLastPruned = frameNumber;
+
+            OSG_INFO<<" DatabasePager::ReadQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestHeap.size()<<std::endl;
+        }
+
+        updateBlock();
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  DatabaseThread
@@ -686,16 +1099,7 @@ void DatabasePager::DatabaseThread::run()
         //
         if (_pager->_deleteRemovedSubgraphsInDatabaseThread/* && !(read_queue->_childrenToDeleteList.empty())*/)
         {
-            ObjectList deleteList;
-            {
-                // Don't hold lock during destruction of deleteList
-                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(read_queue->_requestMutex);
-                if (!read_queue->_childrenToDeleteList.empty())
-                {
-                    deleteList.swap(read_queue->_childrenToDeleteList);
-                    read_queue->updateBlock();
-                }
-            }
+            _pager->deleteRemovedSubgraphs(read_queue.get());
         }
 
         //
@@ -704,265 +1108,286 @@ void DatabasePager::DatabaseThread::run()
         osg::ref_ptr<DatabaseRequest> databaseRequest;
         read_queue->takeFirst(databaseRequest);
 
-        bool readFromFileCache = false;
+        if (!_pager->processRequest(databaseRequest, _mode, out_queue.get(), _name))
+        {
+            OpenThreads::Thread::YieldCurrentThread();
+        }
 
-        osg::ref_ptr<FileCache> fileCache = osgDB::Registry::instance()->getFileCache();
-        osg::ref_ptr<FileLocationCallback> fileLocationCallback = osgDB::Registry::instance()->getFileLocationCallback();
-        osg::ref_ptr<Options> dr_loadOptions;
-        std::string fileName;
-        int frameNumberLastRequest = 0;
-        bool cacheNodes = false;
-        if (databaseRequest.valid())
+
+        // go to sleep till our the next time our thread gets scheduled.
+
+        if (firstTime)
         {
-            {
-                OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-                dr_loadOptions = databaseRequest->_loadOptions.valid() ? databaseRequest->_loadOptions->cloneOptions() : new osgDB::Options;
-                dr_loadOptions->setTerrain(databaseRequest->_terrain);
-                dr_loadOptions->setParentGroup(databaseRequest->_group);
-                fileName = databaseRequest->_fileName;
-                frameNumberLastRequest = databaseRequest->_frameNumberLastRequest;
-            }
+            // do a yield to get round a peculiar thread hang when testCancel() is called
+            // in certain circumstances - of which there is no particular pattern.
+            YieldCurrentThread();
+            firstTime = false;
+        }
 
+    } while (!testCancel() && !_done);
+}
 
-            if (dr_loadOptions->getFileCache()) fileCache = dr_loadOptions->getFileCache();
-            if (dr_loadOptions->getFileLocationCallback()) fileLocationCallback = dr_loadOptions->getFileLocationCallback();
 
-            // disable the FileCache if the fileLocationCallback tells us that it isn't required for this request.
-            if (fileLocationCallback.valid() && !fileLocationCallback->useFileCache()) fileCache = 0;
+void DatabasePager::deleteRemovedSubgraphs(ReadQueue* read_queue)
+{
+    ObjectList deleteList;
+    {
+        // Don't hold lock during destruction of deleteList
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(read_queue->_requestMutex);
+        if (!read_queue->_childrenToDeleteList.empty())
+        {
+            deleteList.swap(read_queue->_childrenToDeleteList);
+            read_queue->updateBlock();
+        }
+    }
+}
 
+bool DatabasePager::processRequest(osg::ref_ptr<DatabaseRequest>& databaseRequest, DatabaseThread::Mode mode, ReadQueue* out_queue, const std::string& name)
+{
+    bool readFromFileCache = false;
+
+    osg::ref_ptr<FileCache> fileCache = osgDB::Registry::instance()->getFileCache();
+    osg::ref_ptr<FileLocationCallback> fileLocationCallback = osgDB::Registry::instance()->getFileLocationCallback();
+    osg::ref_ptr<Options> dr_loadOptions;
+    std::string fileName;
+    int frameNumberLastRequest = 0;
+    bool cacheNodes = false;
+    if (databaseRequest.valid())
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+            dr_loadOptions = databaseRequest->_loadOptions.valid() ? databaseRequest->_loadOptions->cloneOptions() : new osgDB::Options;
+            dr_loadOptions->setTerrain(databaseRequest->_terrain);
+            dr_loadOptions->setParentGroup(databaseRequest->_group);
+            fileName = databaseRequest->_fileName;
+            frameNumberLastRequest = databaseRequest->_frameNumberLastRequest;
+        }
 
-            cacheNodes = (dr_loadOptions->getObjectCacheHint() & osgDB::Options::CACHE_NODES)!=0;
-            if (cacheNodes)
-            {
-                //OSG_NOTICE<<"Checking main ObjectCache"<<std::endl;
-                // check the object cache to see if the file we want has already been loaded.
-                osg::ref_ptr<osg::Object> objectFromCache = osgDB::Registry::instance()->getRefFromObjectCache(fileName);
 
-                // if no object with fileName in ObjectCache then try the filename appropriate for fileCache
-                if (!objectFromCache && (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName)))
-                {
-                    if (fileCache->existsInCache(fileName))
-                    {
-                        objectFromCache = osgDB::Registry::instance()->getRefFromObjectCache(fileCache->createCacheFileName(fileName));
-                    }
-                }
+        if (dr_loadOptions->getFileCache()) fileCache = dr_loadOptions->getFileCache();
+        if (dr_loadOptions->getFileLocationCallback()) fileLocationCallback = dr_loadOptions->getFileLocationCallback();
+
+        // disable the FileCache if the fileLocationCallback tells us that it isn't required for this request.
+        if (fileLocationCallback.valid() && !fileLocationCallback->useFileCache()) fileCache = 0;
 
 
-                osg::Node* modelFromCache = dynamic_cast<osg::Node*>(objectFromCache.get());
-                if (modelFromCache)
+        cacheNodes = (dr_loadOptions->getObjectCacheHint() & osgDB::Options::CACHE_NODES)!=0;
+        if (cacheNodes)
+        {
+            //OSG_NOTICE<<"Checking main ObjectCache"<<std::endl;
+            // check the object cache to see if the file we want has already been loaded.
+            osg::ref_ptr<osg::Object> objectFromCache = osgDB::Registry::instance()->getRefFromObjectCache(fileName);
+
+            // if no object with fileName in ObjectCache then try the filename appropriate for fileCache
+            if (!objectFromCache && (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName)))
+            {
+                if (fileCache->existsInCache(fileName))
                 {
-                    //OSG_NOTICE<<"Found object in cache "<<fileName<<std::endl;
+                    objectFromCache = osgDB::Registry::instance()->getRefFromObjectCache(fileCache->createCacheFileName(fileName));
+                }
+            }
 
-                    // assign the cached model to the request
-                    {
-                        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-                        databaseRequest->_loadedModel = modelFromCache;
-                    }
 
-                    // move the request to the dataToMerge list so it can be merged during the update phase of the frame.
-                    {
-                        OpenThreads::ScopedLock<OpenThreads::Mutex> listLock( _pager->_dataToMergeList->_requestMutex);
-                        _pager->_dataToMergeList->addNoLock(databaseRequest.get());
-                        databaseRequest = 0;
-                    }
+            osg::Node* modelFromCache = dynamic_cast<osg::Node*>(objectFromCache.get());
+            if (modelFromCache)
+            {
+                //OSG_NOTICE<<"Found object in cache "<<fileName<<std::endl;
 
-                    // skip the rest of the do/while loop as we have done all the processing we need to do.
-                    continue;
-                }
-                else
+                // assign the cached model to the request
                 {
-                    //OSG_NOTICE<<"Not Found object in cache "<<fileName<<std::endl;
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+                    databaseRequest->_loadedModel = modelFromCache;
                 }
 
-                // need to disable any attempt to use the cache when loading as we're handle this ourselves to avoid threading conflicts
+                // move the request to the dataToMerge list so it can be merged during the update phase of the frame.
                 {
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-                    databaseRequest->_objectCache = new ObjectCache;
-                    dr_loadOptions->setObjectCache(databaseRequest->_objectCache.get());
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> listLock( _dataToMergeList->_requestMutex);
+                    _dataToMergeList->addNoLock(databaseRequest.get());
+                    databaseRequest = 0;
                 }
-            }
 
+                // nothing more to do as the cached model is already loaded.
+                return true;
+            }
+            else
+            {
+                //OSG_NOTICE<<"Not Found object in cache "<<fileName<<std::endl;
+            }
 
-            // check if databaseRequest is still relevant
-            if ((_pager->_frameNumber-frameNumberLastRequest)<=1)
+            // need to disable any attempt to use the cache when loading as we're handle this ourselves to avoid threading conflicts
             {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+                databaseRequest->_objectCache = new ObjectCache;
+                dr_loadOptions->setObjectCache(databaseRequest->_objectCache.get());
+            }
+        }
+
 
-                // now check to see if this request is appropriate for this thread
-                switch(_mode)
+        // check if databaseRequest is still relevant
+        if ((_frameNumber-frameNumberLastRequest)<=1)
+        {
+
+            // now check to see if this request is appropriate for this thread
+            switch(mode)
+            {
+                case(DatabaseThread::HANDLE_ALL_REQUESTS):
                 {
-                    case(HANDLE_ALL_REQUESTS):
+                    // do nothing as this thread can handle the load
+                    if (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName))
                     {
-                        // do nothing as this thread can handle the load
-                        if (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName))
+                        if (fileCache->existsInCache(fileName))
                         {
-                            if (fileCache->existsInCache(fileName))
-                            {
-                                readFromFileCache = true;
-                            }
+                            readFromFileCache = true;
                         }
-                        break;
                     }
-                    case(HANDLE_NON_HTTP):
+                    break;
+                }
+                case(DatabaseThread::HANDLE_NON_HTTP):
+                {
+                    // check the cache first
+                    bool isHighLatencyFileRequest = false;
+
+                    if (fileLocationCallback.valid())
+                    {
+                        isHighLatencyFileRequest = fileLocationCallback->fileLocation(fileName, dr_loadOptions.get()) == FileLocationCallback::REMOTE_FILE;
+                    }
+                    else  if (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName))
                     {
-                        // check the cache first
-                        bool isHighLatencyFileRequest = false;
+                        isHighLatencyFileRequest = true;
+                    }
 
-                        if (fileLocationCallback.valid())
-                        {
-                            isHighLatencyFileRequest = fileLocationCallback->fileLocation(fileName, dr_loadOptions.get()) == FileLocationCallback::REMOTE_FILE;
-                        }
-                        else  if (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName))
+                    if (isHighLatencyFileRequest)
+                    {
+                        if (fileCache.valid() && fileCache->existsInCache(fileName))
                         {
-                            isHighLatencyFileRequest = true;
+                            readFromFileCache = true;
                         }
-
-                        if (isHighLatencyFileRequest)
+                        else
                         {
-                            if (fileCache.valid() && fileCache->existsInCache(fileName))
-                            {
-                                readFromFileCache = true;
-                            }
-                            else
-                            {
-                                OSG_INFO<<_name<<": Passing http requests over "<<fileName<<std::endl;
-                                out_queue->add(databaseRequest.get());
-                                databaseRequest = 0;
-                            }
+                            OSG_INFO<<name<<": Passing http requests over "<<fileName<<std::endl;
+                            out_queue->add(databaseRequest.get());
+                            databaseRequest = 0;
                         }
-                        break;
-                    }
-                    case(HANDLE_ONLY_HTTP):
-                    {
-                        // accept all requests, as we'll assume only high latency requests will have got here.
-                        break;
                     }
+                    break;
+                }
+                case(DatabaseThread::HANDLE_ONLY_HTTP):
+                {
+                    // accept all requests, as we'll assume only high latency requests will have got here.
+                    break;
                 }
-            }
-            else
-            {
-                databaseRequest = 0;
             }
         }
-
-
-        if (databaseRequest.valid())
+        else
         {
+            databaseRequest = 0;
+        }
+    }
 
-            // load the data, note safe to write to the databaseRequest since once
-            // it is created this thread is the only one to write to the _loadedModel pointer.
-            //OSG_NOTICE<<"In DatabasePager thread readNodeFile("<<databaseRequest->_fileName<<")"<<std::endl;
-            //osg::Timer_t before = osg::Timer::instance()->tick();
 
+    if (!databaseRequest.valid()) return false;
 
-            // assume that readNode is thread safe...
-            ReaderWriter::ReadResult rr = readFromFileCache ?
-                        fileCache->readNode(fileName, dr_loadOptions.get(), false) :
-                        Registry::instance()->readNode(fileName, dr_loadOptions.get(), false);
 
-            osg::ref_ptr<osg::Node> loadedModel;
-            if (rr.validNode()) loadedModel = rr.getNode();
-            if (!rr.success()) OSG_WARN<<"Error in reading file "<<fileName<<" : "<<rr.statusMessage() << std::endl;
+    // load the data, note safe to write to the databaseRequest since once
+    // it is created this thread is the only one to write to the _loadedModel pointer.
+    //OSG_NOTICE<<"In DatabasePager thread readNodeFile("<<databaseRequest->_fileName<<")"<<std::endl;
+    //osg::Timer_t before = osg::Timer::instance()->tick();
 
-            if (loadedModel.valid() &&
-                fileCache.valid() &&
-                fileCache->isFileAppropriateForFileCache(fileName) &&
-                !readFromFileCache)
-            {
-                fileCache->writeNode(*(loadedModel), fileName, dr_loadOptions.get());
-            }
 
-            {
-                OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-                if ((_pager->_frameNumber-databaseRequest->_frameNumberLastRequest)>1)
-                {
-                    OSG_INFO<<_name<<": Warning DatabaseRquest no longer required."<<std::endl;
-                    loadedModel = 0;
-                }
-            }
+    // assume that readNode is thread safe...
+    ReaderWriter::ReadResult rr = readFromFileCache ?
+                fileCache->readNode(fileName, dr_loadOptions.get(), false) :
+                Registry::instance()->readNode(fileName, dr_loadOptions.get(), false);
 
-            //OSG_NOTICE<<"     node read in "<<osg::Timer::instance()->delta_m(before,osg::Timer::instance()->tick())<<" ms"<<std::endl;
+    osg::ref_ptr<osg::Node> loadedModel;
+    if (rr.validNode()) loadedModel = rr.getNode();
+    if (!rr.success()) OSG_WARN<<"Error in reading file "<<fileName<<" : "<<rr.statusMessage() << std::endl;
 
-            if (loadedModel.valid())
-            {
-                loadedModel->getBound();
+    if (loadedModel.valid() &&
+        fileCache.valid() &&
+        fileCache->isFileAppropriateForFileCache(fileName) &&
+        !readFromFileCache)
+    {
+        fileCache->writeNode(*(loadedModel), fileName, dr_loadOptions.get());
+    }
 
-                bool loadedObjectsNeedToBeCompiled = false;
-                osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet = 0;
-                if (!rr.loadedFromCache())
-                {
-                    // find all the compileable rendering objects
-                    DatabasePager::FindCompileableGLObjectsVisitor stateToCompile(_pager, _pager->getMarkerObject());
-                    loadedModel->accept(stateToCompile);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+        if ((_frameNumber-databaseRequest->_frameNumberLastRequest)>1)
+        {
+            OSG_INFO<<name<<": Warning DatabaseRquest no longer required."<<std::endl;
+            loadedModel = 0;
+        }
+    }
 
-                    loadedObjectsNeedToBeCompiled = _pager->_doPreCompile &&
-                                                    _pager->_incrementalCompileOperation.valid() &&
-                                                    _pager->_incrementalCompileOperation->requiresCompile(stateToCompile);
+    //OSG_NOTICE<<"     node read in "<<osg::Timer::instance()->delta_m(before,osg::Timer::instance()->tick())<<" ms"<<std::endl;
 
-                    // move the databaseRequest from the front of the fileRequest to the end of
-                    // dataToCompile or dataToMerge lists.
-                    if (loadedObjectsNeedToBeCompiled)
-                    {
-                        // OSG_NOTICE<<"Using IncrementalCompileOperation"<<std::endl;
+    if (loadedModel.valid())
+    {
+        loadedModel->getBound();
 
-                        compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(loadedModel.get());
-                        compileSet->buildCompileMap(_pager->_incrementalCompileOperation->getContextSet(), stateToCompile);
-                        compileSet->_compileCompletedCallback = new DatabasePagerCompileCompletedCallback(_pager, databaseRequest.get());
-                        _pager->_incrementalCompileOperation->add(compileSet.get(), false);
-                    }
-                }
-                else
-                {
-                    OSG_NOTICE<<"Loaded from ObjectCache"<<std::endl;
-                }
+        bool loadedObjectsNeedToBeCompiled = false;
+        osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet = 0;
+        if (!rr.loadedFromCache())
+        {
+            // find all the compileable rendering objects
+            DatabasePager::FindCompileableGLObjectsVisitor stateToCompile(this, getMarkerObject(), _taskPool.valid());
+            loadedModel->accept(stateToCompile);
 
+            if (_taskPool.valid()) stateToCompile.buildKdTrees(_taskPool.get());
 
-                {
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-                    databaseRequest->_loadedModel = loadedModel;
-                    databaseRequest->_compileSet = compileSet;
-                }
-                // Dereference the databaseRequest while the queue is
-                // locked. This prevents the request from being
-                // deleted at an unpredictable time within
-                // addLoadedDataToSceneGraph.
-                if (loadedObjectsNeedToBeCompiled)
-                {
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> listLock(
-                        _pager->_dataToCompileList->_requestMutex);
-                    _pager->_dataToCompileList->addNoLock(databaseRequest.get());
-                    databaseRequest = 0;
-                }
-                else
-                {
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> listLock(
-                        _pager->_dataToMergeList->_requestMutex);
-                    _pager->_dataToMergeList->addNoLock(databaseRequest.get());
-                    databaseRequest = 0;
-                }
+            loadedObjectsNeedToBeCompiled = _doPreCompile &&
+                                            _incrementalCompileOperation.valid() &&
+                                            _incrementalCompileOperation->requiresCompile(stateToCompile);
 
-            }
+            // move the databaseRequest from the front of the fileRequest to the end of
+            // dataToCompile or dataToMerge lists.
+            if (loadedObjectsNeedToBeCompiled)
+            {
+                // OSG_NOTICE<<"Using IncrementalCompileOperation"<<std::endl;
 
-            // _pager->_dataToCompileList->pruneOldRequestsAndCheckIfEmpty();
+                compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(loadedModel.get());
+                compileSet->buildCompileMap(_incrementalCompileOperation->getContextSet(), stateToCompile);
+                compileSet->_compileCompletedCallback = new DatabasePagerCompileCompletedCallback(this, databaseRequest.get());
+                _incrementalCompileOperation->add(compileSet.get(), false);
+            }
         }
         else
         {
-            OpenThreads::Thread::YieldCurrentThread();
+            OSG_NOTICE<<"Loaded from ObjectCache"<<std::endl;
         }
 
 
-        // go to sleep till our the next time our thread gets scheduled.
-
-        if (firstTime)
         {
-            // do a yield to get round a peculiar thread hang when testCancel() is called
-            // in certain circumstances - of which there is no particular pattern.
-            YieldCurrentThread();
-            firstTime = false;
+            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+            databaseRequest->_loadedModel = loadedModel;
+            databaseRequest->_compileSet = compileSet;
+        }
+        // Dereference the databaseRequest while the queue is
+        // locked. This prevents the request from being
+        // deleted at an unpredictable time within
+        // addLoadedDataToSceneGraph.
+        if (loadedObjectsNeedToBeCompiled)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> listLock(
+                _dataToCompileList->_requestMutex);
+            _dataToCompileList->addNoLock(databaseRequest.get());
+            databaseRequest = 0;
+        }
+        else
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> listLock(
+                _dataToMergeList->_requestMutex);
+            _dataToMergeList->addNoLock(databaseRequest.get());
+            databaseRequest = 0;
         }
 
-    } while (!testCancel() && !_done);
-}
+    }
 
+    // _dataToCompileList->pruneOldRequestsAndCheckIfEmpty();
+
+    return true;
+}
 
 DatabasePager::DatabasePager()
 {
@@ -1047,6 +1472,13 @@ DatabasePager::DatabasePager()
                         strcmp(str,"on")==0 || strcmp(str,"ON")==0;
     }
 
+    _useTaskPool = false;
+    if( (str = getenv("OSG_DATABASE_PAGER_TASK_POOL")) != 0)
+    {
+        _useTaskPool = strcmp(str,"yes")==0 || strcmp(str,"YES")==0 ||
+                       strcmp(str,"on")==0 || strcmp(str,"ON")==0;
+    }
+
     // initialize the stats variables
     resetStats();
 
@@ -1122,6 +1554,9 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
 
     _doPreCompile = rhs._doPreCompile;
 
+    _useTaskPool = rhs._useTaskPool;
+    _taskPool = rhs._taskPool;
+
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
@@ -1270,6 +1705,8 @@ int DatabasePager::setSchedulePriority(OpenThreads::Thread::ThreadPriority prior
 
 bool DatabasePager::isRunning() const
 {
+    if (_useTaskPool && _startThreadCalled && _taskPool.valid()) return true;
+
     for(DatabaseThreadList::const_iterator dt_itr = _databaseThreads.begin();
         dt_itr != _databaseThreads.end();
         ++dt_itr)
@@ -1295,6 +1732,14 @@ int DatabasePager::cancel()
     _fileRequestQueue->release();
     _httpRequestQueue->release();
 
+    // tasks check _done and return straight away, so only those already loading need to be waited for.
+    if (_taskPool.valid() && _taskSet.valid())
+    {
+        _done = true;
+        _taskPool->wait(_taskSet.get());
+        _taskSet = 0;
+    }
+
     for(DatabaseThreadList::iterator dt_itr = _databaseThreads.begin();
         dt_itr != _databaseThreads.end();
         ++dt_itr)
@@ -1330,6 +1775,54 @@ void DatabasePager::resetStats()
     _maximumTimeToMergeTile = -DBL_MAX;
     _totalTimeToMergeTiles = 0.0;
     _numTilesMerges = 0;
+
+    if (_fileRequestQueue.valid()) _fileRequestQueue->resetStats();
+    if (_httpRequestQueue.valid()) _httpRequestQueue->resetStats();
+}
+
+double DatabasePager::getMinimumRequestQueueLatency() const
+{
+    double fileMin, fileMax, fileTotal, httpMin, httpMax, httpTotal;
+    unsigned int numFile = _fileRequestQueue->getLatencyStats(fileMin, fileMax, fileTotal);
+    unsigned int numHttp = _httpRequestQueue->getLatencyStats(httpMin, httpMax, httpTotal);
+    if (numFile+numHttp==0) return 0.0;
+    return osg::minimum(fileMin, httpMin);
+}
+
+double DatabasePager::getMaximumRequestQueueLatency() const
+{
+    double fileMin, fileMax, fileTotal, httpMin, httpMax, httpTotal;
+    unsigned int numFile = _fileRequestQueue->getLatencyStats(fileMin, fileMax, fileTotal);
+    unsigned int numHttp = _httpRequestQueue->getLatencyStats(httpMin, httpMax, httpTotal);
+    if (numFile+numHttp==0) return 0.0;
+    return osg::maximum(fileMax, httpMax);
+}
+
+double DatabasePager::getAverageRequestQueueLatency() const
+{
+    double fileMin, fileMax, fileTotal, httpMin, httpMax, httpTotal;
+    unsigned int numFile = _fileRequestQueue->getLatencyStats(fileMin, fileMax, fileTotal);
+    unsigned int numHttp = _httpRequestQueue->getLatencyStats(httpMin, httpMax, httpTotal);
+    if (numFile+numHttp==0) return 0.0;
+    return (fileTotal+httpTotal)/static_cast<double>(numFile+numHttp);
+}
+
+void DatabasePager::reportStats(unsigned int frameNumber, osg::Stats& stats) const
+{
+    stats.setAttribute(frameNumber, "DatabasePager file requests", static_cast<double>(getFileRequestListSize()));
+    stats.setAttribute(frameNumber, "DatabasePager data to compile", static_cast<double>(getDataToCompileListSize()));
+    stats.setAttribute(frameNumber, "DatabasePager data to merge", static_cast<double>(getDataToMergeListSize()));
+
+    stats.setAttribute(frameNumber, "DatabasePager request latency minimum", getMinimumRequestQueueLatency());
+    stats.setAttribute(frameNumber, "DatabasePager request latency maximum", getMaximumRequestQueueLatency());
+    stats.setAttribute(frameNumber, "DatabasePager request latency average", getAverageRequestQueueLatency());
+
+    if (_numTilesMerges>0)
+    {
+        stats.setAttribute(frameNumber, "DatabasePager time to merge minimum", getMinimumTimeToMergeTile());
+        stats.setAttribute(frameNumber, "DatabasePager time to merge maximum", getMaximumTimeToMergeTile());
+        stats.setAttribute(frameNumber, "DatabasePager time to merge average", getAverageTimeToMergeTiles());
+    }
 }
 
 bool DatabasePager::getRequestsInProgress() const
@@ -1346,6 +1839,9 @@ bool DatabasePager::getRequestsInProgress() const
     {
         if ((*itr)->getActive()) return true;
     }
+
+    if (_taskSet.valid() && !_taskSet->completed()) return true;
+
     return false;
 }
 
@@ -1415,6 +1911,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
     {
         DatabaseRequest* databaseRequest = dynamic_cast<DatabaseRequest*>(databaseRequestRef.get());
         bool requeue = false;
+        osg::ref_ptr<ReadQueue> readQueue;
         if (databaseRequest)
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
@@ -1430,10 +1927,16 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
 
                 databaseRequest->_valid = true;
                 databaseRequest->_frameNumberLastRequest = frameNumber;
-                databaseRequest->_timestampLastRequest = timestamp;
-                databaseRequest->_priorityLastRequest = priority;
                 ++(databaseRequest->_numOfRequests);
 
+                // the time stamp and priority order the read queue heaps, so while queued they are updated under the queue's lock.
+                readQueue = databaseRequest->_readQueue;
+                if (!readQueue)
+                {
+                    databaseRequest->_timestampLastRequest = timestamp;
+                    databaseRequest->_priorityLastRequest = priority;
+                }
+
                 foundEntry = true;
 
                 if (databaseRequestRef->referenceCount()==1)
@@ -1453,36 +1956,49 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             }
         }
         if (requeue)
+        {
             _fileRequestQueue->add(databaseRequest);
+            addRequestTasks(1);
+        }
+        else if (readQueue.valid())
+        {
+            readQueue->updatePriority(databaseRequest, timestamp, priority);
+        }
     }
 
     if (!foundEntry)
     {
         OSG_INFO<<"In DatabasePager::requestNodeFile("<<fileName<<")"<<std::endl;
 
-        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
-
-        if (!databaseRequestRef.valid() || databaseRequestRef->referenceCount()==1)
+        bool added = false;
         {
-            osg::ref_ptr<DatabaseRequest> databaseRequest = new DatabaseRequest;
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+
+            if (!databaseRequestRef.valid() || databaseRequestRef->referenceCount()==1)
+            {
+                osg::ref_ptr<DatabaseRequest> databaseRequest = new DatabaseRequest;
 
-            databaseRequestRef = databaseRequest.get();
+                databaseRequestRef = databaseRequest.get();
 
-            databaseRequest->_valid = true;
-            databaseRequest->_fileName = fileName;
-            databaseRequest->_frameNumberFirstRequest = frameNumber;
-            databaseRequest->_timestampFirstRequest = timestamp;
-            databaseRequest->_priorityFirstRequest = priority;
-            databaseRequest->_frameNumberLastRequest = frameNumber;
-            databaseRequest->_timestampLastRequest = timestamp;
-            databaseRequest->_priorityLastRequest = priority;
-            databaseRequest->_group = group;
-            databaseRequest->_terrain = terrain;
-            databaseRequest->_loadOptions = loadOptions;
-            databaseRequest->_objectCache = 0;
+                databaseRequest->_valid = true;
+                databaseRequest->_fileName = fileName;
+                databaseRequest->_frameNumberFirstRequest = frameNumber;
+                databaseRequest->_timestampFirstRequest = timestamp;
+                databaseRequest->_priorityFirstRequest = priority;
+                databaseRequest->_frameNumberLastRequest = frameNumber;
+                databaseRequest->_timestampLastRequest = timestamp;
+                databaseRequest->_priorityLastRequest = priority;
+                databaseRequest->_group = group;
+                databaseRequest->_terrain = terrain;
+                databaseRequest->_loadOptions = loadOptions;
+                databaseRequest->_objectCache = 0;
 
-            _fileRequestQueue->addNoLock(databaseRequest.get());
+                _fileRequestQueue->addNoLock(databaseRequest.get());
+                added = true;
+            }
         }
+
+        if (added) addRequestTasks(1);
     }
 
     if (!_startThreadCalled)
@@ -1493,21 +2009,39 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
         {
             OSG_INFO<<"DatabasePager::startThread()"<<std::endl;
 
-            if (_databaseThreads.empty())
+            if (_useTaskPool)
             {
-                setUpThreads(
-                    osg::DisplaySettings::instance()->getNumOfDatabaseThreadsHint(),
-                    osg::DisplaySettings::instance()->getNumOfHttpDatabaseThreadsHint());
-            }
+                if (!_taskPool.valid())
+                {
+                    _taskPool = new osg::TaskPool(osg::DisplaySettings::instance()->getNumOfDatabaseThreadsHint());
+                    _taskPool->setProcessorAffinity(_affinity);
+                }
 
-            _startThreadCalled = true;
-            _done = false;
+                _taskSet = new osg::TaskSet;
 
-            for(DatabaseThreadList::const_iterator dt_itr = _databaseThreads.begin();
-                dt_itr != _databaseThreads.end();
-                ++dt_itr)
+                _startThreadCalled = true;
+                _done = false;
+
+                addRequestTasks(_fileRequestQueue->size());
+            }
+            else
             {
-                (*dt_itr)->startThread();
+                if (_databaseThreads.empty())
+                {
+                    setUpThreads(
+                        osg::DisplaySettings::instance()->getNumOfDatabaseThreadsHint(),
+                        osg::DisplaySettings::instance()->getNumOfHttpDatabaseThreadsHint());
+                }
+
+                _startThreadCalled = true;
+                _done = false;
+
+                for(DatabaseThreadList::const_iterator dt_itr = _databaseThreads.begin();
+                    dt_itr != _databaseThreads.end();
+                    ++dt_itr)
+                {
+                    (*dt_itr)->startThread();
+                }
             }
         }
     }
@@ -1517,6 +2051,16 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
 #endif
 }
 
+void DatabasePager::addRequestTasks(unsigned int numRequests)
+{
+    if (!_useTaskPool || !_startThreadCalled || !_taskPool.valid()) return;
+
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        _taskPool->add(new ProcessRequestOperation(this), _taskSet.get());
+    }
+}
+
 void DatabasePager::signalBeginFrame(const osg::FrameStamp* framestamp)
 {
 #if 0
@@ -1553,6 +2097,9 @@ void DatabasePager::setDatabasePagerThreadPause(bool pause)
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_httpRequestQueue->_requestMutex);
         _httpRequestQueue->updateBlock();
     }
+
+    // tasks run while paused return without taking a request, so reschedule for the requests still queued.
+    if (!pause) addRequestTasks(_fileRequestQueue->size()+_httpRequestQueue->size());
 }
 
 
@@ -1780,12 +2327,16 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
         // pass the objects across to the database pager delete list
         if (_deleteRemovedSubgraphsInDatabaseThread)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
-            // splice transfers the entire list in constant time.
-            _fileRequestQueue->_childrenToDeleteList.splice(
-                _fileRequestQueue->_childrenToDeleteList.end(),
-                childrenRemoved);
-            _fileRequestQueue->updateBlock();
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+                // splice transfers the entire list in constant time.
+                _fileRequestQueue->_childrenToDeleteList.splice(
+                    _fileRequestQueue->_childrenToDeleteList.end(),
+                    childrenRemoved);
+                _fileRequestQueue->updateBlock();
+            }
+
+            addRequestTasks(1);
         }
         else
             childrenRemoved.clear();
@@ -14,8 +14,86 @@
 #include <osgDB/ObjectCache>
 #include <osgDB/Options>
 
+#include <osg/Geometry>
+#include <osg/Texture>
+#include <osg/NodeVisitor>
+
+#include <set>
+
 using namespace osgDB;
 
+namespace
+{
+
+// Sum the data sizes of the arrays, primitive sets and images referenced by a subgraph, counting shared data once.
+class ComputeSizeVisitor : public osg::NodeVisitor
+{
+public:
+
+    ComputeSizeVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _sizeInBytes(0) {}
+
+    virtual void apply(osg::Node& node)
+    {
+        apply(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geometry& geometry)
+    {
+        apply(geometry.getStateSet());
+
+        apply(geometry.getVertexArray());
+        apply(geometry.getNormalArray());
+        apply(geometry.getColorArray());
+        apply(geometry.getSecondaryColorArray());
+        apply(geometry.getFogCoordArray());
+
+        for(unsigned int i=0; i<geometry.getNumTexCoordArrays(); ++i)
+        {
+            apply(geometry.getTexCoordArray(i));
+        }
+
+        for(unsigned int i=0; i<geometry.getNumVertexAttribArrays(); ++i)
+        {
+            apply(geometry.getVertexAttribArray(i));
+        }
+
+        for(unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+        {
+            apply(geometry.getPrimitiveSet(i)->getDrawElements());
+        }
+    }
+
+    void apply(osg::StateSet* stateset)
+    {
+        if (!stateset || !_visited.insert(stateset).second) return;
+
+        const osg::StateSet::TextureAttributeList& tal = stateset->getTextureAttributeList();
+        for(unsigned int unit=0; unit<tal.size(); ++unit)
+        {
+            osg::Texture* texture = dynamic_cast<osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (!texture) continue;
+
+            for(unsigned int i=0; i<texture->getNumImages(); ++i)
+            {
+                apply(texture->getImage(i));
+            }
+        }
+    }
+
+    void apply(const osg::BufferData* data)
+    {
+        if (data && _visited.insert(data).second) _sizeInBytes += data->getTotalDataSize();
+    }
+
+    std::set<const void*>   _visited;
+    unsigned long long      _sizeInBytes;
+};
+
+}
+
 bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair& lhs, const ObjectCache::FileNameOptionsPair& rhs) const
 {
     // check if filename are the same
@@ -41,8 +119,16 @@ bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair&
 // ObjectCache
 //
 ObjectCache::ObjectCache():
-    osg::Referenced(true)
+    osg::Referenced(true),
+    _maximumSizeInBytes(0),
+    _sizeInBytes(0),
+    _numEntries(0)
 {
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        _shards[i]._leastRecent = 0;
+        _shards[i]._mostRecent = 0;
+    }
 //    OSG_NOTICE<<"Constructed ObjectCache"<<std::endl;
 }
 
@@ -51,74 +137,254 @@ ObjectCache::~ObjectCache()
 //    OSG_NOTICE<<"Destructed ObjectCache"<<std::endl;
 }
 
+ObjectCache::Shard& ObjectCache::getShard(const std::string& fileName)
+{
+    // FNV-1a hash of the filename, entries differing only in their Options share a shard.
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr = fileName.begin(); itr != fileName.end(); ++itr)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*itr)) * 16777619u;
+    }
+    return _shards[hash % NUM_SHARDS];
+}
+
 void ObjectCache::addObjectCache(ObjectCache* objectCache)
 {
     // don't allow a cache to be added to itself.
     if (objectCache==this) return;
 
-    // lock both ObjectCache to prevent their contents from being modified by other threads while we merge.
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(_objectCacheMutex);
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(objectCache->_objectCacheMutex);
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        // copy the entries out first so that only one shard is locked at a time.
+        ObjectCacheMap entries;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(objectCache->_shards[i]._mutex);
+            entries = objectCache->_shards[i]._objectCache;
+        }
 
-    OSG_DEBUG<<"Inserting objects to main ObjectCache "<<objectCache->_objectCache.size()<<std::endl;
+        OSG_DEBUG<<"Inserting objects to main ObjectCache "<<entries.size()<<std::endl;
+
+        for(ObjectCacheMap::iterator itr = entries.begin();
+            itr != entries.end();
+            ++itr)
+        {
+            Shard& shard = getShard(itr->first.first);
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+            if (shard._objectCache.count(itr->first)==0) addEntryToShard(shard, itr->first, itr->second);
+        }
+    }
 
-    _objectCache.insert(objectCache->_objectCache.begin(), objectCache->_objectCache.end());
+    if (_maximumSizeInBytes>0)
+    {
+        computeMissingSizes();
+        evictLeastRecentlyUsed(0);
+    }
 }
 
+void ObjectCache::setMaximumSizeInBytes(unsigned long long bytes)
+{
+    _maximumSizeInBytes = bytes;
+
+    if (_maximumSizeInBytes>0)
+    {
+        computeMissingSizes();
+        evictLeastRecentlyUsed(0);
+    }
+}
+
+void ObjectCache::computeMissingSizes()
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        for(ObjectCacheMap::iterator itr = shard._objectCache.begin();
+            itr != shard._objectCache.end();
+            ++itr)
+        {
+            CacheEntry& entry = itr->second;
+            if (entry._sizeComputed) continue;
+
+            entry._sizeInBytes = computeSizeInBytes(entry._object.get());
+            entry._sizeComputed = true;
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> totalsLock(_totalsMutex);
+            _sizeInBytes += entry._sizeInBytes;
+        }
+    }
+}
 
 void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp, const Options *options)
 {
     if (!object) return;
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[FileNameOptionsPair(filename, options ? osg::clone(options) : 0)] = ObjectTimeStampPair(object,timestamp);
-    OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
+    CacheEntry entry;
+    entry._object = object;
+    entry._timestamp = timestamp;
+
+    // traversing the object to compute its size is only worth it when there is a budget to keep to.
+    if (_maximumSizeInBytes>0)
+    {
+        entry._sizeInBytes = computeSizeInBytes(object);
+        entry._sizeComputed = true;
+    }
+
+    Shard& shard = getShard(filename);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+        addEntryToShard(shard, FileNameOptionsPair(filename, options ? osg::clone(options) : 0), entry);
+        OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
+    }
+
+    // eviction locks the shards one at a time, so it is done once the shard lock has been released.
+    if (_maximumSizeInBytes>0) evictLeastRecentlyUsed(object);
 }
 
-ObjectCache::ObjectCacheMap::iterator ObjectCache::find(const std::string& fileName, const osgDB::Options* options)
+void ObjectCache::addEntryToShard(Shard& shard, const FileNameOptionsPair& key, const CacheEntry& entry)
 {
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
+    ObjectCacheMap::iterator itr = shard._objectCache.find(key);
+    if (itr==shard._objectCache.end()) itr = shard._objectCache.insert(ObjectCacheMap::value_type(key, CacheEntry())).first;
+
+    CacheEntry& cacheEntry = itr->second;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_totalsMutex);
+        if (cacheEntry._key) _sizeInBytes -= cacheEntry._sizeInBytes;
+        else ++_numEntries;
+        _sizeInBytes += entry._sizeInBytes;
+    }
+
+    cacheEntry._object = entry._object;
+    cacheEntry._timestamp = entry._timestamp;
+    cacheEntry._sizeInBytes = entry._sizeInBytes;
+    cacheEntry._sizeComputed = entry._sizeComputed;
+
+    touch(shard, itr->first, cacheEntry);
+}
+
+void ObjectCache::removeEntryFromShard(Shard& shard, ObjectCacheMap::iterator itr)
+{
+    unlink(shard, itr->second);
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_totalsMutex);
+        _sizeInBytes -= itr->second._sizeInBytes;
+        --_numEntries;
+    }
+
+    shard._objectCache.erase(itr);
+}
+
+void ObjectCache::touch(Shard& shard, const FileNameOptionsPair& key, CacheEntry& entry)
+{
+    entry._lastAccess = ++_accessCount;
+    if (shard._mostRecent==&entry) return;
+
+    if (entry._key) unlink(shard, entry);
+
+    entry._key = &key;
+    entry._lessRecent = shard._mostRecent;
+    entry._moreRecent = 0;
+
+    if (shard._mostRecent) shard._mostRecent->_moreRecent = &entry;
+    else shard._leastRecent = &entry;
+    shard._mostRecent = &entry;
+}
+
+void ObjectCache::unlink(Shard& shard, CacheEntry& entry)
+{
+    if (entry._lessRecent) entry._lessRecent->_moreRecent = entry._moreRecent;
+    else shard._leastRecent = entry._moreRecent;
+
+    if (entry._moreRecent) entry._moreRecent->_lessRecent = entry._lessRecent;
+    else shard._mostRecent = entry._lessRecent;
+
+    entry._key = 0;
+    entry._lessRecent = 0;
+    entry._moreRecent = 0;
+}
+
+ObjectCache::CacheEntry* ObjectCache::getLeastRecentlyUsed(Shard& shard, const osg::Object* keep)
+{
+    // entries referenced from outside the cache are in use, so rather than being skipped on every eviction they are
+    // moved to the most recently used end of the list, removing them wouldn't release any memory.
+    unsigned int numEntries = static_cast<unsigned int>(shard._objectCache.size());
+    for(unsigned int i=0; i<numEntries && shard._leastRecent; ++i)
     {
-        if (itr->first.first==fileName)
+        CacheEntry* entry = shard._leastRecent;
+        if (entry->_object.get()!=keep && entry->_object->referenceCount()==1) return entry;
+
+        touch(shard, *(entry->_key), *entry);
+    }
+    return 0;
+}
+
+void ObjectCache::evictLeastRecentlyUsed(const osg::Object* keep)
+{
+    while(getSizeInBytes()>_maximumSizeInBytes)
+    {
+        // find the shard whose least recently used entry was accessed longest ago, the access counter is allowed to wrap around.
+        Shard* oldestShard = 0;
+        unsigned int oldestAge = 0;
+        for(unsigned int i=0; i<NUM_SHARDS; ++i)
         {
-            if (itr->first.second.valid())
+            Shard& shard = _shards[i];
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+            CacheEntry* entry = getLeastRecentlyUsed(shard, keep);
+            if (!entry) continue;
+
+            unsigned int age = static_cast<unsigned int>(_accessCount) - entry->_lastAccess;
+            if (!oldestShard || age>oldestAge)
             {
-                if (options && *(itr->first.second)==*options) return itr;
+                oldestShard = &shard;
+                oldestAge = age;
             }
-            else if (!options) return itr;
         }
+
+        if (!oldestShard) break;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(oldestShard->_mutex);
+
+        // another thread may have used the shard since it was checked, so look up its least recently used entry again.
+        CacheEntry* entry = getLeastRecentlyUsed(*oldestShard, keep);
+        if (!entry) continue;
+
+        OSG_DEBUG<<"Evicting "<<entry->_key->first<<" from ObjectCache "<<this<<std::endl;
+
+        removeEntryFromShard(*oldestShard, oldestShard->_objectCache.find(*(entry->_key)));
+        ++_numEvictions;
     }
-    return _objectCache.end();
 }
 
-
-osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const Options *options)
+ObjectCache::ObjectCacheMap::iterator ObjectCache::find(Shard& shard, const std::string& fileName, const osgDB::Options* options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    // entries are ordered by filename first, with the entry without Options leading, so only the entries for this filename need checking.
+    for(ObjectCacheMap::iterator itr = shard._objectCache.lower_bound(FileNameOptionsPair(fileName, 0));
+        itr != shard._objectCache.end() && itr->first.first==fileName;
+        ++itr)
     {
-        osg::ref_ptr<const osgDB::Options> o = itr->first.second;
-        if (o.valid())
-        {
-            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< o->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
-        }
-        else
+        if (itr->first.second.valid())
         {
-            OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
+            if (options && *(itr->first.second)==*options) return itr;
         }
-        return itr->second.first.get();
+        else if (!options) return itr;
     }
-    else return 0;
+    return shard._objectCache.end();
+}
+
+
+osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const Options *options)
+{
+    return getRefFromObjectCache(fileName, options).get();
 }
 
 osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard._objectCache.end())
     {
         osg::ref_ptr<const osgDB::Options> o = itr->first.second;
         if (o.valid())
@@ -129,74 +395,155 @@ osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string&
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+
+        touch(shard, itr->first, itr->second);
+        ++_numHits;
+        return itr->second._object.get();
+    }
+    else
+    {
+        ++_numMisses;
+        return 0;
     }
-    else return 0;
 }
 
 void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // look for objects with external references and update their time stamp.
-    for(ObjectCacheMap::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        // look for objects with external references and update their time stamp.
+        for(ObjectCacheMap::iterator itr=shard._objectCache.begin();
+            itr!=shard._objectCache.end();
+            ++itr)
         {
-            // so update it time stamp.
-            itr->second.second = referenceTime;
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->second._object->referenceCount()>1)
+            {
+                // so update it time stamp.
+                itr->second._timestamp = referenceTime;
+            }
         }
     }
 }
 
 void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // Remove expired entries from object cache
-    ObjectCacheMap::iterator oitr = _objectCache.begin();
-    while(oitr != _objectCache.end())
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        if (oitr->second.second<=expiryTime)
-        {
-#if __cplusplus > 199711L
-            oitr = _objectCache.erase(oitr);
-#else
-            _objectCache.erase(oitr++);
-#endif
-        }
-        else
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        // Remove expired entries from object cache
+        ObjectCacheMap::iterator oitr = shard._objectCache.begin();
+        while(oitr != shard._objectCache.end())
         {
-            ++oitr;
+            if (oitr->second._timestamp<=expiryTime)
+            {
+                removeEntryFromShard(shard, oitr++);
+            }
+            else
+            {
+                ++oitr;
+            }
         }
     }
 }
 
 void ObjectCache::removeFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end()) _objectCache.erase(itr);
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard._objectCache.end())
+    {
+        removeEntryFromShard(shard, itr);
+    }
 }
 
 void ObjectCache::clear()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+        while(!shard._objectCache.empty())
+        {
+            removeEntryFromShard(shard, shard._objectCache.begin());
+        }
+    }
 }
 
 void ObjectCache::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
 
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
+        for(ObjectCacheMap::iterator itr = shard._objectCache.begin();
+            itr != shard._objectCache.end();
+            ++itr)
+        {
+            osg::Object* object = itr->second._object.get();
+            object->releaseGLObjects(state);
+        }
+    }
+}
+
+unsigned long long ObjectCache::getSizeInBytes() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_totalsMutex);
+    return _sizeInBytes;
+}
+
+unsigned int ObjectCache::getNumEntries() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_totalsMutex);
+    return _numEntries;
+}
+
+void ObjectCache::resetStats()
+{
+    _numHits.exchange(0);
+    _numMisses.exchange(0);
+    _numEvictions.exchange(0);
+}
+
+void ObjectCache::reportStats(osg::Stats* stats, unsigned int frameNumber) const
+{
+    if (!stats) return;
+
+    unsigned int numEntries = 0;
+    unsigned long long sizeInBytes = 0;
     {
-        osg::Object* object = itr->second.first.get();
-        object->releaseGLObjects(state);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_totalsMutex);
+        numEntries = _numEntries;
+        sizeInBytes = _sizeInBytes;
     }
+
+    stats->setAttribute(frameNumber, "Object cache entries", static_cast<double>(numEntries));
+    stats->setAttribute(frameNumber, "Object cache size", static_cast<double>(sizeInBytes));
+    stats->setAttribute(frameNumber, "Object cache hits", static_cast<double>(getNumHits()));
+    stats->setAttribute(frameNumber, "Object cache misses", static_cast<double>(getNumMisses()));
+    stats->setAttribute(frameNumber, "Object cache evictions", static_cast<double>(getNumEvictions()));
+}
+
+unsigned long long ObjectCache::computeSizeInBytes(osg::Object* object)
+{
+    if (!object) return 0;
+
+    ComputeSizeVisitor csv;
+
+    osg::Node* node = object->asNode();
+    osg::Image* image = dynamic_cast<osg::Image*>(object);
+    osg::StateSet* stateset = dynamic_cast<osg::StateSet*>(object);
+
+    if (node) node->accept(csv);
+    else if (image) csv.apply(image);
+    else if (stateset) csv.apply(stateset);
+
+    return csv._sizeInBytes;
 }
@@ -63,6 +63,7 @@ static osg::ApplicationUsageProxy Registry_e1(osg::ApplicationUsage::ENVIRONMENT
 #endif
 
 static osg::ApplicationUsageProxy Registry_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_BUILD_KDTREES on/off","Enable/disable the automatic building of KdTrees for each loaded Geometry.");
+static osg::ApplicationUsageProxy Registry_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OBJECT_CACHE_MAX_SIZE <megabytes>","Set the maximum size of the data held in the Registry's object cache, 0 for no limit.");
 
 
 // from MimeTypes.cpp
@@ -253,6 +254,12 @@ Registry::Registry()
     // assign ObjectCache.
     _objectCache = new ObjectCache;
 
+    if( (ptr = getenv("OSG_OBJECT_CACHE_MAX_SIZE")) != 0)
+    {
+        _objectCache->setMaximumSizeInBytes(static_cast<unsigned long long>(osg::asciiToDouble(ptr)*1024.0*1024.0));
+        OSG_INFO<<"Registry : ObjectCache maximum size = "<<ptr<<"MB"<<std::endl;
+    }
+
     _createNodeFromImage = false;
     _openingLibrary = false;
 
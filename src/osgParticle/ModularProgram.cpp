@@ -3,6 +3,8 @@
 #include <osgParticle/ParticleSystem>
 #include <osgParticle/Particle>
 
+#include <algorithm>
+
 osgParticle::ModularProgram::ModularProgram()
 : Program()
 {
@@ -23,9 +25,51 @@ void osgParticle::ModularProgram::execute(double dt)
     Operator_vector::iterator ci_end = _operators.end();
 
     ParticleSystem* ps = getParticleSystem();
-    for (ci=_operators.begin(); ci!=ci_end; ++ci) {
-        (*ci)->beginOperate(this);
-        (*ci)->operateParticles(ps, dt);
-        (*ci)->endOperate();
+    int numParticles = ps->numParticles();
+
+    ci = _operators.begin();
+    while (ci!=ci_end)
+    {
+        if (!(*ci)->operatesOnParticleRanges())
+        {
+            (*ci)->beginOperate(this);
+            (*ci)->operateParticles(ps, dt);
+            (*ci)->endOperate();
+            ++ci;
+            continue;
+        }
+
+        // collect the run of operators that can work on ranges of particles, stopping at an operator that
+        // is already in the run as its beginOperate() can't be called again before its endOperate().
+        Operator_vector::iterator run_end = ci;
+        while (run_end!=ci_end && (*run_end)->operatesOnParticleRanges() &&
+               std::find(ci, run_end, *run_end)==run_end)
+        {
+            ++run_end;
+        }
+
+        Operator_vector::iterator ri;
+        for (ri=ci; ri!=run_end; ++ri)
+        {
+            (*ri)->beginOperate(this);
+        }
+
+        // apply all the operators in the run to one block of particles while it is still in cache,
+        // rather than making a pass over all the particles per operator.
+        for (int begin=0; begin<numParticles; begin+=PARTICLE_BLOCK_SIZE)
+        {
+            int end = osg::minimum(begin+PARTICLE_BLOCK_SIZE, numParticles);
+            for (ri=ci; ri!=run_end; ++ri)
+            {
+                if ((*ri)->isEnabled()) (*ri)->operateParticleRange(ps, begin, end, dt);
+            }
+        }
+
+        for (ri=ci; ri!=run_end; ++ri)
+        {
+            (*ri)->endOperate();
+        }
+
+        ci = run_end;
     }
 }
@@ -42,6 +42,7 @@
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 
+#include <osgUtil/GeometryBuilder>
 #include <osgUtil/MeshOptimizers>
 #include <osgUtil/SmoothingVisitor>
 #include <osgUtil/Tessellator>
@@ -450,320 +451,83 @@ void ReaderWriterOBJ::buildMaterialToStateSetMap(obj::Model& model, MaterialToSt
 
 osg::Geometry* ReaderWriterOBJ::convertElementListToGeometry(obj::Model& model, obj::Model::ElementList& elementList, ObjOptionsStruct& localOptions) const
 {
+    if (elementList.empty()) return 0;
 
-    unsigned int numVertexIndices = 0;
-    unsigned int numNormalIndices = 0;
-    unsigned int numTexCoordIndices = 0;
+    // all the elements of a list share their CoordinateCombination, so either all or none of them have normals and texcoords.
+    bool hasNormals = elementList.normalIndices.size()==elementList.vertexIndices.size();
+    bool hasTexCoords = elementList.texCoordIndices.size()==elementList.vertexIndices.size();
+    bool hasColors = !model.colors.empty();
+    bool facetNormals = !hasNormals && localOptions.generateFacetNormals;
 
-    unsigned int numPointElements = 0;
-    unsigned int numPolylineElements = 0;
-    unsigned int numPolygonElements = 0;
+    unsigned int attributes = 0;
+    if (hasNormals || facetNormals) attributes |= osgUtil::GeometryBuilder::NORMALS;
+    if (hasTexCoords) attributes |= osgUtil::GeometryBuilder::TEXCOORDS;
+    if (hasColors) attributes |= osgUtil::GeometryBuilder::COLORS;
 
-    obj::Model::ElementList::iterator itr;
+    // identical face corners are shared, so the geometry comes out indexed without the need for osgUtil::IndexMeshVisitor.
+    osg::ref_ptr<osgUtil::GeometryBuilder> builder = new osgUtil::GeometryBuilder(attributes);
+    builder->setTriangulateLargePolygons(false);
 
-    if (localOptions.generateFacetNormals == true) {
-        for(itr=elementList.begin();
-                itr!=elementList.end();
-                    ++itr)
-        {
-            obj::Element& element = *(*itr);
-            if (element.dataType==obj::Element::POINTS || element.dataType==obj::Element::POLYLINE)
-                continue;
-
-            if (element.normalIndices.size() == 0) {
-                // fill in the normals
-                int a = element.vertexIndices[0];
-                int b = element.vertexIndices[1];
-                int c = element.vertexIndices[2];
-
-                osg::Vec3f ab(model.vertices[b]);
-                osg::Vec3f ac(model.vertices[c]);
-
-                ab -= model.vertices[a];
-                ac -= model.vertices[a];
-
-                osg::Vec3f Norm( ab ^ ac );
-                Norm.normalize();
-                int normal_idx = model.normals.size();
-                model.normals.push_back(Norm);
-
-                for (unsigned i=0 ; i < element.vertexIndices.size() ; i++)
-                    element.normalIndices.push_back(normal_idx);
-            }
-        }
-    }
-
-
-
-    for(itr=elementList.begin();
-        itr!=elementList.end();
-        ++itr)
-    {
-        obj::Element& element = *(*itr);
-
-        numVertexIndices += element.vertexIndices.size();
-        numNormalIndices += element.normalIndices.size();
-        numTexCoordIndices += element.texCoordIndices.size();
-
-        numPointElements += (element.dataType==obj::Element::POINTS) ? 1 : 0;
-        numPolylineElements += (element.dataType==obj::Element::POLYLINE) ? 1 : 0;
-        numPolygonElements += (element.dataType==obj::Element::POLYGON) ? 1 : 0;
-
-    }
-
-    if (numVertexIndices==0) return 0;
-
-    if (numNormalIndices!=0 && numNormalIndices!=numVertexIndices)
-    {
-        OSG_NOTICE<<"Incorrect number of normals, ignore them"<<std::endl;
-        numNormalIndices = 0;
-    }
-
-    if (numTexCoordIndices!=0 && numTexCoordIndices!=numVertexIndices)
-    {
-        OSG_NOTICE<<"Incorrect number of normals, ignore them"<<std::endl;
-        numTexCoordIndices = 0;
-    }
-
-    osg::Vec3Array* vertices = numVertexIndices ? new osg::Vec3Array : 0;
-    osg::Vec3Array* normals = numNormalIndices ? new osg::Vec3Array : 0;
-    osg::Vec2Array* texcoords = numTexCoordIndices ? new osg::Vec2Array : 0;
-    osg::Vec4Array* colors = (!model.colors.empty()) ? new osg::Vec4Array : 0;
-
-    if (vertices) vertices->reserve(numVertexIndices);
-    if (normals) normals->reserve(numNormalIndices);
-    if (texcoords) texcoords->reserve(numTexCoordIndices);
-    if (colors) colors->reserve(numVertexIndices);
-
-
-    osg::Geometry* geometry = new osg::Geometry;
-    if (vertices) geometry->setVertexArray(vertices);
-    if (normals)
-    {
-        geometry->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
-    }
-
-    if (texcoords)
-    {
-        geometry->setTexCoordArray(0,texcoords);
-    }
+    bool hasReversedFaces = false;
 
-    if (colors)
+    obj::Element element;
+    std::vector<unsigned int> indices;
+    for(unsigned int e=0; e<elementList.size(); ++e)
     {
-        geometry->setColorArray(colors, osg::Array::BIND_PER_VERTEX);
-    }
+        elementList.getElement(e, element);
 
-    if (numPointElements>0)
-    {
-        unsigned int startPos = vertices->size();
-        unsigned int numPoints = 0;
-        for(itr=elementList.begin();
-            itr!=elementList.end();
-            ++itr)
+        osg::Vec3 facetNormal;
+        if (facetNormals && element.dataType==obj::Element::POLYGON && element.vertexIndices.size()>=3)
         {
-            obj::Element& element = *(*itr);
-            if (element.dataType==obj::Element::POINTS)
-            {
-                for(obj::Element::IndexList::iterator index_itr = element.vertexIndices.begin();
-                    index_itr != element.vertexIndices.end();
-                    ++index_itr)
-                {
-                    // if use color extension ( not standard but used by meshlab)
-                    if (colors)
-                    {
-                        colors->push_back(model.colors[*index_itr]);
-                    }
-                    vertices->push_back(transformVertex(model.vertices[*index_itr],localOptions.rotate));
-                    ++numPoints;
-                }
-                if (numNormalIndices)
-                {
-                    for(obj::Element::IndexList::iterator index_itr = element.normalIndices.begin();
-                        index_itr != element.normalIndices.end();
-                        ++index_itr)
-                    {
-                        normals->push_back(transformNormal(model.normals[*index_itr],localOptions.rotate));
-                    }
-                }
-                if (numTexCoordIndices)
-                {
-                    for(obj::Element::IndexList::iterator index_itr = element.texCoordIndices.begin();
-                        index_itr != element.texCoordIndices.end();
-                        ++index_itr)
-                    {
-                        texcoords->push_back(model.texcoords[*index_itr]);
-                    }
-                }
-            }
+            osg::Vec3 a = model.vertices[element.vertexIndices[0]];
+            osg::Vec3 ab = model.vertices[element.vertexIndices[1]] - a;
+            osg::Vec3 ac = model.vertices[element.vertexIndices[2]] - a;
+            facetNormal = ab ^ ac;
+            facetNormal.normalize();
+            facetNormal = transformNormal(facetNormal, localOptions.rotate);
         }
 
-        osg::DrawArrays* drawArrays = new osg::DrawArrays(GL_POINTS,startPos,numPoints);
-        geometry->addPrimitiveSet(drawArrays);
-    }
-
-    if (numPolylineElements>0)
-    {
-        unsigned int startPos = vertices->size();
-        osg::DrawArrayLengths* drawArrayLengths = new osg::DrawArrayLengths(GL_LINES,startPos);
+        // OSG assumes anticlockwise ordering, so add faces whose winding disagrees with their normals in reverse order.
+        bool reverse = element.dataType==obj::Element::POLYGON && !localOptions.noReverseFaces && model.needReverse(element);
+        if (reverse) hasReversedFaces = true;
 
-        for(itr=elementList.begin();
-            itr!=elementList.end();
-            ++itr)
+        unsigned int numCorners = element.vertexIndices.size();
+        indices.clear();
+        for(unsigned int c=0; c<numCorners; ++c)
         {
-            obj::Element& element = *(*itr);
-            if (element.dataType==obj::Element::POLYLINE)
-            {
-                drawArrayLengths->push_back(element.vertexIndices.size());
-
-                for(obj::Element::IndexList::iterator index_itr = element.vertexIndices.begin();
-                    index_itr != element.vertexIndices.end();
-                    ++index_itr)
-                {
-                    // if use color extension ( not standard but used by meshlab)
-                    if (colors)
-                    {
-                        colors->push_back(model.colors[*index_itr]);
-                    }
+            unsigned int i = reverse ? numCorners-1-c : c;
+            int vi = element.vertexIndices[i];
 
-                    vertices->push_back(transformVertex(model.vertices[*index_itr],localOptions.rotate));
-                }
-                if (numNormalIndices)
-                {
-                    for(obj::Element::IndexList::iterator index_itr = element.normalIndices.begin();
-                        index_itr != element.normalIndices.end();
-                        ++index_itr)
-                    {
-                        normals->push_back(transformNormal(model.normals[*index_itr],localOptions.rotate));
-                    }
-                }
-                if (numTexCoordIndices)
-                {
-                    for(obj::Element::IndexList::iterator index_itr = element.texCoordIndices.begin();
-                        index_itr != element.texCoordIndices.end();
-                        ++index_itr)
-                    {
-                        texcoords->push_back(model.texcoords[*index_itr]);
-                    }
-                }
-            }
-        }
+            osg::Vec3 normal = facetNormal;
+            if (hasNormals) normal = transformNormal(model.normals[element.normalIndices[i]], localOptions.rotate);
 
-        geometry->addPrimitiveSet(drawArrayLengths);
+            osg::Vec2 texcoord;
+            if (hasTexCoords) texcoord = model.texcoords[element.texCoordIndices[i]];
 
-    }
+            // if use color extension ( not standard but used by meshlab)
+            osg::Vec4 color(1.0f,1.0f,1.0f,1.0f);
+            if (hasColors) color = model.colors[vi];
 
-    // #define USE_DRAWARRAYLENGTHS
-    bool hasReversedFaces = false ;
-    if (numPolygonElements>0)
-    {
-        unsigned int startPos = vertices->size();
-
-        #ifdef USE_DRAWARRAYLENGTHS
-            osg::DrawArrayLengths* drawArrayLengths = new osg::DrawArrayLengths(GL_POLYGON,startPos);
-            geometry->addPrimitiveSet(drawArrayLengths);
-        #endif
+            indices.push_back(builder->addVertex(transformVertex(model.vertices[vi], localOptions.rotate), normal, texcoord, color));
+        }
 
-        for(itr=elementList.begin();
-            itr!=elementList.end();
-            ++itr)
+        switch(element.dataType)
         {
-            obj::Element& element = *(*itr);
-            if (element.dataType==obj::Element::POLYGON)
-            {
-                #ifdef USE_DRAWARRAYLENGTHS
-                    drawArrayLengths->push_back(element.vertexIndices.size());
-                #else
-                    if (element.vertexIndices.size()>4)
-                    {
-                        osg::DrawArrays* drawArrays = new osg::DrawArrays(GL_POLYGON,startPos,element.vertexIndices.size());
-                        startPos += element.vertexIndices.size();
-                        geometry->addPrimitiveSet(drawArrays);
-                    }
-                    else
-                    {
-                        osg::DrawArrays* drawArrays = new osg::DrawArrays(GL_TRIANGLE_FAN,startPos,element.vertexIndices.size());
-                        startPos += element.vertexIndices.size();
-                        geometry->addPrimitiveSet(drawArrays);
-                    }
-                #endif
-
-
-                if (model.needReverse(element) && !localOptions.noReverseFaces)
-                {
-                    hasReversedFaces = true;
-                    // need to reverse so add to OSG arrays in same order as in OBJ, as OSG assume anticlockwise ordering.
-                    for(obj::Element::IndexList::reverse_iterator index_itr = element.vertexIndices.rbegin();
-                        index_itr != element.vertexIndices.rend();
-                        ++index_itr)
-                    {
-                        // if use color extension ( not standard but used by meshlab)
-                        if (colors)
-                        {
-                            colors->push_back(model.colors[*index_itr]);
-                        }
-
-                        vertices->push_back(transformVertex(model.vertices[*index_itr],localOptions.rotate));
-                    }
-                    if (numNormalIndices)
-                    {
-                        for(obj::Element::IndexList::reverse_iterator index_itr = element.normalIndices.rbegin();
-                            index_itr != element.normalIndices.rend();
-                            ++index_itr)
-                        {
-                            normals->push_back(transformNormal(model.normals[*index_itr],localOptions.rotate));
-                        }
-                    }
-
-
-                    if (numTexCoordIndices)
-                    {
-                        for(obj::Element::IndexList::reverse_iterator index_itr = element.texCoordIndices.rbegin();
-                            index_itr != element.texCoordIndices.rend();
-                            ++index_itr)
-                        {
-                            texcoords->push_back(model.texcoords[*index_itr]);
-                        }
-                    }
-                }
-                else
-                {
-                    // no need to reverse so add to OSG arrays in same order as in OBJ.
-                    for(obj::Element::IndexList::iterator index_itr = element.vertexIndices.begin();
-                        index_itr != element.vertexIndices.end();
-                        ++index_itr)
-                    {
-                        // if use color extension ( not standard but used by meshlab)
-                        if (colors)
-                        {
-                            colors->push_back(model.colors[*index_itr]);
-                        }
-
-                        vertices->push_back(transformVertex(model.vertices[*index_itr],localOptions.rotate));
-                    }
-                    if (numNormalIndices)
-                    {
-                        for(obj::Element::IndexList::iterator index_itr = element.normalIndices.begin();
-                            index_itr != element.normalIndices.end();
-                            ++index_itr)
-                        {
-                            normals->push_back(transformNormal(model.normals[*index_itr],localOptions.rotate));
-                        }
-                    }
-                    if (numTexCoordIndices)
-                    {
-                        for(obj::Element::IndexList::iterator index_itr = element.texCoordIndices.begin();
-                            index_itr != element.texCoordIndices.end();
-                            ++index_itr)
-                        {
-                            texcoords->push_back(model.texcoords[*index_itr]);
-                        }
-                    }
-                }
-            }
+            case(obj::Element::POINTS):
+                for(unsigned int c=0; c<numCorners; ++c) builder->addPoint(indices[c]);
+                break;
+            case(obj::Element::POLYLINE):
+                for(unsigned int c=1; c<numCorners; ++c) builder->addLine(indices[c-1], indices[c]);
+                break;
+            case(obj::Element::POLYGON):
+                builder->addPolygon(&indices.front(), numCorners);
+                break;
         }
     }
 
-    if(hasReversedFaces)
+    osg::Geometry* geometry = builder->buildGeometry(0);
+
+    if(geometry && hasReversedFaces)
     {
         OSG_WARN << "Warning: [ReaderWriterOBJ::convertElementListToGeometry] Some faces from geometry '" << geometry->getName() << "' were reversed by the plugin" << std::endl;
     }
@@ -771,6 +535,18 @@ osg::Geometry* ReaderWriterOBJ::convertElementListToGeometry(obj::Model& model,
     return geometry;
 }
 
+// true if the geometry has only the indexed triangles, lines and points of a GeometryBuilder, without large polygons or the
+// DrawArrays that the Tessellator replaces them with.
+static bool isIndexedMesh(const osg::Geometry& geometry)
+{
+    for(unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+    {
+        const osg::PrimitiveSet* primitiveSet = geometry.getPrimitiveSet(i);
+        if (!primitiveSet->getDrawElements() || primitiveSet->getMode()==GL_POLYGON) return false;
+    }
+    return true;
+}
+
 osg::Node* ReaderWriterOBJ::convertModelToSceneGraph(obj::Model& model, ObjOptionsStruct& localOptions, const Options* options) const
 {
 
@@ -811,10 +587,21 @@ osg::Node* ReaderWriterOBJ::convertModelToSceneGraph(obj::Model& model, ObjOptio
                 tessellator.retessellatePolygons(*geometry);
             }
 
-            // tri strip polygons to improve graphics performance
+            // reorder the triangles and vertices to improve graphics performance
             if (!localOptions.noTriStripPolygons)
             {
-                osgUtil::optimizeMesh(geometry);
+                if (isIndexedMesh(*geometry))
+                {
+                    // the builder has indexed the geometry, so only the vertex cache optimizations of osgUtil::optimizeMesh() are needed.
+                    osgUtil::VertexCacheVisitor vcv;
+                    vcv.optimizeVertices(*geometry);
+                    osgUtil::VertexAccessOrderVisitor vaov;
+                    vaov.optimizeOrder(*geometry);
+                }
+                else
+                {
+                    osgUtil::optimizeMesh(geometry);
+                }
             }
 
             // if no normals present add them.
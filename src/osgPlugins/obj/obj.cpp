@@ -572,6 +572,9 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
     float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
     float r,g,b,a;
 
+    // reused for every face so that reading doesn't allocate per element.
+    Element element;
+
     while (fin)
     {
         readline(fin,line,LINE_SIZE);
@@ -654,9 +657,10 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
             {
                 char* ptr = line+2;
 
-                Element* element = new Element( (line[0]=='p') ? Element::POINTS :
-                                                (line[0]=='l') ? Element::POLYLINE :
-                                                Element::POLYGON );
+                element.clear();
+                element.dataType = (line[0]=='p') ? Element::POINTS :
+                                   (line[0]=='l') ? Element::POLYLINE :
+                                   Element::POLYGON;
 
                 // OSG_NOTICE<<"face"<<ptr<<std::endl;
 
@@ -669,28 +673,28 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
                     if (sscanf(ptr, "%d/%d/%d", &vi, &ti, &ni) == 3)
                     {
                         // OSG_NOTICE<<"   vi="<<vi<<"/ti="<<ti<<"/ni="<<ni<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
-                        element->normalIndices.push_back(remapNormalIndex(ni));
-                        element->texCoordIndices.push_back(remapTexCoordIndex(ti));
+                        element.vertexIndices.push_back(remapVertexIndex(vi));
+                        element.normalIndices.push_back(remapNormalIndex(ni));
+                        element.texCoordIndices.push_back(remapTexCoordIndex(ti));
                     }
                     else if (sscanf(ptr, "%d//%d", &vi, &ni) == 2)
                     {
                         // OSG_NOTICE<<"   vi="<<vi<<"//ni="<<ni<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
+                        element.vertexIndices.push_back(remapVertexIndex(vi));
                         if (remapNormalIndex(ni) < static_cast<int>(normals.size()))
-                            element->normalIndices.push_back(remapNormalIndex(ni));
+                            element.normalIndices.push_back(remapNormalIndex(ni));
                     }
                     else if (sscanf(ptr, "%d/%d", &vi, &ti) == 2)
                     {
                         // OSG_NOTICE<<"   vi="<<vi<<"/ti="<<ti<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
+                        element.vertexIndices.push_back(remapVertexIndex(vi));
                         if (remapTexCoordIndex(ti) < static_cast<int>(texcoords.size()))
-                            element->texCoordIndices.push_back(remapTexCoordIndex(ti));
+                            element.texCoordIndices.push_back(remapTexCoordIndex(ti));
                     }
                     else if (sscanf(ptr, "%d", &vi) == 1)
                     {
                         // OSG_NOTICE<<"   vi="<<vi<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
+                        element.vertexIndices.push_back(remapVertexIndex(vi));
                     }
 
                     // skip to white space or end of line
@@ -698,19 +702,19 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
 
                 }
 
-                if (!element->normalIndices.empty() && element->normalIndices.size() != element->vertexIndices.size())
+                if (!element.normalIndices.empty() && element.normalIndices.size() != element.vertexIndices.size())
                 {
-                    element->normalIndices.clear();
+                    element.normalIndices.clear();
                 }
 
-                if (!element->texCoordIndices.empty() && element->texCoordIndices.size() != element->vertexIndices.size())
+                if (!element.texCoordIndices.empty() && element.texCoordIndices.size() != element.vertexIndices.size())
                 {
-                    element->texCoordIndices.clear();
+                    element.texCoordIndices.clear();
                 }
 
-                if (!element->vertexIndices.empty())
+                if (!element.vertexIndices.empty())
                 {
-                    Element::CoordinateCombination coordateCombination = element->getCoordinateCombination();
+                    Element::CoordinateCombination coordateCombination = element.getCoordinateCombination();
                     if (coordateCombination!=currentElementState.coordinateCombination)
                     {
                         currentElementState.coordinateCombination = coordateCombination;
@@ -718,11 +722,6 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
                     }
                     addElement(element);
                 }
-                else
-                {
-                    // empty element, don't both adding, just unref to delete it.
-                    element->unref();
-                }
 
             }
             else if (strncmp(line,"usemtl ",7)==0)
@@ -846,7 +845,7 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
 }
 
 
-void Model::addElement(Element* element)
+void Model::addElement(const Element& element)
 {
     if (!currentElementList)
     {
@@ -856,6 +855,35 @@ void Model::addElement(Element* element)
 
 }
 
+void ElementList::push_back(const Element& element)
+{
+    if (firstIndices.empty()) firstIndices.push_back(0);
+
+    dataTypes.push_back(element.dataType);
+    vertexIndices.insert(vertexIndices.end(), element.vertexIndices.begin(), element.vertexIndices.end());
+    normalIndices.insert(normalIndices.end(), element.normalIndices.begin(), element.normalIndices.end());
+    texCoordIndices.insert(texCoordIndices.end(), element.texCoordIndices.begin(), element.texCoordIndices.end());
+    firstIndices.push_back(static_cast<unsigned int>(vertexIndices.size()));
+}
+
+void ElementList::getElement(unsigned int i, Element& element) const
+{
+    unsigned int first = firstIndices[i];
+    unsigned int last = firstIndices[i+1];
+
+    element.dataType = dataTypes[i];
+    element.vertexIndices.assign(vertexIndices.begin()+first, vertexIndices.begin()+last);
+
+    // the elements of a list share their CoordinateCombination, so either all or none of them have normals and texcoords.
+    if (normalIndices.size()==vertexIndices.size()) element.normalIndices.assign(normalIndices.begin()+first, normalIndices.begin()+last);
+    else element.normalIndices.clear();
+
+    if (texCoordIndices.size()==vertexIndices.size()) element.texCoordIndices.assign(texCoordIndices.begin()+first, texCoordIndices.begin()+last);
+    else element.texCoordIndices.clear();
+
+    element.colorsIndices.clear();
+}
+
 osg::Vec3 Model::averageNormal(const Element& element) const
 {
     osg::Vec3 normal;
@@ -113,7 +113,7 @@ public:
 protected:
 };
 
-class Element : public osg::Referenced
+class Element
 {
 public:
 
@@ -126,9 +126,17 @@ public:
         POLYGON
     };
 
-    Element(DataType type):
+    Element(DataType type=POLYGON):
         dataType(type) {}
 
+    void clear()
+    {
+        vertexIndices.clear();
+        normalIndices.clear();
+        texCoordIndices.clear();
+        colorsIndices.clear();
+    }
+
     enum CoordinateCombination
     {
         VERTICES,
@@ -152,6 +160,32 @@ public:
     IndexList colorsIndices;
 };
 
+/** The elements of an ElementState, with the indices of all its elements appended to shared lists
+  * rather than each element being allocated on its own.*/
+class ElementList
+{
+public:
+
+    ElementList() {}
+
+    void push_back(const Element& element);
+
+    unsigned int size() const { return static_cast<unsigned int>(dataTypes.size()); }
+    bool empty() const { return dataTypes.empty(); }
+
+    /** Copy the indices of element i into element, reusing its IndexList storage.*/
+    void getElement(unsigned int i, Element& element) const;
+
+    typedef std::vector<Element::DataType>  DataTypeList;
+    typedef std::vector<unsigned int>       PositionList;
+
+    DataTypeList        dataTypes;
+    PositionList        firstIndices;
+    Element::IndexList  vertexIndices;
+    Element::IndexList  normalIndices;
+    Element::IndexList  texCoordIndices;
+};
+
 class ElementState
 {
 public:
@@ -199,7 +233,7 @@ public:
     bool readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options);
 
     bool readline(std::istream& fin, char* line, const int LINE_SIZE);
-    void addElement(Element* element);
+    void addElement(const Element& element);
 
     osg::Vec3 averageNormal(const Element& element) const;
     osg::Vec3 computeNormal(const Element& element) const;
@@ -213,7 +247,7 @@ public:
     typedef std::vector< osg::Vec2 >                Vec2Array;
     typedef std::vector< osg::Vec3 >                Vec3Array;
     typedef std::vector< osg::Vec4 >                Vec4Array;
-    typedef std::vector< osg::ref_ptr<Element> >    ElementList;
+    typedef obj::ElementList                        ElementList;
     typedef std::map< ElementState,ElementList >    ElementStateMap;
 
 
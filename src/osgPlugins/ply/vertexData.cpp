@@ -32,15 +32,6 @@ using namespace ply;
 VertexData::VertexData()
     : _invertFaces( false )
 {
-    // Initialize the members
-    _vertices = NULL;
-    _colors = NULL;
-    _normals = NULL;
-    _triangles = NULL;
-    _diffuse = NULL;
-    _ambient = NULL;
-    _specular = NULL;
-    _texcoord = NULL;
 }
 
 
@@ -134,80 +125,76 @@ void VertexData::readVertices( PlyFile* file, const int nVertices,
         for (int i = 21; i < 23; ++i)
             ply_get_property(file, "vertex", &vertexProps[i]);
 
-    // check whether array is valid otherwise allocate the space
-    if(!_vertices.valid())
-        _vertices = new osg::Vec3Array;
-
+    // Apply the colours to the model; at the moment this is a
+    // kludge because we only use one kind and apply them all the
+    // same way. Also, the priority order is completely arbitrary
+    int colorField = NONE;
+    if( fields & RGB || fields & RGBA )
+        colorField = RGB;
+    else if( fields & AMBIENT )
+        colorField = AMBIENT;
+    else if( fields & DIFFUSE )
+        colorField = DIFFUSE;
+    else if( fields & SPECULAR )
+        colorField = SPECULAR;
+
+    unsigned int attributes = 0;
     if( fields & NORMALS )
-    {
-        if(!_normals.valid())
-            _normals = new osg::Vec3Array;
-    }
-
-    // If read colors allocate space for color array
-    if( fields & RGB || fields & RGBA)
-    {
-        if(!_colors.valid())
-            _colors = new osg::Vec4Array;
-    }
-
-    if( fields & AMBIENT )
-    {
-        if(!_ambient.valid())
-            _ambient = new osg::Vec4Array;
-    }
-
-    if( fields & DIFFUSE )
-    {
-        if(!_diffuse.valid())
-            _diffuse = new osg::Vec4Array;
-    }
+        attributes |= osgUtil::GeometryBuilder::NORMALS;
+    if( colorField != NONE )
+        attributes |= osgUtil::GeometryBuilder::COLORS;
+    else if( fields & TEXCOORD )
+        attributes |= osgUtil::GeometryBuilder::TEXCOORDS;
 
-    if( fields & SPECULAR )
-    {
-        if(!_specular.valid())
-            _specular = new osg::Vec4Array;
-    }
-    if (fields & TEXCOORD)
-    {
-        if (!_texcoord.valid())
-            _texcoord = new osg::Vec2Array;
-    }
+    // the faces index the vertices in the order they are read, so mustn't be deduplicated
+    if(!_builder.valid())
+        _builder = new osgUtil::GeometryBuilder(attributes, false);
 
     // read in the vertices
+    osg::Vec3 normal;
+    osg::Vec2 texcoord;
+    osg::Vec4 color(1.0f, 1.0f, 1.0f, 1.0f);
     for( int i = 0; i < nVertices; ++i )
     {
         ply_get_element( file, static_cast< void* >( &vertex ) );
-        _vertices->push_back( osg::Vec3( vertex.x, vertex.y, vertex.z ) );
         if (fields & NORMALS)
-            _normals->push_back( osg::Vec3( vertex.nx, vertex.ny, vertex.nz ) );
-
-        if( fields & RGBA )
-            _colors->push_back( osg::Vec4( (unsigned int) vertex.red / 255.0,
-                                           (unsigned int) vertex.green / 255.0 ,
-                                           (unsigned int) vertex.blue / 255.0,
-                                           (unsigned int) vertex.alpha / 255.0) );
-        else if( fields & RGB )
-            _colors->push_back( osg::Vec4( (unsigned int) vertex.red / 255.0,
-                                           (unsigned int) vertex.green / 255.0 ,
-                                           (unsigned int) vertex.blue / 255.0, 1.0 ) );
-        if( fields & AMBIENT )
-            _ambient->push_back( osg::Vec4( (unsigned int) vertex.ambient_red / 255.0,
-                                            (unsigned int) vertex.ambient_green / 255.0 ,
-                                            (unsigned int) vertex.ambient_blue / 255.0, 1.0 ) );
-
-        if( fields & DIFFUSE )
-            _diffuse->push_back( osg::Vec4( (unsigned int) vertex.diffuse_red / 255.0,
-                                            (unsigned int) vertex.diffuse_green / 255.0 ,
-                                            (unsigned int) vertex.diffuse_blue / 255.0, 1.0 ) );
-
-        if( fields & SPECULAR )
-            _specular->push_back( osg::Vec4( (unsigned int) vertex.specular_red / 255.0,
-                                             (unsigned int) vertex.specular_green / 255.0 ,
-                                             (unsigned int) vertex.specular_blue / 255.0, 1.0 ) );
+            normal.set( vertex.nx, vertex.ny, vertex.nz );
+
+        if( colorField == RGB )
+        {
+            if( fields & RGBA )
+                color.set( (unsigned int) vertex.red / 255.0,
+                           (unsigned int) vertex.green / 255.0 ,
+                           (unsigned int) vertex.blue / 255.0,
+                           (unsigned int) vertex.alpha / 255.0 );
+            else
+                color.set( (unsigned int) vertex.red / 255.0,
+                           (unsigned int) vertex.green / 255.0 ,
+                           (unsigned int) vertex.blue / 255.0, 1.0 );
+        }
+        else if( colorField == AMBIENT )
+            color.set( (unsigned int) vertex.ambient_red / 255.0,
+                       (unsigned int) vertex.ambient_green / 255.0 ,
+                       (unsigned int) vertex.ambient_blue / 255.0, 1.0 );
+        else if( colorField == DIFFUSE )
+            color.set( (unsigned int) vertex.diffuse_red / 255.0,
+                       (unsigned int) vertex.diffuse_green / 255.0 ,
+                       (unsigned int) vertex.diffuse_blue / 255.0, 1.0 );
+        else if( colorField == SPECULAR )
+            color.set( (unsigned int) vertex.specular_red / 255.0,
+                       (unsigned int) vertex.specular_green / 255.0 ,
+                       (unsigned int) vertex.specular_blue / 255.0, 1.0 );
+
         if (fields & TEXCOORD)
-            _texcoord->push_back(osg::Vec2(vertex.texture_u,vertex.texture_v));
+            texcoord.set(vertex.texture_u,vertex.texture_v);
+
+        _builder->addVertex( osg::Vec3( vertex.x, vertex.y, vertex.z ), normal, texcoord, color );
     }
+
+    // add the faces that were read before the vertices they index
+    for( std::vector< std::vector<unsigned int> >::const_iterator itr = _deferredFaces.begin(); itr != _deferredFaces.end(); ++itr )
+        addFace( *itr );
+    _deferredFaces.clear();
 }
 
 
@@ -229,15 +216,11 @@ void VertexData::readTriangles( PlyFile* file, const int nFaces )
 
     ply_get_property( file, "face", &faceProps[0] );
 
-    if(!_triangles.valid())
-        _triangles = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES);
-
-    if(!_quads.valid())
-        _quads = new osg::DrawElementsUInt(osg::PrimitiveSet::QUADS);
+    // the builder is created with the attributes of the vertex element, so faces preceding it are deferred until it has been read
+    bool deferFaces = !_builder.valid();
 
-
-    const char NUM_VERTICES_TRIANGLE(3);
-    const char NUM_VERTICES_QUAD(4);
+    std::vector<unsigned int> indices;
+    unsigned int numFaces = 0;
 
     // read the faces, reversing the reading direction if _invertFaces is true
     for( int i = 0 ; i < nFaces; i++ )
@@ -249,22 +232,40 @@ void VertexData::readTriangles( PlyFile* file, const int nFaces )
         ply_get_element( file, static_cast< void* >( &face ) );
         if (face.vertices)
         {
-            if (face.nVertices == NUM_VERTICES_TRIANGLE ||  face.nVertices == NUM_VERTICES_QUAD)
-            {
-                unsigned short index;
-                for(int j = 0 ; j < face.nVertices ; j++)
-                {
-                    index = ( _invertFaces ? face.nVertices - 1 - j : j );
-                    if(face.nVertices == 4)
-                        _quads->push_back(face.vertices[index]);
-                    else
-                        _triangles->push_back(face.vertices[index]);
-                }
-            }
+            indices.clear();
+            for(int j = 0 ; j < face.nVertices ; j++)
+                indices.push_back( static_cast<unsigned int>( face.vertices[ _invertFaces ? face.nVertices - 1 - j : j ] ) );
+
+            if (deferFaces)
+                _deferredFaces.push_back(indices);
+            else
+                addFace(indices);
+
+            ++numFaces;
+
             // free the memory that was allocated by ply_get_element
             free( face.vertices );
         }
     }
+
+    // Check whether all face elements were read or not
+    MESHASSERT( numFaces == static_cast< unsigned int >( nFaces ) );
+}
+
+
+/*  Add a face, skipping it if it is degenerate or indexes vertices that don't exist.  */
+void VertexData::addFace( const std::vector<unsigned int>& indices )
+{
+    if (indices.size() < 3) return;
+
+    // negative indices wrap around to values beyond the number of vertices
+    for(std::vector<unsigned int>::const_iterator itr = indices.begin(); itr != indices.end(); ++itr)
+    {
+        if (*itr >= _builder->getNumVertices()) return;
+    }
+
+    // faces of more than three vertices are added as fans of triangles
+    _builder->addPolygon(&indices.front(), indices.size());
 }
 
 
@@ -394,33 +395,7 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
                 // Read vertices and store in a std::vector array
                 readVertices( file, nElems, fields );
                 // Check whether all vertices are loaded or not
-                MESHASSERT( _vertices->size() == static_cast< size_t >( nElems ) );
-
-                // Check if all the optional elements were read or not
-                if( fields & NORMALS )
-                {
-                    MESHASSERT( _normals->size() == static_cast< size_t >( nElems ) );
-                }
-                if( fields & RGB || fields & RGBA)
-                {
-                    MESHASSERT( _colors->size() == static_cast< size_t >( nElems ) );
-                }
-                if( fields & AMBIENT )
-                {
-                    MESHASSERT( _ambient->size() == static_cast< size_t >( nElems ) );
-                }
-                if( fields & DIFFUSE )
-                {
-                    MESHASSERT( _diffuse->size() == static_cast< size_t >( nElems ) );
-                }
-                if (fields & SPECULAR)
-                {
-                    MESHASSERT(_specular->size() == static_cast< size_t >(nElems));
-                }
-                if (fields & TEXCOORD)
-                {
-                    MESHASSERT(_texcoord->size() == static_cast< size_t >(nElems));
-                }
+                MESHASSERT( _builder->getNumVertices() == static_cast< size_t >( nElems ) );
 
                 result = true;
             }
@@ -440,13 +415,6 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
         {
             // Read Triangles
             readTriangles( file, nElems );
-            // Check whether all face elements read or not
-#if DEBUG
-            unsigned int nbTriangles = (_triangles.valid() ? _triangles->size() / 3 : 0) ;
-            unsigned int nbQuads = (_quads.valid() ? _quads->size() / 4 : 0 );
-
-            MESHASSERT( (nbTriangles + nbQuads) == static_cast< size_t >( nElems ) );
-#endif
             result = true;
         }
         catch( exception& e )
@@ -471,67 +439,24 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
         free( elemNames[i] );
     free( elemNames );
 
-   // If the result is true means the ply file is successfully read
-   if(result)
+   // If the result is true means the ply file is successfully read, though it needs a vertex element to build geometry
+   if(result && _builder.valid())
    {
-        // Create geometry node
-        osg::Geometry* geom  =  new osg::Geometry;
-
-        // set the vertex array
-        geom->setVertexArray(_vertices.get());
-
-        // Add the primitive set
-        bool hasTriOrQuads = false;
-        if (_triangles.valid() && _triangles->size() > 0 )
-        {
-            geom->addPrimitiveSet(_triangles.get());
-            hasTriOrQuads = true;
-        }
-
-        if (_quads.valid() && _quads->size() > 0 )
-        {
-            geom->addPrimitiveSet(_quads.get());
-            hasTriOrQuads = true;
-        }
-
         // Print points if the file contains unsupported primitives
-        if(!hasTriOrQuads)
-            geom->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, _vertices->size()));
-
-
-        // Apply the colours to the model; at the moment this is a
-        // kludge because we only use one kind and apply them all the
-        // same way. Also, the priority order is completely arbitrary
-
-        if(_colors.valid())
-        {
-            geom->setColorArray(_colors.get(), osg::Array::BIND_PER_VERTEX );
-        }
-        else if(_ambient.valid())
-        {
-            geom->setColorArray(_ambient.get(), osg::Array::BIND_PER_VERTEX );
-        }
-        else if(_diffuse.valid())
+        if(_builder->getNumPrimitives() == 0)
         {
-            geom->setColorArray(_diffuse.get(), osg::Array::BIND_PER_VERTEX );
-        }
-        else if(_specular.valid())
-        {
-            geom->setColorArray(_specular.get(), osg::Array::BIND_PER_VERTEX );
-        }
-        else if (_texcoord.valid())
-        {
-            geom->setTexCoordArray(0, _texcoord.get());
+            for(unsigned int i = 0; i < _builder->getNumVertices(); ++i)
+                _builder->addPoint(i);
         }
 
-        // If the model has normals, add them to the geometry
-        if(_normals.valid())
+        // Create geometry node
+        osg::ref_ptr<osg::Geometry> geom = _builder->buildGeometry(0);
+        if (!geom.valid())
+            return NULL;
+
+        // If the model doesn't have normals, use the smoothing visitor to generate them
+        if(!(_builder->getAttributes() & osgUtil::GeometryBuilder::NORMALS))
         {
-            geom->setNormalArray(_normals.get(), osg::Array::BIND_PER_VERTEX);
-        }
-        else
-        {   // If not, use the smoothing visitor to generate them
-            // (quads will be triangulated by the smoothing visitor)
             osgUtil::SmoothingVisitor::smooth((*geom), osg::PI/2);
         }
 
@@ -554,7 +479,7 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
         }
 
         osg::Geode* geode = new osg::Geode;
-        geode->addDrawable(geom);
+        geode->addDrawable(geom.get());
         return geode;
     }
 
@@ -16,6 +16,8 @@
 #include <osg/Node>
 #include <osg/PrimitiveSet>
 
+#include <osgUtil/GeometryBuilder>
+
 #include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -67,22 +69,16 @@ namespace ply
         // Reads the triangle indices from the ply file
         void readTriangles( PlyFile* file, const int nFaces );
 
+        // Adds a face to the builder if all its indices refer to vertices that have been read
+        void addFace( const std::vector<unsigned int>& indices );
+
         bool        _invertFaces;
 
-        // Vertex array in osg format
-        osg::ref_ptr<osg::Vec3Array>   _vertices;
-        // Color array in osg format
-        osg::ref_ptr<osg::Vec4Array>   _colors;
-        osg::ref_ptr<osg::Vec4Array>   _ambient;
-        osg::ref_ptr<osg::Vec4Array>   _diffuse;
-        osg::ref_ptr<osg::Vec4Array>   _specular;
-        osg::ref_ptr<osg::Vec2Array>   _texcoord;
-
-        // Normals in osg format
-        osg::ref_ptr<osg::Vec3Array> _normals;
-        // The indices of the faces in premitive set
-        osg::ref_ptr<osg::DrawElementsUInt> _triangles;
-        osg::ref_ptr<osg::DrawElementsUInt> _quads;
+        // Faces that precede the vertex element in the file, added once the vertices have been read
+        std::vector< std::vector<unsigned int> > _deferredFaces;
+
+        // Builds the geometry from the vertices, which are already indexed so aren't deduplicated, and the faces
+        osg::ref_ptr<osgUtil::GeometryBuilder> _builder;
     };
 }
 
@@ -32,6 +32,7 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 
+#include <osgUtil/GeometryBuilder>
 #include <osgUtil/MeshOptimizers>
 #include <osgUtil/SmoothingVisitor>
 #include <osg/TriangleFunctor>
@@ -128,7 +129,8 @@ private:
         ReaderObject(bool noTriStripPolygons, bool generateNormals = true):
             _noTriStripPolygons(noTriStripPolygons),
             _generateNormal(generateNormals),
-            _numFacets(0)
+            _numFacets(0),
+            _numColoredFacets(0)
         {
         }
 
@@ -145,53 +147,30 @@ private:
 
         virtual ReadResult read(FILE *fp) = 0;
 
-        osg::ref_ptr<osg::Geometry> asGeometry() const
+        osg::ref_ptr<osg::Geometry> asGeometry()
         {
-            osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+            osg::ref_ptr<osg::Geometry> geom = _builder.valid() ? _builder->buildGeometry(0) : 0;
+            if (!geom.valid()) return geom;
 
-            geom->setVertexArray(_vertex.get());
-
-            if (_normal.valid())
+            if (geom->getColorArray())
             {
-                // need to convert per triangle normals to per vertex
-                osg::ref_ptr<osg::Vec3Array> perVertexNormals = new osg::Vec3Array;
-                perVertexNormals->reserveArray(_normal->size() * 3);
-                for(osg::Vec3Array::iterator itr = _normal->begin();
-                    itr != _normal->end();
-                    ++itr)
+                // the colour extension is only used when every facet has a colour
+                if (_numColoredFacets == _numFacets)
                 {
-                    perVertexNormals->push_back(*itr);
-                    perVertexNormals->push_back(*itr);
-                    perVertexNormals->push_back(*itr);
+                    OSG_INFO << "STL file with color" << std::endl;
                 }
-
-                geom->setNormalArray(perVertexNormals.get(), osg::Array::BIND_PER_VERTEX);
-            }
-
-            if (_color.valid())
-            {
-                // need to convert per triangle colours to per vertex
-                OSG_INFO << "STL file with color" << std::endl;
-                osg::ref_ptr<osg::Vec4Array> perVertexColours = new osg::Vec4Array;
-                perVertexColours->reserveArray(_color->size() * 3);
-                for(osg::Vec4Array::iterator itr = _color->begin();
-                    itr != _color->end();
-                    ++itr)
+                else
                 {
-                    perVertexColours->push_back(*itr);
-                    perVertexColours->push_back(*itr);
-                    perVertexColours->push_back(*itr);
-                }
-
-                if(perVertexColours->size() == geom->getVertexArray()->getNumElements()) {
-                    geom->setColorArray(perVertexColours.get(), osg::Array::BIND_PER_VERTEX);
+                    geom->setColorArray(0);
                 }
             }
 
-            geom->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, 0, _numFacets * 3));
-
             if(!_noTriStripPolygons) {
-                osgUtil::optimizeMesh(geom.get());
+                // the builder has already shared the vertices of adjacent facets, so just reorder them for the vertex cache
+                osgUtil::VertexCacheVisitor vcv;
+                vcv.optimizeVertices(*geom);
+                osgUtil::VertexAccessOrderVisitor vaov;
+                vaov.optimizeOrder(*geom);
             }
 
             return geom;
@@ -211,19 +190,24 @@ private:
         bool _noTriStripPolygons;
         bool _generateNormal;
         unsigned int _numFacets;
+        unsigned int _numColoredFacets;
 
         std::string _solidName;
-        osg::ref_ptr<osg::Vec3Array> _vertex;
-        osg::ref_ptr<osg::Vec3Array> _normal;
-        osg::ref_ptr<osg::Vec4Array> _color;
+        osg::ref_ptr<osgUtil::GeometryBuilder> _builder;
+
+        void addFacet(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& normal, const osg::Vec4& color = osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f))
+        {
+            _builder->addTriangle(_builder->addVertex(v0, normal, osg::Vec2(), color),
+                                  _builder->addVertex(v1, normal, osg::Vec2(), color),
+                                  _builder->addVertex(v2, normal, osg::Vec2(), color));
+        }
 
-        void clear()
+        void clear(unsigned int attributes)
         {
             _solidName = "";
             _numFacets = 0;
-            _vertex = osg::ref_ptr<osg::Vec3Array>();
-            _normal = osg::ref_ptr<osg::Vec3Array>();
-            _color = osg::ref_ptr<osg::Vec4Array>();
+            _numColoredFacets = 0;
+            _builder = new osgUtil::GeometryBuilder(attributes);
         }
     };
 
@@ -581,18 +565,14 @@ osgDB::ReaderWriter::ReadResult ReaderWriterSTL::readNode(const std::string& fil
 ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::AsciiReaderObject::read(FILE* fp)
 {
     unsigned int vertexCount = 0;
-    unsigned int facetIndex[] = { 0, 0, 0 };
-    unsigned int vertexIndex = 0;
-    unsigned int normalIndex = 0;
+    osg::Vec3 facetVertex[3];
+    osg::Vec3 normal;
 
     const int MaxLineSize = 256;
     char buf[MaxLineSize];
     char sx[MaxLineSize], sy[MaxLineSize], sz[MaxLineSize];
 
-    if (!isEmpty())
-    {
-        clear();
-    }
+    clear(osgUtil::GeometryBuilder::NORMALS);
 
     while (fgets(buf, sizeof(buf), fp))
     {
@@ -622,18 +602,17 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::AsciiReaderObject::re
         {
             if (sscanf(bp + 6, "%s %s %s", sx, sy, sz) == 3)
             {
-                if (!_vertex.valid())
-                    _vertex = new osg::Vec3Array;
-
                 float vx = osg::asciiToFloat(sx);
                 float vy = osg::asciiToFloat(sy);
                 float vz = osg::asciiToFloat(sz);
 
-                vertexIndex = _vertex->size();
                 if (vertexCount < 3)
                 {
-                    _vertex->push_back(osg::Vec3(vx, vy, vz));
-                    facetIndex[vertexCount++] = vertexIndex;
+                    facetVertex[vertexCount++] = osg::Vec3(vx, vy, vz);
+                    if (vertexCount == 3)
+                    {
+                        addFacet(facetVertex[0], facetVertex[1], facetVertex[2], normal);
+                    }
                 }
                 else
                 {
@@ -642,12 +621,9 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::AsciiReaderObject::re
                      * that have more than three vertices per facet - add an
                      * additional triangle.
                      */
-                    _normal->push_back((*_normal)[normalIndex]);
-                    _vertex->push_back((*_vertex)[facetIndex[0]]);
-                    _vertex->push_back((*_vertex)[facetIndex[2]]);
-                    _vertex->push_back(osg::Vec3(vx, vy, vz));
-                    facetIndex[1] = facetIndex[2];
-                    facetIndex[2] = vertexIndex;
+                    facetVertex[1] = facetVertex[2];
+                    facetVertex[2] = osg::Vec3(vx, vy, vz);
+                    addFacet(facetVertex[0], facetVertex[1], facetVertex[2], normal);
                     _numFacets++;
                 }
             }
@@ -660,15 +636,9 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::AsciiReaderObject::re
                 float ny = osg::asciiToFloat(sy);
                 float nz = osg::asciiToFloat(sz);
 
-                if (!_normal.valid())
-                    _normal = new osg::Vec3Array;
-
-                osg::Vec3 normal(nx, ny, nz);
+                normal.set(nx, ny, nz);
                 normal.normalize();
 
-                normalIndex = _normal->size();
-                _normal->push_back(normal);
-
                 _numFacets++;
                 vertexCount = 0;
             }
@@ -690,10 +660,7 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::AsciiReaderObject::re
 
 ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::BinaryReaderObject::read(FILE* fp)
 {
-    if (isEmpty())
-    {
-        clear();
-    }
+    clear(osgUtil::GeometryBuilder::NORMALS | osgUtil::GeometryBuilder::COLORS);
 
     _numFacets = _expectNumFacets;
 
@@ -707,80 +674,86 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::BinaryReaderObject::r
         return ReadError;
     }
 
+    // read the facets a block at a time rather than with a call to fread each
+    const unsigned int maxFacetsPerBlock = 1024;
+    std::vector<unsigned char> block(maxFacetsPerBlock * sizeof_StlFacet);
+
     StlFacet facet;
-    for (unsigned int i = 0; i < _expectNumFacets; ++i)
+    for (unsigned int blockStart = 0; blockStart < _expectNumFacets; blockStart += maxFacetsPerBlock)
     {
-        if (::fread((void*) &facet, sizeof_StlFacet, 1, fp) != 1)
+        unsigned int numFacetsInBlock = osg::minimum(maxFacetsPerBlock, _expectNumFacets - blockStart);
+        size_t numFacetsRead = ::fread((void*) &block.front(), sizeof_StlFacet, numFacetsInBlock, fp);
+        if (numFacetsRead != numFacetsInBlock)
         {
-            OSG_FATAL << "ReaderWriterSTL::readStlBinary: Failed to read facet " << i << std::endl;
+            OSG_FATAL << "ReaderWriterSTL::readStlBinary: Failed to read facet " << blockStart + numFacetsRead << std::endl;
             return ReadError;
         }
 
-        // vertices
-        if (!_vertex.valid())
-            _vertex = new osg::Vec3Array;
-
-        osg::Vec3 v0(facet.vertex[0].x, facet.vertex[0].y, facet.vertex[0].z);
-        osg::Vec3 v1(facet.vertex[1].x, facet.vertex[1].y, facet.vertex[1].z);
-        osg::Vec3 v2(facet.vertex[2].x, facet.vertex[2].y, facet.vertex[2].z);
-        _vertex->push_back(v0);
-        _vertex->push_back(v1);
-        _vertex->push_back(v2);
-
-        // per-facet normal
-        osg::Vec3 normal;
-        if (_generateNormal)
+        for (unsigned int i = 0; i < numFacetsInBlock; ++i)
         {
-            osg::Vec3 d01 = v1 - v0;
-            osg::Vec3 d02 = v2 - v0;
-            normal = d01 ^ d02;
-            normal.normalize();
-        }
-        else
-        {
-            normal.set(facet.normal.x, facet.normal.y, facet.normal.z);
-        }
-
-        if (!_normal.valid())
-            _normal = new osg::Vec3Array;
-        _normal->push_back(normal);
-
-        /*
-         * color extension
-         * RGB555 with most-significat bit indicating if color is present
-         *
-         * The magics files may use whether per-face or per-object colors
-         * for a given face, according to the value of the last bit (0 = per-face, 1 = per-object)
-         * Moreover, magics uses RGB instead of BGR (as the other software)
-         */
-        if (!_color.valid())
-        {
-            _color = new osg::Vec4Array;
-        }
-
-        // Case of a Magics file
-        if(comesFromMagics)
-        {
-            if(facet.color & StlHasColor) // The last bit is 1, the per-object color is used
+            // the facets are packed at 50 bytes, so copy each into the padded struct
+            const unsigned char* facetData = &block[i * sizeof_StlFacet];
+            memcpy(&facet.normal, facetData, sizeof(StlVector));
+            memcpy(facet.vertex, facetData + sizeof(StlVector), 3 * sizeof(StlVector));
+            memcpy(&facet.color, facetData + 4 * sizeof(StlVector), sizeof(facet.color));
+
+            // vertices
+            osg::Vec3 v0(facet.vertex[0].x, facet.vertex[0].y, facet.vertex[0].z);
+            osg::Vec3 v1(facet.vertex[1].x, facet.vertex[1].y, facet.vertex[1].z);
+            osg::Vec3 v2(facet.vertex[2].x, facet.vertex[2].y, facet.vertex[2].z);
+
+            // per-facet normal
+            osg::Vec3 normal;
+            if (_generateNormal)
             {
-                _color->push_back(magicsHeaderColor);
+                osg::Vec3 d01 = v1 - v0;
+                osg::Vec3 d02 = v2 - v0;
+                normal = d01 ^ d02;
+                normal.normalize();
             }
-            else // the last bit is 0, the facet has its own unique color
+            else
             {
-                float b = ((facet.color >> 10) & StlColorSize) / StlColorDepth;
-                float g = ((facet.color >> 5) & StlColorSize) / StlColorDepth;
-                float r = (facet.color & StlColorSize) / StlColorDepth;
-                _color->push_back(osg::Vec4(r, g, b, 1.0f));
+                normal.set(facet.normal.x, facet.normal.y, facet.normal.z);
             }
-        }
-        // Case of a generic file
-        else if (facet.color & StlHasColor) // The color is valid if the last bit is 1
+
+            /*
+             * color extension
+             * RGB555 with most-significat bit indicating if color is present
+             *
+             * The magics files may use whether per-face or per-object colors
+             * for a given face, according to the value of the last bit (0 = per-face, 1 = per-object)
+             * Moreover, magics uses RGB instead of BGR (as the other software)
+             */
+            osg::Vec4 color(1.0f, 1.0f, 1.0f, 1.0f);
+
+            // Case of a Magics file
+            if(comesFromMagics)
+            {
+                if(facet.color & StlHasColor) // The last bit is 1, the per-object color is used
+                {
+                    color = magicsHeaderColor;
+                }
+                else // the last bit is 0, the facet has its own unique color
+                {
+                    float b = ((facet.color >> 10) & StlColorSize) / StlColorDepth;
+                    float g = ((facet.color >> 5) & StlColorSize) / StlColorDepth;
+                    float r = (facet.color & StlColorSize) / StlColorDepth;
+                    color.set(r, g, b, 1.0f);
+                }
+                ++_numColoredFacets;
+            }
+            // Case of a generic file
+            else if (facet.color & StlHasColor) // The color is valid if the last bit is 1
             {
                 float r = ((facet.color >> 10) & StlColorSize) / StlColorDepth;
                 float g = ((facet.color >> 5) & StlColorSize) / StlColorDepth;
                 float b = (facet.color & StlColorSize) / StlColorDepth;
-                _color->push_back(osg::Vec4(r, g, b, 1.0f));
+                color.set(r, g, b, 1.0f);
+                ++_numColoredFacets;
             }
+
+            addFacet(v0, v1, v2, normal, color);
+        }
     }
 
     return ReadEOF;
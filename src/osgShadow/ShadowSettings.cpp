@@ -32,7 +32,9 @@ ShadowSettings::ShadowSettings():
     _multipleShadowMapHint(PARALLEL_SPLIT),
     _shaderHint(NO_SHADERS),
 //    _shaderHint(PROVIDE_FRAGMENT_SHADER),
-    _debugDraw(false)
+    _debugDraw(false),
+    _cullShadowMapsInParallel(false),
+    _cacheShadowCasterBounds(false)
 {
     //_computeNearFearModeOverride = osg::CullSettings::COMPUTE_NEAR_FAR_USING_PRIMITIVES;
     //_computeNearFearModeOverride = osg::CullSettings::COMPUTE_NEAR_USING_PRIMITIVES);
@@ -54,7 +56,9 @@ ShadowSettings::ShadowSettings(const ShadowSettings& ss, const osg::CopyOp& copy
     _numShadowMapsPerLight(ss._numShadowMapsPerLight),
     _multipleShadowMapHint(ss._multipleShadowMapHint),
     _shaderHint(ss._shaderHint),
-    _debugDraw(ss._debugDraw)
+    _debugDraw(ss._debugDraw),
+    _cullShadowMapsInParallel(ss._cullShadowMapsInParallel),
+    _cacheShadowCasterBounds(ss._cacheShadowCasterBounds)
 {
 }
 
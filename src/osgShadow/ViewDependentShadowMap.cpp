@@ -15,9 +15,15 @@
 #include <osgShadow/ShadowedScene>
 #include <osg/CullFace>
 #include <osg/Geode>
+#include <osg/Switch>
+#include <osg/LOD>
+#include <osg/Sequence>
 #include <osg/io_utils>
 
+#include <osg/Timer>
+
 #include <sstream>
+#include <algorithm>
 
 using namespace osgShadow;
 
@@ -248,6 +254,29 @@ void VDSMCameraCullCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
 }
 
 
+// expand the clip space bounds by the corners of a bounding box, clamped to the extents of the shadow camera's view volume
+static void expandLightSpaceBound(osg::BoundingBox& lightSpaceBB, const osg::BoundingBox& bb, const osg::Matrix& matrix)
+{
+    if (!bb.valid()) return;
+
+    for(unsigned int i=0; i<8; ++i)
+    {
+        osg::Vec3 v = bb.corner(i) * matrix;
+        if (v.z()<-1.0f)
+        {
+            //OSG_NOTICE<<"discarding("<<v<<")"<<std::endl;
+            continue;
+        }
+        float x = v.x();
+        if (x<-1.0f) x=-1.0f;
+        if (x>1.0f) x=1.0f;
+        float y = v.y();
+        if (y<-1.0f) y=-1.0f;
+        if (y>1.0f) y=1.0f;
+        lightSpaceBB.expandBy(osg::Vec3(x,y,v.z()));
+    }
+}
+
 class ComputeLightSpaceBounds : public osg::NodeVisitor, public osg::CullStack
 {
 public:
@@ -333,35 +362,88 @@ public:
     {
         if (!bb.valid()) return;
 
-        const osg::Matrix& matrix = *getModelViewMatrix() * *getProjectionMatrix();
+        expandLightSpaceBound(_bb, bb, *getModelViewMatrix() * *getProjectionMatrix());
+    }
+
+    osg::BoundingBox _bb;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CollectShadowCasterBounds
+//
+// Flattens the static parts of the shadow casting scene into a list of drawable bounding boxes and the local to world
+// matrices they sit under. Nodes that may change without the scene's bound changing are recorded as dynamic subgraphs.
+// Mirrors ComputeLightSpaceBounds in which nodes it ignores.
+class CollectShadowCasterBounds : public osg::NodeVisitor
+{
+public:
+    CollectShadowCasterBounds(ViewDependentShadowMap::ShadowCasterBounds* casterBounds):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
+        _casterBounds(casterBounds)
+    {
+        setTraversalMask(casterBounds->traversalMask);
 
-        update(bb.corner(0) * matrix);
-        update(bb.corner(1) * matrix);
-        update(bb.corner(2) * matrix);
-        update(bb.corner(3) * matrix);
-        update(bb.corner(4) * matrix);
-        update(bb.corner(5) * matrix);
-        update(bb.corner(6) * matrix);
-        update(bb.corner(7) * matrix);
+        _casterBounds->matrices.push_back(osg::Matrixd::identity());
+        _matrixIndexStack.push_back(0);
     }
 
-    void update(const osg::Vec3& v)
+    bool isDynamic(const osg::Node& node) const
     {
-        if (v.z()<-1.0f)
+        return node.getDataVariance()==osg::Object::DYNAMIC || node.getUpdateCallback()!=0 || node.getCullCallback()!=0;
+    }
+
+    void addDynamicSubgraph(osg::Node& node)
+    {
+        _casterBounds->dynamicSubgraphs.push_back(std::make_pair(osg::ref_ptr<osg::Node>(&node), _matrixIndexStack.back()));
+    }
+
+    void apply(osg::Node& node)
+    {
+        if (isDynamic(node)) addDynamicSubgraph(node);
+        else traverse(node);
+    }
+
+    void apply(osg::Drawable& drawable)
+    {
+        if (isDynamic(drawable)) addDynamicSubgraph(drawable);
+        else if (drawable.getBoundingBox().valid()) _casterBounds->boxes.push_back(ViewDependentShadowMap::ShadowCasterBounds::Box(drawable, _matrixIndexStack.back()));
+    }
+
+    // the active children of these depend on the frame or the viewpoint.
+    void apply(osg::Switch& node) { addDynamicSubgraph(node); }
+    void apply(osg::LOD& node) { addDynamicSubgraph(node); }
+    void apply(osg::Sequence& node) { addDynamicSubgraph(node); }
+
+    void apply(osg::Billboard&) {}
+    void apply(osg::Projection&) {}
+    void apply(osg::Camera&) {}
+
+    void apply(osg::Transform& transform)
+    {
+        if (isDynamic(transform))
         {
-            //OSG_NOTICE<<"discarding("<<v<<")"<<std::endl;
+            addDynamicSubgraph(transform);
             return;
         }
-        float x = v.x();
-        if (x<-1.0f) x=-1.0f;
-        if (x>1.0f) x=1.0f;
-        float y = v.y();
-        if (y<-1.0f) y=-1.0f;
-        if (y>1.0f) y=1.0f;
-        _bb.expandBy(osg::Vec3(x,y,v.z()));
+
+        if (transform.getReferenceFrame()!=osg::Transform::RELATIVE_RF) return;
+
+        osg::Matrixd matrix(_casterBounds->matrices[_matrixIndexStack.back()]);
+        transform.computeLocalToWorldMatrix(matrix, this);
+
+        _matrixIndexStack.push_back(static_cast<unsigned int>(_casterBounds->matrices.size()));
+        _casterBounds->matrices.push_back(matrix);
+
+        traverse(transform);
+
+        _matrixIndexStack.pop_back();
     }
 
-    osg::BoundingBox _bb;
+protected:
+
+    ViewDependentShadowMap::ShadowCasterBounds*     _casterBounds;
+    std::vector<unsigned int>                       _matrixIndexStack;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -649,6 +731,7 @@ ViewDependentShadowMap::ViewDependentData::ViewDependentData(ViewDependentShadow
 {
     OSG_INFO<<"ViewDependentData::ViewDependentData()"<<this<<std::endl;
     _stateset = new osg::StateSet;
+    _shadowCameraGroup = new osg::Group;
 }
 
 void ViewDependentShadowMap::ViewDependentData::releaseGLObjects(osg::State* state) const
@@ -720,6 +803,22 @@ void ViewDependentShadowMap::update(osg::NodeVisitor& nv)
     _shadowedScene->osg::Group::traverse(nv);
 }
 
+namespace
+{
+    // a shadow map whose camera has been set up by ViewDependentShadowMap::cull(..), awaiting its cull traversal.
+    struct ShadowMapSetup
+    {
+        ShadowMapSetup(ViewDependentShadowMap::ShadowData* sd, ViewDependentShadowMap::LightData* ld, VDSMCameraCullCallback* cc):
+            shadowData(sd), lightData(ld), cullCallback(cc) {}
+
+        osg::ref_ptr<ViewDependentShadowMap::ShadowData>    shadowData;
+        ViewDependentShadowMap::LightData*                  lightData;
+        osg::ref_ptr<VDSMCameraCullCallback>                cullCallback;
+    };
+
+    typedef std::vector<ShadowMapSetup> ShadowMapSetupList;
+}
+
 void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
 {
     OSG_INFO<<std::endl<<std::endl<<"ViewDependentShadowMap::cull(osg::CullVisitor&"<<&cv<<")"<<std::endl;
@@ -827,6 +926,9 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
         numShadowMapsPerLight = 2;
     }
 
+    ShadowMapSetupList shadowMaps;
+    CameraList cameras;
+
     LightDataList& pll = vdd->getLightDataList();
     for(LightDataList::iterator itr = pll.begin();
         itr != pll.end();
@@ -862,39 +964,23 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
         // traverse the scene to compute the extents of the objects
         if (/*numShadowMapsPerLight>1 &&*/ _shadowedScene->getCastsShadowTraversalMask()!=0xffffffff)
         {
-            // osg::ElapsedTime timer;
-
-            osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,2048,2048);
-            ComputeLightSpaceBounds clsb(viewport.get(), projectionMatrix, viewMatrix);
-            clsb.setTraversalMask(_shadowedScene->getCastsShadowTraversalMask());
+            osg::BoundingBox casterExtents = computeShadowCasterExtents(*vdd, pl, polytope, projectionMatrix, viewMatrix);
 
-            osg::Matrixd invertModelView;
-            invertModelView.invert(viewMatrix);
-            osg::Polytope local_polytope(polytope);
-            local_polytope.transformProvidingInverse(invertModelView);
+            // OSG_NOTICE<<"Extents of LightSpace "<<casterExtents.xMin()<<", "<<casterExtents.xMax()<<", "<<casterExtents.yMin()<<", "<<casterExtents.yMax()<<", "<<casterExtents.zMin()<<", "<<casterExtents.zMax()<<std::endl;
 
-            osg::CullingSet& cs = clsb.getProjectionCullingStack().back();
-            cs.setFrustum(local_polytope);
-            clsb.pushCullingSet();
-
-            _shadowedScene->accept(clsb);
-
-            // OSG_NOTICE<<"Extents of LightSpace "<<clsb._bb.xMin()<<", "<<clsb._bb.xMax()<<", "<<clsb._bb.yMin()<<", "<<clsb._bb.yMax()<<", "<<clsb._bb.zMin()<<", "<<clsb._bb.zMax()<<std::endl;
-            // OSG_NOTICE<<"  time "<<timer.elapsedTime_m()<<"ms, mask = "<<std::hex<<_shadowedScene->getCastsShadowTraversalMask()<<std::endl;
-
-            if (clsb._bb.xMin()>-1.0f || clsb._bb.xMax()<1.0f || clsb._bb.yMin()>-1.0f || clsb._bb.yMax()<1.0f)
+            if (casterExtents.xMin()>-1.0f || casterExtents.xMax()<1.0f || casterExtents.yMin()>-1.0f || casterExtents.yMax()<1.0f)
             {
                 // OSG_NOTICE<<"Need to clamp projection matrix"<<std::endl;
 
 #if 1
-                double xMid = (clsb._bb.xMin()+clsb._bb.xMax())*0.5f;
-                double xRange = clsb._bb.xMax()-clsb._bb.xMin();
+                double xMid = (casterExtents.xMin()+casterExtents.xMax())*0.5f;
+                double xRange = casterExtents.xMax()-casterExtents.xMin();
 #else
                 double xMid = 0.0;
                 double xRange = 2.0;
 #endif
-                double yMid = (clsb._bb.yMin()+clsb._bb.yMax())*0.5f;
-                double yRange = (clsb._bb.yMax()-clsb._bb.yMin());
+                double yMid = (casterExtents.yMin()+casterExtents.yMax())*0.5f;
+                double yRange = (casterExtents.yMax()-casterExtents.yMin());
 
                 // OSG_NOTICE<<"  xMid="<<xMid<<", yMid="<<yMid<<", xRange="<<xRange<<", yRange="<<yRange<<std::endl;
 
@@ -1046,47 +1132,62 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
             osg::ref_ptr<VDSMCameraCullCallback> vdsmCallback = new VDSMCameraCullCallback(this, local_polytope);
             camera->setCullCallback(vdsmCallback.get());
 
-            // 4.3 traverse RTT camera
-            //
+            shadowMaps.push_back(ShadowMapSetup(sd.get(), &pl, vdsmCallback.get()));
+            cameras.push_back(camera.get());
+        }
+    }
+
+    // 4.3 traverse the RTT cameras, all the shadow maps are set up first so that they can be culled together.
+    //
+    if (!cameras.empty())
+    {
+        cv.pushStateSet(_shadowCastingStateSet.get());
 
-            cv.pushStateSet(_shadowCastingStateSet.get());
+        cullShadowCastingScenes(&cv, *vdd, cameras);
 
-            cullShadowCastingScene(&cv, camera.get());
+        cv.popStateSet();
+    }
 
-            cv.popStateSet();
+    for(ShadowMapSetupList::iterator itr = shadowMaps.begin();
+        itr != shadowMaps.end();
+        ++itr)
+    {
+        ShadowData* sd = itr->shadowData.get();
+        LightData& pl = *(itr->lightData);
+        VDSMCameraCullCallback* vdsmCallback = itr->cullCallback.get();
+        osg::Camera* camera = sd->_camera.get();
 
-            if (!orthographicViewFrustum && settings->getShadowMapProjectionHint()==ShadowSettings::PERSPECTIVE_SHADOW_MAP)
+        if (!orthographicViewFrustum && settings->getShadowMapProjectionHint()==ShadowSettings::PERSPECTIVE_SHADOW_MAP)
+        {
+            adjustPerspectiveShadowMapCameraSettings(vdsmCallback->getRenderStage(), frustum, pl, camera);
+            if (vdsmCallback->getProjectionMatrix())
             {
-                adjustPerspectiveShadowMapCameraSettings(vdsmCallback->getRenderStage(), frustum, pl, camera.get());
-                if (vdsmCallback->getProjectionMatrix())
-                {
-                    vdsmCallback->getProjectionMatrix()->set(camera->getProjectionMatrix());
-                }
+                vdsmCallback->getProjectionMatrix()->set(camera->getProjectionMatrix());
             }
+        }
 
-            // 4.4 compute main scene graph TexGen + uniform settings + setup state
-            //
-            assignTexGenSettings(&cv, camera.get(), textureUnit, sd->_texgen.get());
-
-            // mark the light as one that has active shadows and requires shaders
-            pl.textureUnits.push_back(textureUnit);
+        // 4.4 compute main scene graph TexGen + uniform settings + setup state
+        //
+        assignTexGenSettings(&cv, camera, textureUnit, sd->_texgen.get());
 
-            // pass on shadow data to ShadowDataList
-            sd->_textureUnit = textureUnit;
+        // mark the light as one that has active shadows and requires shaders
+        pl.textureUnits.push_back(textureUnit);
 
-            if (textureUnit >= 8)
-            {
-                OSG_NOTICE<<"Shadow texture unit is invalid for texgen, will not be used."<<std::endl;
-            }
-            else
-            {
-                sdl.push_back(sd);
-            }
+        // pass on shadow data to ShadowDataList
+        sd->_textureUnit = textureUnit;
 
-            // increment counters.
-            ++textureUnit;
-            ++numValidShadows ;
+        if (textureUnit >= 8)
+        {
+            OSG_NOTICE<<"Shadow texture unit is invalid for texgen, will not be used."<<std::endl;
         }
+        else
+        {
+            sdl.push_back(sd);
+        }
+
+        // increment counters.
+        ++textureUnit;
+        ++numValidShadows ;
     }
 
     if (numValidShadows>0)
@@ -2333,6 +2434,179 @@ void ViewDependentShadowMap::cullShadowCastingScene(osgUtil::CullVisitor* cv, os
     return;
 }
 
+void ViewDependentShadowMap::cullShadowCastingScenes(osgUtil::CullVisitor* cv, ViewDependentData& vdd, const CameraList& cameras) const
+{
+    const ShadowSettings* settings = _shadowedScene->getShadowSettings();
+
+    if (cameras.size()<2 || !settings->getCullShadowMapsInParallel() || !cv->getParallelCullTaskPool())
+    {
+        for(CameraList::const_iterator itr = cameras.begin();
+            itr != cameras.end();
+            ++itr)
+        {
+            cullShadowCastingScene(cv, itr->get());
+        }
+        return;
+    }
+
+    OSG_INFO<<"cullShadowCastingScenes() culling "<<cameras.size()<<" shadow cameras in parallel"<<std::endl;
+
+    // record the traversal mask on entry so we can reapply it later.
+    unsigned int traversalMask = cv->getTraversalMask();
+
+    cv->setTraversalMask( traversalMask & settings->getCastsShadowTraversalMask() );
+
+    // each camera is culled by its own CullVisitor, with the RenderStages they set up added to the current stage in camera order.
+    // the cameras are traversed directly rather than through cullShadowCastingScene(..), which isn't called on this path.
+    osg::Group* group = vdd.getShadowCameraGroup();
+    for(CameraList::const_iterator itr = cameras.begin();
+        itr != cameras.end();
+        ++itr)
+    {
+        group->addChild(itr->get());
+    }
+
+    cv->traverseChildrenInParallel(*group);
+
+    group->removeChildren(0, group->getNumChildren());
+
+    cv->setTraversalMask( traversalMask );
+}
+
+static bool lessMatrixIndex(const ViewDependentShadowMap::ShadowCasterBounds::Box& lhs, const ViewDependentShadowMap::ShadowCasterBounds::Box& rhs)
+{
+    return lhs.matrixIndex < rhs.matrixIndex;
+}
+
+osg::ref_ptr<const ViewDependentShadowMap::ShadowCasterBounds> ViewDependentShadowMap::getShadowCasterBounds()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shadowCasterBoundsMutex);
+
+    unsigned int traversalMask = _shadowedScene->getCastsShadowTraversalMask();
+    const osg::BoundingSphere& sceneBound = _shadowedScene->getBound();
+
+    if (_shadowCasterBounds.valid() &&
+        _shadowCasterBounds->traversalMask==traversalMask &&
+        _shadowCasterBounds->sceneBound==sceneBound)
+    {
+        return _shadowCasterBounds.get();
+    }
+
+    osg::ElapsedTime timer;
+
+    // a new ShadowCasterBounds is created each time as the previous one may still be in use by another view's cull.
+    osg::ref_ptr<ShadowCasterBounds> casterBounds = new ShadowCasterBounds;
+    casterBounds->traversalMask = traversalMask;
+    casterBounds->sceneBound = sceneBound;
+
+    CollectShadowCasterBounds cscb(casterBounds.get());
+    _shadowedScene->osg::Group::traverse(cscb);
+
+    // group the boxes by matrix so each matrix is only set up once when computing the extents.
+    std::stable_sort(casterBounds->boxes.begin(), casterBounds->boxes.end(), lessMatrixIndex);
+
+    OSG_INFO<<"ViewDependentShadowMap::getShadowCasterBounds() collected "<<casterBounds->boxes.size()<<" boxes, "
+            <<casterBounds->matrices.size()<<" matrices and "<<casterBounds->dynamicSubgraphs.size()<<" dynamic subgraphs in "
+            <<timer.elapsedTime_m()<<"ms"<<std::endl;
+
+    _shadowCasterBounds = casterBounds;
+
+    return _shadowCasterBounds.get();
+}
+
+void ViewDependentShadowMap::dirtyShadowCasterBounds()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shadowCasterBoundsMutex);
+    _shadowCasterBounds = 0;
+}
+
+osg::BoundingBox ViewDependentShadowMap::computeShadowCasterExtents(ViewDependentData& vdd, LightData& positionedLight, const osg::Polytope& polytope, const osg::Matrixd& projectionMatrix, const osg::Matrixd& viewMatrix)
+{
+    // osg::ElapsedTime timer;
+
+    const ShadowSettings* settings = _shadowedScene->getShadowSettings();
+
+    // transform the polytope in model coords into the light's eye coords.
+    osg::Matrixd invertModelView;
+    invertModelView.invert(viewMatrix);
+    osg::Polytope local_polytope(polytope);
+    local_polytope.transformProvidingInverse(invertModelView);
+
+    osg::Matrixd modelViewMatrix(viewMatrix);
+    osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,2048,2048);
+    ComputeLightSpaceBounds clsb(viewport.get(), projectionMatrix, modelViewMatrix);
+    clsb.setTraversalMask(_shadowedScene->getCastsShadowTraversalMask());
+
+    osg::CullingSet& cs = clsb.getProjectionCullingStack().back();
+    cs.setFrustum(local_polytope);
+    clsb.pushCullingSet();
+
+    if (!settings->getCacheShadowCasterBounds())
+    {
+        _shadowedScene->accept(clsb);
+
+        // OSG_NOTICE<<"  time "<<timer.elapsedTime_m()<<"ms, mask = "<<std::hex<<_shadowedScene->getCastsShadowTraversalMask()<<std::endl;
+
+        return clsb._bb;
+    }
+
+    osg::ref_ptr<const ShadowCasterBounds> casterBounds = getShadowCasterBounds();
+
+    // the extents of the static casters only change when the light, the view frustum or the casters do.
+    ViewDependentData::CasterExtents& casterExtents = vdd.getCasterExtentsMap()[positionedLight.light->getLightNum()];
+    if (casterExtents.casterBounds!=casterBounds ||
+        casterExtents.projectionMatrix!=projectionMatrix ||
+        casterExtents.viewMatrix!=viewMatrix ||
+        casterExtents.planes!=polytope.getPlaneList())
+    {
+        casterExtents.casterBounds = casterBounds;
+        casterExtents.projectionMatrix = projectionMatrix;
+        casterExtents.viewMatrix = viewMatrix;
+        casterExtents.planes = polytope.getPlaneList();
+        casterExtents.bb.init();
+
+        unsigned int matrixIndex = 0xffffffff;
+        osg::Polytope matrix_polytope;
+        osg::Matrix matrix;
+        for(ShadowCasterBounds::Boxes::const_iterator itr = casterBounds->boxes.begin();
+            itr != casterBounds->boxes.end();
+            ++itr)
+        {
+            if (itr->matrixIndex!=matrixIndex)
+            {
+                matrixIndex = itr->matrixIndex;
+
+                osg::Matrixd boxModelView = casterBounds->matrices[matrixIndex] * viewMatrix;
+                matrix_polytope.setAndTransformProvidingInverse(local_polytope, boxModelView);
+                matrix = boxModelView * projectionMatrix;
+            }
+
+            if (!itr->cullingActive || matrix_polytope.contains(itr->bs))
+            {
+                expandLightSpaceBound(casterExtents.bb, itr->bb, matrix);
+            }
+        }
+    }
+
+    // subgraphs that may have changed since the bounds were collected are traversed every frame.
+    for(ShadowCasterBounds::Subgraphs::const_iterator itr = casterBounds->dynamicSubgraphs.begin();
+        itr != casterBounds->dynamicSubgraphs.end();
+        ++itr)
+    {
+        clsb.pushModelViewMatrix(new osg::RefMatrix(casterBounds->matrices[itr->second] * viewMatrix), osg::Transform::RELATIVE_RF);
+
+        itr->first->accept(clsb);
+
+        clsb.popModelViewMatrix();
+    }
+
+    clsb._bb.expandBy(casterExtents.bb);
+
+    // OSG_NOTICE<<"  time "<<timer.elapsedTime_m()<<"ms, "<<casterBounds->boxes.size()<<" cached boxes"<<std::endl;
+
+    return clsb._bb;
+}
+
 osg::StateSet* ViewDependentShadowMap::selectStateSetForRenderingShadow(ViewDependentData& vdd) const
 {
     OSG_INFO<<"   selectStateSetForRenderingShadow() "<<vdd.getStateSet()<<std::endl;
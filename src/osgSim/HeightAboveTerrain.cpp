@@ -19,7 +19,8 @@
 
 using namespace osgSim;
 
-HeightAboveTerrain::HeightAboveTerrain()
+HeightAboveTerrain::HeightAboveTerrain():
+    _intersectionBatch(new osgUtil::IntersectionBatch)
 {
     _lowestHeight = -1000.0;
 
@@ -43,7 +44,8 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
     osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
     osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    _intersectionBatch->clear();
+    _intersectionBatch->setTraversalMask(traversalMask);
 
     for(HATList::iterator itr = _HATList.begin();
         itr != _HATList.end();
@@ -61,10 +63,9 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
 
             itr->_hat = height;
 
-            OSG_NOTICE<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
+            OSG_INFO<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(start, end);
-            intersectorGroup->addIntersector( intersector.get() );
+            _intersectionBatch->addIntersector( new osgUtil::LineSegmentIntersector(start, end) );
         }
         else
         {
@@ -76,37 +77,28 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
 
             itr->_hat = height;
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector( start, end);
-            intersectorGroup->addIntersector( intersector.get() );
+            _intersectionBatch->addIntersector( new osgUtil::LineSegmentIntersector(start, end) );
         }
     }
 
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
+    _intersectionBatch->computeIntersections(scene);
 
-    scene->accept(_intersectionVisitor);
-
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
-    for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
-        intersector_itr != intersectors.end();
-        ++intersector_itr, ++index)
+    for(unsigned int index = 0; index < _HATList.size(); ++index)
     {
-        osgUtil::LineSegmentIntersector* lsi = dynamic_cast<osgUtil::LineSegmentIntersector*>(intersector_itr->get());
-        if (lsi)
+        osgUtil::LineSegmentIntersector* lsi = static_cast<osgUtil::LineSegmentIntersector*>(_intersectionBatch->getIntersector(index));
+
+        osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
+        if (!intersections.empty())
         {
-            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
-            if (!intersections.empty())
-            {
-                const osgUtil::LineSegmentIntersector::Intersection& intersection = *intersections.begin();
-                osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
-                                               intersection.localIntersectionPoint;
-                _HATList[index]._hat = (_HATList[index]._point - intersectionPoint).length();
-            }
+            const osgUtil::LineSegmentIntersector::Intersection& intersection = *intersections.begin();
+            osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
+                                           intersection.localIntersectionPoint;
+            _HATList[index]._hat = (_HATList[index]._point - intersectionPoint).length();
         }
     }
 
+    // release the intersectors and the references their intersections hold on the scene.
+    _intersectionBatch->clear();
 }
 
 double HeightAboveTerrain::computeHeightAboveTerrain(osg::Node* scene, const osg::Vec3d& point, osg::Node::NodeMask traversalMask)
@@ -120,5 +112,5 @@ double HeightAboveTerrain::computeHeightAboveTerrain(osg::Node* scene, const osg
 void HeightAboveTerrain::setDatabaseCacheReadCallback(DatabaseCacheReadCallback* dcrc)
 {
     _dcrc = dcrc;
-    _intersectionVisitor.setReadCallback(dcrc);
+    _intersectionBatch->setReadCallback(dcrc);
 }
@@ -28,6 +28,7 @@ void DatabaseCacheReadCallback::clearDatabaseCache()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
     _filenameSceneMap.clear();
+    _filesFailedToRead.clear();
 }
 
 void DatabaseCacheReadCallback::pruneUnusedDatabaseCache()
@@ -36,27 +37,50 @@ void DatabaseCacheReadCallback::pruneUnusedDatabaseCache()
 
 osg::ref_ptr<osg::Node> DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
 {
-    // first check to see if file is already loaded.
+    // first check to see if file is already loaded, or is being loaded by another thread in which case wait for it.
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
-        FileNameSceneMap::iterator itr = _filenameSceneMap.find(filename);
-        if (itr != _filenameSceneMap.end())
+        while(true)
         {
-            OSG_INFO<<"Getting from cache "<<filename<<std::endl;
+            FileNameSceneMap::iterator itr = _filenameSceneMap.find(filename);
+            if (itr != _filenameSceneMap.end())
+            {
+                OSG_INFO<<"Getting from cache "<<filename<<std::endl;
+
+                return itr->second.get();
+            }
+
+            // a file that failed to read isn't retried, so threads that waited on a failed read don't each repeat it.
+            if (_filesFailedToRead.count(filename)!=0) return 0;
+
+            if (_filesBeingRead.count(filename)==0) break;
 
-            return itr->second.get();
+            _fileReadCondition.wait(&_mutex);
         }
+
+        _filesBeingRead.insert(filename);
     }
 
     // now load the file.
     osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(filename);
 
+    // compute the bound before the subgraph is shared, so that threads intersecting it concurrently don't all compute it.
+    if (node.valid()) node->getBound();
+
     // insert into the cache.
-    if (node.valid())
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
+        _filesBeingRead.erase(filename);
+        _fileReadCondition.broadcast();
+
+        if (!node.valid())
+        {
+            _filesFailedToRead.insert(filename);
+            return node;
+        }
+
         if (_filenameSceneMap.size() < _maxNumFilesToCache)
         {
             OSG_INFO<<"Inserting into cache "<<filename<<std::endl;
@@ -87,7 +111,8 @@ osg::ref_ptr<osg::Node> DatabaseCacheReadCallback::readNodeFile(const std::strin
     return node;
 }
 
-LineOfSight::LineOfSight()
+LineOfSight::LineOfSight():
+    _intersectionBatch(new osgUtil::IntersectionBatch)
 {
     setDatabaseCacheReadCallback(new DatabaseCacheReadCallback);
 }
@@ -106,47 +131,39 @@ unsigned int LineOfSight::addLOS(const osg::Vec3d& start, const osg::Vec3d& end)
 
 void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
 {
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    _intersectionBatch->clear();
+    _intersectionBatch->setTraversalMask(traversalMask);
 
     for(LOSList::iterator itr = _LOSList.begin();
         itr != _LOSList.end();
         ++itr)
     {
-        osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(itr->_start, itr->_end);
-        intersectorGroup->addIntersector( intersector.get() );
+        _intersectionBatch->addIntersector( new osgUtil::LineSegmentIntersector(itr->_start, itr->_end) );
     }
 
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
-
-    scene->accept(_intersectionVisitor);
+    _intersectionBatch->computeIntersections(scene);
 
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
-    for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
-        intersector_itr != intersectors.end();
-        ++intersector_itr, ++index)
+    for(unsigned int index = 0; index < _LOSList.size(); ++index)
     {
-        osgUtil::LineSegmentIntersector* lsi = dynamic_cast<osgUtil::LineSegmentIntersector*>(intersector_itr->get());
-        if (lsi)
-        {
-            Intersections& intersectionsLOS = _LOSList[index]._intersections;
-            _LOSList[index]._intersections.clear();
+        osgUtil::LineSegmentIntersector* lsi = static_cast<osgUtil::LineSegmentIntersector*>(_intersectionBatch->getIntersector(index));
 
-            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
+        Intersections& intersectionsLOS = _LOSList[index]._intersections;
+        intersectionsLOS.clear();
 
-            for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
-                itr != intersections.end();
-                ++itr)
-            {
-                const osgUtil::LineSegmentIntersector::Intersection& intersection = *itr;
-                if (intersection.matrix.valid()) intersectionsLOS.push_back( intersection.localIntersectionPoint * (*intersection.matrix) );
-                else intersectionsLOS.push_back( intersection.localIntersectionPoint  );
-            }
+        osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
+
+        for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
+            itr != intersections.end();
+            ++itr)
+        {
+            const osgUtil::LineSegmentIntersector::Intersection& intersection = *itr;
+            if (intersection.matrix.valid()) intersectionsLOS.push_back( intersection.localIntersectionPoint * (*intersection.matrix) );
+            else intersectionsLOS.push_back( intersection.localIntersectionPoint  );
         }
     }
 
+    // release the intersectors and the references their intersections hold on the scene.
+    _intersectionBatch->clear();
 }
 
 LineOfSight::Intersections LineOfSight::computeIntersections(osg::Node* scene, const osg::Vec3d& start, const osg::Vec3d& end, osg::Node::NodeMask traversalMask)
@@ -160,5 +177,5 @@ LineOfSight::Intersections LineOfSight::computeIntersections(osg::Node* scene, c
 void LineOfSight::setDatabaseCacheReadCallback(DatabaseCacheReadCallback* dcrc)
 {
     _dcrc = dcrc;
-    _intersectionVisitor.setReadCallback(dcrc);
+    _intersectionBatch->setReadCallback(dcrc);
 }
@@ -21,9 +21,15 @@
 #include <osgDB/ReadFile>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <osgDB/fstream>
 #include <osg/GLU>
+#include <osg/Timer>
 
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
 
 #include <OpenThreads/ReentrantMutex>
 
@@ -36,6 +42,8 @@
 using namespace osgText;
 using namespace std;
 
+static osg::ApplicationUsageProxy Font_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_TEXT_GLYPH_CACHE <directory>","Directory in which Font::preloadGlyphs() caches the glyph textures it builds.");
+
 osg::ref_ptr<Font> Font::getDefaultFont()
 {
     static OpenThreads::Mutex s_DefaultFontMutex;
@@ -290,6 +298,11 @@ Font::Font(FontImplementation* implementation):
         if (osg_max_size<_textureWidthHint) _textureWidthHint = osg_max_size;
         if (osg_max_size<_textureHeightHint) _textureHeightHint = osg_max_size;
     }
+
+    if ((ptr = getenv("OSG_TEXT_GLYPH_CACHE")) != 0)
+    {
+        _glyphCacheDirectory = ptr;
+    }
 }
 
 Font::~Font()
@@ -490,50 +503,398 @@ void Font::addGlyph(const FontResolution& fontRes, unsigned int charcode, Glyph*
 
 }
 
+GlyphTexture* Font::createGlyphTexture(ShaderTechnique shaderTechnique)
+{
+    GlyphTexture* glyphTexture = new GlyphTexture;
+
+    static int numberOfTexturesAllocated = 0;
+    ++numberOfTexturesAllocated;
+
+    OSG_INFO<< "   Font " << this<< ", numberOfTexturesAllocated "<<numberOfTexturesAllocated<<std::endl;
+
+    // reserve enough space for the glyphs.
+    glyphTexture->setShaderTechnique(shaderTechnique);
+    glyphTexture->setTextureSize(_textureWidthHint,_textureHeightHint);
+    glyphTexture->setFilter(osg::Texture::MIN_FILTER,_minFilterHint);
+    glyphTexture->setFilter(osg::Texture::MAG_FILTER,_magFilterHint);
+    glyphTexture->setMaxAnisotropy(_maxAnisotropy);
+
+    return glyphTexture;
+}
+
+GlyphTexture* Font::getSpaceForGlyph(GlyphTextureList& glyphTextures, Glyph* glyph, ShaderTechnique shaderTechnique, int& posX, int& posY)
+{
+    for(GlyphTextureList::iterator itr=glyphTextures.begin();
+        itr!=glyphTextures.end();
+        ++itr)
+    {
+        if ((*itr)->getShaderTechnique()==shaderTechnique && (*itr)->getSpaceForGlyph(glyph,posX,posY))
+        {
+            //cout << "    Font::getSpaceForGlyph() found space for texture "<<itr->get()<<" posX="<<posX<<" posY="<<posY<<endl;
+            return itr->get();
+        }
+    }
+
+    GlyphTexture* glyphTexture = createGlyphTexture(shaderTechnique);
+    glyphTextures.push_back(glyphTexture);
+
+    if (!glyphTexture->getSpaceForGlyph(glyph,posX,posY))
+    {
+        OSG_WARN<<"Warning: unable to allocate texture big enough for glyph"<<std::endl;
+        return 0;
+    }
+
+    return glyphTexture;
+}
+
 void Font::assignGlyphToGlyphTexture(Glyph* glyph, ShaderTechnique shaderTechnique)
 {
     int posX=0,posY=0;
 
-    GlyphTexture* glyphTexture = 0;
-    for(GlyphTextureList::iterator itr=_glyphTextureList.begin();
-        itr!=_glyphTextureList.end() && !glyphTexture;
-        ++itr)
+    GlyphTexture* glyphTexture = getSpaceForGlyph(_glyphTextureList, glyph, shaderTechnique, posX, posY);
+    if (!glyphTexture) return;
+
+    // add the glyph into the texture.
+    glyphTexture->addGlyph(glyph,posX,posY);
+}
+
+namespace
+{
+
+class CopyGlyphImagesOperation : public osg::Operation
+{
+public:
+
+    typedef std::vector<Glyph*> Glyphs;
+    typedef std::vector<Glyph::TextureInfo*> TextureInfos;
+
+    CopyGlyphImagesOperation(const Glyphs& glyphs, const TextureInfos& textureInfos, unsigned int begin, unsigned int end):
+        osg::Operation("CopyGlyphImagesOperation", false),
+        _glyphs(glyphs),
+        _textureInfos(textureInfos),
+        _begin(begin),
+        _end(end) {}
+
+    virtual void operator () (osg::Object*)
     {
-        if ((*itr)->getShaderTechnique()==shaderTechnique && (*itr)->getSpaceForGlyph(glyph,posX,posY)) glyphTexture = itr->get();
+        for(unsigned int i=_begin; i<_end; ++i)
+        {
+            _textureInfos[i]->texture->copyGlyphImage(_glyphs[i], _textureInfos[i]);
+        }
     }
 
-    if (glyphTexture)
+protected:
+
+    const Glyphs&           _glyphs;
+    const TextureInfos&     _textureInfos;
+    unsigned int            _begin;
+    unsigned int            _end;
+};
+
+// glyph cache file layout, all values in native byte order:
+//   magic, version,
+//   number of textures, then for each: width, height, pixel format, data size in bytes, data
+//   number of glyphs, then for each in the order they were allocated: charcode, texture index, posX, posY
+const char s_glyphCacheMagic[8] = { 'O', 'S', 'G', 'G', 'L', 'Y', 'P', 'H' };
+const unsigned int s_glyphCacheVersion = 1;
+
+// bytes of each texture header and glyph record, and the largest glyph texture dimension accepted when reading.
+const unsigned int s_glyphCacheTextureHeaderSize = 16;
+const unsigned int s_glyphCacheGlyphRecordSize = 16;
+const int s_glyphCacheMaximumTextureSize = 16384;
+
+template<typename T>
+bool readValue(std::istream& fin, T& value)
+{
+    fin.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return fin.good();
+}
+
+template<typename T>
+void writeValue(std::ostream& fout, const T& value)
+{
+    fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool writeGlyphCacheFile(const std::string& filename, const std::vector<const GlyphTexture*>& glyphTextures, const std::vector<Glyph*>& glyphs, ShaderTechnique shaderTechnique)
+{
+    osgDB::ofstream fout(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!fout) return false;
+
+    fout.write(s_glyphCacheMagic, sizeof(s_glyphCacheMagic));
+    writeValue(fout, s_glyphCacheVersion);
+
+    writeValue(fout, static_cast<unsigned int>(glyphTextures.size()));
+    for(std::vector<const GlyphTexture*>::const_iterator itr = glyphTextures.begin(); itr!=glyphTextures.end(); ++itr)
     {
-        //cout << "    Font::assignGlyphToGlyphTexture() found space for texture "<<glyphTexture<<" posX="<<posX<<" posY="<<posY<<endl;
+        const osg::Image* image = (*itr)->getImage();
+        if (!image) return false;
+
+        writeValue(fout, image->s());
+        writeValue(fout, image->t());
+        writeValue(fout, static_cast<unsigned int>(image->getPixelFormat()));
+        writeValue(fout, image->getTotalSizeInBytes());
+        fout.write(reinterpret_cast<const char*>(image->data()), image->getTotalSizeInBytes());
     }
 
-    if (!glyphTexture)
+    writeValue(fout, static_cast<unsigned int>(glyphs.size()));
+    for(std::vector<Glyph*>::const_iterator itr = glyphs.begin(); itr!=glyphs.end(); ++itr)
     {
+        const Glyph::TextureInfo* info = (*itr)->getTextureInfo(shaderTechnique);
+        unsigned int textureIndex = std::find(glyphTextures.begin(), glyphTextures.end(), info->texture) - glyphTextures.begin();
 
-        glyphTexture = new GlyphTexture;
+        writeValue(fout, (*itr)->getGlyphCode());
+        writeValue(fout, textureIndex);
+        writeValue(fout, info->texturePositionX);
+        writeValue(fout, info->texturePositionY);
+    }
 
-        static int numberOfTexturesAllocated = 0;
-        ++numberOfTexturesAllocated;
+    fout.close();
+    return !fout.fail();
+}
 
-        OSG_INFO<< "   Font " << this<< ", numberOfTexturesAllocated "<<numberOfTexturesAllocated<<std::endl;
+}
+
+std::string Font::getGlyphCacheFileName(const FontResolution& fontRes, const std::vector<unsigned int>& charcodes, ShaderTechnique shaderTechnique) const
+{
+    std::string fontFileName = getFileName();
+    if (fontFileName.empty()) return std::string();
 
-        // reserve enough space for the glyphs.
-        glyphTexture->setShaderTechnique(shaderTechnique);
-        glyphTexture->setTextureSize(_textureWidthHint,_textureHeightHint);
-        glyphTexture->setFilter(osg::Texture::MIN_FILTER,_minFilterHint);
-        glyphTexture->setFilter(osg::Texture::MAG_FILTER,_magFilterHint);
-        glyphTexture->setMaxAnisotropy(_maxAnisotropy);
+    // the size and modification time of the font file stand in for its contents, so an updated font misses the cache.
+    struct stat fontFileStat;
+    if (stat(fontFileName.c_str(), &fontFileStat)!=0) return std::string();
 
-        _glyphTextureList.push_back(glyphTexture);
+    std::stringstream fontFileVersion;
+    fontFileVersion<<fontFileName<<"|"<<fontFileStat.st_size<<"|"<<fontFileStat.st_mtime;
+    std::string fontFileKey = fontFileVersion.str();
+
+    // FNV-1a hash of the font file's name, size and modification time and the charcodes requested.
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr = fontFileKey.begin(); itr!=fontFileKey.end(); ++itr)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*itr)) * 16777619u;
+    }
+    for(std::vector<unsigned int>::const_iterator itr = charcodes.begin(); itr!=charcodes.end(); ++itr)
+    {
+        hash = (hash ^ *itr) * 16777619u;
+    }
+
+    std::stringstream sstr;
+    sstr<<osgDB::getStrippedName(fontFileName)<<"_"<<fontRes.first<<"x"<<fontRes.second
+        <<"_"<<shaderTechnique<<"_"<<_textureWidthHint<<"x"<<_textureHeightHint
+        <<"_"<<std::hex<<hash<<".glyphcache";
+
+    return osgDB::concatPaths(_glyphCacheDirectory, sstr.str());
+}
+
+bool Font::readGlyphCache(const std::string& filename, const FontResolution& fontRes, ShaderTechnique shaderTechnique)
+{
+    osgDB::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return false;
+
+    // the counts and sizes read are checked against the bytes left in the file before anything is allocated for them.
+    fin.seekg(0, std::ios::end);
+    std::streamoff fileSize = fin.tellg();
+    fin.seekg(0, std::ios::beg);
+    if (fileSize<0 || !fin.good()) return false;
+
+    char magic[8];
+    fin.read(magic, sizeof(magic));
+    unsigned int version = 0;
+    if (!fin.good() || memcmp(magic, s_glyphCacheMagic, sizeof(magic))!=0 || !readValue(fin, version) || version!=s_glyphCacheVersion)
+    {
+        OSG_INFO<<"Font::readGlyphCache("<<filename<<") not a valid glyph cache."<<std::endl;
+        return false;
+    }
 
-        if (!glyphTexture->getSpaceForGlyph(glyph,posX,posY))
+    unsigned int numTextures = 0;
+    if (!readValue(fin, numTextures)) return false;
+    if (numTextures>static_cast<std::streamoff>(fileSize-fin.tellg())/s_glyphCacheTextureHeaderSize)
+    {
+        OSG_INFO<<"Font::readGlyphCache("<<filename<<") truncated, ignoring cache."<<std::endl;
+        return false;
+    }
+
+    typedef std::vector< osg::ref_ptr<osg::Image> > Images;
+    Images images;
+    for(unsigned int i=0; i<numTextures; ++i)
+    {
+        int width = 0, height = 0;
+        unsigned int pixelFormat = 0, size = 0;
+        if (!readValue(fin, width) || !readValue(fin, height) || !readValue(fin, pixelFormat) || !readValue(fin, size)) return false;
+
+        if (width<=0 || width>s_glyphCacheMaximumTextureSize || height<=0 || height>s_glyphCacheMaximumTextureSize ||
+            osg::Image::computeNumComponents(pixelFormat)==0 ||
+            osg::Image::computeImageSizeInBytes(width, height, 1, pixelFormat, GL_UNSIGNED_BYTE)!=size ||
+            static_cast<std::streamoff>(size)>fileSize-fin.tellg())
         {
-            OSG_WARN<<"Warning: unable to allocate texture big enough for glyph"<<std::endl;
-            return;
+            OSG_INFO<<"Font::readGlyphCache("<<filename<<") invalid glyph texture, ignoring cache."<<std::endl;
+            return false;
         }
 
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->allocateImage(width, height, 1, pixelFormat, GL_UNSIGNED_BYTE);
+        if (!image->data() || image->getTotalSizeInBytes()!=size) return false;
+
+        fin.read(reinterpret_cast<char*>(image->data()), size);
+        if (!fin.good()) return false;
+
+        images.push_back(image);
     }
 
-    // add the glyph into the texture.
-    glyphTexture->addGlyph(glyph,posX,posY);
+    unsigned int numGlyphs = 0;
+    if (!readValue(fin, numGlyphs)) return false;
+    if (numGlyphs>static_cast<std::streamoff>(fileSize-fin.tellg())/s_glyphCacheGlyphRecordSize)
+    {
+        OSG_INFO<<"Font::readGlyphCache("<<filename<<") truncated, ignoring cache."<<std::endl;
+        return false;
+    }
+
+    // replay the allocation of the glyphs into fresh textures, only accepting the cache if every glyph lands where it was
+    // recorded, so that glyph metrics or packing that have changed since the cache was written can't misplace glyphs.
+    GlyphTextureList glyphTextures;
+    std::vector<Glyph*> glyphs;
+    std::vector<GlyphTexture*> glyphTexturesUsed;
+    std::vector< std::pair<int, int> > positions;
+    for(unsigned int i=0; i<numGlyphs; ++i)
+    {
+        unsigned int charcode = 0, textureIndex = 0;
+        int posX = 0, posY = 0;
+        if (!readValue(fin, charcode) || !readValue(fin, textureIndex) || !readValue(fin, posX) || !readValue(fin, posY)) return false;
+
+        Glyph* glyph = getGlyph(fontRes, charcode);
+        if (!glyph || glyph->getTextureInfo(shaderTechnique)) return false;
+
+        int allocatedX = 0, allocatedY = 0;
+        GlyphTexture* glyphTexture = getSpaceForGlyph(glyphTextures, glyph, shaderTechnique, allocatedX, allocatedY);
+        if (!glyphTexture || textureIndex>=glyphTextures.size() || glyphTextures[textureIndex].get()!=glyphTexture ||
+            allocatedX!=posX || allocatedY!=posY)
+        {
+            OSG_INFO<<"Font::readGlyphCache("<<filename<<") glyph layout does not match, ignoring cache."<<std::endl;
+            return false;
+        }
+
+        glyphs.push_back(glyph);
+        glyphTexturesUsed.push_back(glyphTexture);
+        positions.push_back(std::pair<int, int>(posX, posY));
+    }
+
+    if (glyphTextures.size()!=images.size()) return false;
+
+    for(unsigned int i=0; i<glyphTextures.size(); ++i)
+    {
+        osg::Image* image = glyphTextures[i]->createImage();
+        if (image->s()!=images[i]->s() || image->t()!=images[i]->t() ||
+            image->getPixelFormat()!=images[i]->getPixelFormat() ||
+            image->getTotalSizeInBytes()!=images[i]->getTotalSizeInBytes())
+        {
+            OSG_INFO<<"Font::readGlyphCache("<<filename<<") glyph texture format does not match, ignoring cache."<<std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int i=0; i<glyphTextures.size(); ++i)
+    {
+        osg::Image* image = glyphTextures[i]->createImage();
+        memcpy(image->data(), images[i]->data(), image->getTotalSizeInBytes());
+        image->dirty();
+
+        _glyphTextureList.push_back(glyphTextures[i]);
+    }
+
+    for(unsigned int i=0; i<glyphs.size(); ++i)
+    {
+        glyphTexturesUsed[i]->reserveGlyph(glyphs[i], positions[i].first, positions[i].second);
+    }
+
+    OSG_INFO<<"Font::readGlyphCache("<<filename<<") read "<<glyphs.size()<<" glyphs in "<<glyphTextures.size()<<" textures."<<std::endl;
+
+    return true;
+}
+
+bool Font::writeGlyphCache(const std::string& filename, const std::vector<Glyph*>& glyphs, ShaderTechnique shaderTechnique) const
+{
+    std::vector<const GlyphTexture*> glyphTextures;
+    for(GlyphTextureList::const_iterator itr = _glyphTextureList.begin(); itr!=_glyphTextureList.end(); ++itr)
+    {
+        if ((*itr)->getShaderTechnique()==shaderTechnique) glyphTextures.push_back(itr->get());
+    }
+
+    osgDB::makeDirectoryForFile(filename);
+
+    // write to a uniquely named temporary file and rename it into place, so readers never see a partly written cache.
+    std::stringstream tempFileName;
+    tempFileName<<filename<<"."<<std::hex<<osg::Timer::instance()->tick()<<".tmp";
+
+    if (!writeGlyphCacheFile(tempFileName.str(), glyphTextures, glyphs, shaderTechnique))
+    {
+        OSG_NOTICE<<"Warning: Font::writeGlyphCache("<<filename<<") unable to write "<<tempFileName.str()<<"."<<std::endl;
+        remove(tempFileName.str().c_str());
+        return false;
+    }
+
+    if (rename(tempFileName.str().c_str(), filename.c_str())!=0)
+    {
+        // on some platforms rename() won't replace an existing file, which would hold the cache written by another process.
+        remove(tempFileName.str().c_str());
+        return osgDB::fileExists(filename);
+    }
+
+    return true;
+}
+
+void Font::preloadGlyphs(const FontResolution& fontRes, const std::vector<unsigned int>& charcodes, ShaderTechnique shaderTechnique, osg::TaskPool* taskPool)
+{
+    bool hasGlyphTextures = false;
+    for(GlyphTextureList::iterator itr = _glyphTextureList.begin(); itr!=_glyphTextureList.end(); ++itr)
+    {
+        if ((*itr)->getShaderTechnique()==shaderTechnique) hasGlyphTextures = true;
+    }
+
+    // the cache can only reproduce the glyph textures as a whole, so is only used when starting from none.
+    std::string cacheFileName;
+    if (!hasGlyphTextures && !_glyphCacheDirectory.empty())
+    {
+        cacheFileName = getGlyphCacheFileName(fontRes, charcodes, shaderTechnique);
+        if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName) && readGlyphCache(cacheFileName, fontRes, shaderTechnique)) return;
+    }
+
+    // rasterize the glyphs and allocate their space in the glyph textures serially as the FontImplementation isn't thread safe
+    // and the packing depends on the order the glyphs are added.
+    CopyGlyphImagesOperation::Glyphs glyphs;
+    CopyGlyphImagesOperation::TextureInfos textureInfos;
+    for(std::vector<unsigned int>::const_iterator itr = charcodes.begin(); itr!=charcodes.end(); ++itr)
+    {
+        Glyph* glyph = getGlyph(fontRes, *itr);
+        if (!glyph || glyph->getTextureInfo(shaderTechnique)) continue;
+
+        int posX=0,posY=0;
+        GlyphTexture* glyphTexture = getSpaceForGlyph(_glyphTextureList, glyph, shaderTechnique, posX, posY);
+        if (!glyphTexture) continue;
+
+        glyphs.push_back(glyph);
+        textureInfos.push_back(glyphTexture->reserveGlyph(glyph, posX, posY));
+    }
+
+    // generating the signed distance fields dominates, so spread it across the TaskPool when there is enough of it.
+    const unsigned int glyphsPerTask = 16;
+    bool useTasks = taskPool && shaderTechnique>GREYSCALE && glyphs.size()>glyphsPerTask;
+    osg::ref_ptr<osg::TaskSet> taskSet = useTasks ? new osg::TaskSet : 0;
+    for(unsigned int begin=0; begin<glyphs.size(); begin+=glyphsPerTask)
+    {
+        unsigned int end = osg::minimum(begin+glyphsPerTask, static_cast<unsigned int>(glyphs.size()));
+        osg::ref_ptr<CopyGlyphImagesOperation> operation = new CopyGlyphImagesOperation(glyphs, textureInfos, begin, end);
+        if (useTasks) taskPool->add(operation.get(), taskSet.get());
+        else (*operation)(0);
+    }
+    if (useTasks) taskPool->wait(taskSet.get());
+
+    for(GlyphTextureList::iterator itr = _glyphTextureList.begin(); itr!=_glyphTextureList.end(); ++itr)
+    {
+        if ((*itr)->getShaderTechnique()==shaderTechnique && (*itr)->getImage()) (*itr)->getImage()->dirty();
+    }
+
+    OSG_INFO<<"Font::preloadGlyphs() generated "<<glyphs.size()<<" glyphs."<<std::endl;
+
+    if (!cacheFileName.empty() && !glyphs.empty()) writeGlyphCache(cacheFileName, glyphs, shaderTechnique);
 }
@@ -20,8 +20,10 @@
 
 #include <osgUtil/SmoothingVisitor>
 
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <vector>
 
 #include "GlyphGeometry.h"
 
@@ -152,9 +154,19 @@ bool GlyphTexture::getSpaceForGlyph(Glyph* glyph, int& posX, int& posY)
 
 void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY)
 {
+    Glyph::TextureInfo* info = reserveGlyph(glyph, posX, posY);
 
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
+    copyGlyphImage(glyph, info);
+
+    _image->dirty();
+}
+
+Glyph::TextureInfo* GlyphTexture::reserveGlyph(Glyph* glyph, int posX, int posY)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
     if (!_image.valid()) createImage();
 
     _glyphs.push_back(glyph);
@@ -168,13 +180,65 @@ void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY)
 
     glyph->setTextureInfo(_shaderTechnique, info.get());
 
-    copyGlyphImage(glyph, info.get());
+    return info.get();
 }
 
-void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
+// Felzenszwalb and Huttenlocher's one dimensional squared distance transform, the lower envelope of the
+// parabolas rooted at each sample's value. v and z are workspaces of n and n+1 entries.
+static void distanceTransform(const double* f, double* d, int* v, double* z, int n)
 {
-    _image->dirty();
+    const double infinity = 1e20;
+
+    int k = 0;
+    v[0] = 0;
+    z[0] = -infinity;
+    z[1] = infinity;
+    for(int q=1; q<n; ++q)
+    {
+        double s = ((f[q]+double(q*q)) - (f[v[k]]+double(v[k]*v[k]))) / double(2*q-2*v[k]);
+        while(s<=z[k])
+        {
+            --k;
+            s = ((f[q]+double(q*q)) - (f[v[k]]+double(v[k]*v[k]))) / double(2*q-2*v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = infinity;
+    }
+
+    k = 0;
+    for(int q=0; q<n; ++q)
+    {
+        while(z[k+1]<double(q)) ++k;
+        d[q] = double((q-v[k])*(q-v[k])) + f[v[k]];
+    }
+}
+
+// squared Euclidean distance transform of a columns x rows grid, separably along the columns then the rows.
+static void distanceTransform(std::vector<double>& grid, int columns, int rows)
+{
+    int n = osg::maximum(columns, rows);
+    std::vector<double> f(n), d(n), z(n+1);
+    std::vector<int> v(n);
+
+    for(int c=0; c<columns; ++c)
+    {
+        for(int r=0; r<rows; ++r) f[r] = grid[r*columns+c];
+        distanceTransform(&f[0], &d[0], &v[0], &z[0], rows);
+        for(int r=0; r<rows; ++r) grid[r*columns+c] = d[r];
+    }
+
+    for(int r=0; r<rows; ++r)
+    {
+        double* row = &grid[r*columns];
+        distanceTransform(row, &d[0], &v[0], &z[0], columns);
+        for(int c=0; c<columns; ++c) row[c] = d[c];
+    }
+}
 
+void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
+{
     if (_shaderTechnique<=GREYSCALE)
     {
         // OSG_NOTICE<<"GlyphTexture::copyGlyphImage() greyscale copying. glyphTexture="<<this<<", glyph="<<glyph->getGlyphCode()<<std::endl;
@@ -202,8 +266,6 @@ void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
     int lower = -search_distance;
     int upper = glyph->t()+search_distance;
 
-    float multiplier = 1.0/255.0f;
-
     float max_distance = sqrtf(float(search_distance)*float(search_distance)*2.0);
 
     if ((left+info->texturePositionX)<0) left = -info->texturePositionX;
@@ -212,161 +274,55 @@ void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
     if ((lower+info->texturePositionY)<0) lower = -info->texturePositionY;
     if ((upper+info->texturePositionY)>=dest_rows) upper = dest_rows-info->texturePositionY-1;
 
+    int columns = right-left+1;
+    int rows = upper-lower+1;
+    if (columns<=0 || rows<=0) return;
+
+    // exact distances to the glyph outline, with the partially covered pixels placed on the outline by their coverage,
+    // computed in time linear in the number of pixels rather than searching the neighbourhood of each.
+    const double infinity = 1e20;
+    std::vector<double> outside(columns*rows), inside(columns*rows);
+    for(int dr=lower; dr<=upper; ++dr)
+    {
+        for(int dc=left; dc<=right; ++dc)
+        {
+            unsigned char value = 0;
+            if (dr>=0 && dr<src_rows && dc>=0 && dc<src_columns) value = *(src_data + dr*src_columns + dc);
+
+            int i = (dr-lower)*columns + (dc-left);
+            if (value==255) { outside[i] = 0.0; inside[i] = infinity; }
+            else if (value==0) { outside[i] = infinity; inside[i] = 0.0; }
+            else
+            {
+                double offset = 0.5 - double(value)/255.0;
+                outside[i] = offset>0.0 ? offset*offset : 0.0;
+                inside[i] = offset<0.0 ? offset*offset : 0.0;
+            }
+        }
+    }
+
+    distanceTransform(outside, columns, rows);
+    distanceTransform(inside, columns, rows);
 
     int num_components = osg::Image::computeNumComponents(_image->getPixelFormat());
     int bytes_per_pixel = osg::Image::computePixelSizeInBits(_image->getPixelFormat(),_image->getDataType())/8;
     int alpha_offset = (_image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 1 : 0;
     int sdf_offset = (_image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 0 : 1;
 
-
-    unsigned char full_on = 255;
-    unsigned char mid_point = full_on/2;
-    float mid_point_f = float(mid_point)*multiplier;
-
     for(int dr=lower; dr<=upper; ++dr)
     {
         for(int dc=left; dc<=right; ++dc)
         {
-            unsigned char value = 0;
-
             unsigned char center_value = 0;
             if (dr>=0 && dr<src_rows && dc>=0 && dc<src_columns) center_value = *(src_data + dr*src_columns + dc);
 
-            float center_value_f = center_value*multiplier;
-            float min_distance = max_distance;
-
-            if (center_value>0 && center_value<full_on)
-            {
-                if (center_value_f>=mid_point_f)
-                {
-                    min_distance = center_value_f-mid_point_f;
-                    value = 128+(min_distance/max_distance)*127;
-                }
-                else
-                {
-                    min_distance = mid_point_f-center_value_f;
-                    value = 127-(min_distance/max_distance)*127;
-                }
-            }
-            else
-            {
-                for(int radius=1; radius<search_distance; ++radius)
-                {
-                    for(int span=-radius; span<=radius; ++span)
-                    {
-                        {
-                            // left
-                            int dx = -radius;
-                            int dy = span;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // top
-                            int dx = span;
-                            int dy = radius;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // right
-                            int dx = radius;
-                            int dy = span;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // bottom
-                            int dx = span;
-                            int dy = -radius;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-                    }
-                }
-
-                if (center_value_f>=0.5)
-                {
-                    value = 128+(min_distance/max_distance)*127;
-                }
-                else
-                {
-                    value = 127-(min_distance/max_distance)*127;
-                }
-            }
+            int i = (dr-lower)*columns + (dc-left);
+            float distance = float(sqrt(outside[i]) - sqrt(inside[i]));
 
+            // map the signed distance, positive outside the glyph, so that the outline is at the mid point.
+            unsigned char value;
+            if (distance<=0.0f) value = 128+osg::minimum(-distance/max_distance, 1.0f)*127;
+            else value = 127-osg::minimum(distance/max_distance, 1.0f)*127;
 
             unsigned char* dest_ptr = dest_data + (dr*dest_columns + dc)*bytes_per_pixel;
             if (num_components==2)
@@ -0,0 +1,1182 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgText/TextBatch>
+
+#include <osg/GL>
+#include <osg/Notify>
+#include <osg/Program>
+#include <osg/Viewport>
+#include <osg/Camera>
+#include <osg/DisplaySettings>
+
+#include <osgUtil/CullVisitor>
+
+#include <osgDB/ReadFile>
+
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+using namespace osgText;
+
+// the labels are decluttered in screen space by binning them into square cells of this many pixels.
+static const int s_declutterCellSize = 64;
+
+struct TextBatch::DeclutterCallback : public osg::DrawableCullCallback
+{
+    virtual bool cull(osg::NodeVisitor* nv, osg::Drawable* drawable, osg::RenderInfo*) const
+    {
+        TextBatch* textBatch = static_cast<TextBatch*>(drawable);
+        osgUtil::CullVisitor* cv = nv->asCullVisitor();
+        if (cv && textBatch->getDeclutter()) textBatch->declutter(*cv);
+        return false;
+    }
+};
+
+TextBatch::TextBatch():
+    _fontSize(32,32),
+    _shaderTechnique(GREYSCALE),
+    _characterHeight(32.0f),
+    _characterSizeMode(TextBase::OBJECT_COORDS),
+    _alignment(TextBase::BASE_LINE),
+    _declutter(true),
+    _fadeSpeed(0.01f),
+    _numUsedQuads(0),
+    _maximumLabelRadius(0.0f),
+    _primitivesDirty(false)
+{
+    const std::string& str = osg::DisplaySettings::instance()->getTextShaderTechnique();
+    if (!str.empty())
+    {
+        if (str=="ALL_FEATURES" || str=="ALL") _shaderTechnique = ALL_FEATURES;
+        else if (str=="GREYSCALE") _shaderTechnique = GREYSCALE;
+        else if (str=="SIGNED_DISTANCE_FIELD" || str=="SDF") _shaderTechnique = SIGNED_DISTANCE_FIELD;
+    }
+
+    init();
+}
+
+TextBatch::TextBatch(const TextBatch& textBatch,const osg::CopyOp& copyop):
+    osg::Drawable(textBatch,copyop),
+    _font(textBatch._font),
+    _fontSize(textBatch._fontSize),
+    _shaderTechnique(textBatch._shaderTechnique),
+    _characterHeight(textBatch._characterHeight),
+    _characterSizeMode(textBatch._characterSizeMode),
+    _alignment(textBatch._alignment),
+    _declutter(textBatch._declutter),
+    _fadeSpeed(textBatch._fadeSpeed),
+    _labels(textBatch._labels),
+    _freeLabels(textBatch._freeLabels),
+    _numUsedQuads(0),
+    _maximumLabelRadius(0.0f),
+    _primitivesDirty(false)
+{
+    init();
+
+    relayoutAll();
+}
+
+TextBatch::~TextBatch()
+{
+}
+
+void TextBatch::init()
+{
+    setUseDisplayList(false);
+    setSupportsDisplayList(false);
+    _supportsVertexBufferObjects = true;
+
+    // the vertex arrays are modified during update and the per Camera colors during cull.
+    setDataVariance(osg::Object::DYNAMIC);
+
+    _vbo = new osg::VertexBufferObject;
+    _ebo = new osg::ElementBufferObject;
+
+    _positions = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+    _offsets = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
+    _texcoords = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
+    _colors = new osg::Vec4Array(osg::Array::BIND_PER_VERTEX);
+
+    _positions->setBufferObject(_vbo.get());
+    _offsets->setBufferObject(_vbo.get());
+    _texcoords->setBufferObject(_vbo.get());
+    _colors->setBufferObject(_vbo.get());
+
+    setCullCallback(new DeclutterCallback);
+
+    setStateSet(createStateSet());
+}
+
+Font* TextBatch::getActiveFont()
+{
+    if (_font.valid()) return _font.get();
+
+    if (!_fontFallback) _fontFallback = Font::getDefaultFont();
+
+    return _fontFallback.get();
+}
+
+osg::StateSet* TextBatch::createStateSet()
+{
+    Font* activeFont = getActiveFont();
+    if (!activeFont) return 0;
+
+    Font::StateSets& statesets = activeFont->getCachedStateSets();
+
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(1);
+
+    osg::StateSet::DefineList defineList;
+
+    // distinguishes the TextBatch StateSets, with their own vertex shader, from the Text ones in the Font's cache.
+    defineList["TEXT_BATCH"] = osg::StateSet::DefinePair("1", osg::StateAttribute::ON);
+
+    ss.str("");
+    ss << float(_fontSize.second);
+    defineList["GLYPH_DIMENSION"] = osg::StateSet::DefinePair(ss.str(), osg::StateAttribute::ON);
+
+    ss.str("");
+    ss << float(activeFont->getTextureWidthHint());
+    defineList["TEXTURE_DIMENSION"] = osg::StateSet::DefinePair(ss.str(), osg::StateAttribute::ON);
+
+    if (_shaderTechnique>GREYSCALE)
+    {
+        defineList["SIGNED_DISTANCE_FIELD"] = osg::StateSet::DefinePair("1", osg::StateAttribute::ON);
+    }
+
+    if (_characterSizeMode==TextBase::SCREEN_COORDS)
+    {
+        defineList["SCREEN_COORDS"] = osg::StateSet::DefinePair("1", osg::StateAttribute::ON);
+    }
+
+    for(Font::StateSets::iterator itr = statesets.begin();
+        itr != statesets.end();
+        ++itr)
+    {
+        if ((*itr)->getDefineList()==defineList) return itr->get();
+    }
+
+    OSG_INFO<<"TextBatch::createStateSet() : Not Matched DefineList, creating new StateSet"<<std::endl;
+
+    osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+
+    stateset->setDefineList(defineList);
+
+    statesets.push_back(stateset.get());
+
+    stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+    stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+    stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+
+    stateset->addUniform(new osg::Uniform("glyphTexture", 0));
+
+    osg::ref_ptr<osg::Program> program = new osg::Program;
+    stateset->setAttributeAndModes(program.get());
+
+    {
+        #include "shaders/osgText_TextBatch_vert.cpp"
+        program->addShader(osgDB::readRefShaderFileWithFallback(osg::Shader::VERTEX, "shaders/osgText_TextBatch.vert", osgText_TextBatch_vert));
+    }
+
+    {
+        #include "shaders/osgText_Text_frag.cpp"
+        program->addShader(osgDB::readRefShaderFileWithFallback(osg::Shader::FRAGMENT, "shaders/osgText_Text.frag", osgText_Text_frag));
+    }
+
+    return stateset.release();
+}
+
+void TextBatch::setFont(osg::ref_ptr<Font> font)
+{
+    if (_font==font) return;
+
+    _font = font;
+
+    setStateSet(createStateSet());
+
+    relayoutAll();
+}
+
+void TextBatch::setFont(const std::string& fontfile)
+{
+    setFont(readRefFontFile(fontfile));
+}
+
+void TextBatch::setFontResolution(unsigned int width, unsigned int height)
+{
+    FontResolution size(width,height);
+    if (_fontSize==size) return;
+
+    _fontSize = size;
+
+    setStateSet(createStateSet());
+
+    relayoutAll();
+}
+
+void TextBatch::setShaderTechnique(ShaderTechnique technique)
+{
+    // the labels can only be placed by the shaders, so treat NO_TEXT_SHADER as GREYSCALE
+    if (technique==NO_TEXT_SHADER) technique = GREYSCALE;
+
+    if (_shaderTechnique==technique) return;
+
+    _shaderTechnique = technique;
+
+    setStateSet(createStateSet());
+
+    relayoutAll();
+}
+
+void TextBatch::setCharacterSize(float height)
+{
+    if (_characterHeight==height) return;
+
+    _characterHeight = height;
+
+    relayoutAll();
+}
+
+void TextBatch::setCharacterSizeMode(TextBase::CharacterSizeMode mode)
+{
+    if (mode==TextBase::OBJECT_COORDS_WITH_MAXIMUM_SCREEN_SIZE_CAPPED_BY_FONT_HEIGHT) mode = TextBase::OBJECT_COORDS;
+
+    if (_characterSizeMode==mode) return;
+
+    _characterSizeMode = mode;
+
+    setStateSet(createStateSet());
+
+    dirtyBound();
+}
+
+void TextBatch::setAlignment(TextBase::AlignmentType alignment)
+{
+    if (_alignment==alignment) return;
+
+    _alignment = alignment;
+
+    relayoutAll();
+}
+
+unsigned int TextBatch::addLabel(const String& text, const osg::Vec3& position, const osg::Vec4& color)
+{
+    unsigned int index;
+    if (!_freeLabels.empty())
+    {
+        index = _freeLabels.back();
+        _freeLabels.pop_back();
+    }
+    else
+    {
+        index = static_cast<unsigned int>(_labels.size());
+        _labels.push_back(Label());
+    }
+
+    Label& label = _labels[index];
+    label.valid = true;
+    label.text = text;
+    label.position = position;
+    label.color = color;
+
+    layoutLabel(index);
+
+    return index;
+}
+
+void TextBatch::removeLabel(unsigned int index)
+{
+    if (!isLabelValid(index)) return;
+
+    Label& label = _labels[index];
+    releaseQuads(label);
+    label.valid = false;
+    label.text.clear();
+    ++label.modifiedCount;
+
+    _freeLabels.push_back(index);
+
+    dirtyBound();
+}
+
+void TextBatch::clear()
+{
+    _labels.clear();
+    _freeLabels.clear();
+    _quadTextures.clear();
+    _numUsedQuads = 0;
+    _maximumLabelRadius = 0.0f;
+
+    _positions->clear();
+    _offsets->clear();
+    _texcoords->clear();
+    _colors->clear();
+
+    dirtyVertexArrays();
+
+    _primitivesDirty = true;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cameraDataMutex);
+        _cameraDataMap.clear();
+    }
+
+    dirtyBound();
+}
+
+void TextBatch::setLabelText(unsigned int index, const String& text)
+{
+    if (!isLabelValid(index)) return;
+
+    _labels[index].text = text;
+
+    layoutLabel(index);
+}
+
+void TextBatch::setLabelPosition(unsigned int index, const osg::Vec3& position)
+{
+    if (!isLabelValid(index)) return;
+
+    Label& label = _labels[index];
+    label.position = position;
+
+    writeLabelPosition(label);
+
+    dirtyBound();
+}
+
+void TextBatch::setLabelColor(unsigned int index, const osg::Vec4& color)
+{
+    if (!isLabelValid(index)) return;
+
+    Label& label = _labels[index];
+    label.color = color;
+
+    writeLabelColor(label);
+}
+
+void TextBatch::writeLabelPosition(const Label& label)
+{
+    unsigned int begin = label.firstQuad*4;
+    unsigned int end = (label.firstQuad+label.capacity)*4;
+    for(unsigned int i=begin; i<end; ++i) (*_positions)[i] = label.position;
+
+    dirtyVertexRange(POSITION_ARRAY, begin, end);
+}
+
+void TextBatch::writeLabelColor(Label& label)
+{
+    unsigned int begin = label.firstQuad*4;
+    unsigned int end = (label.firstQuad+label.capacity)*4;
+    for(unsigned int i=begin; i<end; ++i) (*_colors)[i] = label.color;
+
+    dirtyVertexRange(COLOR_ARRAY, begin, end);
+
+    // prompt the per Camera colors to be updated.
+    ++label.modifiedCount;
+}
+
+void TextBatch::releaseQuads(Label& label)
+{
+    for(unsigned int q=label.firstQuad; q<label.firstQuad+label.capacity; ++q)
+    {
+        _quadTextures[q] = 0;
+    }
+
+    _numUsedQuads -= label.capacity;
+
+    label.firstQuad = 0;
+    label.numQuads = 0;
+    label.capacity = 0;
+
+    _primitivesDirty = true;
+}
+
+void TextBatch::layoutLabel(unsigned int index)
+{
+    Label& label = _labels[index];
+
+    Font* activefont = getActiveFont();
+
+    std::vector<osg::Vec2> corners;
+    std::vector<osg::Vec2> texcoords;
+    std::vector<GlyphTexture*> textures;
+
+    float hr = _characterHeight;
+    float wr = _characterHeight;
+
+    float lineShiftRatio = 0.0f;
+    switch(_alignment)
+    {
+        case TextBase::CENTER_TOP:
+        case TextBase::CENTER_CENTER:
+        case TextBase::CENTER_BOTTOM:
+        case TextBase::CENTER_BASE_LINE:
+        case TextBase::CENTER_BOTTOM_BASE_LINE:
+            lineShiftRatio = -0.5f;
+            break;
+        case TextBase::RIGHT_TOP:
+        case TextBase::RIGHT_CENTER:
+        case TextBase::RIGHT_BOTTOM:
+        case TextBase::RIGHT_BASE_LINE:
+        case TextBase::RIGHT_BOTTOM_BASE_LINE:
+            lineShiftRatio = -1.0f;
+            break;
+        default:
+            break;
+    }
+
+    osg::BoundingBox bb;
+    osg::BoundingBox lineBB;
+    osg::Vec2 cursor(0.0f, 0.0f);
+    unsigned int previous_charcode = 0;
+    unsigned int startOfLine = 0;
+    unsigned int lineCount = 1;
+
+    String::const_iterator itr = label.text.begin();
+    while(activefont)
+    {
+        if (itr==label.text.end() || *itr=='\n')
+        {
+            // center or right align the completed line.
+            float lineShift = cursor.x() * lineShiftRatio;
+            for(unsigned int i=startOfLine; i<corners.size(); ++i) corners[i].x() += lineShift;
+
+            if (lineBB.valid())
+            {
+                bb.expandBy(osg::Vec3(lineBB.xMin()+lineShift, lineBB.yMin(), 0.0f));
+                bb.expandBy(osg::Vec3(lineBB.xMax()+lineShift, lineBB.yMax(), 0.0f));
+            }
+
+            if (itr==label.text.end()) break;
+
+            ++lineCount;
+            cursor.set(0.0f, cursor.y() - hr);
+            previous_charcode = 0;
+            startOfLine = static_cast<unsigned int>(corners.size());
+            lineBB.init();
+            ++itr;
+            continue;
+        }
+
+        unsigned int charcode = *itr++;
+
+        Glyph* glyph = activefont->getGlyph(_fontSize, charcode);
+        if (!glyph) continue;
+
+        if (previous_charcode)
+        {
+            osg::Vec2 delta(activefont->getKerning(_fontSize, previous_charcode, charcode, KERNING_DEFAULT));
+            cursor.x() += delta.x() * wr;
+            cursor.y() += delta.y() * hr;
+        }
+        previous_charcode = charcode;
+
+        float width = glyph->getWidth() * wr;
+        float height = glyph->getHeight() * hr;
+
+        osg::Vec2 local = cursor + osg::Vec2(glyph->getHorizontalBearing().x() * wr, glyph->getHorizontalBearing().y() * hr);
+
+        const Glyph::TextureInfo* info = glyph->getOrCreateTextureInfo(_shaderTechnique);
+        if (info)
+        {
+            // expand the quad and its texture coordinates by the texel margin, as Text does, to avoid clipping the
+            // edges of antialiased glyphs.
+            osg::Vec2 mintc = info->minTexCoord;
+            osg::Vec2 maxtc = info->maxTexCoord;
+            osg::Vec2 vDiff = maxtc - mintc;
+
+            float fHorizTCMargin = info->texelMargin / info->texture->getTextureWidth();
+            float fVertTCMargin = info->texelMargin / info->texture->getTextureHeight();
+            float fHorizQuadMargin = vDiff.x() == 0.0f ? 0.0f : width * fHorizTCMargin / vDiff.x();
+            float fVertQuadMargin = vDiff.y() == 0.0f ? 0.0f : height * fVertTCMargin / vDiff.y();
+
+            mintc.x() -= fHorizTCMargin;
+            mintc.y() -= fVertTCMargin;
+            maxtc.x() += fHorizTCMargin;
+            maxtc.y() += fVertTCMargin;
+            osg::Vec2 minc = local - osg::Vec2(fHorizQuadMargin, fVertQuadMargin);
+            osg::Vec2 maxc = local + osg::Vec2(width+fHorizQuadMargin, height+fVertQuadMargin);
+
+            corners.push_back(osg::Vec2(minc.x(), maxc.y()));
+            corners.push_back(osg::Vec2(minc.x(), minc.y()));
+            corners.push_back(osg::Vec2(maxc.x(), minc.y()));
+            corners.push_back(osg::Vec2(maxc.x(), maxc.y()));
+
+            texcoords.push_back(osg::Vec2(mintc.x(), maxtc.y()));
+            texcoords.push_back(osg::Vec2(mintc.x(), mintc.y()));
+            texcoords.push_back(osg::Vec2(maxtc.x(), mintc.y()));
+            texcoords.push_back(osg::Vec2(maxtc.x(), maxtc.y()));
+
+            textures.push_back(info->texture);
+
+            lineBB.expandBy(osg::Vec3(local.x(), local.y(), 0.0f));
+            lineBB.expandBy(osg::Vec3(local.x()+width, local.y()+height, 0.0f));
+        }
+
+        cursor.x() += glyph->getHorizontalAdvance() * wr;
+    }
+
+    if (!bb.valid()) bb.set(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+
+    // position the label relative to its position according to the alignment, as TextBase does.
+    osg::Vec2 offset;
+    float bottomBaseLine = -hr*float(lineCount-1);
+    switch(_alignment)
+    {
+        case TextBase::LEFT_TOP:      offset.set(bb.xMin(), bb.yMax()); break;
+        case TextBase::LEFT_CENTER:   offset.set(bb.xMin(), (bb.yMax()+bb.yMin())*0.5f); break;
+        case TextBase::LEFT_BOTTOM:   offset.set(bb.xMin(), bb.yMin()); break;
+
+        case TextBase::CENTER_TOP:    offset.set((bb.xMax()+bb.xMin())*0.5f, bb.yMax()); break;
+        case TextBase::CENTER_CENTER: offset.set((bb.xMax()+bb.xMin())*0.5f, (bb.yMax()+bb.yMin())*0.5f); break;
+        case TextBase::CENTER_BOTTOM: offset.set((bb.xMax()+bb.xMin())*0.5f, bb.yMin()); break;
+
+        case TextBase::RIGHT_TOP:     offset.set(bb.xMax(), bb.yMax()); break;
+        case TextBase::RIGHT_CENTER:  offset.set(bb.xMax(), (bb.yMax()+bb.yMin())*0.5f); break;
+        case TextBase::RIGHT_BOTTOM:  offset.set(bb.xMax(), bb.yMin()); break;
+
+        case TextBase::LEFT_BASE_LINE:   offset.set(bb.xMin(), 0.0f); break;
+        case TextBase::CENTER_BASE_LINE: offset.set((bb.xMax()+bb.xMin())*0.5f, 0.0f); break;
+        case TextBase::RIGHT_BASE_LINE:  offset.set(bb.xMax(), 0.0f); break;
+
+        case TextBase::LEFT_BOTTOM_BASE_LINE:   offset.set(bb.xMin(), bottomBaseLine); break;
+        case TextBase::CENTER_BOTTOM_BASE_LINE: offset.set((bb.xMax()+bb.xMin())*0.5f, bottomBaseLine); break;
+        case TextBase::RIGHT_BOTTOM_BASE_LINE:  offset.set(bb.xMax(), bottomBaseLine); break;
+    }
+
+    for(std::vector<osg::Vec2>::iterator citr = corners.begin(); citr != corners.end(); ++citr) *citr -= offset;
+
+    label.bound.set(bb.xMin()-offset.x(), bb.yMin()-offset.y(), 0.0f, bb.xMax()-offset.x(), bb.yMax()-offset.y(), 0.0f);
+    _maximumLabelRadius = osg::maximum(_maximumLabelRadius, osg::maximum(label.bound.corner(0).length(), label.bound.corner(3).length()));
+    _maximumLabelRadius = osg::maximum(_maximumLabelRadius, osg::maximum(label.bound.corner(1).length(), label.bound.corner(2).length()));
+
+    // reuse the label's quads when they have room, otherwise allocate new ones at the end of the arrays.
+    unsigned int numQuads = static_cast<unsigned int>(textures.size());
+    bool resized = false;
+    if (numQuads>label.capacity)
+    {
+        releaseQuads(label);
+
+        label.firstQuad = static_cast<unsigned int>(_quadTextures.size());
+        label.capacity = numQuads;
+        _numUsedQuads += numQuads;
+
+        unsigned int numVertices = (label.firstQuad+numQuads)*4;
+        _quadTextures.resize(label.firstQuad+numQuads, 0);
+        _positions->resize(numVertices);
+        _offsets->resize(numVertices);
+        _texcoords->resize(numVertices);
+        _colors->resize(numVertices);
+        resized = true;
+    }
+    label.numQuads = numQuads;
+
+    for(unsigned int q=0; q<label.capacity; ++q)
+    {
+        unsigned int v = (label.firstQuad+q)*4;
+        if (q<numQuads)
+        {
+            _quadTextures[label.firstQuad+q] = textures[q];
+            for(unsigned int c=0; c<4; ++c)
+            {
+                (*_offsets)[v+c] = corners[q*4+c];
+                (*_texcoords)[v+c] = texcoords[q*4+c];
+            }
+        }
+        else
+        {
+            _quadTextures[label.firstQuad+q] = 0;
+        }
+    }
+
+    writeLabelPosition(label);
+    writeLabelColor(label);
+
+    // resizing the arrays moves them within the buffer object, so only then are they copied as a whole.
+    if (resized)
+    {
+        dirtyVertexArrays();
+    }
+    else
+    {
+        dirtyVertexRange(OFFSET_ARRAY, label.firstQuad*4, (label.firstQuad+label.capacity)*4);
+        dirtyVertexRange(TEXCOORD_ARRAY, label.firstQuad*4, (label.firstQuad+label.capacity)*4);
+    }
+
+    _primitivesDirty = true;
+
+    dirtyBound();
+
+    // reclaim the quads left behind by labels that have grown or been removed once they outnumber those in use.
+    unsigned int numUnusedQuads = static_cast<unsigned int>(_quadTextures.size()) - _numUsedQuads;
+    if (numUnusedQuads>1024 && numUnusedQuads>_numUsedQuads) compact();
+}
+
+void TextBatch::relayoutAll()
+{
+    _maximumLabelRadius = 0.0f;
+
+    for(unsigned int i=0; i<_labels.size(); ++i)
+    {
+        if (_labels[i].valid) layoutLabel(i);
+    }
+}
+
+void TextBatch::compact()
+{
+    unsigned int numQuads = 0;
+    for(Labels::iterator itr = _labels.begin(); itr != _labels.end(); ++itr)
+    {
+        if (itr->valid) numQuads += itr->numQuads;
+    }
+
+    std::vector<osg::Vec3> positions; positions.reserve(numQuads*4);
+    std::vector<osg::Vec2> offsets; offsets.reserve(numQuads*4);
+    std::vector<osg::Vec2> texcoords; texcoords.reserve(numQuads*4);
+    std::vector<osg::Vec4> colors; colors.reserve(numQuads*4);
+    std::vector<GlyphTexture*> quadTextures; quadTextures.reserve(numQuads);
+
+    for(Labels::iterator itr = _labels.begin(); itr != _labels.end(); ++itr)
+    {
+        Label& label = *itr;
+        if (!label.valid) continue;
+
+        unsigned int begin = label.firstQuad*4;
+        unsigned int end = (label.firstQuad+label.numQuads)*4;
+
+        positions.insert(positions.end(), _positions->begin()+begin, _positions->begin()+end);
+        offsets.insert(offsets.end(), _offsets->begin()+begin, _offsets->begin()+end);
+        texcoords.insert(texcoords.end(), _texcoords->begin()+begin, _texcoords->begin()+end);
+        colors.insert(colors.end(), _colors->begin()+begin, _colors->begin()+end);
+
+        label.firstQuad = static_cast<unsigned int>(quadTextures.size());
+        label.capacity = label.numQuads;
+        ++label.modifiedCount;
+
+        quadTextures.insert(quadTextures.end(), _quadTextures.begin()+begin/4, _quadTextures.begin()+end/4);
+    }
+
+    _positions->asVector().swap(positions);
+    _offsets->asVector().swap(offsets);
+    _texcoords->asVector().swap(texcoords);
+    _colors->asVector().swap(colors);
+    _quadTextures.swap(quadTextures);
+    _numUsedQuads = numQuads;
+
+    dirtyVertexArrays();
+
+    _primitivesDirty = true;
+}
+
+osg::Array* TextBatch::getVertexArray(VertexArray array) const
+{
+    switch(array)
+    {
+        case POSITION_ARRAY: return _positions.get();
+        case OFFSET_ARRAY:   return _offsets.get();
+        case TEXCOORD_ARRAY: return _texcoords.get();
+        case COLOR_ARRAY:    return _colors.get();
+        default:             return 0;
+    }
+}
+
+void TextBatch::dirtyVertexRange(VertexArray array, unsigned int begin, unsigned int end)
+{
+    if (begin>=end) return;
+
+    for(unsigned int i=0; i<_modifiedRanges.size(); ++i)
+    {
+        _modifiedRanges[i].ranges[array].add(begin, end);
+    }
+}
+
+void TextBatch::dirtyVertexArrays()
+{
+    for(unsigned int a=0; a<NUM_VERTEX_ARRAYS; ++a)
+    {
+        getVertexArray(static_cast<VertexArray>(a))->dirty();
+    }
+
+    // the whole arrays are copied to every context, covering the ranges modified so far.
+    for(unsigned int i=0; i<_modifiedRanges.size(); ++i)
+    {
+        _modifiedRanges[i] = ModifiedRanges();
+    }
+}
+
+void TextBatch::copyModifiedRanges(osg::State& state, bool usingVertexBufferObjects) const
+{
+    ModifiedRanges& modifiedRanges = _modifiedRanges[state.getContextID()];
+
+    osg::GLBufferObject* glBufferObject = usingVertexBufferObjects ? _vbo->getOrCreateGLBufferObject(state.getContextID()) : 0;
+    if (glBufferObject)
+    {
+        for(unsigned int a=0; a<NUM_VERTEX_ARRAYS; ++a)
+        {
+            copyVertexRange(state, glBufferObject, getVertexArray(static_cast<VertexArray>(a)), modifiedRanges.ranges[a]);
+        }
+    }
+
+    modifiedRanges = ModifiedRanges();
+}
+
+void TextBatch::copyModifiedColors(osg::State& state, CameraData& cameraData, bool usingVertexBufferObjects) const
+{
+    VertexRange& range = cameraData.modifiedColors[state.getContextID()];
+
+    osg::GLBufferObject* glBufferObject = usingVertexBufferObjects ? cameraData.colors->getOrCreateGLBufferObject(state.getContextID()) : 0;
+    if (glBufferObject) copyVertexRange(state, glBufferObject, cameraData.colors.get(), range);
+
+    range = VertexRange();
+}
+
+void TextBatch::copyVertexRange(osg::State& state, osg::GLBufferObject* glBufferObject, const osg::Array* array, const VertexRange& range)
+{
+    // a dirty buffer object is compiled as a whole on binding, which copies all the arrays dirtied since it was last compiled.
+    if (range.empty() || glBufferObject->isDirty()) return;
+
+    state.getCurrentVertexArrayState()->bindVertexBufferObject(glBufferObject);
+
+    unsigned int elementSize = array->getElementSize();
+    state.get<osg::GLExtensions>()->glBufferSubData(GL_ARRAY_BUFFER_ARB,
+                                                    glBufferObject->getOffset(array->getBufferIndex()) + range.begin*elementSize,
+                                                    (range.end-range.begin)*elementSize,
+                                                    static_cast<const char*>(array->getDataPointer()) + range.begin*elementSize);
+}
+
+void TextBatch::updatePrimitivesIfRequired() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_primitivesMutex);
+
+    if (!_primitivesDirty) return;
+    _primitivesDirty = false;
+
+    for(TexturePrimitivesMap::iterator itr = _texturePrimitivesMap.begin();
+        itr != _texturePrimitivesMap.end();
+        ++itr)
+    {
+        itr->second->clear();
+    }
+
+    for(unsigned int q=0; q<_quadTextures.size(); ++q)
+    {
+        GlyphTexture* glyphTexture = _quadTextures[q];
+        if (!glyphTexture) continue;
+
+        osg::ref_ptr<osg::DrawElementsUInt>& primitives = _texturePrimitivesMap[glyphTexture];
+        if (!primitives)
+        {
+            primitives = new osg::DrawElementsUInt(GL_TRIANGLES);
+            primitives->setBufferObject(_ebo.get());
+        }
+
+        unsigned int lt = q*4;
+        unsigned int lb = lt+1;
+        unsigned int rb = lt+2;
+        unsigned int rt = lt+3;
+
+        primitives->push_back(lt);
+        primitives->push_back(lb);
+        primitives->push_back(rb);
+
+        primitives->push_back(lt);
+        primitives->push_back(rb);
+        primitives->push_back(rt);
+    }
+
+    for(TexturePrimitivesMap::iterator itr = _texturePrimitivesMap.begin();
+        itr != _texturePrimitivesMap.end();
+        ++itr)
+    {
+        itr->second->dirty();
+    }
+}
+
+namespace
+{
+
+struct DeclutterCandidate
+{
+    DeclutterCandidate(unsigned int i, double d, const osg::Vec2& minc, const osg::Vec2& maxc):
+        index(i), depth(d), min(minc), max(maxc) {}
+
+    bool operator < (const DeclutterCandidate& rhs) const { return depth < rhs.depth; }
+
+    bool overlaps(const DeclutterCandidate& rhs) const
+    {
+        return min.x()<rhs.max.x() && rhs.min.x()<max.x() && min.y()<rhs.max.y() && rhs.min.y()<max.y();
+    }
+
+    unsigned int    index;
+    double          depth;
+    osg::Vec2       min;
+    osg::Vec2       max;
+};
+
+}
+
+void TextBatch::declutter(osgUtil::CullVisitor& cv)
+{
+    const osg::Viewport* viewport = cv.getViewport();
+    if (!viewport || viewport->width()<=0.0 || viewport->height()<=0.0) return;
+
+    osg::Camera* camera = cv.getCurrentCamera();
+
+    // each Camera is only culled by one thread at a time, so its own state needs no locking once it is found.
+    CameraData* cameraData = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cameraDataMutex);
+
+        // drop the state of deleted Cameras.
+        for(CameraDataMap::iterator itr = _cameraDataMap.begin(); itr != _cameraDataMap.end(); )
+        {
+            if (!itr->first.valid()) _cameraDataMap.erase(itr++);
+            else ++itr;
+        }
+
+        osg::ref_ptr<CameraData>& cd = _cameraDataMap[osg::observer_ptr<osg::Camera>(camera)];
+        if (!cd) cd = new CameraData;
+        cameraData = cd.get();
+    }
+
+    // declutter once per frame for each Camera, even when the TextBatch appears more than once below it.
+    if (cv.getFrameStamp())
+    {
+        unsigned int frameNumber = cv.getFrameStamp()->getFrameNumber();
+        if (cameraData->frameNumber==frameNumber) return;
+        cameraData->frameNumber = frameNumber;
+    }
+
+    osg::Matrixd modelview(*cv.getModelViewMatrix());
+    osg::Matrixd projectionWindow = osg::Matrixd(*cv.getProjectionMatrix()) * viewport->computeWindowMatrix();
+
+    osg::Vec2 viewportMin(viewport->x(), viewport->y());
+    osg::Vec2 viewportMax(viewport->x()+viewport->width(), viewport->y()+viewport->height());
+
+    // project the bounds of the labels in front of the eye point onto the viewport.
+    std::vector<DeclutterCandidate> candidates;
+    for(unsigned int i=0; i<_labels.size(); ++i)
+    {
+        const Label& label = _labels[i];
+        if (!label.valid || label.numQuads==0) continue;
+
+        osg::Vec3d eye = osg::Vec3d(label.position) * modelview;
+        if (eye.z()>=0.0) continue;
+
+        osg::Vec3d window = eye * projectionWindow;
+        if (window.z()<0.0 || window.z()>1.0) continue;
+
+        osg::Vec2 minc, maxc;
+        if (_characterSizeMode==TextBase::SCREEN_COORDS)
+        {
+            minc.set(window.x()+label.bound.xMin(), window.y()+label.bound.yMin());
+            maxc.set(window.x()+label.bound.xMax(), window.y()+label.bound.yMax());
+        }
+        else
+        {
+            osg::Vec3d lowerLeft = (eye + osg::Vec3d(label.bound.xMin(), label.bound.yMin(), 0.0)) * projectionWindow;
+            osg::Vec3d upperRight = (eye + osg::Vec3d(label.bound.xMax(), label.bound.yMax(), 0.0)) * projectionWindow;
+            minc.set(osg::minimum(lowerLeft.x(), upperRight.x()), osg::minimum(lowerLeft.y(), upperRight.y()));
+            maxc.set(osg::maximum(lowerLeft.x(), upperRight.x()), osg::maximum(lowerLeft.y(), upperRight.y()));
+        }
+
+        if (maxc.x()<viewportMin.x() || minc.x()>viewportMax.x() || maxc.y()<viewportMin.y() || minc.y()>viewportMax.y()) continue;
+
+        candidates.push_back(DeclutterCandidate(i, -eye.z(), minc, maxc));
+    }
+
+    // accept labels nearest first, rejecting those that overlap a label already accepted, found by binning the accepted
+    // labels into a grid of cells over the viewport.
+    std::sort(candidates.begin(), candidates.end());
+
+    int numColumns = static_cast<int>(viewport->width())/s_declutterCellSize + 1;
+    int numRows = static_cast<int>(viewport->height())/s_declutterCellSize + 1;
+    std::vector< std::vector<unsigned int> > cells(numColumns*numRows);
+
+    std::vector<bool> visible(_labels.size(), false);
+    for(unsigned int c=0; c<candidates.size(); ++c)
+    {
+        const DeclutterCandidate& candidate = candidates[c];
+
+        int columnBegin = osg::clampBetween(static_cast<int>((candidate.min.x()-viewportMin.x())/s_declutterCellSize), 0, numColumns-1);
+        int columnEnd = osg::clampBetween(static_cast<int>((candidate.max.x()-viewportMin.x())/s_declutterCellSize), 0, numColumns-1);
+        int rowBegin = osg::clampBetween(static_cast<int>((candidate.min.y()-viewportMin.y())/s_declutterCellSize), 0, numRows-1);
+        int rowEnd = osg::clampBetween(static_cast<int>((candidate.max.y()-viewportMin.y())/s_declutterCellSize), 0, numRows-1);
+
+        bool occluded = false;
+        for(int row=rowBegin; row<=rowEnd && !occluded; ++row)
+        {
+            for(int column=columnBegin; column<=columnEnd && !occluded; ++column)
+            {
+                const std::vector<unsigned int>& cell = cells[row*numColumns+column];
+                for(std::vector<unsigned int>::const_iterator itr = cell.begin(); itr != cell.end() && !occluded; ++itr)
+                {
+                    occluded = candidates[*itr].overlaps(candidate);
+                }
+            }
+        }
+
+        if (occluded) continue;
+
+        visible[candidate.index] = true;
+
+        for(int row=rowBegin; row<=rowEnd; ++row)
+        {
+            for(int column=columnBegin; column<=columnEnd; ++column)
+            {
+                cells[row*numColumns+column].push_back(c);
+            }
+        }
+    }
+
+    // fade the labels in or out, writing the faded colors of any label whose fade or base color has changed.
+    if (!cameraData->colors || cameraData->colors->size()!=_colors->size())
+    {
+        cameraData->colors = new osg::Vec4Array(osg::Array::BIND_PER_VERTEX);
+        cameraData->colors->assign(_colors->begin(), _colors->end());
+        cameraData->colors->setBufferObject(new osg::VertexBufferObject);
+        cameraData->modifiedCounts.clear();
+
+        // the new buffer object is compiled as a whole, so any ranges still to be copied are covered.
+        for(unsigned int i=0; i<cameraData->modifiedColors.size(); ++i)
+        {
+            cameraData->modifiedColors[i] = VertexRange();
+        }
+    }
+
+    cameraData->alphas.resize(_labels.size(), 0.0f);
+    cameraData->modifiedCounts.resize(_labels.size(), 0xffffffff);
+
+    VertexRange modifiedColors;
+    for(unsigned int i=0; i<_labels.size(); ++i)
+    {
+        const Label& label = _labels[i];
+        if (!label.valid)
+        {
+            // removed labels fade in from scratch should their index be reused.
+            cameraData->alphas[i] = 0.0f;
+            continue;
+        }
+
+        float alpha = cameraData->alphas[i];
+        float newAlpha = visible[i] ? osg::minimum(alpha+_fadeSpeed, 1.0f) : osg::maximum(alpha-_fadeSpeed, 0.0f);
+
+        if (newAlpha==alpha && cameraData->modifiedCounts[i]==label.modifiedCount) continue;
+
+        cameraData->alphas[i] = newAlpha;
+        cameraData->modifiedCounts[i] = label.modifiedCount;
+
+        osg::Vec4 color(label.color.r(), label.color.g(), label.color.b(), label.color.a()*newAlpha);
+        unsigned int begin = label.firstQuad*4;
+        unsigned int end = (label.firstQuad+label.numQuads)*4;
+        for(unsigned int v=begin; v<end; ++v) (*cameraData->colors)[v] = color;
+
+        modifiedColors.add(begin, end);
+    }
+
+    // copy just the modified colors to each context's buffer object before the next draw, as with the shared arrays.
+    if (!modifiedColors.empty())
+    {
+        for(unsigned int i=0; i<cameraData->modifiedColors.size(); ++i)
+        {
+            cameraData->modifiedColors[i].add(modifiedColors.begin, modifiedColors.end);
+        }
+    }
+}
+
+osg::BoundingBox TextBatch::computeBoundingBox() const
+{
+    osg::BoundingBox bb;
+
+    for(Labels::const_iterator itr = _labels.begin(); itr != _labels.end(); ++itr)
+    {
+        if (itr->valid && itr->numQuads>0) bb.expandBy(itr->position);
+    }
+
+    // the labels face the screen so may extend in any direction from their positions.
+    if (bb.valid() && _characterSizeMode!=TextBase::SCREEN_COORDS)
+    {
+        osg::Vec3 radius(_maximumLabelRadius, _maximumLabelRadius, _maximumLabelRadius);
+        bb.set(bb._min-radius, bb._max+radius);
+    }
+
+    return bb;
+}
+
+osg::VertexArrayState* TextBatch::createVertexArrayStateImplementation(osg::RenderInfo& renderInfo) const
+{
+    osg::State& state = *renderInfo.getState();
+
+    osg::VertexArrayState* vas = new osg::VertexArrayState(&state);
+
+    vas->assignVertexArrayDispatcher();
+    vas->assignColorArrayDispatcher();
+    vas->assignTexCoordArrayDispatcher(2);
+
+    if (state.useVertexArrayObject(_useVertexArrayObject))
+    {
+        vas->generateVertexArrayObject();
+    }
+
+    return vas;
+}
+
+void TextBatch::drawImplementation(osg::RenderInfo& renderInfo) const
+{
+    osg::State& state = *renderInfo.getState();
+
+    updatePrimitivesIfRequired();
+
+    if (_texturePrimitivesMap.empty()) return;
+
+    const osg::Vec4Array* colors = _colors.get();
+    CameraData* cameraData = 0;
+    if (_declutter)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cameraDataMutex);
+        CameraDataMap::const_iterator itr = _cameraDataMap.find(osg::observer_ptr<osg::Camera>(renderInfo.getCurrentCamera()));
+        if (itr != _cameraDataMap.end() && itr->second->colors.valid() && itr->second->colors->size()==_colors->size())
+        {
+            cameraData = itr->second.get();
+            colors = cameraData->colors.get();
+        }
+    }
+
+    if (_characterSizeMode==TextBase::SCREEN_COORDS)
+    {
+        // the vertex shader needs the viewport size to convert the glyph offsets from pixels.
+        const osg::Program::PerContextProgram* pcp = state.getLastAppliedProgramObject();
+        const osg::Viewport* viewport = state.getCurrentViewport();
+        if (pcp && viewport)
+        {
+            osg::ref_ptr<osg::Uniform>& uniform = _viewportSizeUniforms[state.getContextID()];
+            osg::Vec2 viewportSize(viewport->width(), viewport->height());
+            if (!uniform) uniform = new osg::Uniform("viewportSize", viewportSize);
+            else uniform->set(viewportSize);
+
+            pcp->apply(*uniform);
+        }
+    }
+
+    osg::VertexArrayState* vas = state.getCurrentVertexArrayState();
+    bool usingVertexBufferObjects = state.useVertexBufferObject(_supportsVertexBufferObjects && _useVertexBufferObjects);
+    bool usingVertexArrayObjects = usingVertexBufferObjects && state.useVertexArrayObject(_useVertexArrayObject);
+    bool requiresSetArrays = !usingVertexBufferObjects || !usingVertexArrayObjects || vas->getRequiresSetArrays();
+
+    copyModifiedRanges(state, usingVertexBufferObjects);
+    if (cameraData) copyModifiedColors(state, *cameraData, usingVertexBufferObjects);
+
+    if (requiresSetArrays)
+    {
+        vas->lazyDisablingOfVertexAttributes();
+        vas->setVertexArray(state, _positions.get());
+        vas->setColorArray(state, colors);
+        vas->setTexCoordArray(state, 0, _texcoords.get());
+        vas->setTexCoordArray(state, 1, _offsets.get());
+        vas->applyDisablingOfVertexAttributes(state);
+    }
+    else if (_declutter)
+    {
+        // the vertex array object may hold the colors of another Camera.
+        vas->setColorArray(state, colors);
+    }
+
+    glDepthMask(GL_FALSE);
+
+    for(TexturePrimitivesMap::const_iterator itr = _texturePrimitivesMap.begin();
+        itr != _texturePrimitivesMap.end();
+        ++itr)
+    {
+        if (itr->second->empty()) continue;
+
+        state.applyTextureAttribute(0, itr->first.get());
+
+        itr->second->draw(state, usingVertexBufferObjects);
+    }
+
+    state.haveAppliedAttribute(osg::StateAttribute::DEPTH);
+
+    if (usingVertexBufferObjects && !usingVertexArrayObjects)
+    {
+        // unbind the VBO's if any are used.
+        vas->unbindVertexBufferObject();
+        vas->unbindElementBufferObject();
+    }
+}
+
+void TextBatch::resizeGLObjectBuffers(unsigned int maxSize)
+{
+    if (_font.valid()) _font->resizeGLObjectBuffers(maxSize);
+
+    _positions->resizeGLObjectBuffers(maxSize);
+    _offsets->resizeGLObjectBuffers(maxSize);
+    _texcoords->resizeGLObjectBuffers(maxSize);
+    _colors->resizeGLObjectBuffers(maxSize);
+
+    for(TexturePrimitivesMap::iterator itr = _texturePrimitivesMap.begin();
+        itr != _texturePrimitivesMap.end();
+        ++itr)
+    {
+        itr->second->resizeGLObjectBuffers(maxSize);
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cameraDataMutex);
+        for(CameraDataMap::iterator itr = _cameraDataMap.begin();
+            itr != _cameraDataMap.end();
+            ++itr)
+        {
+            if (itr->second->colors.valid()) itr->second->colors->resizeGLObjectBuffers(maxSize);
+            itr->second->modifiedColors.resize(maxSize);
+        }
+    }
+
+    _viewportSizeUniforms.resize(maxSize);
+    _modifiedRanges.resize(maxSize);
+
+    Drawable::resizeGLObjectBuffers(maxSize);
+}
+
+void TextBatch::releaseGLObjects(osg::State* state) const
+{
+    if (_font.valid()) _font->releaseGLObjects(state);
+
+    _positions->releaseGLObjects(state);
+    _offsets->releaseGLObjects(state);
+    _texcoords->releaseGLObjects(state);
+    _colors->releaseGLObjects(state);
+
+    for(TexturePrimitivesMap::const_iterator itr = _texturePrimitivesMap.begin();
+        itr != _texturePrimitivesMap.end();
+        ++itr)
+    {
+        itr->second->releaseGLObjects(state);
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cameraDataMutex);
+        for(CameraDataMap::const_iterator itr = _cameraDataMap.begin();
+            itr != _cameraDataMap.end();
+            ++itr)
+        {
+            if (itr->second->colors.valid()) itr->second->colors->releaseGLObjects(state);
+        }
+    }
+
+    Drawable::releaseGLObjects(state);
+}
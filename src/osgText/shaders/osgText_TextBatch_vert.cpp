@@ -0,0 +1,31 @@
+char osgText_TextBatch_vert[] = "$OSG_GLSL_VERSION\n"
+                                "$OSG_PRECISION_FLOAT\n"
+                                "\n"
+                                "#pragma import_defines( SCREEN_COORDS )\n"
+                                "\n"
+                                "uniform vec2 viewportSize;\n"
+                                "\n"
+                                "$OSG_VARYING_OUT vec2 texCoord;\n"
+                                "$OSG_VARYING_OUT vec4 vertexColor;\n"
+                                "\n"
+                                "void main(void)\n"
+                                "{\n"
+                                "    // gl_Vertex is the label position, gl_MultiTexCoord1 the glyph quad corner relative to it.\n"
+                                "    vec4 eyePosition = gl_ModelViewMatrix * gl_Vertex;\n"
+                                "\n"
+                                "#ifdef SCREEN_COORDS\n"
+                                "    gl_Position = gl_ProjectionMatrix * eyePosition;\n"
+                                "    gl_Position.xy += gl_MultiTexCoord1.xy * (2.0 / viewportSize) * gl_Position.w;\n"
+                                "#else\n"
+                                "    eyePosition.xy += gl_MultiTexCoord1.xy * eyePosition.w;\n"
+                                "    gl_Position = gl_ProjectionMatrix * eyePosition;\n"
+                                "#endif\n"
+                                "\n"
+                                "    texCoord = gl_MultiTexCoord0.xy;\n"
+                                "    vertexColor = gl_Color;\n"
+                                "\n"
+                                "#if !defined(GL_ES) && __VERSION__<140\n"
+                                "    gl_ClipVertex = eyePosition;\n"
+                                "#endif\n"
+                                "}\n"
+                                "\n";
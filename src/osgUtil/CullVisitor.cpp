@@ -52,7 +52,10 @@ CullVisitor::CullVisitor():
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
-    _numberOfEncloseOverrideRenderBinDetails(0)
+    _numRenderLeavesAllocated(0),
+    _numRenderLeavesReused(0),
+    _numberOfEncloseOverrideRenderBinDetails(0),
+    _currentParallelCullFragmentIndex(0)
 {
     _identifier = new Identifier;
 }
@@ -67,8 +70,12 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
+    _numRenderLeavesAllocated(0),
+    _numRenderLeavesReused(0),
     _numberOfEncloseOverrideRenderBinDetails(0),
-    _identifier(rhs._identifier)
+    _identifier(rhs._identifier),
+    _parallelCullTaskPool(rhs._parallelCullTaskPool),
+    _currentParallelCullFragmentIndex(0)
 {
 }
 
@@ -130,9 +137,14 @@ void CullVisitor::reset()
 
     // reset the resuse lists.
     _currentReuseRenderLeafIndex = 0;
+    _numRenderLeavesAllocated = 0;
+    _numRenderLeavesReused = 0;
 
     _nearPlaneCandidateMap.clear();
     _farPlaneCandidateMap.clear();
+
+    // the fragments used for parallel cull last frame can now be reused.
+    _currentParallelCullFragmentIndex = 0;
 }
 
 float CullVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
@@ -1746,3 +1758,362 @@ void CullVisitor::apply(osg::OcclusionQueryNode& node)
     popCurrentMask();
 }
 
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Parallel cull
+//
+// Each child of a Group culled in parallel is traversed by its own fragment CullVisitor, which starts from a copy of
+// the CullStack, node path and cull settings of the parent CullVisitor, with a StateGraph that mirrors the current
+// StateGraph parental chain and a RenderStage/RenderBin chain that mirrors the current render bin. Once all the
+// children have been culled the fragments are merged back in child order, which reproduces the serial result:
+// state graphs are appended to the bins in the order in which they first received a leaf, render leaves keep their
+// order and have their traversal order numbers offset, and the near/far values are combined.
+//
+struct CullVisitor::ParallelCullFragment : public osg::Operation
+{
+    ParallelCullFragment():
+        osg::Operation("ParallelCullFragment", false),
+        _clearMask(0) {}
+
+    virtual void operator () (osg::Object*)
+    {
+        if (_child.valid()) _child->accept(*_cullVisitor);
+    }
+
+    osg::ref_ptr<CullVisitor>   _cullVisitor;
+    osg::ref_ptr<osg::Node>     _child;
+
+    // clear settings of the parent's RenderStage when forked, used to detect a ClearNode changing them.
+    GLbitfield                  _clearMask;
+    osg::Vec4                   _clearColor;
+};
+
+void CullVisitor::traverseChildrenInParallel(osg::Group& group)
+{
+    unsigned int numChildren = group.getNumChildren();
+    if (!_parallelCullTaskPool.valid() || numChildren<2 || !_currentStateGraph || !_currentRenderBin)
+    {
+        traverse(group);
+        return;
+    }
+
+    ParallelCullFragmentList::size_type firstFragment = _currentParallelCullFragmentIndex;
+
+    osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+    for(unsigned int i=0; i<numChildren; ++i)
+    {
+        if (_currentParallelCullFragmentIndex>=_parallelCullFragments.size())
+        {
+            _parallelCullFragments.push_back(new ParallelCullFragment);
+        }
+
+        ParallelCullFragment* fragment = _parallelCullFragments[_currentParallelCullFragmentIndex++].get();
+        forkParallelCullFragment(*fragment, group.getChild(i));
+
+        _parallelCullTaskPool->add(fragment, taskSet.get());
+    }
+
+    _parallelCullTaskPool->wait(taskSet.get());
+
+    for(ParallelCullFragmentList::size_type i=firstFragment; i<_currentParallelCullFragmentIndex; ++i)
+    {
+        mergeParallelCullFragment(*_parallelCullFragments[i]);
+    }
+}
+
+void CullVisitor::forkParallelCullFragment(ParallelCullFragment& fragment, osg::Node* child)
+{
+    if (!fragment._cullVisitor.valid()) fragment._cullVisitor = clone();
+
+    CullVisitor* cv = fragment._cullVisitor.get();
+    cv->reset();
+
+    // NodeVisitor and cull settings
+    cv->setTraversalMode(getTraversalMode());
+    cv->setTraversalMask(getTraversalMask());
+    cv->setNodeMaskOverride(getNodeMaskOverride());
+    cv->setTraversalNumber(getTraversalNumber());
+    cv->_frameStamp = _frameStamp;
+    cv->_databaseRequestHandler = _databaseRequestHandler;
+    cv->_imageRequestHandler = _imageRequestHandler;
+    cv->setUserDataContainer(getUserDataContainer());
+    cv->setCullSettings(*this);
+    cv->setRenderInfo(_renderInfo);
+    cv->_identifier = _identifier;
+    cv->_parallelCullTaskPool = _parallelCullTaskPool;
+
+    // traversal state
+    cv->copyCullStackState(*this);
+    cv->_nodePath = _nodePath;
+    cv->_numberOfEncloseOverrideRenderBinDetails = _numberOfEncloseOverrideRenderBinDetails;
+
+    // replicate the StateGraph parental chain.
+    typedef std::vector<StateGraph*> StateGraphStack;
+    StateGraphStack stateGraphParentalChain;
+    for(StateGraph* sg = _currentStateGraph; sg; sg = sg->_parent)
+    {
+        stateGraphParentalChain.push_back(sg);
+    }
+
+    if (!cv->_rootStateGraph.valid()) cv->_rootStateGraph = new StateGraph;
+    cv->_rootStateGraph->setStateSet(stateGraphParentalChain.back()->getStateSet());
+    cv->_currentStateGraph = cv->_rootStateGraph.get();
+    for(StateGraphStack::reverse_iterator ritr = stateGraphParentalChain.rbegin()+1;
+        ritr != stateGraphParentalChain.rend();
+        ++ritr)
+    {
+        cv->_currentStateGraph = cv->_currentStateGraph->find_or_insert((*ritr)->getStateSet());
+    }
+
+    // set up a RenderStage with the settings of the current stage, and replicate the RenderBin chain down to the current bin.
+    RenderStage* stage = getCurrentRenderStage();
+    if (!cv->_rootRenderStage.valid())
+    {
+        cv->_rootRenderStage = _rootRenderStage.valid() ? osg::cloneType(_rootRenderStage.get()) : new RenderStage;
+    }
+
+    RenderStage* fragmentStage = cv->_rootRenderStage.get();
+    fragmentStage->setCamera(stage->getCamera());
+    fragmentStage->setViewport(stage->getViewport());
+    fragmentStage->setInitialViewMatrix(stage->getInitialViewMatrix());
+    fragmentStage->setDrawBuffer(stage->getDrawBuffer(), stage->getDrawBufferApplyMask());
+    fragmentStage->setReadBuffer(stage->getReadBuffer(), stage->getReadBufferApplyMask());
+    fragmentStage->setColorMask(stage->getColorMask());
+    fragmentStage->setClearMask(stage->getClearMask());
+    fragmentStage->setClearColor(stage->getClearColor());
+    fragmentStage->setClearAccum(stage->getClearAccum());
+    fragmentStage->setClearDepth(stage->getClearDepth());
+    fragmentStage->setClearStencil(stage->getClearStencil());
+
+    fragment._clearMask = stage->getClearMask();
+    fragment._clearColor = stage->getClearColor();
+
+    std::vector<RenderBin*> renderBinChain;
+    for(RenderBin* rb = _currentRenderBin; rb && rb->getParent(); rb = rb->getParent())
+    {
+        renderBinChain.push_back(rb);
+    }
+
+    cv->_currentRenderBin = fragmentStage;
+    for(std::vector<RenderBin*>::reverse_iterator ritr = renderBinChain.rbegin();
+        ritr != renderBinChain.rend();
+        ++ritr)
+    {
+        cv->_currentRenderBin = cv->_currentRenderBin->find_or_insert((*ritr)->getBinNum(), *ritr);
+    }
+
+    fragment._child = child;
+}
+
+namespace
+{
+    typedef std::map<StateGraph*, StateGraph*> StateGraphMap;
+
+    StateGraph* findMatchingStateGraph(StateGraph* sg, StateGraphMap& stateGraphMap)
+    {
+        StateGraphMap::iterator itr = stateGraphMap.find(sg);
+        if (itr!=stateGraphMap.end()) return itr->second;
+
+        // the fragment's root StateGraph is always in the map, so walking up the parents always terminates.
+        StateGraph* matching = findMatchingStateGraph(sg->_parent, stateGraphMap)->find_or_insert(sg->getStateSet());
+        stateGraphMap[sg] = matching;
+        return matching;
+    }
+
+    void offsetTraversalOrder(RenderBin* bin, unsigned int offset)
+    {
+        for(RenderBin::StateGraphList::iterator sg_itr = bin->getStateGraphList().begin();
+            sg_itr != bin->getStateGraphList().end();
+            ++sg_itr)
+        {
+            for(StateGraph::LeafList::iterator l_itr = (*sg_itr)->_leaves.begin();
+                l_itr != (*sg_itr)->_leaves.end();
+                ++l_itr)
+            {
+                (*l_itr)->_traversalOrderNumber += offset;
+            }
+        }
+
+        for(RenderBin::RenderBinList::iterator b_itr = bin->getRenderBinList().begin();
+            b_itr != bin->getRenderBinList().end();
+            ++b_itr)
+        {
+            offsetTraversalOrder(b_itr->second.get(), offset);
+        }
+
+        RenderStage* stage = dynamic_cast<RenderStage*>(bin);
+        if (stage)
+        {
+            for(RenderStage::RenderStageList::iterator s_itr = stage->getPreRenderList().begin();
+                s_itr != stage->getPreRenderList().end();
+                ++s_itr)
+            {
+                offsetTraversalOrder(s_itr->second.get(), offset);
+            }
+
+            for(RenderStage::RenderStageList::iterator s_itr = stage->getPostRenderList().begin();
+                s_itr != stage->getPostRenderList().end();
+                ++s_itr)
+            {
+                offsetTraversalOrder(s_itr->second.get(), offset);
+            }
+        }
+    }
+
+    void mergeRenderBin(RenderBin* bin, RenderBin* fragmentBin, StateGraphMap& stateGraphMap, unsigned int offset)
+    {
+        for(RenderBin::StateGraphList::iterator sg_itr = fragmentBin->getStateGraphList().begin();
+            sg_itr != fragmentBin->getStateGraphList().end();
+            ++sg_itr)
+        {
+            StateGraph* fragmentStateGraph = *sg_itr;
+            StateGraph* sg = findMatchingStateGraph(fragmentStateGraph, stateGraphMap);
+
+            // as in CullVisitor::addDrawable(), a StateGraph is added to the bin it first receives a leaf in.
+            if (sg->leaves_empty()) bin->addStateGraph(sg);
+
+            for(StateGraph::LeafList::iterator l_itr = fragmentStateGraph->_leaves.begin();
+                l_itr != fragmentStateGraph->_leaves.end();
+                ++l_itr)
+            {
+                (*l_itr)->_traversalOrderNumber += offset;
+                sg->addLeaf(l_itr->get());
+            }
+        }
+
+        for(RenderBin::RenderBinList::iterator b_itr = fragmentBin->getRenderBinList().begin();
+            b_itr != fragmentBin->getRenderBinList().end();
+            ++b_itr)
+        {
+            mergeRenderBin(bin->find_or_insert(b_itr->first, b_itr->second.get()), b_itr->second.get(), stateGraphMap, offset);
+        }
+    }
+}
+
+void CullVisitor::mergeParallelCullFragment(ParallelCullFragment& fragment)
+{
+    CullVisitor* cv = fragment._cullVisitor.get();
+    fragment._child = 0;
+
+    // near/far, a fragment starts with an empty near/far range so it may have recorded more near/far plane
+    // candidates than the serial traversal would have, these extra candidates all lie beyond the computed
+    // near/far range so they never affect computeNearPlane(), but are discarded here to keep the maps small.
+    if (cv->_computed_znear<_computed_znear) _computed_znear = cv->_computed_znear;
+    if (cv->_computed_zfar>_computed_zfar) _computed_zfar = cv->_computed_zfar;
+
+    for(DistanceMatrixDrawableMap::iterator itr = cv->_nearPlaneCandidateMap.begin();
+        itr != cv->_nearPlaneCandidateMap.end() && itr->first<_computed_znear;
+        ++itr)
+    {
+        _nearPlaneCandidateMap.insert(*itr);
+    }
+
+    for(DistanceMatrixDrawableMap::reverse_iterator itr = cv->_farPlaneCandidateMap.rbegin();
+        itr != cv->_farPlaneCandidateMap.rend() && itr->first>_computed_zfar;
+        ++itr)
+    {
+        _farPlaneCandidateMap.insert(*itr);
+    }
+
+    cv->_nearPlaneCandidateMap.clear();
+    cv->_farPlaneCandidateMap.clear();
+
+    unsigned int offset = _traversalOrderNumber;
+    _traversalOrderNumber += cv->_traversalOrderNumber;
+
+    // merge the state graphs and render leaves into the current stage.
+    RenderStage* stage = getCurrentRenderStage();
+    RenderStage* fragmentStage = cv->_rootRenderStage.get();
+
+    StateGraph* rootStateGraph = _currentStateGraph;
+    while(rootStateGraph->_parent) rootStateGraph = rootStateGraph->_parent;
+
+    StateGraphMap stateGraphMap;
+    stateGraphMap[cv->_rootStateGraph.get()] = rootStateGraph;
+
+    mergeRenderBin(stage, fragmentStage, stateGraphMap, offset);
+
+    // positioned attributes
+    PositionalStateContainer* fragmentPSC = fragmentStage->getPositionalStateContainer();
+    if (!fragmentPSC->getAttrMatrixList().empty() || !fragmentPSC->getTexUnitAttrMatrixListMap().empty())
+    {
+        PositionalStateContainer* psc = stage->getPositionalStateContainer();
+        for(PositionalStateContainer::AttrMatrixList::iterator itr = fragmentPSC->getAttrMatrixList().begin();
+            itr != fragmentPSC->getAttrMatrixList().end();
+            ++itr)
+        {
+            psc->addPositionedAttribute(itr->second.get(), itr->first.get());
+        }
+
+        for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator titr = fragmentPSC->getTexUnitAttrMatrixListMap().begin();
+            titr != fragmentPSC->getTexUnitAttrMatrixListMap().end();
+            ++titr)
+        {
+            for(PositionalStateContainer::AttrMatrixList::iterator itr = titr->second.begin();
+                itr != titr->second.end();
+                ++itr)
+            {
+                psc->addPositionedTextureAttribute(titr->first, itr->second.get(), itr->first.get());
+            }
+        }
+    }
+
+    // pre and post render stages, those set up by Cameras in the fragment inherit the fragment stage's positioned
+    // attributes so need to be redirected to the current stage's.
+    for(RenderStage::RenderStageList::iterator itr = fragmentStage->getPreRenderList().begin();
+        itr != fragmentStage->getPreRenderList().end();
+        ++itr)
+    {
+        offsetTraversalOrder(itr->second.get(), offset);
+        if (itr->second->getInheritedPositionalStateContainer()==fragmentPSC) itr->second->setInheritedPositionalStateContainer(stage->getPositionalStateContainer());
+        stage->addPreRenderStage(itr->second.get(), itr->first);
+    }
+
+    for(RenderStage::RenderStageList::iterator itr = fragmentStage->getPostRenderList().begin();
+        itr != fragmentStage->getPostRenderList().end();
+        ++itr)
+    {
+        offsetTraversalOrder(itr->second.get(), offset);
+        if (itr->second->getInheritedPositionalStateContainer()==fragmentPSC) itr->second->setInheritedPositionalStateContainer(stage->getPositionalStateContainer());
+        stage->addPostRenderStage(itr->second.get(), itr->first);
+    }
+
+    // clear settings changed by a ClearNode in the fragment
+    if (fragmentStage->getClearMask()!=fragment._clearMask) stage->setClearMask(fragmentStage->getClearMask());
+    if (fragmentStage->getClearColor()!=fragment._clearColor) stage->setClearColor(fragmentStage->getClearColor());
+
+    // empty the fragment, the pre and post render stages now belong to the current stage so mustn't be reset.
+    fragmentStage->getPreRenderList().clear();
+    fragmentStage->getPostRenderList().clear();
+    fragmentStage->reset();
+
+    cv->_rootStateGraph->clean();
+    cv->_rootStateGraph->prune();
+
+    _numRenderLeavesAllocated += cv->_numRenderLeavesAllocated;
+    _numRenderLeavesReused += cv->_numRenderLeavesReused;
+    _numMatricesAllocated += cv->_numMatricesAllocated;
+    _numMatricesReused += cv->_numMatricesReused;
+
+    // release the references to the matrices shared with this CullVisitor so that they can be reused.
+    cv->osg::CullStack::reset();
+    cv->_nodePath.clear();
+}
+
+void ParallelCullCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
+{
+    CullVisitor* cv = nv ? nv->asCullVisitor() : 0;
+    osg::Group* group = node ? node->asGroup() : 0;
+
+    if (cv && group && cv->getParallelCullTaskPool() &&
+        !_nestedCallback.valid() && group->getNumChildren()>=_minimumNumChildren &&
+        !group->asSwitch() && !dynamic_cast<osg::LOD*>(group))
+    {
+        cv->traverseChildrenInParallel(*group);
+    }
+    else
+    {
+        traverse(node, nv);
+    }
+}
@@ -0,0 +1,415 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgUtil/GeometryBuilder>
+
+#include <string.h>
+
+using namespace osgUtil;
+
+namespace
+{
+
+// Appends elements to a list of fixed size chunks, so growing never moves the elements already added.
+template<typename T>
+class ChunkedArray
+{
+    public:
+
+        static const unsigned int CHUNK_SHIFT = 14;
+        static const unsigned int CHUNK_SIZE = 1u<<CHUNK_SHIFT;
+        static const unsigned int CHUNK_MASK = CHUNK_SIZE-1;
+
+        ChunkedArray(): _size(0) {}
+
+        ~ChunkedArray() { clear(); }
+
+        inline void push_back(const T& value)
+        {
+            if ((_size & CHUNK_MASK)==0) _chunks.push_back(new T[CHUNK_SIZE]);
+            _chunks.back()[_size & CHUNK_MASK] = value;
+            ++_size;
+        }
+
+        inline const T& operator [] (unsigned int i) const { return _chunks[i >> CHUNK_SHIFT][i & CHUNK_MASK]; }
+
+        inline unsigned int size() const { return _size; }
+
+        inline bool empty() const { return _size==0; }
+
+        void copyTo(T* destination) const
+        {
+            unsigned int remaining = _size;
+            for(unsigned int c=0; c<_chunks.size(); ++c)
+            {
+                unsigned int num = remaining<CHUNK_SIZE ? remaining : CHUNK_SIZE;
+                for(unsigned int i=0; i<num; ++i) *(destination++) = _chunks[c][i];
+                remaining -= num;
+            }
+        }
+
+        void clear()
+        {
+            for(unsigned int c=0; c<_chunks.size(); ++c) delete [] _chunks[c];
+            _chunks.clear();
+            _size = 0;
+        }
+
+    protected:
+
+        ChunkedArray(const ChunkedArray&);
+        ChunkedArray& operator = (const ChunkedArray&);
+
+        std::vector<T*> _chunks;
+        unsigned int    _size;
+};
+
+template<typename T> const unsigned int ChunkedArray<T>::CHUNK_SHIFT;
+template<typename T> const unsigned int ChunkedArray<T>::CHUNK_SIZE;
+template<typename T> const unsigned int ChunkedArray<T>::CHUNK_MASK;
+
+// FNV-1a over the bits of each float, with -0.0 hashed as 0.0 so that values that compare equal hash the same.
+inline void hashFloats(unsigned int& hash, const float* values, unsigned int num)
+{
+    for(unsigned int i=0; i<num; ++i)
+    {
+        float value = values[i]==0.0f ? 0.0f : values[i];
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for(unsigned int b=0; b<4; ++b)
+        {
+            hash ^= (bits >> (b*8)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+}
+
+template<class DrawElementsType, class ChunkedIndices>
+DrawElementsType* createDrawElements(GLenum mode, const ChunkedIndices& indices)
+{
+    DrawElementsType* drawElements = new DrawElementsType(mode, indices.size());
+    for(unsigned int i=0; i<indices.size(); ++i)
+    {
+        (*drawElements)[i] = static_cast<typename DrawElementsType::value_type>(indices[i]);
+    }
+    return drawElements;
+}
+
+template<class DrawElementsType, class ChunkedIndices>
+void addPrimitiveSets(osg::Geometry* geometry, const ChunkedIndices& triangles, const ChunkedIndices& lines, const ChunkedIndices& points,
+                      const ChunkedIndices& polygonIndices, const std::vector<unsigned int>& polygonSizes)
+{
+    if (!triangles.empty()) geometry->addPrimitiveSet(createDrawElements<DrawElementsType>(GL_TRIANGLES, triangles));
+    if (!lines.empty()) geometry->addPrimitiveSet(createDrawElements<DrawElementsType>(GL_LINES, lines));
+    if (!points.empty()) geometry->addPrimitiveSet(createDrawElements<DrawElementsType>(GL_POINTS, points));
+
+    unsigned int first = 0;
+    for(std::vector<unsigned int>::const_iterator itr = polygonSizes.begin();
+        itr != polygonSizes.end();
+        ++itr)
+    {
+        DrawElementsType* polygon = new DrawElementsType(GL_POLYGON, *itr);
+        for(unsigned int i=0; i<*itr; ++i)
+        {
+            (*polygon)[i] = static_cast<typename DrawElementsType::value_type>(polygonIndices[first+i]);
+        }
+        geometry->addPrimitiveSet(polygon);
+        first += *itr;
+    }
+}
+
+}
+
+struct GeometryBuilder::MaterialData : public osg::Referenced
+{
+    MaterialData(): numHashedVertices(0) {}
+
+    unsigned int                findVertex(unsigned int hash, const osg::Vec3& vertex, const osg::Vec3& normal, const osg::Vec2& texcoord, const osg::Vec4& color, unsigned int attributes) const;
+    void                        insertVertex(unsigned int hash, unsigned int index);
+    void                        rehash(unsigned int tableSize);
+
+    ChunkedArray<osg::Vec3>     vertices;
+    ChunkedArray<osg::Vec3>     normals;
+    ChunkedArray<osg::Vec2>     texcoords;
+    ChunkedArray<osg::Vec4>     colors;
+
+    ChunkedArray<unsigned int>  triangles;
+    ChunkedArray<unsigned int>  lines;
+    ChunkedArray<unsigned int>  points;
+    ChunkedArray<unsigned int>  polygonIndices;
+    std::vector<unsigned int>   polygonSizes;
+
+    // open addressing hash table of vertex index+1, 0 marking an empty slot, with the hash of each vertex kept for rehashing.
+    std::vector<unsigned int>   hashTable;
+    ChunkedArray<unsigned int>  hashes;
+    unsigned int                numHashedVertices;
+};
+
+unsigned int GeometryBuilder::MaterialData::findVertex(unsigned int hash, const osg::Vec3& vertex, const osg::Vec3& normal, const osg::Vec2& texcoord, const osg::Vec4& color, unsigned int attributes) const
+{
+    if (hashTable.empty()) return 0;
+
+    unsigned int mask = static_cast<unsigned int>(hashTable.size())-1;
+    for(unsigned int slot = hash & mask; hashTable[slot]!=0; slot = (slot+1) & mask)
+    {
+        unsigned int index = hashTable[slot]-1;
+        if (hashes[index]==hash &&
+            vertices[index]==vertex &&
+            (!(attributes & NORMALS) || normals[index]==normal) &&
+            (!(attributes & TEXCOORDS) || texcoords[index]==texcoord) &&
+            (!(attributes & COLORS) || colors[index]==color))
+        {
+            return index+1;
+        }
+    }
+    return 0;
+}
+
+void GeometryBuilder::MaterialData::insertVertex(unsigned int hash, unsigned int index)
+{
+    // keep the table at most half full.
+    if ((numHashedVertices+1)*2 > hashTable.size())
+    {
+        rehash(hashTable.empty() ? 1024 : static_cast<unsigned int>(hashTable.size())*2);
+    }
+
+    unsigned int mask = static_cast<unsigned int>(hashTable.size())-1;
+    unsigned int slot = hash & mask;
+    while(hashTable[slot]!=0) slot = (slot+1) & mask;
+    hashTable[slot] = index+1;
+    ++numHashedVertices;
+}
+
+void GeometryBuilder::MaterialData::rehash(unsigned int tableSize)
+{
+    std::vector<unsigned int> previous;
+    previous.swap(hashTable);
+    hashTable.resize(tableSize, 0);
+
+    unsigned int mask = tableSize-1;
+    for(std::vector<unsigned int>::iterator itr = previous.begin();
+        itr != previous.end();
+        ++itr)
+    {
+        if (*itr==0) continue;
+
+        unsigned int slot = hashes[*itr-1] & mask;
+        while(hashTable[slot]!=0) slot = (slot+1) & mask;
+        hashTable[slot] = *itr;
+    }
+}
+
+GeometryBuilder::GeometryBuilder(unsigned int attributes, bool deduplicateVertices):
+    _attributes(attributes),
+    _deduplicateVertices(deduplicateVertices),
+    _triangulateLargePolygons(true),
+    _currentMaterial(0),
+    _currentMaterialData(0)
+{
+}
+
+GeometryBuilder::~GeometryBuilder()
+{
+}
+
+void GeometryBuilder::setMaterial(unsigned int material)
+{
+    if (material==_currentMaterial) return;
+
+    _currentMaterial = material;
+
+    MaterialDataMap::iterator itr = _materialDataMap.find(material);
+    _currentMaterialData = itr!=_materialDataMap.end() ? itr->second.get() : 0;
+}
+
+GeometryBuilder::MaterialData* GeometryBuilder::getOrCreateMaterialData()
+{
+    if (!_currentMaterialData)
+    {
+        osg::ref_ptr<MaterialData>& materialData = _materialDataMap[_currentMaterial];
+        materialData = new MaterialData;
+        _currentMaterialData = materialData.get();
+    }
+    return _currentMaterialData;
+}
+
+unsigned int GeometryBuilder::addVertex(const osg::Vec3& vertex, const osg::Vec3& normal, const osg::Vec2& texcoord, const osg::Vec4& color)
+{
+    MaterialData* md = getOrCreateMaterialData();
+
+    unsigned int hash = 2166136261u;
+    if (_deduplicateVertices)
+    {
+        hashFloats(hash, vertex.ptr(), 3);
+        if (_attributes & NORMALS) hashFloats(hash, normal.ptr(), 3);
+        if (_attributes & TEXCOORDS) hashFloats(hash, texcoord.ptr(), 2);
+        if (_attributes & COLORS) hashFloats(hash, color.ptr(), 4);
+
+        unsigned int found = md->findVertex(hash, vertex, normal, texcoord, color, _attributes);
+        if (found!=0) return found-1;
+    }
+
+    unsigned int index = md->vertices.size();
+    md->vertices.push_back(vertex);
+    if (_attributes & NORMALS) md->normals.push_back(normal);
+    if (_attributes & TEXCOORDS) md->texcoords.push_back(texcoord);
+    if (_attributes & COLORS) md->colors.push_back(color);
+
+    if (_deduplicateVertices)
+    {
+        // pad the hashes of any vertices added whilst deduplication was disabled, these are never matched.
+        while(md->hashes.size()<index) md->hashes.push_back(0);
+        md->hashes.push_back(hash);
+        md->insertVertex(hash, index);
+    }
+
+    return index;
+}
+
+void GeometryBuilder::addPoint(unsigned int i)
+{
+    getOrCreateMaterialData()->points.push_back(i);
+}
+
+void GeometryBuilder::addLine(unsigned int i0, unsigned int i1)
+{
+    MaterialData* md = getOrCreateMaterialData();
+    md->lines.push_back(i0);
+    md->lines.push_back(i1);
+}
+
+void GeometryBuilder::addTriangle(unsigned int i0, unsigned int i1, unsigned int i2)
+{
+    MaterialData* md = getOrCreateMaterialData();
+    md->triangles.push_back(i0);
+    md->triangles.push_back(i1);
+    md->triangles.push_back(i2);
+}
+
+void GeometryBuilder::addPolygon(const unsigned int* indices, unsigned int numIndices)
+{
+    if (numIndices<3) return;
+
+    if (numIndices<=4 || _triangulateLargePolygons)
+    {
+        for(unsigned int i=2; i<numIndices; ++i)
+        {
+            addTriangle(indices[0], indices[i-1], indices[i]);
+        }
+        return;
+    }
+
+    MaterialData* md = getOrCreateMaterialData();
+    for(unsigned int i=0; i<numIndices; ++i)
+    {
+        md->polygonIndices.push_back(indices[i]);
+    }
+    md->polygonSizes.push_back(numIndices);
+}
+
+unsigned int GeometryBuilder::getNumVertices() const
+{
+    return _currentMaterialData ? _currentMaterialData->vertices.size() : 0;
+}
+
+unsigned int GeometryBuilder::getNumPrimitives() const
+{
+    if (!_currentMaterialData) return 0;
+
+    return _currentMaterialData->points.size() +
+           _currentMaterialData->lines.size()/2 +
+           _currentMaterialData->triangles.size()/3 +
+           static_cast<unsigned int>(_currentMaterialData->polygonSizes.size());
+}
+
+void GeometryBuilder::getMaterials(MaterialList& materials) const
+{
+    for(MaterialDataMap::const_iterator itr = _materialDataMap.begin();
+        itr != _materialDataMap.end();
+        ++itr)
+    {
+        const MaterialData* md = itr->second.get();
+        if (!md->triangles.empty() || !md->lines.empty() || !md->points.empty() || !md->polygonSizes.empty())
+        {
+            materials.push_back(itr->first);
+        }
+    }
+}
+
+osg::Geometry* GeometryBuilder::buildGeometry(unsigned int material)
+{
+    MaterialDataMap::iterator itr = _materialDataMap.find(material);
+    if (itr==_materialDataMap.end()) return 0;
+
+    // take the material out of the map so its memory is released when it goes out of scope.
+    osg::ref_ptr<MaterialData> md = itr->second;
+    _materialDataMap.erase(itr);
+    if (md.get()==_currentMaterialData) _currentMaterialData = 0;
+
+    if (md->vertices.empty() ||
+        (md->triangles.empty() && md->lines.empty() && md->points.empty() && md->polygonSizes.empty())) return 0;
+
+    // the hash table is no longer needed, so release it before allocating the arrays.
+    std::vector<unsigned int>().swap(md->hashTable);
+    md->hashes.clear();
+
+    unsigned int numVertices = md->vertices.size();
+
+    osg::Geometry* geometry = new osg::Geometry;
+
+    osg::Vec3Array* vertices = new osg::Vec3Array(numVertices);
+    md->vertices.copyTo(&(vertices->front()));
+    md->vertices.clear();
+    geometry->setVertexArray(vertices);
+
+    if (_attributes & NORMALS)
+    {
+        osg::Vec3Array* normals = new osg::Vec3Array(numVertices);
+        md->normals.copyTo(&(normals->front()));
+        md->normals.clear();
+        geometry->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+    }
+
+    if (_attributes & TEXCOORDS)
+    {
+        osg::Vec2Array* texcoords = new osg::Vec2Array(numVertices);
+        md->texcoords.copyTo(&(texcoords->front()));
+        md->texcoords.clear();
+        geometry->setTexCoordArray(0, texcoords, osg::Array::BIND_PER_VERTEX);
+    }
+
+    if (_attributes & COLORS)
+    {
+        osg::Vec4Array* colors = new osg::Vec4Array(numVertices);
+        md->colors.copyTo(&(colors->front()));
+        md->colors.clear();
+        geometry->setColorArray(colors, osg::Array::BIND_PER_VERTEX);
+    }
+
+    if (numVertices<=65536)
+    {
+        addPrimitiveSets<osg::DrawElementsUShort>(geometry, md->triangles, md->lines, md->points, md->polygonIndices, md->polygonSizes);
+    }
+    else
+    {
+        addPrimitiveSets<osg::DrawElementsUInt>(geometry, md->triangles, md->lines, md->points, md->polygonIndices, md->polygonSizes);
+    }
+
+    return geometry;
+}
+
+void GeometryBuilder::clear()
+{
+    _materialDataMap.clear();
+    _currentMaterialData = 0;
+}
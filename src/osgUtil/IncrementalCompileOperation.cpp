@@ -23,7 +23,9 @@
 #include <OpenThreads/ScopedLock>
 
 #include <algorithm>
+#include <fstream>
 #include <iterator>
+#include <sstream>
 #include <stdlib.h>
 #include <string.h>
 
@@ -48,6 +50,7 @@ namespace osgUtil
 static osg::ApplicationUsageProxy ICO_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MINIMUM_COMPILE_TIME_PER_FRAME <float>","minimum compile time alloted to compiling OpenGL objects per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_OBJECTS_TO_COMPILE_PER_FRAME <int>","maximum number of OpenGL objects to compile per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_FORCE_TEXTURE_DOWNLOAD <ON/OFF>","should the texture compiles be forced to download using a dummy Geometry.");
+static osg::ApplicationUsageProxy UCO_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_COMPILE_TRACE <filename>","record the incremental compile operations and write them to the file on exit.");
 
 /////////////////////////////////////////////////////////////////
 //
@@ -218,6 +221,108 @@ void StateToCompile::apply(osg::Texture& texture)
     _textures.insert(&texture);
 }
 
+/////////////////////////////////////////////////////////////////
+//
+// CompileTrace
+//
+CompileTrace::CompileTrace():
+    osg::Referenced(true)
+{
+}
+
+void CompileTrace::add(const Record& record)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _records.push_back(record);
+}
+
+void CompileTrace::getRecords(Records& records) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    records = _records;
+}
+
+unsigned int CompileTrace::getNumRecords() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _records.size();
+}
+
+void CompileTrace::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _records.clear();
+}
+
+static const char* compileTypeName(CompileTrace::CompileType type)
+{
+    switch(type)
+    {
+        case(CompileTrace::TEXTURE): return "TEXTURE";
+        case(CompileTrace::PROGRAM): return "PROGRAM";
+        default: return "GEOMETRY";
+    }
+}
+
+bool CompileTrace::write(std::ostream& fout) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    fout<<"# frameNumberAdded frameNumberCompiled type compileSize estimatedTime compileTime"<<std::endl;
+    for(Records::const_iterator itr = _records.begin();
+        itr != _records.end();
+        ++itr)
+    {
+        fout<<itr->frameNumberAdded<<" "<<itr->frameNumberCompiled<<" "<<compileTypeName(itr->type)<<" "
+            <<itr->compileSize<<" "<<itr->estimatedTime<<" "<<itr->compileTime<<std::endl;
+    }
+    return !fout.fail();
+}
+
+bool CompileTrace::write(const std::string& filename) const
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout) return false;
+    return write(fout);
+}
+
+bool CompileTrace::read(std::istream& fin)
+{
+    Records records;
+    std::string line;
+    while(std::getline(fin, line))
+    {
+        if (line.empty() || line[0]=='#') continue;
+
+        std::istringstream str(line);
+        Record record;
+        std::string typeName;
+        str>>record.frameNumberAdded>>record.frameNumberCompiled>>typeName>>record.compileSize>>record.estimatedTime>>record.compileTime;
+        if (str.fail())
+        {
+            OSG_NOTICE<<"Warning: CompileTrace::read() could not parse line '"<<line<<"'"<<std::endl;
+            return false;
+        }
+
+        if (typeName=="TEXTURE") record.type = TEXTURE;
+        else if (typeName=="PROGRAM") record.type = PROGRAM;
+        else record.type = GEOMETRY;
+
+        records.push_back(record);
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _records.insert(_records.end(), records.begin(), records.end());
+    return true;
+}
+
+bool CompileTrace::read(const std::string& filename)
+{
+    std::ifstream fin(filename.c_str());
+    if (!fin) return false;
+    return read(fin);
+}
+
 /////////////////////////////////////////////////////////////////
 //
 // CompileOps
@@ -245,6 +350,19 @@ bool IncrementalCompileOperation::CompileDrawableOp::compile(CompileInfo& compil
     return true;
 }
 
+void IncrementalCompileOperation::CompileDrawableOp::recordCompileTime(CompileInfo& compileInfo, double estimatedTime, double compileTime)
+{
+    osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
+    osg::Geometry* geometry = _drawable->asGeometry();
+    if (!gce || !geometry) return;
+
+    osg::GeometryCostEstimator* estimator = gce->getGeometryCostEstimator();
+    unsigned int compileSize = estimator->computeCompileSize(geometry);
+    estimator->recordCompileTime(compileSize, compileTime);
+
+    compileInfo.addToCompileTrace(CompileTrace::GEOMETRY, compileSize, estimatedTime, compileTime);
+}
+
 IncrementalCompileOperation::CompileTextureOp::CompileTextureOp(osg::Texture* texture):
     _texture(texture)
 {
@@ -282,6 +400,18 @@ bool IncrementalCompileOperation::CompileTextureOp::compile(CompileInfo& compile
     return true;
 }
 
+void IncrementalCompileOperation::CompileTextureOp::recordCompileTime(CompileInfo& compileInfo, double estimatedTime, double compileTime)
+{
+    osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
+    if (!gce) return;
+
+    osg::TextureCostEstimator* estimator = gce->getTextureCostEstimator();
+    unsigned int compileSize = estimator->computeCompileSize(_texture.get());
+    estimator->recordCompileTime(compileSize, compileTime);
+
+    compileInfo.addToCompileTrace(CompileTrace::TEXTURE, compileSize, estimatedTime, compileTime);
+}
+
 IncrementalCompileOperation::CompileProgramOp::CompileProgramOp(osg::Program* program):
     _program(program)
 {
@@ -301,15 +431,57 @@ bool IncrementalCompileOperation::CompileProgramOp::compile(CompileInfo& compile
     return true;
 }
 
+void IncrementalCompileOperation::CompileProgramOp::recordCompileTime(CompileInfo& compileInfo, double estimatedTime, double compileTime)
+{
+    osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
+    if (!gce) return;
+
+    osg::ProgramCostEstimator* estimator = gce->getProgramCostEstimator();
+    unsigned int compileSize = estimator->computeCompileSize(_program.get());
+    estimator->recordCompileTime(compileSize, compileTime);
+
+    compileInfo.addToCompileTrace(CompileTrace::PROGRAM, compileSize, estimatedTime, compileTime);
+}
+
 IncrementalCompileOperation::CompileInfo::CompileInfo(osg::GraphicsContext* context, IncrementalCompileOperation* ico):
     compileAll(false),
     maxNumObjectsToCompile(0),
-    allocatedTime(0)
+    allocatedTime(0),
+    useCostEstimates(ico ? ico->getUseCostEstimates() : false),
+    numObjectsCompiled(0),
+    compileSet(0)
 {
     setState(context->getState());
     incrementalCompileOperation = ico;
 }
 
+IncrementalCompileOperation::CompileInfo::CompileInfo(osg::State* state, IncrementalCompileOperation* ico):
+    compileAll(false),
+    maxNumObjectsToCompile(0),
+    allocatedTime(0),
+    useCostEstimates(ico ? ico->getUseCostEstimates() : false),
+    numObjectsCompiled(0),
+    compileSet(0)
+{
+    setState(state);
+    incrementalCompileOperation = ico;
+}
+
+void IncrementalCompileOperation::CompileInfo::addToCompileTrace(CompileTrace::CompileType type, unsigned int compileSize, double estimatedTime, double compileTime) const
+{
+    CompileTrace* trace = incrementalCompileOperation ? incrementalCompileOperation->getCompileTrace() : 0;
+    if (!trace) return;
+
+    CompileTrace::Record record;
+    record.frameNumberCompiled = incrementalCompileOperation->getCurrentFrameNumber();
+    record.frameNumberAdded = compileSet ? compileSet->_frameNumberAdded : record.frameNumberCompiled;
+    record.type = type;
+    record.compileSize = compileSize;
+    record.estimatedTime = estimatedTime;
+    record.compileTime = compileTime;
+    trace->add(record);
+}
+
 
 /////////////////////////////////////////////////////////////////
 //
@@ -342,35 +514,38 @@ double IncrementalCompileOperation::CompileList::estimatedTimeForCompile(Compile
 
 bool IncrementalCompileOperation::CompileList::compile(CompileInfo& compileInfo)
 {
-//#define USE_TIME_ESTIMATES
-
     for(CompileOps::iterator itr = _compileOps.begin();
         itr != _compileOps.end() && compileInfo.okToCompile();
     )
     {
-        #ifdef USE_TIME_ESTIMATES
-        double estimatedCompileCost = (*itr)->estimatedTimeForCompile(compileInfo);
-        #endif
+        double estimatedCompileCost = 0.0;
+        if (compileInfo.useCostEstimates)
+        {
+            estimatedCompileCost = (*itr)->estimatedTimeForCompile(compileInfo);
+
+            // leave operations that won't fit in the remaining time for a later frame and try the ones after them,
+            // but always allow the first compile of a frame so that operations larger than a frame's budget still progress.
+            if (compileInfo.numObjectsCompiled>0 && !compileInfo.okToCompile(estimatedCompileCost))
+            {
+                ++itr;
+                continue;
+            }
+        }
 
         --compileInfo.maxNumObjectsToCompile;
+        ++compileInfo.numObjectsCompiled;
 
-        #ifdef USE_TIME_ESTIMATES
-        osg::ElapsedTime timer;
-        #endif
+        double startTime = compileInfo.elapsedTime();
 
         CompileOps::iterator saved_itr(itr);
         ++itr;
         if ((*saved_itr)->compile(compileInfo))
         {
+            // only completed compiles are recorded, so that aborted or partial ones don't skew the cost estimates.
+            (*saved_itr)->recordCompileTime(compileInfo, estimatedCompileCost, compileInfo.elapsedTime()-startTime);
+
             _compileOps.erase(saved_itr);
         }
-
-        #ifdef USE_TIME_ESTIMATES
-        double actualCompileCost = timer.elapsedTime();
-        OSG_NOTICE<<"IncrementalCompileOperation::CompileList::compile() estimatedTimForCompile = "<<estimatedCompileCost*1000.0<<"ms, actual = "<<actualCompileCost*1000.0<<"ms";
-        if (estimatedCompileCost>0.0) OSG_NOTICE<<", ratio="<<(actualCompileCost/estimatedCompileCost);
-        OSG_NOTICE<<std::endl;
-        #endif
     }
     return empty();
 }
@@ -432,7 +607,11 @@ bool IncrementalCompileOperation::CompileSet::compile(CompileInfo& compileInfo)
     CompileList& compileList = _compileMap[compileInfo.getState()->getGraphicsContext()];
     if (!compileList.empty())
     {
-        if (compileList.compile(compileInfo))
+        compileInfo.compileSet = this;
+        bool completed = compileList.compile(compileInfo);
+        compileInfo.compileSet = 0;
+
+        if (completed)
         {
             --_numberCompileListsToCompile;
             return _numberCompileListsToCompile==0;
@@ -450,6 +629,7 @@ IncrementalCompileOperation::IncrementalCompileOperation():
     osg::GraphicsOperation("IncrementalCompileOperation",true),
     _flushTimeRatio(0.5),
     _conservativeTimeRatio(0.5),
+    _useCostEstimates(false),
     _currentFrameNumber(0),
     _compileAllTillFrameNumber(0)
 {
@@ -484,10 +664,26 @@ IncrementalCompileOperation::IncrementalCompileOperation():
         assignForceTextureDownloadGeometry();
     }
 
+    if( (ptr = getenv("OSG_COMPILE_TRACE")) != 0)
+    {
+        _compileTraceFileName = ptr;
+        _compileTrace = new CompileTrace;
+    }
 }
 
 IncrementalCompileOperation::~IncrementalCompileOperation()
 {
+    if (_compileTrace.valid() && !_compileTraceFileName.empty())
+    {
+        if (_compileTrace->write(_compileTraceFileName))
+        {
+            OSG_NOTICE<<"IncrementalCompileOperation wrote "<<_compileTrace->getNumRecords()<<" compiles to "<<_compileTraceFileName<<std::endl;
+        }
+        else
+        {
+            OSG_NOTICE<<"Warning: IncrementalCompileOperation could not write compile trace to "<<_compileTraceFileName<<std::endl;
+        }
+    }
 }
 
 void IncrementalCompileOperation::assignForceTextureDownloadGeometry()
@@ -582,6 +778,7 @@ void IncrementalCompileOperation::add(CompileSet* compileSet, bool callBuildComp
 
     // pass on the markerObject to the CompileSet
     compileSet->_markerObject = _markerObject;
+    compileSet->_frameNumberAdded = _currentFrameNumber;
 
     if (compileSet->_subgraphToCompile.valid())
     {
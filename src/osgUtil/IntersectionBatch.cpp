@@ -0,0 +1,201 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgUtil/IntersectionBatch>
+#include <osgUtil/LineSegmentIntersector>
+
+#include <osg/BoundingBox>
+#include <osg/Notify>
+
+#include <algorithm>
+
+using namespace osgUtil;
+
+namespace
+{
+
+// spread the bottom 10 bits of value so there are two zero bits between each.
+inline unsigned int spreadBits(unsigned int value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+inline unsigned int quantize(double value, double minimum, double scale)
+{
+    double q = (value-minimum)*scale;
+    if (q<=0.0) return 0;
+    if (q>=1023.0) return 1023;
+    return static_cast<unsigned int>(q);
+}
+
+typedef std::pair<unsigned int, unsigned int> CodeIndexPair;
+
+class IntersectBinOperation : public osg::Operation
+{
+    public:
+
+        IntersectBinOperation(osg::Node* scene, IntersectorGroup* intersectorGroup, IntersectionVisitor::ReadCallback* readCallback, osg::Node::NodeMask traversalMask):
+            osg::Operation("IntersectBin", false),
+            _scene(scene),
+            _intersectorGroup(intersectorGroup),
+            _readCallback(readCallback),
+            _traversalMask(traversalMask) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            IntersectionVisitor iv(_intersectorGroup.get(), _readCallback.get());
+            iv.setTraversalMask(_traversalMask);
+            _scene->accept(iv);
+        }
+
+    protected:
+
+        osg::ref_ptr<osg::Node>                         _scene;
+        osg::ref_ptr<IntersectorGroup>                  _intersectorGroup;
+        osg::ref_ptr<IntersectionVisitor::ReadCallback> _readCallback;
+        osg::Node::NodeMask                             _traversalMask;
+};
+
+}
+
+IntersectionBatch::IntersectionBatch():
+    _traversalMask(0xffffffff),
+    _maximumNumIntersectorsPerBin(64),
+    _numBins(0)
+{
+}
+
+unsigned int IntersectionBatch::addIntersector(Intersector* intersector)
+{
+    unsigned int index = static_cast<unsigned int>(_intersectors.size());
+    _intersectors.push_back(intersector);
+    return index;
+}
+
+void IntersectionBatch::clear()
+{
+    _intersectors.clear();
+    _numBins = 0;
+}
+
+void IntersectionBatch::binIntersectors(std::vector<IndexList>& bins) const
+{
+    std::vector<osg::Vec3d> midPoints(_intersectors.size());
+    std::vector<bool> hasMidPoint(_intersectors.size(), false);
+    osg::BoundingBoxd bb;
+
+    for(unsigned int i=0; i<_intersectors.size(); ++i)
+    {
+        const LineSegmentIntersector* lsi = dynamic_cast<const LineSegmentIntersector*>(_intersectors[i].get());
+        if (lsi && lsi->getCoordinateFrame()==Intersector::MODEL)
+        {
+            midPoints[i] = (lsi->getStart()+lsi->getEnd())*0.5;
+            hasMidPoint[i] = true;
+            bb.expandBy(midPoints[i]);
+        }
+    }
+
+    std::vector<CodeIndexPair> sorted;
+    IndexList unsorted;
+    if (bb.valid())
+    {
+        osg::Vec3d scale;
+        for(unsigned int axis=0; axis<3; ++axis)
+        {
+            double range = bb._max[axis]-bb._min[axis];
+            scale[axis] = range>0.0 ? 1023.0/range : 0.0;
+        }
+
+        for(unsigned int i=0; i<_intersectors.size(); ++i)
+        {
+            if (!hasMidPoint[i])
+            {
+                unsorted.push_back(i);
+                continue;
+            }
+
+            const osg::Vec3d& p = midPoints[i];
+            unsigned int code = spreadBits(quantize(p.x(), bb._min.x(), scale.x())) |
+                                (spreadBits(quantize(p.y(), bb._min.y(), scale.y())) << 1) |
+                                (spreadBits(quantize(p.z(), bb._min.z(), scale.z())) << 2);
+            sorted.push_back(CodeIndexPair(code, i));
+        }
+
+        std::sort(sorted.begin(), sorted.end());
+    }
+    else
+    {
+        for(unsigned int i=0; i<_intersectors.size(); ++i) unsorted.push_back(i);
+    }
+
+    unsigned int binSize = std::max(1u, _maximumNumIntersectorsPerBin);
+
+    for(unsigned int i=0; i<sorted.size(); ++i)
+    {
+        if ((i%binSize)==0) bins.push_back(IndexList());
+        bins.back().push_back(sorted[i].second);
+    }
+
+    for(unsigned int i=0; i<unsorted.size(); ++i)
+    {
+        if ((i%binSize)==0) bins.push_back(IndexList());
+        bins.back().push_back(unsorted[i]);
+    }
+}
+
+void IntersectionBatch::computeIntersections(osg::Node* scene)
+{
+    _numBins = 0;
+    if (!scene || _intersectors.empty()) return;
+
+    for(Intersectors::iterator itr = _intersectors.begin();
+        itr != _intersectors.end();
+        ++itr)
+    {
+        (*itr)->reset();
+    }
+
+    std::vector<IndexList> bins;
+    binIntersectors(bins);
+    _numBins = static_cast<unsigned int>(bins.size());
+
+    // compute the bounds up front, as they are otherwise computed lazily by whichever traversal gets to them first.
+    scene->getBound();
+
+    osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+    for(std::vector<IndexList>::iterator bitr = bins.begin();
+        bitr != bins.end();
+        ++bitr)
+    {
+        osg::ref_ptr<IntersectorGroup> intersectorGroup = new IntersectorGroup;
+        for(IndexList::iterator itr = bitr->begin();
+            itr != bitr->end();
+            ++itr)
+        {
+            intersectorGroup->addIntersector(_intersectors[*itr].get());
+        }
+
+        osg::ref_ptr<IntersectBinOperation> operation = new IntersectBinOperation(scene, intersectorGroup.get(), _readCallback.get(), _traversalMask);
+        if (_taskPool.valid() && bins.size()>1) _taskPool->add(operation.get(), taskSet.get());
+        else (*operation)(0);
+    }
+
+    if (_taskPool.valid() && bins.size()>1) _taskPool->wait(taskSet.get());
+
+    OSG_INFO<<"IntersectionBatch::computeIntersections() "<<_intersectors.size()<<" intersectors in "<<_numBins<<" bins"<<std::endl;
+}
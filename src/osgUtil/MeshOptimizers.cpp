@@ -16,12 +16,16 @@
 #include <limits>
 
 #include <algorithm>
+#include <map>
+#include <sstream>
 #include <vector>
 
 #include <iostream>
 
+#include <osg/CullStack>
 #include <osg/Geometry>
 #include <osg/Math>
+#include <osg/Notify>
 #include <osg/PrimitiveSet>
 #include <osg/TriangleIndexFunctor>
 #include <osg/TriangleLinePointIndexFunctor>
@@ -43,6 +47,173 @@ void GeometryCollector::apply(Geometry& geom)
     _geometryList.insert(&geom);
 }
 
+namespace
+{
+// Union find over the geometry indices, used to join geometries that share data.
+class GeometrySets
+{
+public:
+    GeometrySets(unsigned int size): _parents(size)
+    {
+        for(unsigned int i=0; i<size; ++i) _parents[i] = i;
+    }
+
+    unsigned int find(unsigned int i)
+    {
+        while(_parents[i]!=i)
+        {
+            _parents[i] = _parents[_parents[i]];
+            i = _parents[i];
+        }
+        return i;
+    }
+
+    // join the two sets, keeping the lower index as the root so sets are ordered by their first geometry.
+    void join(unsigned int lhs, unsigned int rhs)
+    {
+        lhs = find(lhs);
+        rhs = find(rhs);
+        if (lhs<rhs) _parents[rhs] = lhs;
+        else if (rhs<lhs) _parents[lhs] = rhs;
+    }
+
+protected:
+    std::vector<unsigned int> _parents;
+};
+
+typedef std::map<const osg::BufferData*, unsigned int> BufferDataOwnerMap;
+
+void joinOwners(GeometrySets& sets, BufferDataOwnerMap& owners, const osg::BufferData* data, unsigned int index)
+{
+    if (!data) return;
+
+    BufferDataOwnerMap::iterator itr = owners.find(data);
+    if (itr!=owners.end()) sets.join(itr->second, index);
+    else owners[data] = index;
+}
+
+class ProcessGeometriesOperation : public osg::Operation
+{
+public:
+    typedef void (*GeometryFunction)(GeometryCollector& collector, osg::Geometry& geom);
+
+    ProcessGeometriesOperation(GeometryCollector& collector, GeometryFunction function):
+        osg::Operation("ProcessGeometriesOperation", false),
+        _collector(collector),
+        _function(function) {}
+
+    virtual void operator () (osg::Object*)
+    {
+        for(std::vector<osg::Geometry*>::iterator itr = _geometries.begin();
+            itr != _geometries.end();
+            ++itr)
+        {
+            _function(_collector, **itr);
+        }
+    }
+
+    GeometryCollector&              _collector;
+    GeometryFunction                _function;
+    std::vector<osg::Geometry*>     _geometries;
+};
+}
+
+void GeometryCollector::partitionGeometries(const GeometryList& geometryList, GeometryPartitions& partitions)
+{
+    partitions.clear();
+
+    std::vector<osg::Geometry*> geometries(geometryList.begin(), geometryList.end());
+    GeometrySets sets(geometries.size());
+    BufferDataOwnerMap owners;
+
+    for(unsigned int i=0; i<geometries.size(); ++i)
+    {
+        osg::Geometry* geom = geometries[i];
+
+        joinOwners(sets, owners, geom->getVertexArray(), i);
+        joinOwners(sets, owners, geom->getNormalArray(), i);
+        joinOwners(sets, owners, geom->getColorArray(), i);
+        joinOwners(sets, owners, geom->getSecondaryColorArray(), i);
+        joinOwners(sets, owners, geom->getFogCoordArray(), i);
+
+        for(unsigned int unit=0; unit<geom->getNumTexCoordArrays(); ++unit)
+        {
+            joinOwners(sets, owners, geom->getTexCoordArray(unit), i);
+        }
+
+        for(unsigned int index=0; index<geom->getNumVertexAttribArrays(); ++index)
+        {
+            joinOwners(sets, owners, geom->getVertexAttribArray(index), i);
+        }
+
+        for(unsigned int primitiveIndex=0; primitiveIndex<geom->getNumPrimitiveSets(); ++primitiveIndex)
+        {
+            joinOwners(sets, owners, geom->getPrimitiveSet(primitiveIndex), i);
+        }
+    }
+
+    std::vector<unsigned int> partitionIndices(geometries.size(), 0);
+    for(unsigned int i=0; i<geometries.size(); ++i)
+    {
+        unsigned int root = sets.find(i);
+        if (root==i)
+        {
+            partitionIndices[i] = partitions.size();
+            partitions.push_back(std::vector<osg::Geometry*>());
+        }
+        partitions[partitionIndices[root]].push_back(geometries[i]);
+    }
+}
+
+void GeometryCollector::processGeometryList(GeometryFunction function)
+{
+    if (!_taskPool.valid() || _geometryList.size()<2)
+    {
+        for(GeometryList::iterator itr=_geometryList.begin();
+            itr!=_geometryList.end();
+            ++itr)
+        {
+            function(*this, *(*itr));
+        }
+        return;
+    }
+
+    // dirty the bounds up front, as Optimizer::MergeGeometryVisitor::mergeCollectedGroups() does, so that the dirtyBound()
+    // calls made by the tasks don't propagate to parents that may be shared with geometries on other threads.
+    for(GeometryList::iterator itr=_geometryList.begin();
+        itr!=_geometryList.end();
+        ++itr)
+    {
+        (*itr)->dirtyBound();
+    }
+
+    GeometryPartitions partitions;
+    partitionGeometryList(partitions);
+
+    // batch up small partitions so that the task overhead doesn't outweigh the work done on each geometry.
+    const unsigned int minimumGeometriesPerTask = 16;
+
+    osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+    osg::ref_ptr<ProcessGeometriesOperation> operation;
+    for(GeometryPartitions::iterator itr = partitions.begin();
+        itr != partitions.end();
+        ++itr)
+    {
+        if (!operation) operation = new ProcessGeometriesOperation(*this, function);
+
+        operation->_geometries.insert(operation->_geometries.end(), itr->begin(), itr->end());
+        if (operation->_geometries.size()>=minimumGeometriesPerTask)
+        {
+            _taskPool->add(operation.get(), taskSet.get());
+            operation = 0;
+        }
+    }
+
+    if (operation.valid()) _taskPool->add(operation.get(), taskSet.get());
+
+    _taskPool->wait(taskSet.get());
+}
+
 namespace
 {
 typedef std::vector<unsigned int> IndexList;
@@ -394,14 +565,17 @@ void IndexMeshVisitor::makeMesh(Geometry& geom)
     geom.setPrimitiveSetList(new_primitives);
 }
 
+namespace
+{
+void makeMeshFunction(GeometryCollector& collector, osg::Geometry& geom)
+{
+    static_cast<IndexMeshVisitor&>(collector).makeMesh(geom);
+}
+}
+
 void IndexMeshVisitor::makeMesh()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        makeMesh(*(*itr));
-    }
+    processGeometryList(makeMeshFunction);
 }
 
 namespace
@@ -871,14 +1045,17 @@ void VertexCacheVisitor::doVertexOptimization(Geometry& geom,
      }
 }
 
+namespace
+{
+void optimizeVerticesFunction(GeometryCollector& collector, osg::Geometry& geom)
+{
+    static_cast<VertexCacheVisitor&>(collector).optimizeVertices(geom);
+}
+}
+
 void VertexCacheVisitor::optimizeVertices()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        optimizeVertices(*(*itr));
-    }
+    processGeometryList(optimizeVerticesFunction);
 }
 
 VertexCacheMissVisitor::VertexCacheMissVisitor(unsigned cacheSize)
@@ -1100,14 +1277,17 @@ struct VertexReorder : public TriangleLinePointIndexFunctor<osgUtil::VertexReord
 };
 }
 
+namespace
+{
+void optimizeOrderFunction(GeometryCollector& collector, osg::Geometry& geom)
+{
+    static_cast<VertexAccessOrderVisitor&>(collector).optimizeOrder(geom);
+}
+}
+
 void VertexAccessOrderVisitor::optimizeOrder()
 {
-    for (GeometryList::iterator itr = _geometryList.begin(), end = _geometryList.end();
-         itr != end;
-         ++itr)
-    {
-        optimizeOrder(*(*itr));
-    }
+    processGeometryList(optimizeOrderFunction);
 }
 
 template<typename DE>
@@ -1242,4 +1422,849 @@ void SharedArrayOptimizer::deduplicateUVs(osg::Geometry& geometry)
     }
 }
 
+MeshletCullCallback::MeshletCullCallback():
+    _coneCutoff(1.0f)
+{
+}
+
+MeshletCullCallback::MeshletCullCallback(const osg::BoundingSphere& bs, const osg::Vec3& coneAxis, float coneCutoff):
+    _boundingSphere(bs),
+    _coneAxis(coneAxis),
+    _coneCutoff(coneCutoff)
+{
+}
+
+MeshletCullCallback::MeshletCullCallback(const MeshletCullCallback& rhs, const osg::CopyOp& copyop):
+    osg::Object(rhs, copyop),
+    osg::Callback(rhs, copyop),
+    osg::DrawableCullCallback(rhs, copyop),
+    _boundingSphere(rhs._boundingSphere),
+    _coneAxis(rhs._coneAxis),
+    _coneCutoff(rhs._coneCutoff)
+{
+}
+
+bool MeshletCullCallback::cull(osg::NodeVisitor* nv, osg::Drawable*, osg::RenderInfo*) const
+{
+    osg::CullStack* cullStack = nv ? nv->asCullStack() : 0;
+    if (!cullStack) return false;
+
+    if (cullStack->isCulled(_boundingSphere)) return true;
+
+    // the cone test assumes all view rays start at the eye point, so is only valid for perspective projections.
+    const osg::RefMatrix* projection = cullStack->getProjectionMatrix();
+    if (_coneCutoff>=1.0f || !projection || (*projection)(3,3)!=0.0) return false;
+
+    // the meshlet faces away from the eye if the cone of normals, widened by the angle the bounding sphere
+    // subtends at the eye, points away from the eye.
+    osg::Vec3 eyeToCenter = _boundingSphere.center() - cullStack->getEyeLocal();
+    return eyeToCenter*_coneAxis >= _coneCutoff*eyeToCenter.length() + _boundingSphere.radius();
+}
+
+bool MeshletBuildVisitor::buildMeshlets(const osg::Geometry& geom, MeshletList& meshlets) const
+{
+    meshlets.clear();
+
+    if (_maximumNumVertices<3 || _maximumNumTriangles==0) return false;
+
+    const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geom.getVertexArray());
+    if (!vertices || vertices->empty()) return false;
+
+    // only meshes made up entirely of triangle primitives can be split.
+    for(unsigned int i=0; i<geom.getNumPrimitiveSets(); ++i)
+    {
+        GLenum mode = geom.getPrimitiveSet(i)->getMode();
+        if (mode<osg::PrimitiveSet::TRIANGLES || mode>osg::PrimitiveSet::POLYGON) return false;
+    }
+
+    // arrays bound per primitive set can't be shared by the meshlets.
+    osg::Geometry::ArrayList arrayList;
+    geom.getArrayList(arrayList);
+    for(osg::Geometry::ArrayList::iterator itr = arrayList.begin();
+        itr != arrayList.end();
+        ++itr)
+    {
+        if ((*itr)->getBinding()==osg::Array::BIND_PER_PRIMITIVE_SET) return false;
+    }
+
+    MyTriangleIndexFunctor collector;
+    geom.accept(collector);
+
+    // drop degenerate triangles.
+    const unsigned int numVertices = vertices->size();
+    IndexList indices;
+    indices.reserve(collector._in_indices.size());
+    for(IndexList::iterator itr = collector._in_indices.begin();
+        itr != collector._in_indices.end();
+        itr += 3)
+    {
+        unsigned int a = itr[0], b = itr[1], c = itr[2];
+        if (a>=numVertices || b>=numVertices || c>=numVertices) return false;
+        if (a==b || b==c || a==c) continue;
+
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    const unsigned int numTriangles = indices.size()/3;
+    if (numTriangles<=_maximumNumTriangles) return false;
+
+    // vertex to triangle adjacency, stored as offsets into a single list.
+    IndexList triangleOffsets(numVertices+1, 0);
+    for(IndexList::iterator itr = indices.begin(); itr != indices.end(); ++itr)
+    {
+        ++triangleOffsets[*itr+1];
+    }
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        triangleOffsets[v+1] += triangleOffsets[v];
+    }
+
+    IndexList vertexTriangles(indices.size());
+    IndexList insertPositions(triangleOffsets.begin(), triangleOffsets.end()-1);
+    for(unsigned int i=0; i<indices.size(); ++i)
+    {
+        vertexTriangles[insertPositions[indices[i]]++] = i/3;
+    }
+
+    std::vector<osg::Vec3> normals(numTriangles);
+    for(unsigned int t=0; t<numTriangles; ++t)
+    {
+        const osg::Vec3& v0 = (*vertices)[indices[t*3]];
+        const osg::Vec3& v1 = (*vertices)[indices[t*3+1]];
+        const osg::Vec3& v2 = (*vertices)[indices[t*3+2]];
+        normals[t] = (v1-v0)^(v2-v0);
+        normals[t].normalize();
+    }
+
+    const unsigned int invalidIndex = std::numeric_limits<unsigned int>::max();
+    std::vector<bool> triangleUsed(numTriangles, false);
+    IndexList triangleCandidate(numTriangles, invalidIndex);
+    IndexList vertexMeshlet(numVertices, invalidIndex);
+
+    IndexList meshletVertices;
+    IndexList meshletTriangles;
+    IndexList candidates;
+    unsigned int nextSeed = 0;
+
+    for(unsigned int meshletIndex = 0; ; ++meshletIndex)
+    {
+        while(nextSeed<numTriangles && triangleUsed[nextSeed]) ++nextSeed;
+        if (nextSeed==numTriangles) break;
+
+        meshlets.push_back(Meshlet());
+        Meshlet& meshlet = meshlets.back();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        candidates.clear();
+
+        unsigned int triangle = nextSeed;
+        while(triangle!=invalidIndex)
+        {
+            triangleUsed[triangle] = true;
+            meshletTriangles.push_back(triangle);
+
+            for(unsigned int i=0; i<3; ++i)
+            {
+                unsigned int v = indices[triangle*3+i];
+                meshlet._indices.push_back(v);
+
+                if (vertexMeshlet[v]==meshletIndex) continue;
+
+                vertexMeshlet[v] = meshletIndex;
+                meshletVertices.push_back(v);
+
+                for(unsigned int j=triangleOffsets[v]; j<triangleOffsets[v+1]; ++j)
+                {
+                    unsigned int adjacent = vertexTriangles[j];
+                    if (!triangleUsed[adjacent] && triangleCandidate[adjacent]!=meshletIndex)
+                    {
+                        triangleCandidate[adjacent] = meshletIndex;
+                        candidates.push_back(adjacent);
+                    }
+                }
+            }
+
+            if (meshletTriangles.size()>=_maximumNumTriangles) break;
+
+            // grow the meshlet with the connected triangle that adds the fewest new vertices.
+            triangle = invalidIndex;
+            unsigned int bestNumNewVertices = 4;
+            for(unsigned int c=0; c<candidates.size(); )
+            {
+                unsigned int candidate = candidates[c];
+                if (triangleUsed[candidate])
+                {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                unsigned int numNewVertices = 0;
+                for(unsigned int i=0; i<3; ++i)
+                {
+                    if (vertexMeshlet[indices[candidate*3+i]]!=meshletIndex) ++numNewVertices;
+                }
+
+                if (numNewVertices<bestNumNewVertices)
+                {
+                    triangle = candidate;
+                    bestNumNewVertices = numNewVertices;
+                    if (numNewVertices==0) break;
+                }
+                ++c;
+            }
+
+            // nothing connected left, so carry on with the next unused triangle in the mesh's own order.
+            if (triangle==invalidIndex)
+            {
+                while(nextSeed<numTriangles && triangleUsed[nextSeed]) ++nextSeed;
+                if (nextSeed==numTriangles) break;
+
+                triangle = nextSeed;
+                bestNumNewVertices = 0;
+                for(unsigned int i=0; i<3; ++i)
+                {
+                    if (vertexMeshlet[indices[triangle*3+i]]!=meshletIndex) ++bestNumNewVertices;
+                }
+            }
+
+            if (meshletVertices.size()+bestNumNewVertices>_maximumNumVertices) triangle = invalidIndex;
+        }
+
+        osg::BoundingBox bb;
+        for(IndexList::iterator itr = meshletVertices.begin(); itr != meshletVertices.end(); ++itr)
+        {
+            bb.expandBy((*vertices)[*itr]);
+        }
+
+        float radius2 = 0.0f;
+        for(IndexList::iterator itr = meshletVertices.begin(); itr != meshletVertices.end(); ++itr)
+        {
+            radius2 = osg::maximum(radius2, ((*vertices)[*itr]-bb.center()).length2());
+        }
+        meshlet._boundingBox = bb;
+        meshlet._boundingSphere.set(bb.center(), sqrtf(radius2));
+
+        if (!_backFaceCulling) continue;
+
+        // the normal cone is centered on the average triangle normal, with cones wider than 90 degrees left
+        // disabled as a meshlet facing that many ways can't be culled from any eye point.
+        osg::Vec3 axis;
+        for(IndexList::iterator itr = meshletTriangles.begin(); itr != meshletTriangles.end(); ++itr)
+        {
+            axis += normals[*itr];
+        }
+        if (axis.normalize()==0.0f) continue;
+
+        float minDot = 1.0f;
+        for(IndexList::iterator itr = meshletTriangles.begin(); itr != meshletTriangles.end(); ++itr)
+        {
+            // zero area triangles are never drawn so don't constrain the cone.
+            if (normals[*itr].length2()>0.0f) minDot = osg::minimum(minDot, normals[*itr]*axis);
+        }
+
+        if (minDot>0.1f)
+        {
+            meshlet._coneAxis = axis;
+            meshlet._coneCutoff = sqrtf(1.0f-minDot*minDot);
+        }
+    }
+
+    return true;
+}
+
+void MeshletBuildVisitor::buildMeshletsFunction(GeometryCollector& collector, osg::Geometry& geom)
+{
+    // the map entries are all created up front, so tasks only write to their own entry.
+    MeshletBuildVisitor& visitor = static_cast<MeshletBuildVisitor&>(collector);
+    GeometryMeshletMap::iterator itr = visitor._geometryMeshletMap.find(&geom);
+    if (itr!=visitor._geometryMeshletMap.end()) visitor.buildMeshlets(geom, itr->second);
+}
+
+void MeshletBuildVisitor::buildMeshlets()
+{
+    _geometryMeshletMap.clear();
+
+    for(GeometryList::iterator itr = _geometryList.begin();
+        itr != _geometryList.end();
+        )
+    {
+        osg::Geometry* geom = *itr;
+        if (geom->getDataVariance()==osg::Object::DYNAMIC ||
+            geom->getUpdateCallback() || geom->getEventCallback() || geom->getCullCallback() ||
+            !isOperationPermissibleForObject(geom))
+        {
+            _geometryList.erase(itr++);
+        }
+        else
+        {
+            _geometryMeshletMap[geom];
+            ++itr;
+        }
+    }
+
+    processGeometryList(buildMeshletsFunction);
+
+    for(GeometryMeshletMap::iterator itr = _geometryMeshletMap.begin();
+        itr != _geometryMeshletMap.end();
+        ++itr)
+    {
+        MeshletList& meshlets = itr->second;
+        if (meshlets.empty()) continue;
+
+        osg::ref_ptr<osg::Geometry> geom = itr->first;
+
+        std::vector< osg::ref_ptr<osg::Geometry> > meshletGeometries;
+        for(MeshletList::iterator mitr = meshlets.begin();
+            mitr != meshlets.end();
+            ++mitr)
+        {
+            unsigned int maxIndex = *std::max_element(mitr->_indices.begin(), mitr->_indices.end());
+
+            osg::ref_ptr<osg::DrawElements> elements;
+            if (maxIndex<65536) elements = new osg::DrawElementsUShort(osg::PrimitiveSet::TRIANGLES);
+            else elements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES);
+
+            elements->reserveElements(mitr->_indices.size());
+            for(IndexList::iterator iitr = mitr->_indices.begin(); iitr != mitr->_indices.end(); ++iitr)
+            {
+                elements->addElement(*iitr);
+            }
+
+            // a shallow copy shares the arrays and StateSet of the original geometry.
+            osg::ref_ptr<osg::Geometry> meshletGeometry = new osg::Geometry(*geom, osg::CopyOp::SHALLOW_COPY);
+            meshletGeometry->getPrimitiveSetList().clear();
+            meshletGeometry->addPrimitiveSet(elements.get());
+            meshletGeometry->setCullCallback(new MeshletCullCallback(mitr->_boundingSphere, mitr->_coneAxis, mitr->_coneCutoff));
+
+            // the vertex arrays are shared with the other meshlets, so the bound is set from the meshlet's own vertices
+            // rather than computed from the whole array, the default ComputeBoundingBoxCallback adds nothing to it.
+            meshletGeometry->setInitialBound(mitr->_boundingBox);
+            meshletGeometry->setComputeBoundingBoxCallback(new osg::Drawable::ComputeBoundingBoxCallback);
+
+            meshletGeometries.push_back(meshletGeometry);
+        }
+
+        osg::Node::ParentList parents = geom->getParents();
+        for(osg::Node::ParentList::iterator pitr = parents.begin();
+            pitr != parents.end();
+            ++pitr)
+        {
+            osg::Group* parent = *pitr;
+            unsigned int pos = parent->getChildIndex(geom.get());
+            parent->removeChildren(pos, 1);
+
+            for(unsigned int i=0; i<meshletGeometries.size(); ++i)
+            {
+                parent->insertChild(pos+i, meshletGeometries[i].get());
+            }
+        }
+
+        OSG_INFO<<"MeshletBuildVisitor::buildMeshlets() split geometry into "<<meshletGeometries.size()<<" meshlets"<<std::endl;
+    }
+
+    _geometryMeshletMap.clear();
+}
+
+namespace
+{
+const char* s_decodeShaderSource =
+    "#ifdef OSG_QUANTIZED_POSITION\n"
+    "uniform vec3 osg_PositionDecodeOffset;\n"
+    "uniform vec3 osg_PositionDecodeScale;\n"
+    "vec4 osg_decodePosition(vec4 vertex) { return vec4(osg_PositionDecodeOffset + osg_PositionDecodeScale*vertex.xyz, 1.0); }\n"
+    "#else\n"
+    "vec4 osg_decodePosition(vec4 vertex) { return vertex; }\n"
+    "#endif\n"
+    "\n"
+    "#ifdef OSG_OCTAHEDRAL_NORMAL\n"
+    "attribute vec2 osg_OctahedralNormal;\n"
+    "vec3 osg_decodeNormal(vec3 normal)\n"
+    "{\n"
+    "    vec3 n = vec3(osg_OctahedralNormal, 1.0 - abs(osg_OctahedralNormal.x) - abs(osg_OctahedralNormal.y));\n"
+    "    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+    "    return normalize(n);\n"
+    "}\n"
+    "#else\n"
+    "vec3 osg_decodeNormal(vec3 normal) { return normal; }\n"
+    "#endif\n";
+
+// octahedral mapping of a unit vector onto the [-1,1] square, folding the lower hemisphere over the diagonals.
+inline Vec2 encodeOctahedral(const Vec3& n)
+{
+    float l1 = fabsf(n.x())+fabsf(n.y())+fabsf(n.z());
+    if (l1==0.0f) return Vec2(0.0f, 0.0f);
+
+    float x = n.x()/l1;
+    float y = n.y()/l1;
+    if (n.z()<0.0f)
+    {
+        float fx = (1.0f-fabsf(y))*(x>=0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f-fabsf(x))*(y>=0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    return Vec2(x, y);
+}
+
+inline Vec3 decodeOctahedral(float x, float y)
+{
+    Vec3 n(x, y, 1.0f-fabsf(x)-fabsf(y));
+    if (n.z()<0.0f)
+    {
+        float fx = (1.0f-fabsf(y))*(x>=0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f-fabsf(x))*(y>=0.0f ? 1.0f : -1.0f);
+        n.x() = fx;
+        n.y() = fy;
+    }
+    n.normalize();
+    return n;
+}
+
+// Encode normals as octahedral pairs of normalized integers in [-maxValue, maxValue], picking the rounding of each
+// component that decodes closest to the original, and return the largest angle between an original and decoded normal.
+template<class ArrayType>
+float encodeOctahedralNormals(const Vec3Array& normals, ArrayType& encoded, int maxValue)
+{
+    typedef typename ArrayType::ElementDataType Element;
+    typedef typename Element::value_type Component;
+
+    float scale = static_cast<float>(maxValue);
+    float minimumDot = 1.0f;
+
+    encoded.reserve(normals.size());
+    for(Vec3Array::const_iterator itr = normals.begin(); itr != normals.end(); ++itr)
+    {
+        Vec3 n = *itr;
+        if (n.normalize()==0.0f)
+        {
+            encoded.push_back(Element(0, 0));
+            continue;
+        }
+
+        Vec2 e = encodeOctahedral(n);
+        int x0 = static_cast<int>(floorf(e.x()*scale));
+        int y0 = static_cast<int>(floorf(e.y()*scale));
+
+        int bestX = 0, bestY = 0;
+        float bestDot = -2.0f;
+        for(int dy=0; dy<2; ++dy)
+        {
+            for(int dx=0; dx<2; ++dx)
+            {
+                int x = clampTo(x0+dx, -maxValue, maxValue);
+                int y = clampTo(y0+dy, -maxValue, maxValue);
+                float dot = decodeOctahedral(static_cast<float>(x)/scale, static_cast<float>(y)/scale)*n;
+                if (dot>bestDot)
+                {
+                    bestDot = dot;
+                    bestX = x;
+                    bestY = y;
+                }
+            }
+        }
+
+        encoded.push_back(Element(static_cast<Component>(bestX), static_cast<Component>(bestY)));
+        if (bestDot<minimumDot) minimumDot = bestDot;
+    }
+
+    return acosf(clampTo(minimumDot, -1.0f, 1.0f));
+}
+
+inline short quantizeToShort(float value, float offset, float scale)
+{
+    return static_cast<short>(clampTo(static_cast<int>(floorf((value-offset)/scale+0.5f)), -32767, 32767));
+}
+
+}
+
+bool VertexAttributeCompressionVisitor::DecodeParameters::operator < (const DecodeParameters& rhs) const
+{
+    if (_quantizedPositions!=rhs._quantizedPositions) return _quantizedPositions<rhs._quantizedPositions;
+    if (_positionOffset!=rhs._positionOffset) return _positionOffset<rhs._positionOffset;
+    if (_positionScale!=rhs._positionScale) return _positionScale<rhs._positionScale;
+    if (_octahedralNormals!=rhs._octahedralNormals) return _octahedralNormals<rhs._octahedralNormals;
+    return _texCoordDecodes<rhs._texCoordDecodes;
+}
+
+std::string VertexAttributeCompressionVisitor::getDecodeShaderSource(unsigned int numTextureUnits)
+{
+    std::ostringstream source;
+
+    source<<"#pragma import_defines(OSG_QUANTIZED_POSITION, OSG_OCTAHEDRAL_NORMAL";
+    for(unsigned int unit=0; unit<numTextureUnits; ++unit)
+    {
+        source<<", "<<getTexCoordDecodeDefine(unit);
+    }
+    source<<")\n\n";
+
+    source<<s_decodeShaderSource;
+
+    for(unsigned int unit=0; unit<numTextureUnits; ++unit)
+    {
+        std::string define = getTexCoordDecodeDefine(unit);
+        std::string uniform = getTexCoordDecodeUniform(unit);
+        source<<"\n"
+              <<"#ifdef "<<define<<"\n"
+              <<"uniform vec4 "<<uniform<<";\n"
+              <<"vec4 osg_decodeTexCoord"<<unit<<"(vec4 texcoord) { return vec4("<<uniform<<".xy + "<<uniform<<".zw*texcoord.xy, 0.0, 1.0); }\n"
+              <<"#else\n"
+              <<"vec4 osg_decodeTexCoord"<<unit<<"(vec4 texcoord) { return texcoord; }\n"
+              <<"#endif\n";
+    }
+
+    return source.str();
+}
+
+std::string VertexAttributeCompressionVisitor::getTexCoordDecodeDefine(unsigned int unit)
+{
+    std::ostringstream define;
+    define<<"OSG_QUANTIZED_TEXCOORD"<<unit;
+    return define.str();
+}
+
+std::string VertexAttributeCompressionVisitor::getTexCoordDecodeUniform(unsigned int unit)
+{
+    std::ostringstream uniform;
+    uniform<<"osg_TexCoordDecode"<<unit;
+    return uniform.str();
+}
+
+bool VertexAttributeCompressionVisitor::isCompressible(const Geometry& geom) const
+{
+    return geom.getDataVariance()!=Object::DYNAMIC &&
+           !geom.getUpdateCallback() && !geom.getEventCallback() &&
+           !geom.containsDeprecatedData() &&
+           isOperationPermissibleForObject(&geom);
+}
+
+bool VertexAttributeCompressionVisitor::compressArray(ArrayKind kind, Array* array, CompressedArray& compressed)
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_compressedArrayMapMutex);
+        CompressedArrayMap::iterator itr = _compressedArrayMap.find(std::make_pair(kind, static_cast<const Array*>(array)));
+        if (itr!=_compressedArrayMap.end())
+        {
+            compressed = itr->second;
+            return compressed._compressed.valid();
+        }
+    }
+
+    compressed._original = array;
+    compressed._compressed = 0;
+
+    switch(kind)
+    {
+        case(POSITION_ARRAY):
+        {
+            Vec3Array* vertices = dynamic_cast<Vec3Array*>(array);
+            if (!vertices || vertices->empty()) break;
+
+            BoundingBox bb;
+            for(Vec3Array::iterator itr = vertices->begin(); itr != vertices->end(); ++itr) bb.expandBy(*itr);
+
+            Vec3 halfExtents = (bb._max-bb._min)*0.5f;
+            Vec3 scale;
+            float maximumError = 0.0f;
+            for(unsigned int axis=0; axis<3; ++axis)
+            {
+                scale[axis] = halfExtents[axis]>0.0f ? halfExtents[axis]/32767.0f : 1.0f;
+                if (halfExtents[axis]>0.0f) maximumError = osg::maximum(maximumError, scale[axis]*0.5f);
+            }
+
+            float size = osg::maximum(halfExtents.x(), osg::maximum(halfExtents.y(), halfExtents.z()))*2.0f;
+            if (maximumError>_maximumPositionError*size) break;
+
+            Vec3 offset = bb.center();
+            ref_ptr<Vec3sArray> quantized = new Vec3sArray;
+            quantized->reserve(vertices->size());
+            for(Vec3Array::iterator itr = vertices->begin(); itr != vertices->end(); ++itr)
+            {
+                quantized->push_back(Vec3s(quantizeToShort(itr->x(), offset.x(), scale.x()),
+                                           quantizeToShort(itr->y(), offset.y(), scale.y()),
+                                           quantizeToShort(itr->z(), offset.z(), scale.z())));
+            }
+
+            compressed._compressed = quantized;
+            compressed._offset = offset;
+            compressed._scale = scale;
+            break;
+        }
+        case(NORMAL_ARRAY):
+        {
+            Vec3Array* normals = dynamic_cast<Vec3Array*>(array);
+            if (!normals || normals->empty() || normals->getBinding()!=Array::BIND_PER_VERTEX) break;
+
+            ref_ptr<Vec2bArray> normalsAsBytes = new Vec2bArray;
+            if (encodeOctahedralNormals(*normals, *normalsAsBytes, 127)<=_maximumNormalError)
+            {
+                compressed._compressed = normalsAsBytes;
+            }
+            else
+            {
+                ref_ptr<Vec2sArray> normalsAsShorts = new Vec2sArray;
+                if (encodeOctahedralNormals(*normals, *normalsAsShorts, 32767)<=_maximumNormalError)
+                {
+                    compressed._compressed = normalsAsShorts;
+                }
+            }
+
+            if (compressed._compressed.valid()) compressed._compressed->setNormalize(true);
+            break;
+        }
+        case(TEXCOORD_ARRAY):
+        {
+            Vec2Array* texcoords = dynamic_cast<Vec2Array*>(array);
+            if (!texcoords || texcoords->empty()) break;
+
+            Vec2 minimum = texcoords->front();
+            Vec2 maximum = texcoords->front();
+            for(Vec2Array::iterator itr = texcoords->begin(); itr != texcoords->end(); ++itr)
+            {
+                minimum.set(osg::minimum(minimum.x(), itr->x()), osg::minimum(minimum.y(), itr->y()));
+                maximum.set(osg::maximum(maximum.x(), itr->x()), osg::maximum(maximum.y(), itr->y()));
+            }
+
+            Vec2 offset = (minimum+maximum)*0.5f;
+            Vec2 halfExtents = (maximum-minimum)*0.5f;
+            Vec2 scale(halfExtents.x()>0.0f ? halfExtents.x()/32767.0f : 1.0f,
+                       halfExtents.y()>0.0f ? halfExtents.y()/32767.0f : 1.0f);
+
+            float maximumError = 0.0f;
+            if (halfExtents.x()>0.0f) maximumError = osg::maximum(maximumError, scale.x()*0.5f);
+            if (halfExtents.y()>0.0f) maximumError = osg::maximum(maximumError, scale.y()*0.5f);
+            if (maximumError>_maximumTexCoordError) break;
+
+            ref_ptr<Vec2sArray> quantized = new Vec2sArray;
+            quantized->reserve(texcoords->size());
+            for(Vec2Array::iterator itr = texcoords->begin(); itr != texcoords->end(); ++itr)
+            {
+                quantized->push_back(Vec2s(quantizeToShort(itr->x(), offset.x(), scale.x()),
+                                           quantizeToShort(itr->y(), offset.y(), scale.y())));
+            }
+
+            compressed._compressed = quantized;
+            compressed._offset.set(offset.x(), offset.y(), 0.0f);
+            compressed._scale.set(scale.x(), scale.y(), 1.0f);
+            break;
+        }
+        case(COLOR_ARRAY):
+        {
+            Vec4Array* colors = dynamic_cast<Vec4Array*>(array);
+            if (!colors || colors->empty() || 0.5f/255.0f>_maximumColorError) break;
+
+            ref_ptr<Vec4ubArray> colorsAsBytes = new Vec4ubArray;
+            colorsAsBytes->reserve(colors->size());
+            for(Vec4Array::iterator itr = colors->begin(); itr != colors->end(); ++itr)
+            {
+                Vec4ub color;
+                for(unsigned int c=0; c<4; ++c)
+                {
+                    float value = (*itr)[c];
+                    if (value<0.0f || value>1.0f)
+                    {
+                        // colors outside of the [0,1] range can't be normalized.
+                        colorsAsBytes = 0;
+                        break;
+                    }
+                    color[c] = static_cast<unsigned char>(floorf(value*255.0f+0.5f));
+                }
+
+                if (!colorsAsBytes) break;
+                colorsAsBytes->push_back(color);
+            }
+
+            if (colorsAsBytes.valid())
+            {
+                colorsAsBytes->setNormalize(true);
+                compressed._compressed = colorsAsBytes;
+            }
+            break;
+        }
+    }
+
+    if (compressed._compressed.valid())
+    {
+        compressed._compressed->setName(array->getName());
+        compressed._compressed->setBinding(kind==NORMAL_ARRAY ? Array::BIND_PER_VERTEX : array->getBinding());
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_compressedArrayMapMutex);
+    _compressedArrayMap[std::make_pair(kind, static_cast<const Array*>(array))] = compressed;
+    return compressed._compressed.valid();
+}
+
+void VertexAttributeCompressionVisitor::compressArrays(Geometry& geom, CompressedGeometry& compressed)
+{
+    // the initial bound replaces the bound computed from quantized positions, so a custom bound callback rules them out.
+    if ((_attributes & POSITIONS) && geom.getVertexArray() && !geom.getComputeBoundingBoxCallback())
+    {
+        compressArray(POSITION_ARRAY, geom.getVertexArray(), compressed._vertexArray);
+    }
+
+    if ((_attributes & NORMALS) && geom.getNormalArray() &&
+        (_normalAttributeIndex>=geom.getNumVertexAttribArrays() || !geom.getVertexAttribArray(_normalAttributeIndex)))
+    {
+        compressArray(NORMAL_ARRAY, geom.getNormalArray(), compressed._normalArray);
+    }
+
+    if (_attributes & TEXCOORDS)
+    {
+        for(unsigned int unit=0; unit<geom.getNumTexCoordArrays(); ++unit)
+        {
+            if (!geom.getTexCoordArray(unit)) continue;
+
+            CompressedArray texcoords;
+            if (compressArray(TEXCOORD_ARRAY, geom.getTexCoordArray(unit), texcoords))
+            {
+                compressed._texCoordArrays[unit] = texcoords;
+            }
+        }
+    }
+
+    if ((_attributes & COLORS) && geom.getColorArray())
+    {
+        compressArray(COLOR_ARRAY, geom.getColorArray(), compressed._colorArray);
+    }
+}
+
+bool VertexAttributeCompressionVisitor::applyCompressedArrays(Geometry& geom, const CompressedGeometry& compressed)
+{
+    bool arraysCompressed = false;
+    DecodeParameters decodeParameters;
+
+    if (compressed._vertexArray._compressed.valid())
+    {
+        BoundingBox bb = geom.getBoundingBox();
+        geom.setVertexArray(compressed._vertexArray._compressed.get());
+        geom.setInitialBound(bb);
+        geom.setComputeBoundingBoxCallback(new Drawable::ComputeBoundingBoxCallback);
+
+        decodeParameters._quantizedPositions = true;
+        decodeParameters._positionOffset = compressed._vertexArray._offset;
+        decodeParameters._positionScale = compressed._vertexArray._scale;
+        arraysCompressed = true;
+    }
+
+    if (compressed._normalArray._compressed.valid())
+    {
+        geom.setNormalArray(0);
+        geom.setVertexAttribArray(_normalAttributeIndex, compressed._normalArray._compressed.get());
+
+        decodeParameters._octahedralNormals = true;
+        arraysCompressed = true;
+    }
+
+    for(std::map<unsigned int, CompressedArray>::const_iterator itr = compressed._texCoordArrays.begin();
+        itr != compressed._texCoordArrays.end();
+        ++itr)
+    {
+        const CompressedArray& texcoords = itr->second;
+        geom.setTexCoordArray(itr->first, texcoords._compressed.get());
+
+        decodeParameters._texCoordDecodes[itr->first] = Vec4(texcoords._offset.x(), texcoords._offset.y(), texcoords._scale.x(), texcoords._scale.y());
+        arraysCompressed = true;
+    }
+
+    if (compressed._colorArray._compressed.valid())
+    {
+        geom.setColorArray(compressed._colorArray._compressed.get());
+        arraysCompressed = true;
+    }
+
+    if (!decodeParameters._quantizedPositions && !decodeParameters._octahedralNormals && decodeParameters._texCoordDecodes.empty())
+    {
+        return arraysCompressed;
+    }
+
+    // geometries sharing a StateSet and decode parameters share the StateSet that decodes them.
+    StateSet* original = geom.getStateSet();
+    DecodeStateSet& decodeStateSet = _decodeStateSetMap[std::make_pair(original, decodeParameters)];
+    if (!decodeStateSet._decode)
+    {
+        decodeStateSet._original = original;
+        decodeStateSet._decode = original ? new StateSet(*original, CopyOp::SHALLOW_COPY) : new StateSet;
+
+        StateSet* stateset = decodeStateSet._decode.get();
+        if (decodeParameters._quantizedPositions)
+        {
+            stateset->setDefine("OSG_QUANTIZED_POSITION");
+            stateset->addUniform(new Uniform("osg_PositionDecodeOffset", decodeParameters._positionOffset));
+            stateset->addUniform(new Uniform("osg_PositionDecodeScale", decodeParameters._positionScale));
+        }
+
+        if (decodeParameters._octahedralNormals)
+        {
+            stateset->setDefine("OSG_OCTAHEDRAL_NORMAL");
+        }
+
+        for(std::map<unsigned int, Vec4>::iterator itr = decodeParameters._texCoordDecodes.begin();
+            itr != decodeParameters._texCoordDecodes.end();
+            ++itr)
+        {
+            stateset->setDefine(getTexCoordDecodeDefine(itr->first));
+            stateset->addUniform(new Uniform(getTexCoordDecodeUniform(itr->first).c_str(), itr->second));
+        }
+    }
+
+    geom.setStateSet(decodeStateSet._decode.get());
+    return true;
+}
+
+void VertexAttributeCompressionVisitor::compressArraysFunction(GeometryCollector& collector, Geometry& geom)
+{
+    // the map entries are all created up front, so tasks only write to their own entry.
+    VertexAttributeCompressionVisitor& visitor = static_cast<VertexAttributeCompressionVisitor&>(collector);
+    CompressedGeometryMap::iterator itr = visitor._compressedGeometryMap.find(&geom);
+    if (itr!=visitor._compressedGeometryMap.end()) visitor.compressArrays(geom, itr->second);
+}
+
+bool VertexAttributeCompressionVisitor::compress(Geometry& geom)
+{
+    if (!isCompressible(geom)) return false;
+
+    CompressedGeometry compressed;
+    compressArrays(geom, compressed);
+    return applyCompressedArrays(geom, compressed);
+}
+
+void VertexAttributeCompressionVisitor::compress()
+{
+    _compressedGeometryMap.clear();
+
+    for(GeometryList::iterator itr = _geometryList.begin();
+        itr != _geometryList.end();
+        )
+    {
+        if (!isCompressible(**itr))
+        {
+            _geometryList.erase(itr++);
+        }
+        else
+        {
+            _compressedGeometryMap[*itr];
+            ++itr;
+        }
+    }
+
+    processGeometryList(compressArraysFunction);
+
+    // the geometries' bounds and StateSets are updated serially as they can be shared between the tasks' partitions.
+    unsigned int numCompressed = 0;
+    for(CompressedGeometryMap::iterator itr = _compressedGeometryMap.begin();
+        itr != _compressedGeometryMap.end();
+        ++itr)
+    {
+        if (applyCompressedArrays(*(itr->first), itr->second)) ++numCompressed;
+    }
+
+    OSG_INFO<<"VertexAttributeCompressionVisitor::compress() compressed the arrays of "<<numCompressed<<" of "<<_compressedGeometryMap.size()<<" geometries"<<std::endl;
+
+    _compressedGeometryMap.clear();
+    _compressedArrayMap.clear();
+    _decodeStateSetMap.clear();
+}
+
 }
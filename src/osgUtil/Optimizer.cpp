@@ -53,7 +53,22 @@ void Optimizer::reset()
 {
 }
 
-static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | BUFFER_OBJECT_SETTINGS");
+Optimizer::ScopedPassTimer::ScopedPassTimer(Optimizer* optimizer, const char* name):
+    _optimizer(optimizer),
+    _name(name),
+    _startTick(osg::Timer::instance()->tick())
+{
+}
+
+Optimizer::ScopedPassTimer::~ScopedPassTimer()
+{
+    double duration = osg::Timer::instance()->delta_m(_startTick, osg::Timer::instance()->tick());
+    _optimizer->_passTimings.push_back(PassTiming(_name, duration));
+
+    OSG_INFO<<"Optimizer::optimize() "<<_name<<" took "<<duration<<"ms"<<std::endl;
+}
+
+static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | BUFFER_OBJECT_SETTINGS | BUILD_MESHLETS | COMPRESS_VERTEX_ATTRIBUTES | PARALLEL");
 
 void Optimizer::optimize(osg::Node* node)
 {
@@ -132,12 +147,23 @@ void Optimizer::optimize(osg::Node* node)
 
         if(str.find("~BUFFER_OBJECT_SETTINGS")!=std::string::npos) options ^= BUFFER_OBJECT_SETTINGS;
         else if(str.find("BUFFER_OBJECT_SETTINGS")!=std::string::npos) options |= BUFFER_OBJECT_SETTINGS;
+
+        if(str.find("~BUILD_MESHLETS")!=std::string::npos) options ^= BUILD_MESHLETS;
+        else if(str.find("BUILD_MESHLETS")!=std::string::npos) options |= BUILD_MESHLETS;
+
+        if(str.find("~COMPRESS_VERTEX_ATTRIBUTES")!=std::string::npos) options ^= COMPRESS_VERTEX_ATTRIBUTES;
+        else if(str.find("COMPRESS_VERTEX_ATTRIBUTES")!=std::string::npos) options |= COMPRESS_VERTEX_ATTRIBUTES;
     }
     else
     {
         options = DEFAULT_OPTIMIZATIONS;
     }
 
+    if (env && !_taskPool.valid() && std::string(env).find("PARALLEL")!=std::string::npos)
+    {
+        setTaskPool(osg::TaskPool::instance().get());
+    }
+
     optimize(node,options);
 
 }
@@ -146,6 +172,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 {
     StatsVisitor stats;
 
+    _passTimings.clear();
+
     if (osg::getNotifyLevel()>=osg::INFO)
     {
         node->accept(stats);
@@ -156,12 +184,16 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & STATIC_OBJECT_DETECTION)
     {
+        ScopedPassTimer timer(this, "STATIC_OBJECT_DETECTION");
+
         StaticObjectDetectionVisitor sodv;
         node->accept(sodv);
     }
 
     if (options & TESSELLATE_GEOMETRY)
     {
+        ScopedPassTimer timer(this, "TESSELLATE_GEOMETRY");
+
         OSG_INFO<<"Optimizer::optimize() doing TESSELLATE_GEOMETRY"<<std::endl;
 
         TessellateVisitor tsv;
@@ -170,6 +202,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_LOADED_PROXY_NODES)
     {
+        ScopedPassTimer timer(this, "REMOVE_LOADED_PROXY_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing REMOVE_LOADED_PROXY_NODES"<<std::endl;
 
         RemoveLoadedProxyNodesVisitor rlpnv(this);
@@ -180,6 +214,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COMBINE_ADJACENT_LODS)
     {
+        ScopedPassTimer timer(this, "COMBINE_ADJACENT_LODS");
+
         OSG_INFO<<"Optimizer::optimize() doing COMBINE_ADJACENT_LODS"<<std::endl;
 
         CombineLODsVisitor clv(this);
@@ -189,6 +225,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & OPTIMIZE_TEXTURE_SETTINGS)
     {
+        ScopedPassTimer timer(this, "OPTIMIZE_TEXTURE_SETTINGS");
+
         OSG_INFO<<"Optimizer::optimize() doing OPTIMIZE_TEXTURE_SETTINGS"<<std::endl;
 
         TextureVisitor tv(true,true, // unref image
@@ -200,6 +238,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SHARE_DUPLICATE_STATE)
     {
+        ScopedPassTimer timer(this, "SHARE_DUPLICATE_STATE");
+
         OSG_INFO<<"Optimizer::optimize() doing SHARE_DUPLICATE_STATE"<<std::endl;
 
         bool combineDynamicState = false;
@@ -213,6 +253,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & TEXTURE_ATLAS_BUILDER)
     {
+        ScopedPassTimer timer(this, "TEXTURE_ATLAS_BUILDER");
+
         OSG_INFO<<"Optimizer::optimize() doing TEXTURE_ATLAS_BUILDER"<<std::endl;
 
         // traverse the scene collecting textures into texture atlas.
@@ -232,6 +274,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COPY_SHARED_NODES)
     {
+        ScopedPassTimer timer(this, "COPY_SHARED_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing COPY_SHARED_NODES"<<std::endl;
 
         CopySharedSubgraphsVisitor cssv(this);
@@ -241,6 +285,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS)
     {
+        ScopedPassTimer timer(this, "FLATTEN_STATIC_TRANSFORMS");
+
         OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS"<<std::endl;
 
         int i=0;
@@ -262,6 +308,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS)
     {
+        ScopedPassTimer timer(this, "FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS");
+
         OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS"<<std::endl;
 
         // now combine any adjacent static transforms.
@@ -272,6 +320,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_REDUNDANT_NODES)
     {
+        ScopedPassTimer timer(this, "REMOVE_REDUNDANT_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing REMOVE_REDUNDANT_NODES"<<std::endl;
 
         RemoveEmptyNodesVisitor renv(this);
@@ -286,20 +336,18 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEODES)
     {
-        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEODES"<<std::endl;
+        ScopedPassTimer timer(this, "MERGE_GEODES");
 
-        osg::Timer_t startTick = osg::Timer::instance()->tick();
+        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEODES"<<std::endl;
 
         MergeGeodesVisitor visitor;
         node->accept(visitor);
-
-        osg::Timer_t endTick = osg::Timer::instance()->tick();
-
-        OSG_INFO<<"MERGE_GEODES took "<<osg::Timer::instance()->delta_s(startTick,endTick)<<std::endl;
     }
 
     if (options & MAKE_FAST_GEOMETRY)
     {
+        ScopedPassTimer timer(this, "MAKE_FAST_GEOMETRY");
+
         OSG_INFO<<"Optimizer::optimize() doing MAKE_FAST_GEOMETRY"<<std::endl;
 
         MakeFastGeometryVisitor mgv(this);
@@ -308,22 +356,22 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEOMETRY"<<std::endl;
+        ScopedPassTimer timer(this, "MERGE_GEOMETRY");
 
-        osg::Timer_t startTick = osg::Timer::instance()->tick();
+        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEOMETRY"<<std::endl;
 
         MergeGeometryVisitor mgv(this);
         mgv.setTargetMaximumNumberOfVertices(10000);
+        mgv.setTaskPool(_taskPool.get());
         node->accept(mgv);
-
-        osg::Timer_t endTick = osg::Timer::instance()->tick();
-
-        OSG_INFO<<"MERGE_GEOMETRY took "<<osg::Timer::instance()->delta_s(startTick,endTick)<<std::endl;
+        if (mgv.getTaskPool()) mgv.mergeCollectedGroups();
     }
 
 
     if (options & FLATTEN_BILLBOARDS)
     {
+        ScopedPassTimer timer(this, "FLATTEN_BILLBOARDS");
+
         FlattenBillboardVisitor fbv(this);
         node->accept(fbv);
         fbv.process();
@@ -331,6 +379,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SPATIALIZE_GROUPS)
     {
+        ScopedPassTimer timer(this, "SPATIALIZE_GROUPS");
+
         OSG_INFO<<"Optimizer::optimize() doing SPATIALIZE_GROUPS"<<std::endl;
 
         SpatializeGroupsVisitor sv(this);
@@ -340,6 +390,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & INDEX_MESH)
     {
+        ScopedPassTimer timer(this, "INDEX_MESH");
+
         OSG_INFO<<"Optimizer::optimize() doing INDEX_MESH"<<std::endl;
         IndexMeshVisitor imv(this);
         node->accept(imv);
@@ -348,22 +400,48 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & VERTEX_POSTTRANSFORM)
     {
+        ScopedPassTimer timer(this, "VERTEX_POSTTRANSFORM");
+
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_POSTTRANSFORM"<<std::endl;
-        VertexCacheVisitor vcv;
+        VertexCacheVisitor vcv(this);
         node->accept(vcv);
         vcv.optimizeVertices();
     }
 
     if (options & VERTEX_PRETRANSFORM)
     {
+        ScopedPassTimer timer(this, "VERTEX_PRETRANSFORM");
+
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_PRETRANSFORM"<<std::endl;
-        VertexAccessOrderVisitor vaov;
+        VertexAccessOrderVisitor vaov(this);
         node->accept(vaov);
         vaov.optimizeOrder();
     }
 
+    if (options & BUILD_MESHLETS)
+    {
+        ScopedPassTimer timer(this, "BUILD_MESHLETS");
+
+        OSG_INFO<<"Optimizer::optimize() doing BUILD_MESHLETS"<<std::endl;
+        MeshletBuildVisitor mbv(this);
+        node->accept(mbv);
+        mbv.buildMeshlets();
+    }
+
+    if (options & COMPRESS_VERTEX_ATTRIBUTES)
+    {
+        ScopedPassTimer timer(this, "COMPRESS_VERTEX_ATTRIBUTES");
+
+        OSG_INFO<<"Optimizer::optimize() doing COMPRESS_VERTEX_ATTRIBUTES"<<std::endl;
+        VertexAttributeCompressionVisitor vacv(this);
+        node->accept(vacv);
+        vacv.compress();
+    }
+
     if (options & BUFFER_OBJECT_SETTINGS)
     {
+        ScopedPassTimer timer(this, "BUFFER_OBJECT_SETTINGS");
+
         OSG_INFO<<"Optimizer::optimize() doing BUFFER_OBJECT_SETTINGS"<<std::endl;
         BufferObjectVisitor bov(true, true, true, true, true, false);
         node->accept(bov);
@@ -1773,10 +1851,153 @@ bool isAbleToMerge(const osg::Geometry& g1, const osg::Geometry& g2)
     return true;
 }
 
+void Optimizer::MergeGeometryVisitor::apply(osg::Group& group)
+{
+    if (_taskPool.valid()) _groupList.push_back(&group);
+    else mergeGroup(group);
+
+    traverse(group);
+}
+
+namespace
+{
+    // return true if merging the group can't change anything outside the group itself, its children's parent lists
+    // and its own bound, so that it can be merged alongside other such groups. Children shared with other groups
+    // have their parent lists modified by each group's merge, so groups with shared children are merged serially.
+    bool isIndependentGroup(osg::Group& group)
+    {
+        for(unsigned int i=0; i<group.getNumChildren(); ++i)
+        {
+            osg::Node* child = group.getChild(i);
+            if (child->getNumParents()!=1) return false;
+
+            // removing and re-adding these children changes the traversal counts of the group's parents.
+            if (child->getNumChildrenRequiringUpdateTraversal()>0 || child->getUpdateCallback()) return false;
+            if (child->getNumChildrenRequiringEventTraversal()>0 || child->getEventCallback()) return false;
+            if (child->getNumChildrenWithCullingDisabled()>0 || !child->getCullingActive()) return false;
+            if (child->getNumChildrenWithOccluderNodes()>0 || child->asOccluderNode()) return false;
+        }
+        return true;
+    }
+
+    class MergeGroupsOperation : public osg::Operation
+    {
+    public:
+        MergeGroupsOperation(Optimizer::MergeGeometryVisitor& visitor):
+            osg::Operation("MergeGroupsOperation", false),
+            _visitor(visitor) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            for(unsigned int i=0; i<_groups.size(); ++i)
+            {
+                _visitor.mergeGroup(*_groups[i], *_permissibleGeometries[i]);
+            }
+        }
+
+        typedef Optimizer::MergeGeometryVisitor::GeometrySet GeometrySet;
+
+        Optimizer::MergeGeometryVisitor&    _visitor;
+        std::vector<osg::Group*>            _groups;
+        std::vector<const GeometrySet*>     _permissibleGeometries;
+    };
+}
+
+void Optimizer::MergeGeometryVisitor::mergeCollectedGroups()
+{
+    // groups reached through more than one parental path are visited, and merged, more than once.
+    typedef std::map<osg::Group*, unsigned int> VisitCountMap;
+    VisitCountMap visitCounts;
+    for(GroupList::iterator itr = _groupList.begin();
+        itr != _groupList.end();
+        ++itr)
+    {
+        ++visitCounts[*itr];
+    }
+
+    // the Optimizer's IsOperationPermissibleForObjectCallback isn't required to be thread safe, so the permissions
+    // for the independent groups and their geometries are all gathered here before any merging starts.
+    GroupList independentGroups;
+    std::vector<GeometrySet> permissibleGeometries;
+    GroupList dependentGroups;
+    for(GroupList::iterator itr = _groupList.begin();
+        itr != _groupList.end();
+        ++itr)
+    {
+        osg::Group* group = *itr;
+
+        // dirty the bounds up front so that the dirtyBound() calls made while merging don't propagate to the parents.
+        group->dirtyBound();
+
+        if (visitCounts[group]==1 && isIndependentGroup(*group))
+        {
+            if (!isOperationPermissibleForObject(group)) continue;
+
+            independentGroups.push_back(group);
+            permissibleGeometries.push_back(GeometrySet());
+            getPermissibleGeometries(*group, permissibleGeometries.back());
+        }
+        else dependentGroups.push_back(group);
+    }
+
+    _groupList.clear();
+
+    if (_taskPool.valid() && independentGroups.size()>1)
+    {
+        const unsigned int numGroupsPerTask = 16;
+
+        osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+        for(unsigned int i=0; i<independentGroups.size(); i+=numGroupsPerTask)
+        {
+            osg::ref_ptr<MergeGroupsOperation> operation = new MergeGroupsOperation(*this);
+            unsigned int end = osg::minimum(i+numGroupsPerTask, static_cast<unsigned int>(independentGroups.size()));
+            for(unsigned int j=i; j<end; ++j)
+            {
+                operation->_groups.push_back(independentGroups[j]);
+                operation->_permissibleGeometries.push_back(&permissibleGeometries[j]);
+            }
+            _taskPool->add(operation.get(), taskSet.get());
+        }
+        _taskPool->wait(taskSet.get());
+    }
+    else
+    {
+        for(unsigned int i=0; i<independentGroups.size(); ++i)
+        {
+            mergeGroup(*independentGroups[i], permissibleGeometries[i]);
+        }
+    }
+
+    // the independent groups share no geometries with these, so merging these afterwards gives the same result as a serial traversal.
+    for(GroupList::iterator itr = dependentGroups.begin();
+        itr != dependentGroups.end();
+        ++itr)
+    {
+        mergeGroup(**itr);
+    }
+}
+
+void Optimizer::MergeGeometryVisitor::getPermissibleGeometries(osg::Group& group, GeometrySet& geometries)
+{
+    for(unsigned int i=0; i<group.getNumChildren(); ++i)
+    {
+        osg::Geometry* geom = group.getChild(i)->asGeometry();
+        if (geom && isOperationPermissibleForObject(geom)) geometries.insert(geom);
+    }
+}
+
 bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
 {
     if (!isOperationPermissibleForObject(&group)) return false;
 
+    GeometrySet permissibleGeometries;
+    getPermissibleGeometries(group, permissibleGeometries);
+
+    return mergeGroup(group, permissibleGeometries);
+}
+
+bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group, const GeometrySet& permissibleGeometries)
+{
     if (group.getNumChildren()>=2)
     {
 
@@ -1798,7 +2019,7 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
             {
                 if (!geometryContainsSharedArrays(*geom) &&
                     geom->getDataVariance()!=osg::Object::DYNAMIC &&
-                    isOperationPermissibleForObject(geom))
+                    permissibleGeometries.count(geom)!=0)
                 {
                     geometryDuplicateMap[geom].push_back(geom);
                 }
@@ -419,6 +419,31 @@ RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
     return rb;
 }
 
+RenderBin* RenderBin::find_or_insert(int binNum,const RenderBin* binTemplate)
+{
+    // search for appropriate bin.
+    RenderBinList::iterator itr = _bins.find(binNum);
+    if (itr!=_bins.end()) return itr->second.get();
+
+    RenderBin* rb = binTemplate ? dynamic_cast<RenderBin*>(binTemplate->cloneType()) : 0;
+    if (!rb) rb = new RenderBin;
+
+    if (binTemplate)
+    {
+        rb->_sortMode = binTemplate->_sortMode;
+        rb->_sortCallback = binTemplate->_sortCallback;
+        rb->_drawCallback = binTemplate->_drawCallback;
+        rb->_stateset = binTemplate->_stateset;
+    }
+
+    rb->_binNum = binNum;
+    rb->_parent = this;
+    rb->_stage = _stage;
+    _bins[binNum] = rb;
+
+    return rb;
+}
+
 void RenderBin::draw(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     renderInfo.pushRenderBin(this);
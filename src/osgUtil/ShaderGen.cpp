@@ -17,6 +17,7 @@
  */
 
 #include <osgUtil/ShaderGen>
+#include <osgUtil/MeshOptimizers>
 #include <osg/Geode>
 #include <osg/Geometry> // for ShaderGenVisitor::update
 #include <osg/Fog>
@@ -31,7 +32,8 @@ namespace osgUtil
 {
 
 ShaderGenVisitor::ShaderGenVisitor():
-    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _normalAttributeIndex(VertexAttributeCompressionVisitor::DEFAULT_NORMAL_ATTRIBUTE_INDEX)
 {
 }
 
@@ -40,8 +42,12 @@ void ShaderGenVisitor::assignUberProgram(osg::StateSet *stateSet)
     if (stateSet)
     {
         osg::ref_ptr<osg::Program> uberProgram = new osg::Program;
-        uberProgram->addShader(new osg::Shader(osg::Shader::VERTEX, shadergen_vert));
+        // decode the arrays compressed by VertexAttributeCompressionVisitor, whatever texture units they are on.
+        std::string vertexSource = VertexAttributeCompressionVisitor::getDecodeShaderSource() + "\n" + shadergen_vert;
+
+        uberProgram->addShader(new osg::Shader(osg::Shader::VERTEX, vertexSource));
         uberProgram->addShader(new osg::Shader(osg::Shader::FRAGMENT, shadergen_frag));
+        uberProgram->addBindAttribLocation("osg_OctahedralNormal", _normalAttributeIndex);
 
         stateSet->setAttribute(uberProgram.get());
         stateSet->addUniform(new osg::Uniform("diffuseMap", 0));
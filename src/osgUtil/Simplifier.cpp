@@ -12,6 +12,7 @@
 */
 
 #include <osg/TriangleIndexFunctor>
+#include <osg/Notify>
 
 #include <osgUtil/Simplifier>
 
@@ -21,6 +22,8 @@
 #include <set>
 #include <list>
 #include <algorithm>
+#include <float.h>
+#include <math.h>
 
 #include <iterator>
 
@@ -1719,6 +1722,800 @@ void EdgeCollapse::copyBackToGeometry()
 }
 
 
+namespace
+{
+
+// Quadric error metric, the weighted sum of squared distances to a set of planes.
+struct Quadric
+{
+    Quadric():
+        a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0),
+        b0(0.0), b1(0.0), b2(0.0), c(0.0), w(0.0) {}
+
+    // add the plane n.p + d = 0, with n normalized.
+    void addPlane(const osg::Vec3d& n, double d, double weight)
+    {
+        a00 += weight*n.x()*n.x(); a01 += weight*n.x()*n.y(); a02 += weight*n.x()*n.z();
+        a11 += weight*n.y()*n.y(); a12 += weight*n.y()*n.z(); a22 += weight*n.z()*n.z();
+        b0 += weight*n.x()*d; b1 += weight*n.y()*d; b2 += weight*n.z()*d;
+        c += weight*d*d;
+        w += weight;
+    }
+
+    void add(const Quadric& rhs)
+    {
+        a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02;
+        a11 += rhs.a11; a12 += rhs.a12; a22 += rhs.a22;
+        b0 += rhs.b0; b1 += rhs.b1; b2 += rhs.b2;
+        c += rhs.c;
+        w += rhs.w;
+    }
+
+    double evaluate(const osg::Vec3d& p) const
+    {
+        double x = p.x(), y = p.y(), z = p.z();
+        double error = a00*x*x + a11*y*y + a22*z*z +
+                       2.0*(a01*x*y + a02*x*z + a12*y*z) +
+                       2.0*(b0*x + b1*y + b2*z) + c;
+        return error>0.0 ? error : 0.0;
+    }
+
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double w;
+};
+
+struct CollectTriangleIndicesOperator
+{
+    Simplifier::IndexList _indices;
+
+    inline void operator()(unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        _indices.push_back(p1);
+        _indices.push_back(p2);
+        _indices.push_back(p3);
+    }
+};
+
+// Moves the kept elements of an array down over the removed ones, the kept indices must be in increasing order.
+class CompactArrayVisitor : public osg::ArrayVisitor
+{
+public:
+    CompactArrayVisitor(const Simplifier::IndexList& kept): _kept(kept) {}
+
+    template<class ARRAY>
+    inline void compact(ARRAY& array)
+    {
+        for(unsigned int i=0; i<_kept.size(); ++i)
+        {
+            array[i] = array[_kept[i]];
+        }
+        array.resize(_kept.size());
+        array.trim();
+        array.dirty();
+    }
+
+    virtual void apply(osg::Array&) {}
+    virtual void apply(osg::ByteArray& array) { compact(array); }
+    virtual void apply(osg::ShortArray& array) { compact(array); }
+    virtual void apply(osg::IntArray& array) { compact(array); }
+    virtual void apply(osg::UByteArray& array) { compact(array); }
+    virtual void apply(osg::UShortArray& array) { compact(array); }
+    virtual void apply(osg::UIntArray& array) { compact(array); }
+    virtual void apply(osg::FloatArray& array) { compact(array); }
+    virtual void apply(osg::DoubleArray& array) { compact(array); }
+
+    virtual void apply(osg::Vec2Array& array) { compact(array); }
+    virtual void apply(osg::Vec3Array& array) { compact(array); }
+    virtual void apply(osg::Vec4Array& array) { compact(array); }
+    virtual void apply(osg::Vec4ubArray& array) { compact(array); }
+
+    virtual void apply(osg::Vec2bArray& array) { compact(array); }
+    virtual void apply(osg::Vec3bArray& array) { compact(array); }
+    virtual void apply(osg::Vec4bArray& array) { compact(array); }
+
+    virtual void apply(osg::Vec2sArray& array) { compact(array); }
+    virtual void apply(osg::Vec3sArray& array) { compact(array); }
+    virtual void apply(osg::Vec4sArray& array) { compact(array); }
+
+    virtual void apply(osg::Vec2dArray& array) { compact(array); }
+    virtual void apply(osg::Vec3dArray& array) { compact(array); }
+    virtual void apply(osg::Vec4dArray& array) { compact(array); }
+
+    const Simplifier::IndexList& _kept;
+
+protected:
+    CompactArrayVisitor& operator = (const CompactArrayVisitor&) { return *this; }
+};
+
+// Simplifies a triangle mesh by half edge collapses taken in order of least quadric error from an indexed heap.
+// The mesh is held in flat arrays, a triangle index list and for each vertex a linked list of the triangle
+// corners that reference it, so no per element allocations are made. Vertices that share a position but
+// differ in their other attributes are wedges of a seam, the wedges on either side of a seam are collapsed
+// together along the seam so that the seam can't open up.
+class QuadricCollapse
+{
+public:
+
+    enum VertexKind
+    {
+        MANIFOLD,   // interior vertex, can collapse to any neighbour
+        BORDER,     // on an open boundary, can only collapse along the boundary
+        SEAM,       // one of a pair of wedges along a seam, collapses along the seam with its partner
+        LOCKED      // protected, non manifold or a seam junction, never moves
+    };
+
+    typedef Simplifier::IndexList IndexList;
+
+    QuadricCollapse(): _numTriangles(0) {}
+
+    bool setGeometry(const osg::Geometry& geometry, const IndexList& protectedPoints);
+
+    unsigned int getNumTriangles() const { return _numTriangles; }
+
+    bool empty() const { return _heap.empty(); }
+
+    /** Get the RMS distance error of the next collapse.*/
+    float getNextError() const { return _heap.empty() ? FLT_MAX : static_cast<float>(sqrt(_cost[_heap[0]])); }
+
+    /** Perform the next collapse, return false when there are none left.*/
+    bool collapseNext();
+
+    /** Write the remaining triangles to geometry, which must have the arrays of the geometry passed to setGeometry.*/
+    void copyToGeometry(osg::Geometry& geometry) const;
+
+protected:
+
+    static const unsigned int INVALID;
+
+    unsigned int nextCorner(unsigned int corner) const { return (corner%3==2) ? corner-2 : corner+1; }
+    unsigned int prevCorner(unsigned int corner) const { return (corner%3==0) ? corner+2 : corner-1; }
+
+    void addCorner(unsigned int corner, unsigned int vertex)
+    {
+        _nextCorner[corner] = INVALID;
+        if (_lastCorner[vertex]==INVALID) _firstCorner[vertex] = corner;
+        else _nextCorner[_lastCorner[vertex]] = corner;
+        _lastCorner[vertex] = corner;
+    }
+
+    void collectNeighbours(unsigned int vertex, IndexList& neighbours) const;
+    unsigned int countTrianglesWithEdge(unsigned int a, unsigned int b) const;
+    bool isCollapseValid(unsigned int u, unsigned int v) const;
+    bool computeCollapseCost(unsigned int u, unsigned int v, double& cost) const;
+    bool isCollapseAllowed(unsigned int u, unsigned int v) const;
+    bool findSeamPartners(unsigned int u, unsigned int v, unsigned int& uPartner, unsigned int& vPartner) const;
+    void updateVertex(unsigned int vertex);
+    void collapse(unsigned int u, unsigned int v);
+
+    bool heapLess(unsigned int lhs, unsigned int rhs) const
+    {
+        return _cost[lhs]<_cost[rhs] || (_cost[lhs]==_cost[rhs] && lhs<rhs);
+    }
+    void heapUp(unsigned int position);
+    void heapDown(unsigned int position);
+    void heapUpdate(unsigned int vertex);
+    void heapRemove(unsigned int vertex);
+
+    unsigned int                _numVertices;
+    unsigned int                _numTriangles;
+
+    std::vector<osg::Vec3d>     _positions;
+    std::vector<Quadric>        _quadrics;
+    std::vector<unsigned char>  _kinds;
+    std::vector<unsigned char>  _removedVertices;
+    IndexList                   _wedges;
+
+    IndexList                   _indices;
+    std::vector<unsigned char>  _removedTriangles;
+    IndexList                   _firstCorner;
+    IndexList                   _lastCorner;
+    IndexList                   _nextCorner;
+
+    std::vector<double>         _cost;
+    IndexList                   _target;
+    IndexList                   _heap;
+    IndexList                   _heapPosition;
+
+    typedef std::pair<double, unsigned int> Candidate;
+    typedef std::vector<Candidate> Candidates;
+
+    IndexList                   _neighbours;
+    Candidates                  _candidates;
+    mutable IndexList           _uNeighbours;
+    mutable IndexList           _vNeighbours;
+};
+
+const unsigned int QuadricCollapse::INVALID = 0xffffffff;
+
+struct PositionLess
+{
+    PositionLess(const std::vector<osg::Vec3d>& positions): _positions(positions) {}
+
+    bool operator() (unsigned int lhs, unsigned int rhs) const
+    {
+        if (_positions[lhs]<_positions[rhs]) return true;
+        if (_positions[rhs]<_positions[lhs]) return false;
+        return lhs<rhs;
+    }
+
+    const std::vector<osg::Vec3d>& _positions;
+};
+
+bool QuadricCollapse::setGeometry(const osg::Geometry& geometry, const IndexList& protectedPoints)
+{
+    const osg::Array* vertices = geometry.getVertexArray();
+    if (!vertices) return false;
+
+    _numVertices = vertices->getNumElements();
+    _positions.resize(_numVertices);
+
+    if (const osg::Vec3Array* vec3Array = dynamic_cast<const osg::Vec3Array*>(vertices))
+    {
+        for(unsigned int i=0; i<_numVertices; ++i) _positions[i] = (*vec3Array)[i];
+    }
+    else if (const osg::Vec3dArray* vec3dArray = dynamic_cast<const osg::Vec3dArray*>(vertices))
+    {
+        for(unsigned int i=0; i<_numVertices; ++i) _positions[i] = (*vec3dArray)[i];
+    }
+    else
+    {
+        return false;
+    }
+
+    osg::TriangleIndexFunctor<CollectTriangleIndicesOperator> collectTriangles;
+    const_cast<osg::Geometry&>(geometry).accept(collectTriangles);
+
+    _indices.clear();
+    _indices.reserve(collectTriangles._indices.size());
+    for(unsigned int i=0; i+2<collectTriangles._indices.size(); i+=3)
+    {
+        unsigned int a = collectTriangles._indices[i];
+        unsigned int b = collectTriangles._indices[i+1];
+        unsigned int c = collectTriangles._indices[i+2];
+        if (a>=_numVertices || b>=_numVertices || c>=_numVertices) return false;
+        if (a==b || b==c || a==c) continue;
+
+        _indices.push_back(a);
+        _indices.push_back(b);
+        _indices.push_back(c);
+    }
+
+    unsigned int numCorners = _indices.size();
+    _numTriangles = numCorners/3;
+    _removedTriangles.assign(_numTriangles, 0);
+
+    _firstCorner.assign(_numVertices, INVALID);
+    _lastCorner.assign(_numVertices, INVALID);
+    _nextCorner.assign(numCorners, INVALID);
+    for(unsigned int corner=0; corner<numCorners; ++corner)
+    {
+        addCorner(corner, _indices[corner]);
+    }
+
+    // area weighted plane quadrics of the triangles.
+    _quadrics.assign(_numVertices, Quadric());
+    for(unsigned int t=0; t<_numTriangles; ++t)
+    {
+        const osg::Vec3d& p0 = _positions[_indices[t*3]];
+        osg::Vec3d normal = (_positions[_indices[t*3+1]]-p0)^(_positions[_indices[t*3+2]]-p0);
+        double length = normal.normalize();
+        if (length==0.0) continue;
+
+        for(unsigned int i=0; i<3; ++i)
+        {
+            _quadrics[_indices[t*3+i]].addPlane(normal, -(normal*p0), length*0.5);
+        }
+    }
+
+    // find the border edges, those used by just one triangle, and the non manifold edges used by more than two.
+    std::vector< std::pair< std::pair<unsigned int, unsigned int>, unsigned int > > edges;
+    edges.reserve(numCorners);
+    for(unsigned int corner=0; corner<numCorners; ++corner)
+    {
+        unsigned int a = _indices[corner];
+        unsigned int b = _indices[nextCorner(corner)];
+        edges.push_back(std::make_pair(std::make_pair(osg::minimum(a,b), osg::maximum(a,b)), corner));
+    }
+    std::sort(edges.begin(), edges.end());
+
+    IndexList numBorderEdges(_numVertices, 0);
+    std::vector<unsigned char> nonManifold(_numVertices, 0);
+    for(unsigned int i=0; i<edges.size(); )
+    {
+        unsigned int end = i+1;
+        while(end<edges.size() && edges[end].first==edges[i].first) ++end;
+
+        unsigned int a = edges[i].first.first;
+        unsigned int b = edges[i].first.second;
+        if (end-i==1)
+        {
+            ++numBorderEdges[a];
+            ++numBorderEdges[b];
+
+            // a plane through the border edge, perpendicular to its triangle, keeps the border in place.
+            unsigned int corner = edges[i].second;
+            unsigned int t = corner/3;
+            const osg::Vec3d& pa = _positions[_indices[corner]];
+            const osg::Vec3d& pb = _positions[_indices[nextCorner(corner)]];
+            const osg::Vec3d& p0 = _positions[_indices[t*3]];
+            osg::Vec3d normal = (_positions[_indices[t*3+1]]-p0)^(_positions[_indices[t*3+2]]-p0);
+            osg::Vec3d edgePlane = (pb-pa)^normal;
+            if (edgePlane.normalize()>0.0)
+            {
+                const double borderWeight = 10.0;
+                double weight = (pb-pa).length2()*borderWeight;
+                _quadrics[a].addPlane(edgePlane, -(edgePlane*pa), weight);
+                _quadrics[b].addPlane(edgePlane, -(edgePlane*pa), weight);
+            }
+        }
+        else if (end-i>2)
+        {
+            nonManifold[a] = 1;
+            nonManifold[b] = 1;
+        }
+        i = end;
+    }
+
+    // link the used vertices that share a position into rings of wedges.
+    IndexList usedVertices;
+    for(unsigned int v=0; v<_numVertices; ++v)
+    {
+        if (_firstCorner[v]!=INVALID) usedVertices.push_back(v);
+    }
+    std::sort(usedVertices.begin(), usedVertices.end(), PositionLess(_positions));
+
+    _wedges.resize(_numVertices);
+    for(unsigned int v=0; v<_numVertices; ++v) _wedges[v] = v;
+
+    IndexList numWedges(_numVertices, 1);
+    for(unsigned int i=0; i<usedVertices.size(); )
+    {
+        unsigned int end = i+1;
+        while(end<usedVertices.size() && _positions[usedVertices[end]]==_positions[usedVertices[i]]) ++end;
+
+        for(unsigned int j=i; j<end; ++j)
+        {
+            _wedges[usedVertices[j]] = usedVertices[(j+1<end) ? j+1 : i];
+            numWedges[usedVertices[j]] = end-i;
+        }
+        i = end;
+    }
+
+    _kinds.assign(_numVertices, LOCKED);
+    for(unsigned int v=0; v<_numVertices; ++v)
+    {
+        if (nonManifold[v]) continue;
+
+        if (numWedges[v]==1)
+        {
+            if (numBorderEdges[v]==0) _kinds[v] = MANIFOLD;
+            else if (numBorderEdges[v]==2) _kinds[v] = BORDER;
+        }
+        else if (numWedges[v]==2)
+        {
+            unsigned int partner = _wedges[v];
+            if (numBorderEdges[v]==2 && numBorderEdges[partner]==2 && !nonManifold[partner]) _kinds[v] = SEAM;
+        }
+    }
+
+    for(IndexList::const_iterator itr = protectedPoints.begin(); itr != protectedPoints.end(); ++itr)
+    {
+        if (*itr<_numVertices) _kinds[*itr] = LOCKED;
+    }
+
+    // a seam vertex whose partner is locked can't collapse with it.
+    for(unsigned int v=0; v<_numVertices; ++v)
+    {
+        if (_kinds[v]==SEAM && _kinds[_wedges[v]]!=SEAM) _kinds[v] = LOCKED;
+    }
+
+    _removedVertices.assign(_numVertices, 0);
+    _cost.assign(_numVertices, 0.0);
+    _target.assign(_numVertices, INVALID);
+    _heapPosition.assign(_numVertices, INVALID);
+    _heap.clear();
+
+    for(unsigned int v=0; v<_numVertices; ++v)
+    {
+        updateVertex(v);
+    }
+
+    return true;
+}
+
+void QuadricCollapse::collectNeighbours(unsigned int vertex, IndexList& neighbours) const
+{
+    neighbours.clear();
+    for(unsigned int corner = _firstCorner[vertex]; corner!=INVALID; corner = _nextCorner[corner])
+    {
+        if (_removedTriangles[corner/3]) continue;
+
+        neighbours.push_back(_indices[nextCorner(corner)]);
+        neighbours.push_back(_indices[prevCorner(corner)]);
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+unsigned int QuadricCollapse::countTrianglesWithEdge(unsigned int a, unsigned int b) const
+{
+    unsigned int count = 0;
+    for(unsigned int corner = _firstCorner[a]; corner!=INVALID; corner = _nextCorner[corner])
+    {
+        if (_removedTriangles[corner/3]) continue;
+        if (_indices[nextCorner(corner)]==b || _indices[prevCorner(corner)]==b) ++count;
+    }
+    return count;
+}
+
+bool QuadricCollapse::isCollapseValid(unsigned int u, unsigned int v) const
+{
+    // link condition, the only vertices adjacent to both u and v must be those of the triangles on the edge,
+    // otherwise the collapse would create a non manifold edge.
+    collectNeighbours(u, _uNeighbours);
+    collectNeighbours(v, _vNeighbours);
+
+    unsigned int numShared = 0;
+    IndexList::const_iterator uitr = _uNeighbours.begin();
+    IndexList::const_iterator vitr = _vNeighbours.begin();
+    while(uitr!=_uNeighbours.end() && vitr!=_vNeighbours.end())
+    {
+        if (*uitr<*vitr) ++uitr;
+        else if (*vitr<*uitr) ++vitr;
+        else { ++numShared; ++uitr; ++vitr; }
+    }
+
+    unsigned int numEdgeTriangles = countTrianglesWithEdge(u, v);
+    if (numEdgeTriangles==0 || numShared!=numEdgeTriangles) return false;
+
+    // reject collapses that flip, or fold over, any of the triangles that remain around u.
+    const osg::Vec3d& newPosition = _positions[v];
+    for(unsigned int corner = _firstCorner[u]; corner!=INVALID; corner = _nextCorner[corner])
+    {
+        if (_removedTriangles[corner/3]) continue;
+
+        unsigned int b = _indices[nextCorner(corner)];
+        unsigned int c = _indices[prevCorner(corner)];
+        if (b==v || c==v) continue;
+
+        const osg::Vec3d& pb = _positions[b];
+        const osg::Vec3d& pc = _positions[c];
+        osg::Vec3d before = (pb-_positions[u])^(pc-_positions[u]);
+        osg::Vec3d after = (pb-newPosition)^(pc-newPosition);
+
+        double before2 = before.length2();
+        if (before2==0.0) continue;
+
+        if (before*after <= 0.25*sqrt(before2*after.length2())) return false;
+    }
+
+    return true;
+}
+
+bool QuadricCollapse::findSeamPartners(unsigned int u, unsigned int v, unsigned int& uPartner, unsigned int& vPartner) const
+{
+    uPartner = _wedges[u];
+    for(vPartner = _wedges[v]; vPartner!=v; vPartner = _wedges[vPartner])
+    {
+        if (countTrianglesWithEdge(uPartner, vPartner)==1) return true;
+    }
+    return false;
+}
+
+bool QuadricCollapse::computeCollapseCost(unsigned int u, unsigned int v, double& cost) const
+{
+    if (_removedVertices[v]) return false;
+
+    switch(_kinds[u])
+    {
+        case(MANIFOLD):
+        {
+            cost = _quadrics[u].evaluate(_positions[v])/osg::maximum(_quadrics[u].w, DBL_MIN);
+            return true;
+        }
+        case(BORDER):
+        {
+            if (_kinds[v]!=BORDER && _kinds[v]!=LOCKED) return false;
+            if (countTrianglesWithEdge(u, v)!=1) return false;
+
+            cost = _quadrics[u].evaluate(_positions[v])/osg::maximum(_quadrics[u].w, DBL_MIN);
+            return true;
+        }
+        case(SEAM):
+        {
+            if (_kinds[v]!=SEAM && _kinds[v]!=LOCKED) return false;
+            if (countTrianglesWithEdge(u, v)!=1) return false;
+
+            unsigned int uPartner, vPartner;
+            if (!findSeamPartners(u, v, uPartner, vPartner)) return false;
+
+            Quadric combined = _quadrics[u];
+            combined.add(_quadrics[uPartner]);
+            cost = combined.evaluate(_positions[v])/osg::maximum(combined.w, DBL_MIN);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool QuadricCollapse::isCollapseAllowed(unsigned int u, unsigned int v) const
+{
+    if (!isCollapseValid(u, v)) return false;
+
+    if (_kinds[u]==SEAM)
+    {
+        unsigned int uPartner, vPartner;
+        if (!findSeamPartners(u, v, uPartner, vPartner) || !isCollapseValid(uPartner, vPartner)) return false;
+    }
+
+    return true;
+}
+
+void QuadricCollapse::updateVertex(unsigned int vertex)
+{
+    if (_removedVertices[vertex] || _kinds[vertex]==LOCKED)
+    {
+        heapRemove(vertex);
+        return;
+    }
+
+    collectNeighbours(vertex, _neighbours);
+
+    _candidates.clear();
+    for(IndexList::const_iterator itr = _neighbours.begin(); itr != _neighbours.end(); ++itr)
+    {
+        double cost;
+        if (computeCollapseCost(vertex, *itr, cost)) _candidates.push_back(Candidate(cost, *itr));
+    }
+
+    // the topology checks are the expensive part, so only check the candidates in order until one passes.
+    std::sort(_candidates.begin(), _candidates.end());
+
+    for(Candidates::const_iterator itr = _candidates.begin(); itr != _candidates.end(); ++itr)
+    {
+        if (isCollapseAllowed(vertex, itr->second))
+        {
+            _target[vertex] = itr->second;
+            _cost[vertex] = itr->first;
+            heapUpdate(vertex);
+            return;
+        }
+    }
+
+    heapRemove(vertex);
+}
+
+void QuadricCollapse::collapse(unsigned int u, unsigned int v)
+{
+    for(unsigned int corner = _firstCorner[u]; corner!=INVALID; corner = _nextCorner[corner])
+    {
+        unsigned int t = corner/3;
+        if (_removedTriangles[t]) continue;
+
+        if (_indices[nextCorner(corner)]==v || _indices[prevCorner(corner)]==v)
+        {
+            _removedTriangles[t] = 1;
+            --_numTriangles;
+        }
+        else
+        {
+            _indices[corner] = v;
+        }
+    }
+
+    // hand u's corners over to v, dropping the corners of removed triangles so the lists stay short.
+    unsigned int lists[2] = { _firstCorner[v], _firstCorner[u] };
+    _firstCorner[v] = INVALID;
+    _lastCorner[v] = INVALID;
+    _firstCorner[u] = INVALID;
+    _lastCorner[u] = INVALID;
+    for(unsigned int i=0; i<2; ++i)
+    {
+        unsigned int corner = lists[i];
+        while(corner!=INVALID)
+        {
+            unsigned int next = _nextCorner[corner];
+            if (!_removedTriangles[corner/3]) addCorner(corner, v);
+            corner = next;
+        }
+    }
+
+    _quadrics[v].add(_quadrics[u]);
+    _removedVertices[u] = 1;
+    heapRemove(u);
+}
+
+bool QuadricCollapse::collapseNext()
+{
+    if (_heap.empty()) return false;
+
+    unsigned int u = _heap[0];
+    unsigned int v = _target[u];
+
+    // the costs of the neighbourhood are kept up to date, but recheck in case the choice has gone stale.
+    double cost;
+    if (!computeCollapseCost(u, v, cost) || cost!=_cost[u] || !isCollapseAllowed(u, v))
+    {
+        updateVertex(u);
+        return true;
+    }
+
+    unsigned int uPartner = INVALID, vPartner = INVALID;
+    if (_kinds[u]==SEAM) findSeamPartners(u, v, uPartner, vPartner);
+
+    collapse(u, v);
+    if (uPartner!=INVALID) collapse(uPartner, vPartner);
+
+    IndexList affected;
+    collectNeighbours(v, affected);
+    affected.push_back(v);
+    if (vPartner!=INVALID)
+    {
+        IndexList partnerNeighbours;
+        collectNeighbours(vPartner, partnerNeighbours);
+        affected.insert(affected.end(), partnerNeighbours.begin(), partnerNeighbours.end());
+        affected.push_back(vPartner);
+    }
+
+    for(IndexList::const_iterator itr = affected.begin(); itr != affected.end(); ++itr)
+    {
+        updateVertex(*itr);
+    }
+
+    return true;
+}
+
+void QuadricCollapse::heapUp(unsigned int position)
+{
+    unsigned int vertex = _heap[position];
+    while(position>0)
+    {
+        unsigned int parent = (position-1)/2;
+        if (!heapLess(vertex, _heap[parent])) break;
+
+        _heap[position] = _heap[parent];
+        _heapPosition[_heap[position]] = position;
+        position = parent;
+    }
+    _heap[position] = vertex;
+    _heapPosition[vertex] = position;
+}
+
+void QuadricCollapse::heapDown(unsigned int position)
+{
+    unsigned int vertex = _heap[position];
+    unsigned int size = _heap.size();
+    for(;;)
+    {
+        unsigned int child = position*2+1;
+        if (child>=size) break;
+        if (child+1<size && heapLess(_heap[child+1], _heap[child])) ++child;
+        if (!heapLess(_heap[child], vertex)) break;
+
+        _heap[position] = _heap[child];
+        _heapPosition[_heap[position]] = position;
+        position = child;
+    }
+    _heap[position] = vertex;
+    _heapPosition[vertex] = position;
+}
+
+void QuadricCollapse::heapUpdate(unsigned int vertex)
+{
+    unsigned int position = _heapPosition[vertex];
+    if (position==INVALID)
+    {
+        _heap.push_back(vertex);
+        heapUp(_heap.size()-1);
+    }
+    else
+    {
+        heapUp(position);
+        heapDown(_heapPosition[vertex]);
+    }
+}
+
+void QuadricCollapse::heapRemove(unsigned int vertex)
+{
+    unsigned int position = _heapPosition[vertex];
+    if (position==INVALID) return;
+
+    _heapPosition[vertex] = INVALID;
+
+    unsigned int last = _heap.back();
+    _heap.pop_back();
+    if (last==vertex) return;
+
+    _heap[position] = last;
+    _heapPosition[last] = position;
+    heapUp(position);
+    heapDown(_heapPosition[last]);
+}
+
+void QuadricCollapse::copyToGeometry(osg::Geometry& geometry) const
+{
+    // keep the vertices still in use, in their original order so the arrays can be compacted in place.
+    IndexList remap(_numVertices, INVALID);
+    for(unsigned int t=0; t<_removedTriangles.size(); ++t)
+    {
+        if (_removedTriangles[t]) continue;
+        for(unsigned int i=0; i<3; ++i) remap[_indices[t*3+i]] = 0;
+    }
+
+    IndexList kept;
+    for(unsigned int v=0; v<_numVertices; ++v)
+    {
+        if (remap[v]==INVALID) continue;
+        remap[v] = kept.size();
+        kept.push_back(v);
+    }
+
+    CompactArrayVisitor compactArray(kept);
+
+    osg::Geometry::ArrayList arrays;
+    geometry.getArrayList(arrays);
+    for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr)
+    {
+        osg::Array* array = itr->get();
+        if (array->getNumElements()==_numVertices &&
+            (array==geometry.getVertexArray() || array->getBinding()==osg::Array::BIND_PER_VERTEX))
+        {
+            array->accept(compactArray);
+        }
+    }
+
+    osg::DrawElementsUInt* primitives = new osg::DrawElementsUInt(GL_TRIANGLES);
+    primitives->reserve(_numTriangles*3);
+    for(unsigned int t=0; t<_removedTriangles.size(); ++t)
+    {
+        if (_removedTriangles[t]) continue;
+        for(unsigned int i=0; i<3; ++i) primitives->push_back(remap[_indices[t*3+i]]);
+    }
+
+    geometry.getPrimitiveSetList().clear();
+    geometry.addPrimitiveSet(primitives);
+    geometry.dirtyBound();
+}
+
+void finishSimplifiedGeometry(osg::Geometry& geometry, bool smoothing, bool triStrip)
+{
+    if (smoothing)
+    {
+        osgUtil::SmoothingVisitor::smooth(geometry);
+    }
+
+    if (triStrip)
+    {
+        osgUtil::optimizeMesh(&geometry);
+    }
+}
+
+class SimplifyGeometriesOperation : public osg::Operation
+{
+public:
+    SimplifyGeometriesOperation(Simplifier& simplifier):
+        osg::Operation("SimplifyGeometriesOperation", false),
+        _simplifier(simplifier) {}
+
+    virtual void operator () (osg::Object*)
+    {
+        for(std::vector<osg::Geometry*>::iterator itr = _geometries.begin();
+            itr != _geometries.end();
+            ++itr)
+        {
+            _simplifier.simplify(**itr);
+        }
+    }
+
+    Simplifier&                     _simplifier;
+    std::vector<osg::Geometry*>     _geometries;
+};
+
+}
+
 Simplifier::Simplifier(double sampleRatio, double maximumError, double maximumLength):
             osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
             _sampleRatio(sampleRatio),
@@ -1745,6 +2542,35 @@ void Simplifier::simplify(osg::Geometry& geometry, const IndexList& protectedPoi
 
     bool downSample = requiresDownSampling();
 
+    if (downSample)
+    {
+        if (geometry.containsSharedArrays())
+        {
+            OSG_INFO<<"Simplifier::simplify(..): Duplicate shared arrays"<<std::endl;
+            geometry.duplicateSharedArrays();
+        }
+
+        QuadricCollapse qc;
+        if (qc.setGeometry(geometry, protectedPoints))
+        {
+            unsigned int numOriginalPrimitives = qc.getNumTriangles();
+
+            while (!qc.empty() &&
+                   continueSimplification(qc.getNextError(), numOriginalPrimitives, qc.getNumTriangles()) &&
+                   qc.collapseNext())
+            {
+            }
+
+            OSG_INFO<<"Simplifier, in = "<<numOriginalPrimitives<<"\tout = "<<qc.getNumTriangles()<<"\terror="<<qc.getNextError()<<"\tvs "<<getMaximumError()<<std::endl;
+
+            qc.copyToGeometry(geometry);
+            finishSimplifiedGeometry(geometry, _smoothing, _triStrip);
+            return;
+        }
+
+        // fall back to the general EdgeCollapse for vertex arrays other than Vec3Array and Vec3dArray.
+    }
+
     EdgeCollapse ec;
     ec.setComputeErrorMetricUsingLength(!downSample);
     ec.setGeometry(&geometry, protectedPoints);
@@ -1795,14 +2621,101 @@ void Simplifier::simplify(osg::Geometry& geometry, const IndexList& protectedPoi
 
     ec.copyBackToGeometry();
 
-    if (_smoothing)
+    finishSimplifiedGeometry(geometry, _smoothing, _triStrip);
+}
+
+void Simplifier::simplifyCollectedGeometries()
+{
+    if (!_taskPool.valid() || _geometryList.size()<2)
     {
-        osgUtil::SmoothingVisitor::smooth(geometry);
+        for(std::set<osg::Geometry*>::iterator itr = _geometryList.begin();
+            itr != _geometryList.end();
+            ++itr)
+        {
+            simplify(**itr);
+        }
+        _geometryList.clear();
+        return;
     }
 
-    if (_triStrip)
+    // dirty the bounds up front so that the dirtyBound() calls made by the tasks don't propagate to parents that
+    // may be shared with geometries on other threads.
+    for(std::set<osg::Geometry*>::iterator itr = _geometryList.begin();
+        itr != _geometryList.end();
+        ++itr)
     {
-        osgUtil::optimizeMesh(&geometry);
+        (*itr)->dirtyBound();
     }
 
+    GeometryCollector::GeometryPartitions partitions;
+    GeometryCollector::partitionGeometries(_geometryList, partitions);
+    _geometryList.clear();
+
+    osg::ref_ptr<osg::TaskSet> taskSet = new osg::TaskSet;
+    for(GeometryCollector::GeometryPartitions::iterator itr = partitions.begin();
+        itr != partitions.end();
+        ++itr)
+    {
+        osg::ref_ptr<SimplifyGeometriesOperation> operation = new SimplifyGeometriesOperation(*this);
+        operation->_geometries = *itr;
+        _taskPool->add(operation.get(), taskSet.get());
+    }
+    _taskPool->wait(taskSet.get());
+}
+
+void Simplifier::buildLODChain(const osg::Geometry& geometry, const SampleRatioList& sampleRatios, LODChain& levels)
+{
+    levels.clear();
+
+    QuadricCollapse qc;
+    if (!qc.setGeometry(geometry, IndexList()))
+    {
+        OSG_NOTICE<<"Simplifier::buildLODChain(..) geometry requires a Vec3Array or Vec3dArray vertex array."<<std::endl;
+        return;
+    }
+
+    unsigned int numOriginalPrimitives = qc.getNumTriangles();
+
+    for(SampleRatioList::const_iterator itr = sampleRatios.begin();
+        itr != sampleRatios.end();
+        ++itr)
+    {
+        while (!qc.empty() &&
+               continueLevelSimplification(*itr, qc.getNextError(), numOriginalPrimitives, qc.getNumTriangles()) &&
+               qc.collapseNext())
+        {
+        }
+
+        osg::ref_ptr<osg::Geometry> level = new osg::Geometry(geometry, osg::CopyOp::DEEP_COPY_ARRAYS | osg::CopyOp::DEEP_COPY_PRIMITIVES);
+        qc.copyToGeometry(*level);
+        finishSimplifiedGeometry(*level, _smoothing, _triStrip);
+
+        levels.push_back(level);
+    }
+}
+
+bool Simplifier::continueLevelSimplification(double sampleRatio, float nextError, unsigned int numOriginalPrimitives, unsigned int numRemainingPrimitives) const
+{
+    if ((float)numRemainingPrimitives <= ((float)numOriginalPrimitives) * sampleRatio || nextError>getMaximumError()) return false;
+
+    return !_continueSimplificationCallback.valid() ||
+           _continueSimplificationCallback->continueSimplification(*this, nextError, numOriginalPrimitives, numRemainingPrimitives);
+}
+
+void Simplifier::addLODChain(osg::LOD& lod, osg::Geometry& geometry, const SampleRatioList& sampleRatios, float rangeScale)
+{
+    LODChain levels;
+    buildLODChain(geometry, sampleRatios, levels);
+
+    float radius = geometry.getBound().radius();
+    float minRange = 0.0f;
+    for(unsigned int i=0; i<=levels.size(); ++i)
+    {
+        float maxRange = (i<levels.size()) ? rangeScale*radius/sqrtf(osg::maximum(sampleRatios[i], FLT_MIN)) : FLT_MAX;
+
+        if (i==0) lod.addChild(&geometry, minRange, maxRange);
+        else lod.addChild(levels[i-1].get(), minRange, maxRange);
+
+        minRange = maxRange;
+    }
 }
@@ -49,17 +49,65 @@ void StateGraph::clean()
 /** recursively prune the StateGraph of empty children.*/
 void StateGraph::prune()
 {
-    // call prune on all children.
-    ChildList::iterator citr=_children.begin();
-    while(citr!=_children.end())
+    // call prune on all children, compacting the non empty children to the front of the list
+    // and returning the empty ones to the pool.
+    ChildList::iterator insert_itr = _children.begin();
+    for(ChildList::iterator citr=_children.begin();
+        citr!=_children.end();
+        ++citr)
     {
         citr->second->prune();
 
         if (citr->second->empty())
         {
-            ChildList::iterator ditr= citr++;
-            _children.erase(ditr);
+            StateGraph* child = citr->second.get();
+            if (_pool.valid() && child->_pool==_pool && child->referenceCount()==1)
+            {
+                // release the child's references so the pool doesn't keep them, or itself, alive.
+                child->_parent = NULL;
+                child->_stateset = NULL;
+                child->_userData = 0;
+                child->_pool = 0;
+                _pool->_freeList.push_back(child);
+            }
+            citr->second = 0;
         }
-        else ++citr;
+        else
+        {
+            if (insert_itr!=citr) *insert_itr = *citr;
+            ++insert_itr;
+        }
+    }
+
+    if (insert_itr!=_children.end()) _children.erase(insert_itr, _children.end());
+}
+
+StateGraph* StateGraph::createChild(const osg::StateSet* stateset)
+{
+    if (!_pool.valid()) _pool = new Pool;
+
+    if (_pool->_freeList.empty())
+    {
+        ++(_pool->_numAllocated);
+
+        StateGraph* sg = new StateGraph(this,stateset);
+        sg->_pool = _pool;
+        return sg;
     }
+
+    ++(_pool->_numReused);
+
+    // take the reference from the pool, the caller takes over ownership when adding it to the children list.
+    osg::ref_ptr<StateGraph> sg = _pool->_freeList.back();
+    _pool->_freeList.pop_back();
+
+    sg->_parent = this;
+    sg->_stateset = stateset;
+    sg->_depth = _depth + 1;
+    sg->_averageDistance = 0.0f;
+    sg->_minimumDistance = 0.0f;
+    sg->_pool = _pool;
+    sg->_dynamic = _dynamic ? true : stateset->getDataVariance()==osg::Object::DYNAMIC;
+
+    return sg.release();
 }
@@ -31,16 +31,20 @@ char shadergen_vert[] = "// ShaderGen shader\n"
                         "\n"
                         "void main()\n"
                         "{\n"
+                        "#if defined(OSG_QUANTIZED_POSITION)\n"
+                        "  gl_Position = gl_ModelViewProjectionMatrix * osg_decodePosition(gl_Vertex);\n"
+                        "#else\n"
                         "  gl_Position = ftransform();\n"
+                        "#endif\n"
                         "\n"
                         "#if defined(GL_TEXTURE_2D)\n"
-                        "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+                        "  gl_TexCoord[0] = osg_decodeTexCoord0(gl_MultiTexCoord0);\n"
                         "#endif\n"
                         "\n"
                         "  vertexColor = gl_Color;\n"
                         "\n"
                         "#if defined(GL_LIGHTING)\n"
-                        "    directionalLight(0, gl_Normal, vertexColor);\n"
+                        "    directionalLight(0, osg_decodeNormal(gl_Normal), vertexColor);\n"
                         "#endif\n"
                         "}\n"
                         "\n";
@@ -1377,6 +1377,11 @@ void CompositeViewer::updateTraversal()
     osgDB::Registry::instance()->updateTimeStampOfObjectsInCacheWithExternalReferences(*getFrameStamp());
     osgDB::Registry::instance()->removeExpiredObjectsInCache(*getFrameStamp());
 
+    if (getViewerStats() && getViewerStats()->collectStats("update") && osgDB::Registry::instance()->getObjectCache())
+    {
+        osgDB::Registry::instance()->getObjectCache()->reportStats(getViewerStats(), getFrameStamp()->getFrameNumber());
+    }
+
 
     if (_incrementalCompileOperation.valid())
     {
@@ -1448,6 +1453,14 @@ void CompositeViewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+
+        for(Scenes::iterator sitr = scenes.begin();
+            sitr != scenes.end();
+            ++sitr)
+        {
+            Scene* scene = *sitr;
+            if (scene->getDatabasePager()) scene->getDatabasePager()->reportStats(_frameStamp->getFrameNumber(), *getViewerStats());
+        }
     }
 
 }
@@ -632,6 +632,15 @@ static void collectSceneViewStats(unsigned int frameNumber, osgUtil::SceneView*
     stats->setAttribute(frameNumber, "Visible number of impostors", static_cast<double>(sceneStats.nimpostor));
     stats->setAttribute(frameNumber, "Number of ordered leaves", static_cast<double>(sceneStats.numOrderedLeaves));
 
+    const osgUtil::CullVisitor* cullVisitor = sceneView->getCullVisitor();
+    if (cullVisitor)
+    {
+        stats->setAttribute(frameNumber, "Number of RenderLeaves allocated", static_cast<double>(cullVisitor->getNumRenderLeavesAllocated()));
+        stats->setAttribute(frameNumber, "Number of RenderLeaves reused", static_cast<double>(cullVisitor->getNumRenderLeavesReused()));
+        stats->setAttribute(frameNumber, "Number of cull matrices allocated", static_cast<double>(cullVisitor->getNumMatricesAllocated()));
+        stats->setAttribute(frameNumber, "Number of cull matrices reused", static_cast<double>(cullVisitor->getNumMatricesReused()));
+    }
+
     unsigned int totalNumPrimitiveSets = 0;
     const osgUtil::Statistics::PrimitiveValueMap& pvm = sceneStats.getPrimitiveValueMap();
     for(osgUtil::Statistics::PrimitiveValueMap::const_iterator pvm_itr = pvm.begin();
@@ -1159,6 +1159,11 @@ void Viewer::updateTraversal()
     osgDB::Registry::instance()->updateTimeStampOfObjectsInCacheWithExternalReferences(*getFrameStamp());
     osgDB::Registry::instance()->removeExpiredObjectsInCache(*getFrameStamp());
 
+    if (getViewerStats() && getViewerStats()->collectStats("update") && osgDB::Registry::instance()->getObjectCache())
+    {
+        osgDB::Registry::instance()->getObjectCache()->reportStats(getViewerStats(), getFrameStamp()->getFrameNumber());
+    }
+
 
     if (_updateOperations.valid())
     {
@@ -1223,6 +1228,11 @@ void Viewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+
+        if (_scene.valid() && _scene->getDatabasePager())
+        {
+            _scene->getDatabasePager()->reportStats(_frameStamp->getFrameNumber(), *getViewerStats());
+        }
     }
 }
 
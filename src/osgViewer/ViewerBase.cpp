@@ -25,6 +25,7 @@
 #include <osg/TextureRectangle>
 #include <osg/TexMat>
 #include <osg/DeleteHandler>
+#include <osg/BackgroundDeleteHandler>
 
 #include <osgDB/Registry>
 
@@ -39,6 +40,7 @@ static osg::ApplicationUsageProxy ViewerBase_e3(osg::ApplicationUsage::ENVIRONME
 static osg::ApplicationUsageProxy ViewerBase_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_RUN_FRAME_SCHEME","Frame rate manage scheme that viewer run should use,  ON_DEMAND or CONTINUOUS (default).");
 static osg::ApplicationUsageProxy ViewerBase_e5(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_RUN_MAX_FRAME_RATE","Set the maximum number of frame as second that viewer run. 0.0 is default and disables an frame rate capping.");
 static osg::ApplicationUsageProxy ViewerBase_e6(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_RUN_FRAME_COUNT", "Set the maximum number of frames to run the viewer run method.");
+static osg::ApplicationUsageProxy ViewerBase_e7(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_BACKGROUND_DELETE <mode>","ON | OFF, Delete released objects on a background thread using an osg::BackgroundDeleteHandler.");
 
 using namespace osgViewer;
 
@@ -79,6 +81,11 @@ void ViewerBase::viewerBaseInit()
 
     osg::getEnvVar("OSG_RUN_MAX_FRAME_RATE", _runMaxFrameRate);
 
+    if (osg::getEnvVar("OSG_BACKGROUND_DELETE", str) && str=="ON" && !osg::Referenced::getDeleteHandler())
+    {
+        osg::Referenced::setDeleteHandler(new osg::BackgroundDeleteHandler);
+    }
+
     _useConfigureAffinity = true;
 }
 
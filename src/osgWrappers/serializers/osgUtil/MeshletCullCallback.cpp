@@ -0,0 +1,48 @@
+#undef OBJECT_CAST
+#define OBJECT_CAST dynamic_cast
+
+#include <osgUtil/MeshOptimizers>
+#include <osgDB/ObjectWrapper>
+#include <osgDB/InputStream>
+#include <osgDB/OutputStream>
+
+// _boundingSphere
+static bool checkBoundingSphere( const osgUtil::MeshletCullCallback& callback )
+{
+    return callback.getBoundingSphere().valid();
+}
+
+static bool readBoundingSphere( osgDB::InputStream& is, osgUtil::MeshletCullCallback& callback )
+{
+    osg::Vec3d center;
+    double radius;
+    is >> is.BEGIN_BRACKET;
+    is >> is.PROPERTY("Center") >> center;
+    is >> is.PROPERTY("Radius") >> radius;
+    is >> is.END_BRACKET;
+    callback.setBoundingSphere( osg::BoundingSphere(center, radius) );
+    return true;
+}
+
+static bool writeBoundingSphere( osgDB::OutputStream& os, const osgUtil::MeshletCullCallback& callback )
+{
+    const osg::BoundingSphere& bs = callback.getBoundingSphere();
+    os << os.BEGIN_BRACKET << std::endl;
+    os << os.PROPERTY("Center") << osg::Vec3d(bs.center()) << std::endl;
+    os << os.PROPERTY("Radius") << double(bs.radius()) << std::endl;
+    os << os.END_BRACKET << std::endl;
+    return true;
+}
+
+REGISTER_OBJECT_WRAPPER( MeshletCullCallback,
+                         new osgUtil::MeshletCullCallback,
+                         osgUtil::MeshletCullCallback,
+                         "osg::Object osg::Callback osgUtil::MeshletCullCallback" )
+{
+    ADD_USER_SERIALIZER( BoundingSphere );  // _boundingSphere
+    ADD_VEC3_SERIALIZER( ConeAxis, osg::Vec3() );  // _coneAxis
+    ADD_FLOAT_SERIALIZER( ConeCutoff, 1.0f );  // _coneCutoff
+}
+
+#undef OBJECT_CAST
+#define OBJECT_CAST static_cast